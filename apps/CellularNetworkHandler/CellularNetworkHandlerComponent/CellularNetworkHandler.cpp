@@ -10,10 +10,18 @@
 #include "interfaces.h"
 #include "CellularNetwork/CellularNetwork.h"
 #include "CellularNetwork/CellularNetworkUtils.h"
-#include "Utils/SystemUtils.h"
+#include "Network/LinkLivenessTracker.h"
+#include "Network/NetlinkMonitor.h"
+#include "Network/VpnTunnel.h"
 #include "Utils/TimeUpdater.h"
+#include <unordered_map>
 
+using namespace AtChannelConstants;
+using namespace AtChannelTypes;
 using namespace CellularNetworkConstants;
+using namespace LinkLivenessTypes;
+using namespace NetlinkMonitorTypes;
+using namespace VpnTunnelTypes;
 
 static const std::string CONNECTIVITY_LED_NAME              = "RGB_D2";
 static const std::string CONNECTIVITY_LED_CMD_CONNECTED     = "On";
@@ -22,19 +30,110 @@ static const uint8_t CONNECTIVITY_LED_RED                   = 0x03;
 static const uint8_t CONNECTIVITY_LED_GREEN                 = 0x00;
 static const uint8_t CONNECTIVITY_LED_BLUE                  = 0x36;
 
+/* Time between two checks of the time update */
+static const uint32_t TIME_UPDATE_POLL_MS                   = 2000;
+
+/* What the supervision timer does when it expires */
+enum SupervisionAction
+{
+    SUPERVISION_HEARTBEAT,
+    SUPERVISION_RECONNECT,
+    SUPERVISION_WAIT_TIME
+};
+
+static CellularNetwork cellNetwork;
+static ConnectivityProber linkProber;
+static LinkLivenessTracker linkTracker(linkProber);
+static NetlinkMonitor netlink;
+static int32_t netlinkSubscriberId = -1;
+static VpnTunnel vpnTunnel;
+static le_timer_Ref_t supervisionTimer;
+static SupervisionAction supervisionAction = SUPERVISION_HEARTBEAT;
+static uint8_t reconnectStage = 0;
+
+/* Size of the buffer of the caller of each API call awaiting its answer */
+static std::unordered_map<AtChannel_ServerCmdRef_t, size_t> apiBufferSizes;
+
 /*!
- * @brief Main function of the CellularNetworkHandler component. Start and
- * maintain network connectivity.
+ * @brief Arm the supervision timer
  *
+ * @param[in] action    What to do when the timer expires
+ * @param[in] delayMs   Delay before the action
+ *
+ * @return None
  * */
-COMPONENT_INIT
+static void scheduleSupervision(SupervisionAction action, uint32_t delayMs)
 {
-    CellularNetwork cellNetwork;
-    uint8_t reconnectStage = 0;
-    bool isConnected = false;
-    char env[] = "PATH=/legato/systems/current/bin:/usr/local/bin:"
-                "/usr/bin:/bin:/usr/local/sbin:/usr/sbin:/sbin";
-    putenv(env);
+    supervisionAction = action;
+
+    le_timer_Stop(supervisionTimer);
+    le_timer_SetMsInterval(supervisionTimer, delayMs);
+    le_timer_Start(supervisionTimer);
+}
+
+/*!
+ * @brief Handler of the changes of the cellular interface: losing the link,
+ * its address or its default route is checked at once
+ *
+ * @param[in] eventPtr      Change of the interface
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ * */
+static void onInterfaceEvent(const NetlinkEvent* eventPtr, void* contextPtr)
+{
+    LE_WARN("Cellular interface %s changed (0x%02X)", eventPtr->ifName,
+            eventPtr->type);
+
+    netlink.unsubscribe(netlinkSubscriberId);
+    netlinkSubscriberId = -1;
+
+    linkTracker.stop();
+    scheduleSupervision(SUPERVISION_HEARTBEAT, 0);
+}
+
+/*!
+ * @brief Watch the cellular interface of the data connection
+ *
+ * @return None
+ * */
+static void watchInterface(void)
+{
+    char ifName[IFNAMSIZ] = {0};
+
+    if ((netlinkSubscriberId >= 0) ||
+        !cellNetwork.getInterfaceName(ifName, sizeof(ifName)))
+    {
+        return;
+    }
+
+    netlinkSubscriberId = netlink.subscribe(ifName, NETLINK_LINK_DOWN |
+                                            NETLINK_ADDRESS_REMOVED |
+                                            NETLINK_DEFAULT_ROUTE_REMOVED,
+                                            onInterfaceEvent, NULL);
+}
+
+/*!
+ * @brief Handler of the connectivity check. Once connected, wait for the
+ * time update then track the link from the traffic. Otherwise, restart the
+ * data connection after a delay growing with the number of failed attempts.
+ *
+ * @param[in] isConnected   True if the internet is reachable
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ * */
+static void onConnectivity(bool isConnected, void* contextPtr)
+{
+    if (isConnected)
+    {
+        LE_INFO("Successfull heartbeat");
+
+        watchInterface();
+
+        scheduleSupervision(SUPERVISION_WAIT_TIME, 0);
+        return;
+    }
 
     LEDsHandler_setLedCommand(CONNECTIVITY_LED_NAME.c_str(),
                                 CONNECTIVITY_LED_CMD_NOT_CONNECTED.c_str(),
@@ -42,69 +141,476 @@ COMPONENT_INIT
                                 CONNECTIVITY_LED_GREEN,
                                 CONNECTIVITY_LED_BLUE);
 
-    cellNetwork.open();
+    /* Closing the connection removes the interface address */
+    netlink.unsubscribe(netlinkSubscriberId);
+    netlinkSubscriberId = -1;
+
+    linkTracker.stop();
+    cellNetwork.close();
 
-    while(1)
+    LE_DEBUG("Reconnect stage %d, %d "
+            "seconds before new attempt",
+            reconnectStage,
+            RECONNECT_SLEEPTIMES[reconnectStage]);
+
+    scheduleSupervision(SUPERVISION_RECONNECT,
+                        RECONNECT_SLEEPTIMES[reconnectStage] * 1000);
+
+    /* Adjust the time to wait before reseting the connection */
+    if (reconnectStage < (RECONNECT_SLEEPTIMES.size() - 1))
     {
-        isConnected = cellNetwork.checkConnectivity();
+        reconnectStage++;
+    }
+}
 
-        while(!isConnected)
-        {
-            LEDsHandler_setLedCommand(CONNECTIVITY_LED_NAME.c_str(),
-                                    CONNECTIVITY_LED_CMD_NOT_CONNECTED.c_str(),
-                                    CONNECTIVITY_LED_RED,
-                                    CONNECTIVITY_LED_GREEN,
-                                    CONNECTIVITY_LED_BLUE);
+/*!
+ * @brief Check the connectivity, without blocking the event loop: the
+ * result is handled by onConnectivity()
+ *
+ * @return None
+ * */
+static void heartbeat(void)
+{
+    cellNetwork.checkConnectivity(onConnectivity, NULL);
+}
 
+/*!
+ * @brief Handler of the end of the cellular bring-up
+ *
+ * @param[in] isConnected   True if the data connection is up
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ * */
+static void onBringUp(bool isConnected, void* contextPtr)
+{
+    if (!isConnected)
+    {
+        LE_WARN("Cellular bring-up failed");
+    }
 
-            cellNetwork.close();
+    /* The connectivity is checked either way, it is restarted if needed */
+    heartbeat();
+}
+
+/*!
+ * @brief Handler of the link liveness: a link confirmed down is checked
+ * once more, then restarted
+ *
+ * @param[in] state         State of the link
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ * */
+static void onLinkState(LinkState state, void* contextPtr)
+{
+    if (state == LINK_DOWN)
+    {
+        linkTracker.logStats();
+        cellNetwork.getDnsCache().logStats();
+        linkTracker.stop();
+        scheduleSupervision(SUPERVISION_HEARTBEAT, 0);
+    }
+}
+
+/*!
+ * @brief Handler of the VPN tunnel events
+ *
+ * @param[in] eventPtr      Event of the tunnel
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ * */
+static void onTunnelEvent(const TunnelEvent* eventPtr, void* contextPtr)
+{
+    switch (eventPtr->type)
+    {
+        case TUNNEL_EVENT_UP:
+            LE_INFO("VPN tunnel up, address %s", eventPtr->localAddress);
+            linkTracker.reportTunnel(true);
+            break;
 
-            /* This sleep seems necessary, otherwise radio and
-             * data connection init fails */
-            sleep(5);
+        case TUNNEL_EVENT_DOWN:
+            vpnTunnel.logStats();
+            linkTracker.reportTunnel(false);
+            break;
 
-            cellNetwork.open();
+        case TUNNEL_EVENT_RTT:
+            LE_DEBUG("VPN tunnel RTT %u ms (smoothed %u ms)", eventPtr->rttMs,
+                        eventPtr->smoothedRttMs);
+            linkTracker.reportTunnel(true);
+            break;
 
-            LE_DEBUG("Reconnect stage %d, %d "
-                    "seconds before new attempt",
-                    reconnectStage,
-                    RECONNECT_SLEEPTIMES[reconnectStage]);
+        default:
+            break;
+    }
+}
 
-            /* Wait before next check */
-            sleep(RECONNECT_SLEEPTIMES[reconnectStage]);
+/*!
+ * @brief Handler of the supervision timer
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void onSupervisionTimer(le_timer_Ref_t timerRef)
+{
+    switch (supervisionAction)
+    {
+        case SUPERVISION_HEARTBEAT:
+            heartbeat();
+            break;
 
-            /* Adjust the time to wait before checking and reseting the
-             * connection. */
-            if (reconnectStage < (RECONNECT_SLEEPTIMES.size() - 1))
+        case SUPERVISION_RECONNECT:
+            cellNetwork.open(onBringUp, NULL);
+            break;
+
+        case SUPERVISION_WAIT_TIME:
+        {
+            TimeUpdater timeUpdater;
+
+            if (false == timeUpdater.getTimeUpdateStatus())
             {
-                reconnectStage++;
+                scheduleSupervision(SUPERVISION_WAIT_TIME,
+                                    TIME_UPDATE_POLL_MS);
+                break;
             }
 
-            isConnected = cellNetwork.checkConnectivity();
-        }
+            LEDsHandler_setLedCommand(CONNECTIVITY_LED_NAME.c_str(),
+                                        CONNECTIVITY_LED_CMD_CONNECTED.c_str(),
+                                        CONNECTIVITY_LED_RED,
+                                        CONNECTIVITY_LED_GREEN,
+                                        CONNECTIVITY_LED_BLUE);
 
-        LE_INFO("Successfull heartbeat, next one in %d seconds",
-                                                        HEARTBEAT_PERIOD_S);
+            /* Supervised from the event loop, restarted if it exits:
+             * nothing is done if it already runs */
+            vpnTunnel.start();
 
-        TimeUpdater timeUpdater;
-        while(false == timeUpdater.getTimeUpdateStatus())
-        {
-            sleep(2);
+            /* Reset the connecting stage */
+            reconnectStage = 0;
+
+            /* No more periodic heartbeat: the traffic of all the apps, seen
+             * on the bearer counters, and the VPN tunnel prove the link
+             * alive, and it is only probed when idle */
+            linkTracker.start(onLinkState, NULL);
+            break;
         }
 
-        LEDsHandler_setLedCommand(CONNECTIVITY_LED_NAME.c_str(),
-                                    CONNECTIVITY_LED_CMD_CONNECTED.c_str(),
-                                    CONNECTIVITY_LED_RED,
-                                    CONNECTIVITY_LED_GREEN,
-                                    CONNECTIVITY_LED_BLUE);
+        default:
+            break;
+    }
+}
+
+/*!
+ * @brief Get the result of the AtChannel API matching an AT result
+ *
+ * @param[in] result    Result of an AT command
+ *
+ * @return Result of the API
+ * */
+static le_result_t getApiResult(AtResult result)
+{
+    switch (result)
+    {
+        case AT_RESULT_OK:
+            return LE_OK;
+
+        case AT_RESULT_ERROR:
+            return LE_FAULT;
+
+        case AT_RESULT_TIMEOUT:
+            return LE_TIMEOUT;
+
+        default:
+            return LE_COMM_ERROR;
+    }
+}
+
+/*!
+ * @brief Send an AT command for an API call, remembering the size of the
+ * buffer of its caller until it is answered
+ *
+ * @param[in] cmdRef        Reference of the API call
+ * @param[in] command       AT command
+ * @param[in] timeoutMs     Time given to the command
+ * @param[in] handler       Handler of the response
+ * @param[in] bufferSize    Size of the buffer of the caller
+ *
+ * @return Status of the operation
+ * */
+static bool sendApiCommand(AtChannel_ServerCmdRef_t cmdRef,
+                            const std::string& command, uint32_t timeoutMs,
+                            AtHandler handler, size_t bufferSize)
+{
+    apiBufferSizes[cmdRef] = bufferSize;
+
+    if (!cellNetwork.getAtChannel().send(command, timeoutMs, handler, cmdRef))
+    {
+        apiBufferSizes.erase(cmdRef);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Fit a value in the buffer of the caller of an API call, which is
+ * then answered
+ *
+ * @param[in] cmdRef        Reference of the API call
+ * @param[in,out] value     Value, truncated to the buffer if it is too long
+ *
+ * @return True if the whole value fits
+ * */
+static bool fitApiValue(AtChannel_ServerCmdRef_t cmdRef, std::string& value)
+{
+    std::unordered_map<AtChannel_ServerCmdRef_t, size_t>::iterator it =
+                                                apiBufferSizes.find(cmdRef);
+    size_t maxLen = 0;
+
+    if (it == apiBufferSizes.end())
+    {
+        value.clear();
+        return false;
+    }
+
+    /* The buffer holds the final '\0' */
+    maxLen = (it->second > 0) ? (it->second - 1) : 0;
+    apiBufferSizes.erase(it);
+
+    if (value.size() <= maxLen)
+    {
+        return true;
+    }
+
+    value.resize(maxLen);
+
+    return false;
+}
+
+/*!
+ * @brief Handler of the response of a command sent through the API. A
+ * response longer than the buffer of the caller is truncated, and an OK
+ * result is then given as LE_OVERFLOW.
+ *
+ * @param[in] responsePtr   Response of the command
+ * @param[in] contextPtr    Reference of the API call
+ *
+ * @return None
+ * */
+static void onApiCommand(const AtResponse* responsePtr, void* contextPtr)
+{
+    AtChannel_ServerCmdRef_t cmdRef = (AtChannel_ServerCmdRef_t) contextPtr;
+    le_result_t result = getApiResult(responsePtr->result);
+    std::string lines = responsePtr->lines;
+
+    if (!fitApiValue(cmdRef, lines) && (result == LE_OK))
+    {
+        result = LE_OVERFLOW;
+    }
+
+    AtChannel_sendCommandRespond(cmdRef, result, lines.c_str());
+}
+
+/*!
+ * @brief Answer an API call asking for a value of the modem or of the SIM.
+ * A value which doesn't fit in the buffer of the caller is not given, a
+ * truncated identity being of no use.
+ *
+ * @param[in] responsePtr   Response of the command
+ * @param[in] cmdRef        Reference of the API call
+ * @param[out] result       Result of the API call
+ *
+ * @return Value to answer with
+ * */
+static std::string getApiValue(const AtResponse* responsePtr,
+                                AtChannel_ServerCmdRef_t cmdRef,
+                                le_result_t* result)
+{
+    std::string value;
+    bool isValid = AtChannel::getValue(responsePtr, &value);
+
+    if (!fitApiValue(cmdRef, value))
+    {
+        *result = LE_OVERFLOW;
+        return "";
+    }
 
-        SystemUtils::RunSystemCommand("openvpn --config /home/root/client_hub.ovpn");
+    *result = isValid ? LE_OK : LE_FAULT;
 
-        /* Reset the connecting stage */
-        reconnectStage = 0;
+    return value;
+}
 
-        sleep(HEARTBEAT_PERIOD_S);
+/*!
+ * @brief Send an AT command for another app, answered once its final
+ * response is received
+ *
+ * @param[in] cmdRef        Reference of the API call
+ * @param[in] command       AT command
+ * @param[in] timeoutMs     Time given to the command, 0 for the default one
+ * @param[in] responseSize  Size of the response buffer of the caller
+ *
+ * @return None
+ * */
+void AtChannel_sendCommand(AtChannel_ServerCmdRef_t cmdRef,
+                            const char* command, uint32_t timeoutMs,
+                            size_t responseSize)
+{
+    if (timeoutMs == 0)
+    {
+        timeoutMs = AT_COMMAND_TIMEOUT_MS;
     }
+
+    if (!sendApiCommand(cmdRef, command, timeoutMs, onApiCommand,
+                        responseSize))
+    {
+        AtChannel_sendCommandRespond(cmdRef, LE_COMM_ERROR, "");
+    }
+}
+
+/*!
+ * @brief Handler of the response of the IMEI request
+ *
+ * @param[in] responsePtr   Response of the command
+ * @param[in] contextPtr    Reference of the API call
+ *
+ * @return None
+ * */
+static void onImei(const AtResponse* responsePtr, void* contextPtr)
+{
+    AtChannel_ServerCmdRef_t cmdRef = (AtChannel_ServerCmdRef_t) contextPtr;
+    le_result_t result = LE_FAULT;
+    std::string value = getApiValue(responsePtr, cmdRef, &result);
+
+    AtChannel_getImeiRespond(cmdRef, result, value.c_str());
+}
+
+/*!
+ * @brief Get the IMEI of the modem for another app, from the cache once it
+ * was read
+ *
+ * @param[in] cmdRef    Reference of the API call
+ * @param[in] imeiSize  Size of the IMEI buffer of the caller
+ *
+ * @return None
+ * */
+void AtChannel_getImei(AtChannel_ServerCmdRef_t cmdRef, size_t imeiSize)
+{
+    if (!sendApiCommand(cmdRef, AT_CMD_IMEI, AT_COMMAND_TIMEOUT_MS, onImei,
+                        imeiSize))
+    {
+        AtChannel_getImeiRespond(cmdRef, LE_FAULT, "");
+    }
+}
+
+/*!
+ * @brief Handler of the response of the ICCID request
+ *
+ * @param[in] responsePtr   Response of the command
+ * @param[in] contextPtr    Reference of the API call
+ *
+ * @return None
+ * */
+static void onIccid(const AtResponse* responsePtr, void* contextPtr)
+{
+    AtChannel_ServerCmdRef_t cmdRef = (AtChannel_ServerCmdRef_t) contextPtr;
+    le_result_t result = LE_FAULT;
+    std::string value = getApiValue(responsePtr, cmdRef, &result);
+
+    AtChannel_getIccidRespond(cmdRef, result, value.c_str());
+}
+
+/*!
+ * @brief Get the ICCID of the SIM for another app, from the cache once it
+ * was read
+ *
+ * @param[in] cmdRef    Reference of the API call
+ * @param[in] iccidSize Size of the ICCID buffer of the caller
+ *
+ * @return None
+ * */
+void AtChannel_getIccid(AtChannel_ServerCmdRef_t cmdRef, size_t iccidSize)
+{
+    if (!sendApiCommand(cmdRef, AT_CMD_ICCID, AT_COMMAND_TIMEOUT_MS, onIccid,
+                        iccidSize))
+    {
+        AtChannel_getIccidRespond(cmdRef, LE_FAULT, "");
+    }
+}
+
+/*!
+ * @brief Handler of the response of the firmware version request
+ *
+ * @param[in] responsePtr   Response of the command
+ * @param[in] contextPtr    Reference of the API call
+ *
+ * @return None
+ * */
+static void onFirmwareVersion(const AtResponse* responsePtr,
+                                void* contextPtr)
+{
+    AtChannel_ServerCmdRef_t cmdRef = (AtChannel_ServerCmdRef_t) contextPtr;
+    le_result_t result = LE_FAULT;
+    std::string value = getApiValue(responsePtr, cmdRef, &result);
+
+    AtChannel_getFirmwareVersionRespond(cmdRef, result, value.c_str());
+}
+
+/*!
+ * @brief Get the firmware version of the modem for another app, from the
+ * cache once it was read
+ *
+ * @param[in] cmdRef        Reference of the API call
+ * @param[in] versionSize   Size of the version buffer of the caller
+ *
+ * @return None
+ * */
+void AtChannel_getFirmwareVersion(AtChannel_ServerCmdRef_t cmdRef,
+                                    size_t versionSize)
+{
+    if (!sendApiCommand(cmdRef, AT_CMD_FIRMWARE_VERSION,
+                        AT_COMMAND_TIMEOUT_MS, onFirmwareVersion, versionSize))
+    {
+        AtChannel_getFirmwareVersionRespond(cmdRef, LE_FAULT, "");
+    }
+}
+
+/*!
+ * @brief Main function of the CellularNetworkHandler component. Start and
+ * maintain network connectivity. Everything runs from the event loop, so
+ * that the modem events reach the bring-up state machine.
+ *
+ * */
+COMPONENT_INIT
+{
+    static char env[] = "PATH=/legato/systems/current/bin:/usr/local/bin:"
+                "/usr/bin:/bin:/usr/local/sbin:/usr/sbin:/sbin";
+    putenv(env);
+
+    LEDsHandler_setLedCommand(CONNECTIVITY_LED_NAME.c_str(),
+                                CONNECTIVITY_LED_CMD_NOT_CONNECTED.c_str(),
+                                CONNECTIVITY_LED_RED,
+                                CONNECTIVITY_LED_GREEN,
+                                CONNECTIVITY_LED_BLUE);
+
+    supervisionTimer = le_timer_Create("cellularSupervisionTimer");
+    le_timer_SetRepeat(supervisionTimer, 1);
+    le_timer_SetHandler(supervisionTimer, onSupervisionTimer);
+
+    if (netlink.open())
+    {
+        netlink.monitor();
+    }
+
+    vpnTunnel.subscribe(TUNNEL_ALL_EVENTS, onTunnelEvent, NULL);
+
+    /* The DNS servers are given by each bring-up */
+    cellNetwork.getDnsCache().monitor();
+
+    /* Owned for the life of the process, the other apps use AtChannel */
+    cellNetwork.getAtChannel().open(AT_PORT_PATH.c_str());
+
+    cellNetwork.open(onBringUp, NULL);
 }
 
 /*** end of file ***/
@@ -8,6 +8,8 @@
 #include "legato.h"
 #include "interfaces.h"
 #include "Com/WearableDeviceCom.h"
+#include "Utils/TimerWheel.h"
+#include "Network/NetlinkMonitor.h"
 #include <vector>
 #include <arpa/inet.h>
 
@@ -18,48 +20,86 @@
 #define PING_HEADER_SIZE            (5)
 #define PING_FOOTER_SIZE            (3)
 
+/* Longest wait for the interface before opening the server again */
+#define LINK_WAIT_MS                (5000)
+
 /*!
- * @brief Main function of the WiFiServerHandler component
+ * @brief Echo the ping messages received from a device, then close its
+ * connection once the echo is sent
+ *
+ * @param[in] connectionId  Connection which received data
+ * @param[in] contextPtr    Server
+ *
+ * @return None
  * */
-COMPONENT_INIT
+static void onPingData(uint8_t connectionId, void* contextPtr)
 {
-    while (1)
+    WearableDeviceCom* serverPtr = (WearableDeviceCom*) contextPtr;
+    std::vector<uint8_t> header(PING_HEADER_SIZE);
+
+    /* Wait for the whole message, the read deadline bounds the wait */
+    if (!serverPtr->peek(connectionId, &header[0], header.size()))
     {
-        WearableDeviceCom server(55555, INADDR_ANY, "eth0");
+        return;
+    }
 
-        while(1)
-        {
-            if (!server.open())
-            {
-                break;
-            }
+    uint16_t length = header[1] | (header[2] << 8);
+    uint32_t pingSize = PING_HEADER_SIZE + length + PING_FOOTER_SIZE;
 
-            std::vector<uint8_t> header(PING_HEADER_SIZE);
-            server.read(&header[0], header.size());
+    if (serverPtr->getReceivedNb(connectionId) < pingSize)
+    {
+        return;
+    }
 
-            uint16_t length = header[1] | (header[2] << 8);
+    LE_INFO("Received a length: %d", length);
 
-            LE_INFO("Received a length: %d", length);
+    std::vector<uint8_t> pingBack(pingSize);
 
-            std::vector<uint8_t> payload(length);
+    serverPtr->read(connectionId, &pingBack[0], pingBack.size());
 
-            server.read(&payload[0], payload.size());
+    LE_INFO("Pingback size: %d", pingBack.size());
 
-            std::vector<uint8_t> footer(PING_FOOTER_SIZE);
-            server.read(&footer[0], footer.size());
+    serverPtr->write(connectionId, &pingBack[0], pingBack.size());
 
-            std::vector<uint8_t> pingBack;
+    serverPtr->logConnectStats();
 
-            pingBack.insert(pingBack.end(), header.begin(), header.end());
-            pingBack.insert(pingBack.end(), payload.begin(), payload.end());
-            pingBack.insert(pingBack.end(), footer.begin(), footer.end());
+    /* Closed once the echo is sent, the other devices are served meanwhile */
+    serverPtr->close(connectionId);
+}
 
-            LE_INFO("Pingback size: %d", pingBack.size());
+/*!
+ * @brief Main function of the WiFiServerHandler component
+ * */
+COMPONENT_INIT
+{
+    TimerWheel deadlines;
+    NetlinkMonitor netlink;
+
+    LE_ASSERT(deadlines.init());
+
+    if (!netlink.open())
+    {
+        LE_WARN("Interface changes not monitored");
+    }
 
-            server.write((uint8_t*)(&pingBack[0]), pingBack.size());
+    while (1)
+    {
+        WearableDeviceCom server(55555, INADDR_ANY, "eth0");
+        server.setDeadlineService(&deadlines);
+        server.setReceiveHandler(onPingData, &server);
+
+        /* Serve the devices, all at once, until the server fails */
+        while (server.serve(-1))
+        {
         }
 
-        sleep(5);
+        /* Open the server again as soon as the interface gets back */
+        if (!netlink.waitEvent("eth0", NetlinkMonitorTypes::NETLINK_LINK_UP |
+                            NetlinkMonitorTypes::NETLINK_ADDRESS_ADDED,
+                            LINK_WAIT_MS) && (netlink.getFd() < 0))
+        {
+            sleep(LINK_WAIT_MS / 1000);
+        }
     }
 }
 
@@ -8,12 +8,13 @@
 #include "legato.h"
 #include "interfaces.h"
 #include "LEDs/LEDController.h"
-#include "Utils/SystemUtils.h"
+#include "Network/FirewallManager.h"
 
 using namespace LP55231Constants;
 using namespace LEDControllerTypes;
 
 LEDController controller;
+static FirewallManager firewall("LED");
 
 /*!
  * @brief API Interface. Define a command to be applied to an RGB LED.
@@ -53,12 +54,11 @@ void LEDsHandler_setLedCommand(const char* ledStr,
                                                                       green,
                                                                       blue);
 
-    char env[] = "PATH=/legato/systems/current/bin:/usr/local/bin:"
-                    "/usr/bin:/bin:/usr/local/sbin:/usr/sbin:/sbin";
-    putenv(env);
-
-    SystemUtils::RunSystemCommand("iptables --policy INPUT ACCEPT");
-
+    /* Only runs iptables if the policy was never applied */
+    if (!firewall.apply())
+    {
+        LE_ERROR("Couldn't set the firewall policy");
+    }
 
     /* Check the target LED */
     if (!strcmp(ledStr, "RGB_D1"))
@@ -111,6 +111,12 @@ void LEDsHandler_setLedCommand(const char* ledStr,
  * */
 COMPONENT_INIT
 {
+    static char env[] = "PATH=/legato/systems/current/bin:/usr/local/bin:"
+                "/usr/bin:/bin:/usr/local/sbin:/usr/sbin:/sbin";
+    putenv(env);
+
+    firewall.setPolicy("INPUT", "ACCEPT");
+
     controller.init();
 }
 
@@ -85,7 +85,9 @@ static void EventHandler(le_wifiClient_Event_t clientEvent, void *contextPtr)
  * */
 COMPONENT_INIT
 {
-    SystemUtils::RunSystemCommand("/etc/init.d/tiwifi stop");
+    /* Not killed midway, it would leave the WiFi modules half unloaded */
+    SystemUtils::RunCommand({"/etc/init.d/tiwifi", "stop"},
+                            CommandExecutorConstants::COMMAND_NO_TIMEOUT);
 
     while (1)
     {
@@ -0,0 +1,326 @@
+/** @file RollingAggregator.cpp
+ *
+ * @brief This class summarizes the samples of each channel of each device
+ * over fixed windows, for the uplink to send when it cannot keep up with the
+ * raw data
+ *
+ * Each sample costs a lookup in a HashIndex and a constant update of the
+ * window of its channel. The windows and the closed summaries live in
+ * arrays sized at build time, so the memory used does not depend on the
+ * traffic.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Aggregation/RollingAggregator.h"
+
+using namespace WearableDeviceALPConstants;
+using namespace RollingAggregatorConstants;
+using namespace RollingAggregatorTypes;
+
+/*!
+ * @brief Constructor for RollingAggregator
+ * */
+RollingAggregator::RollingAggregator(void) : index(AGGREGATE_MAX_WINDOWS,
+                                                    AGGREGATE_KEY_SIZE),
+                                                summaryHead(0), summaryNb(0),
+                                                sampleNb(0), lateSampleNb(0),
+                                                droppedSummaryNb(0),
+                                                evictedNb(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for RollingAggregator
+ * */
+RollingAggregator::~RollingAggregator(void)
+{
+
+}
+
+/*!
+ * @brief Build the key of a channel of a device
+ *
+ * @param[in] mac           MAC address of the device
+ * @param[in] channelId     Channel
+ * @param[out] key          Key (AGGREGATE_KEY_SIZE bytes)
+ *
+ * @return None
+ * */
+void RollingAggregator::makeKey(const uint8_t* mac, uint8_t channelId,
+                                uint8_t* key)
+{
+    memcpy(key, mac, MAC_ADDRESS_SIZE);
+    key[MAC_ADDRESS_SIZE] = channelId;
+}
+
+/*!
+ * @brief Release the window started the longest time ago, preferring the
+ * empty ones. Its samples are summarized first.
+ *
+ * @return None
+ * */
+void RollingAggregator::evictOldest(void)
+{
+    int32_t oldest = -1;
+
+    for (uint16_t i = 0; i < AGGREGATE_MAX_WINDOWS; i++)
+    {
+        if (!index.isUsed(i))
+        {
+            continue;
+        }
+
+        if ((oldest < 0) ||
+            ((windows[oldest].count > 0) && (windows[i].count == 0)) ||
+            (((windows[oldest].count > 0) == (windows[i].count > 0)) &&
+             (windows[i].windowStart < windows[oldest].windowStart)))
+        {
+            oldest = i;
+        }
+    }
+
+    if (oldest >= 0)
+    {
+        closeWindow(windows[oldest]);
+        index.remove(oldest);
+        evictedNb++;
+    }
+}
+
+/*!
+ * @brief Find the window of a channel, creating it if the channel has none
+ *
+ * @param[in] mac           MAC address of the device
+ * @param[in] channelId     Channel
+ *
+ * @return Index of the window
+ * */
+int32_t RollingAggregator::findOrInsert(const uint8_t* mac, uint8_t channelId)
+{
+    uint8_t key[AGGREGATE_KEY_SIZE];
+
+    makeKey(mac, channelId, key);
+
+    int32_t entry = index.find(key);
+
+    if (entry >= 0)
+    {
+        return entry;
+    }
+
+    if (index.isFull())
+    {
+        evictOldest();
+    }
+
+    entry = index.insert(key);
+    LE_ASSERT(entry >= 0);
+
+    Window& window = windows[entry];
+
+    memcpy(window.mac, mac, MAC_ADDRESS_SIZE);
+    window.channelId = channelId;
+    window.count = 0;
+    window.windowStart = 0;
+
+    return entry;
+}
+
+/*!
+ * @brief Reset a window for a new period
+ *
+ * @param[out] window       Window to reset
+ * @param[in] windowStart   Start of the period
+ *
+ * @return None
+ * */
+void RollingAggregator::startWindow(Window& window, uint64_t windowStart)
+{
+    window.windowStart = windowStart;
+    window.count = 0;
+    window.mean = 0;
+    window.m2 = 0;
+}
+
+/*!
+ * @brief Summarize the samples of a window and empty it. The summary goes to
+ * the queue, dropping the oldest one if it is full.
+ *
+ * @param[in,out] window    Window to close
+ *
+ * @return None
+ * */
+void RollingAggregator::closeWindow(Window& window)
+{
+    if (window.count == 0)
+    {
+        return;
+    }
+
+    if (summaryNb == AGGREGATE_SUMMARY_QUEUE_SIZE)
+    {
+        summaryHead = (summaryHead + 1) % AGGREGATE_SUMMARY_QUEUE_SIZE;
+        summaryNb--;
+        droppedSummaryNb++;
+    }
+
+    Summary& summary =
+            summaries[(summaryHead + summaryNb) % AGGREGATE_SUMMARY_QUEUE_SIZE];
+
+    memcpy(summary.mac, window.mac, MAC_ADDRESS_SIZE);
+    summary.channelId = window.channelId;
+    summary.windowStart = window.windowStart;
+    summary.count = window.count;
+    summary.min = window.min;
+    summary.max = window.max;
+    summary.mean = window.mean;
+    summary.variance = window.m2 / window.count;
+    summary.last = window.last;
+    summaryNb++;
+
+    window.count = 0;
+}
+
+/*!
+ * @brief Add a sample to the window of its channel. A sample of a later
+ * period closes the current window, a late sample is counted in the current
+ * one.
+ *
+ * @param[in] mac           MAC address of the device
+ * @param[in] channelId     Channel of the sample
+ * @param[in] timestamp     Time of the sample in milliseconds
+ * @param[in] value         Value of the sample
+ *
+ * @return None
+ * */
+void RollingAggregator::addSample(const uint8_t* mac, uint8_t channelId,
+                                    uint64_t timestamp, float value)
+{
+    Window& window = windows[findOrInsert(mac, channelId)];
+    uint64_t windowStart = timestamp - (timestamp % AGGREGATE_WINDOW_MS);
+
+    if (window.count == 0)
+    {
+        startWindow(window, windowStart);
+    }
+    else if (windowStart > window.windowStart)
+    {
+        closeWindow(window);
+        startWindow(window, windowStart);
+    }
+    else if (windowStart < window.windowStart)
+    {
+        lateSampleNb++;
+    }
+
+    if (window.count == 0)
+    {
+        window.min = value;
+        window.max = value;
+    }
+    else
+    {
+        window.min = (value < window.min) ? value : window.min;
+        window.max = (value > window.max) ? value : window.max;
+    }
+
+    window.count++;
+
+    double delta = value - window.mean;
+
+    window.mean += delta / window.count;
+    window.m2 += delta * (value - window.mean);
+    window.last = value;
+
+    sampleNb++;
+}
+
+/*!
+ * @brief Close the windows whose period ended more than
+ * AGGREGATE_LATENESS_MS ago. To be called regularly so that the devices
+ * which stopped sending get their last summary.
+ *
+ * @param[in] now   Current time in milliseconds, same clock as the samples
+ *
+ * @return None
+ * */
+void RollingAggregator::closeExpired(uint64_t now)
+{
+    for (uint16_t i = 0; i < AGGREGATE_MAX_WINDOWS; i++)
+    {
+        Window& window = windows[i];
+
+        if (index.isUsed(i) && (window.count > 0) &&
+            ((window.windowStart + AGGREGATE_WINDOW_MS +
+                                            AGGREGATE_LATENESS_MS) <= now))
+        {
+            closeWindow(window);
+        }
+    }
+}
+
+/*!
+ * @brief Close all the windows, e.g. when switching to summary mode
+ *
+ * @return None
+ * */
+void RollingAggregator::closeAll(void)
+{
+    for (uint16_t i = 0; i < AGGREGATE_MAX_WINDOWS; i++)
+    {
+        if (index.isUsed(i))
+        {
+            closeWindow(windows[i]);
+        }
+    }
+}
+
+/*!
+ * @brief Get the oldest summary not read yet
+ *
+ * @param[out] summaryPtr   Summary
+ *
+ * @return False if there is no summary
+ * */
+bool RollingAggregator::popSummary(Summary* summaryPtr)
+{
+    if (summaryNb == 0)
+    {
+        return false;
+    }
+
+    *summaryPtr = summaries[summaryHead];
+    summaryHead = (summaryHead + 1) % AGGREGATE_SUMMARY_QUEUE_SIZE;
+    summaryNb--;
+
+    return true;
+}
+
+/*!
+ * @brief Get the number of summaries not read yet
+ *
+ * @return Number of summaries
+ * */
+uint16_t RollingAggregator::getSummaryNb(void) const
+{
+    return summaryNb;
+}
+
+/*!
+ * @brief Log the statistics of the aggregator
+ *
+ * @return None
+ * */
+void RollingAggregator::logStats(void) const
+{
+    LE_INFO("Aggregator: %u samples (%u late), %u windows, %u summaries "
+            "queued, %u dropped, %u windows evicted", sampleNb, lateSampleNb,
+            index.getUsedNb(), summaryNb, droppedSummaryNb, evictedNb);
+}
+
+/*** end of file ***/
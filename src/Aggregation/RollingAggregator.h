@@ -0,0 +1,70 @@
+/** @file RollingAggregator.h
+ *
+ * @brief This class summarizes the samples of each channel of each device
+ * over fixed windows, for the uplink to send when it cannot keep up with the
+ * raw data
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef ROLLING_AGGREGATOR_H
+#define ROLLING_AGGREGATOR_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Aggregation/RollingAggregatorUtils.h"
+#include "Utils/HashIndex.h"
+
+class RollingAggregator
+{
+    private:
+        /* Window being filled. The mean and the sum of the squared
+         * differences to it (m2) are updated with Welford's method. */
+        struct Window
+        {
+            uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+            uint8_t channelId;
+            uint64_t windowStart;
+            uint32_t count;
+            float min;
+            float max;
+            double mean;
+            double m2;
+            float last;
+        };
+
+        /* Window of entry N of the index at index N */
+        HashIndex index;
+        Window windows[RollingAggregatorConstants::AGGREGATE_MAX_WINDOWS];
+        RollingAggregatorTypes::Summary
+            summaries[RollingAggregatorConstants::AGGREGATE_SUMMARY_QUEUE_SIZE];
+        uint16_t summaryHead;
+        uint16_t summaryNb;
+        uint32_t sampleNb;
+        uint32_t lateSampleNb;
+        uint32_t droppedSummaryNb;
+        uint32_t evictedNb;
+
+        static void makeKey(const uint8_t* mac, uint8_t channelId,
+                            uint8_t* key);
+        int32_t findOrInsert(const uint8_t* mac, uint8_t channelId);
+        void evictOldest(void);
+        void startWindow(Window& window, uint64_t windowStart);
+        void closeWindow(Window& window);
+
+    public:
+        RollingAggregator(void);
+        ~RollingAggregator(void);
+        void addSample(const uint8_t* mac, uint8_t channelId,
+                        uint64_t timestamp, float value);
+        void closeExpired(uint64_t now);
+        void closeAll(void);
+        bool popSummary(RollingAggregatorTypes::Summary* summaryPtr);
+        uint16_t getSummaryNb(void) const;
+        void logStats(void) const;
+};
+
+#endif /* ROLLING_AGGREGATOR_H */
+
+/*** end of file ***/
@@ -0,0 +1,63 @@
+/** @file RollingAggregatorUtils.h
+ *
+ * @brief This file provides the types and constants of the rolling
+ * aggregates computed on the hub
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef ROLLING_AGGREGATOR_UTILS_H
+#define ROLLING_AGGREGATOR_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Com/WearableDeviceALPUtils.h"
+
+namespace RollingAggregatorTypes
+{
+    /* Summary of the samples of one channel of a device over a window */
+    struct Summary
+    {
+        uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+        uint8_t channelId;
+        uint64_t windowStart;
+        uint32_t count;
+        float min;
+        float max;
+        float mean;
+        /* Population variance of the samples */
+        float variance;
+        float last;
+    };
+}
+
+namespace RollingAggregatorConstants
+{
+    /* Length of the windows, aligned on multiples of it */
+    const uint32_t AGGREGATE_WINDOW_MS = 60000;
+
+    /* A window is closed this long after its end if no sample of a later
+     * window came, so that a device going silent still gets its summary */
+    const uint32_t AGGREGATE_LATENESS_MS = 10000;
+
+    /* Channels aggregated per device */
+    const uint8_t AGGREGATE_MAX_CHANNELS = 8;
+
+    /* Windows open at once, the oldest is closed to make room for a new
+     * channel */
+    const uint16_t AGGREGATE_MAX_WINDOWS =
+            WearableDeviceALPConstants::MAX_WEARABLE_DEVICES *
+                                                    AGGREGATE_MAX_CHANNELS;
+
+    /* A window is found by the MAC address of its device and its channel */
+    const uint8_t AGGREGATE_KEY_SIZE =
+            WearableDeviceALPConstants::MAC_ADDRESS_SIZE + 1;
+
+    /* Summaries closed and not read yet. The oldest is dropped when full. */
+    const uint16_t AGGREGATE_SUMMARY_QUEUE_SIZE = 256;
+}
+
+#endif /* ROLLING_AGGREGATOR_UTILS_H */
+
+/*** end of file ***/
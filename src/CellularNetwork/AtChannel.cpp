@@ -0,0 +1,869 @@
+/** @file AtChannel.cpp
+ *
+ * @brief This class owns the AT command port of the modem: the commands of
+ * all the clients go through its queue, and the responses are parsed from
+ * the event loop
+ *
+ * The port is opened once, instead of by each user of the modem. The
+ * commands are sent one at a time, as the modem requires, the next one being
+ * written as soon as the final response of the previous one is parsed. A
+ * client is called back with the intermediate lines and the final response
+ * of its command, and never waits on the port. The responses of the
+ * commands which don't change while the modem runs (IMEI, ICCID, firmware
+ * version) are read when the port is opened and served from the cache.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "CellularNetwork/AtChannel.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+
+using namespace AtChannelTypes;
+using namespace AtChannelConstants;
+
+/*!
+ * @brief Constructor for AtChannel. The port is opened by open().
+ * */
+AtChannel::AtChannel(void) : fd(-1), fdMonitorRef(NULL), timer(NULL),
+                                isSent(false), sentMs(0), outputOffset(0),
+                                lineLen(0), isLineDropped(false), openNb(0),
+                                commandNb(0), cacheHitNb(0), errorNb(0),
+                                timeoutNb(0), unsolicitedNb(0),
+                                totalCommandMs(0), maxCommandMs(0),
+                                totalWaitMs(0), maxWaitMs(0), batchNb(0),
+                                lastBatchMs(0), maxBatchMs(0)
+{
+    memset(batches, 0, sizeof(batches));
+}
+
+/*!
+ * @brief Destructor for AtChannel. The commands still queued are dropped
+ * without calling their handlers.
+ * */
+AtChannel::~AtChannel(void)
+{
+    closePort();
+
+    if (timer != NULL)
+    {
+        le_timer_Delete(timer);
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t AtChannel::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Get the form of a command used as a key of the cache: upper case,
+ * without the surrounding spaces
+ *
+ * @param[in] command   AT command
+ *
+ * @return Key
+ * */
+std::string AtChannel::getKey(const std::string& command)
+{
+    size_t first = command.find_first_not_of(" \t\r\n");
+    size_t last = command.find_last_not_of(" \t\r\n");
+    std::string key;
+
+    if (first != std::string::npos)
+    {
+        key = command.substr(first, last - first + 1);
+    }
+
+    std::transform(key.begin(), key.end(), key.begin(), ::toupper);
+
+    return key;
+}
+
+/*!
+ * @brief Check whether a line is a final response
+ *
+ * @param[in] text          Line received
+ * @param[out] resultPtr    Result of the command, if it is a final response
+ *
+ * @return True if the line ends the command
+ * */
+bool AtChannel::isFinalLine(const char* text, AtResult* resultPtr)
+{
+    if (strcmp(text, "OK") == 0)
+    {
+        *resultPtr = AT_RESULT_OK;
+        return true;
+    }
+
+    if ((strcmp(text, "ERROR") == 0) || (strcmp(text, "NO CARRIER") == 0) ||
+        (strncmp(text, "+CME ERROR:", 11) == 0) ||
+        (strncmp(text, "+CMS ERROR:", 11) == 0))
+    {
+        *resultPtr = AT_RESULT_ERROR;
+        return true;
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Open the AT port and queue the commands whose responses are cached.
+ * If it fails, it is opened again after AT_REOPEN_MS.
+ *
+ * @param[in] portPath  Path of the port
+ *
+ * @return False if the port couldn't be opened at once
+ * */
+bool AtChannel::open(const char* portPath)
+{
+    path = portPath;
+
+    if (fd >= 0)
+    {
+        return true;
+    }
+
+    if (!openPort())
+    {
+        armTimer(AT_REOPEN_MS);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Close the AT port. The queued commands fail with AT_RESULT_CLOSED,
+ * and the port is not opened again.
+ *
+ * @return None
+ * */
+void AtChannel::close(void)
+{
+    path.clear();
+
+    if (timer != NULL)
+    {
+        le_timer_Stop(timer);
+    }
+
+    closePort();
+
+    while (!queue.empty())
+    {
+        complete(AT_RESULT_CLOSED, "");
+    }
+}
+
+/*!
+ * @brief Open the port in raw mode and monitor it. The cache is cleared, the
+ * modem may have restarted with another SIM.
+ *
+ * @return False if the port couldn't be opened
+ * */
+bool AtChannel::openPort(void)
+{
+    struct termios attributes;
+
+    fd = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        LE_ERROR("Couldn't open the AT port %s: %m", path.c_str());
+        return false;
+    }
+
+    /* No echo, nor translation of the line endings, by the tty itself */
+    if (tcgetattr(fd, &attributes) == 0)
+    {
+        cfmakeraw(&attributes);
+
+        if (tcsetattr(fd, TCSANOW, &attributes) < 0)
+        {
+            LE_WARN("Couldn't set the AT port in raw mode: %m");
+        }
+
+        tcflush(fd, TCIOFLUSH);
+    }
+
+    fdMonitorRef = le_fdMonitor_Create("AtPort", fd, fdHandler, POLLIN);
+    le_fdMonitor_SetContextPtr(fdMonitorRef, this);
+
+    openNb++;
+    lineLen = 0;
+    isLineDropped = false;
+    cache.clear();
+
+    LE_INFO("AT port %s open", path.c_str());
+
+    for (uint8_t i = 0; i < AT_STATIC_CMDS.size(); i++)
+    {
+        enqueue(AT_STATIC_CMDS[i], AT_COMMAND_TIMEOUT_MS, NULL, NULL, -1);
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Close the port, the queue is kept
+ *
+ * @return None
+ * */
+void AtChannel::closePort(void)
+{
+    if (fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(fdMonitorRef);
+        fdMonitorRef = NULL;
+    }
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+/*!
+ * @brief Handle a failure of the port: the queued commands fail, and the
+ * port is opened again after AT_REOPEN_MS
+ *
+ * @return None
+ * */
+void AtChannel::failPort(void)
+{
+    LE_ERROR("AT port %s failed, %u commands dropped", path.c_str(),
+                (unsigned int) queue.size());
+
+    closePort();
+
+    while (!queue.empty())
+    {
+        complete(AT_RESULT_CLOSED, "");
+    }
+
+    /* A handler may have closed the channel */
+    if (!path.empty())
+    {
+        armTimer(AT_REOPEN_MS);
+    }
+}
+
+/*!
+ * @brief Arm the timer, created on first use
+ *
+ * @param[in] delayMs   Delay before the timer expires
+ *
+ * @return None
+ * */
+void AtChannel::armTimer(uint32_t delayMs)
+{
+    if (timer == NULL)
+    {
+        timer = le_timer_Create("AtChannelTimer");
+        le_timer_SetRepeat(timer, 1);
+        le_timer_SetHandler(timer, timerHandler);
+        le_timer_SetContextPtr(timer, this);
+    }
+
+    le_timer_Stop(timer);
+    le_timer_SetMsInterval(timer, delayMs);
+    le_timer_Start(timer);
+}
+
+/*!
+ * @brief Send a command through the queue. A command whose response is
+ * cached is answered at once, its handler is called before returning.
+ *
+ * @param[in] command       AT command, without the final carriage return
+ * @param[in] timeoutMs     Time given to the command to get its final
+ *                          response once sent
+ * @param[in] handler       Function called with the response, may be NULL
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return False if the port is not open, or the queue is full
+ * */
+bool AtChannel::send(const std::string& command, uint32_t timeoutMs,
+                        AtHandler handler, void* contextPtr)
+{
+    std::unordered_map<std::string, std::string>::const_iterator it =
+                                                    cache.find(getKey(command));
+
+    if (it != cache.end())
+    {
+        AtResponse response;
+
+        cacheHitNb++;
+
+        if (handler != NULL)
+        {
+            response.result = AT_RESULT_OK;
+            response.command = command.c_str();
+            response.lines = it->second.c_str();
+            response.finalLine = "OK";
+            response.durationMs = 0;
+            response.isCached = true;
+
+            handler(&response, contextPtr);
+        }
+        return true;
+    }
+
+    return enqueue(command, timeoutMs, handler, contextPtr, -1);
+}
+
+/*!
+ * @brief Send commands as one batch: they are queued together, so that no
+ * other client's command runs between them. A failed command doesn't stop
+ * the batch.
+ *
+ * @param[in] commands      AT commands, sent in this order
+ * @param[in] handler       Function called once all the commands are done,
+ *                          may be NULL
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return False if the port is not open, or there is no room for the batch
+ * */
+bool AtChannel::sendBatch(const std::vector<std::string>& commands,
+                            AtBatchHandler handler, void* contextPtr)
+{
+    int8_t batchIndex = -1;
+
+    if ((fd < 0) || commands.empty() ||
+        ((queue.size() + commands.size()) > AT_MAX_QUEUED))
+    {
+        LE_ERROR("Couldn't queue a batch of %u AT commands",
+                    (unsigned int) commands.size());
+        return false;
+    }
+
+    for (uint8_t i = 0; i < AT_MAX_BATCHES; i++)
+    {
+        if (!batches[i].isUsed)
+        {
+            batchIndex = i;
+            break;
+        }
+    }
+
+    if (batchIndex < 0)
+    {
+        LE_ERROR("Too many batches of AT commands in progress");
+        return false;
+    }
+
+    Batch& batch = batches[batchIndex];
+
+    batch.isUsed = true;
+    batch.commandNb = commands.size();
+    batch.doneNb = 0;
+    batch.failedNb = 0;
+    batch.startMs = getNowMs();
+    batch.handler = handler;
+    batch.contextPtr = contextPtr;
+
+    for (uint8_t i = 0; i < commands.size(); i++)
+    {
+        if (!enqueue(commands[i], AT_COMMAND_TIMEOUT_MS, NULL, NULL,
+                        batchIndex))
+        {
+            /* Counted as failed, the batch completes with the others */
+            completeBatch(batchIndex, true);
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Add a command at the end of the queue, and send it if the port is
+ * idle
+ *
+ * @param[in] command       AT command
+ * @param[in] timeoutMs     Time given to the command once sent
+ * @param[in] handler       Function called with the response, may be NULL
+ * @param[in] contextPtr    Context given to the handler
+ * @param[in] batchIndex    Batch of the command, -1 if none
+ *
+ * @return False if the command couldn't be queued
+ * */
+bool AtChannel::enqueue(const std::string& command, uint32_t timeoutMs,
+                        AtHandler handler, void* contextPtr,
+                        int8_t batchIndex)
+{
+    Command entry;
+
+    if (fd < 0)
+    {
+        LE_ERROR("AT port not open, %s not sent", command.c_str());
+        return false;
+    }
+
+    if ((queue.size() >= AT_MAX_QUEUED) || command.empty() ||
+        (command.size() >= AT_COMMAND_SIZE))
+    {
+        LE_ERROR("Couldn't queue AT command %s", command.c_str());
+        return false;
+    }
+
+    entry.text = command;
+    entry.timeoutMs = timeoutMs;
+    entry.handler = handler;
+    entry.contextPtr = contextPtr;
+    entry.batchIndex = batchIndex;
+    entry.queuedMs = getNowMs();
+
+    queue.push_back(entry);
+
+    sendNext();
+
+    return true;
+}
+
+/*!
+ * @brief Write the first command of the queue, if none is in progress
+ *
+ * @return None
+ * */
+void AtChannel::sendNext(void)
+{
+    uint32_t waitMs;
+
+    if (isSent || queue.empty() || (fd < 0))
+    {
+        return;
+    }
+
+    Command& command = queue.front();
+
+    isSent = true;
+    sentMs = getNowMs();
+    lines.clear();
+
+    waitMs = sentMs - command.queuedMs;
+    totalWaitMs += waitMs;
+    maxWaitMs = std::max(maxWaitMs, waitMs);
+
+    LE_DEBUG("AT command %s", command.text.c_str());
+
+    output = command.text + "\r";
+    outputOffset = 0;
+
+    armTimer(command.timeoutMs);
+    writePort();
+}
+
+/*!
+ * @brief Write what is left of the command sent. If the port is full, the
+ * rest is written once it is writable again.
+ *
+ * @return None
+ * */
+void AtChannel::writePort(void)
+{
+    while (outputOffset < output.size())
+    {
+        ssize_t writtenNb = write(fd, output.data() + outputOffset,
+                                    output.size() - outputOffset);
+
+        if (writtenNb > 0)
+        {
+            outputOffset += writtenNb;
+        }
+        else if ((writtenNb < 0) && ((errno == EAGAIN) ||
+                                        (errno == EWOULDBLOCK)))
+        {
+            le_fdMonitor_Enable(fdMonitorRef, POLLOUT);
+            return;
+        }
+        else if ((writtenNb < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        else
+        {
+            LE_ERROR("Couldn't write to the AT port: %m");
+            failPort();
+            return;
+        }
+    }
+
+    le_fdMonitor_Disable(fdMonitorRef, POLLOUT);
+}
+
+/*!
+ * @brief Handler of the AT port
+ *
+ * @param[in] fd        File descriptor of the port
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void AtChannel::fdHandler(int fd, short events)
+{
+    AtChannel* channelPtr = (AtChannel*) le_fdMonitor_GetContextPtr();
+
+    if (events & POLLOUT)
+    {
+        channelPtr->writePort();
+    }
+
+    if ((channelPtr->fd >= 0) && (events & (POLLIN | POLLHUP | POLLERR)))
+    {
+        channelPtr->readPort();
+    }
+}
+
+/*!
+ * @brief Read the port, and parse its complete lines
+ *
+ * @return None
+ * */
+void AtChannel::readPort(void)
+{
+    char buffer[AT_LINE_SIZE];
+    ssize_t readNb;
+
+    while ((readNb = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t i = 0; i < readNb; i++)
+        {
+            char c = buffer[i];
+
+            if ((c == '\r') || (c == '\n'))
+            {
+                line[lineLen] = '\0';
+
+                if (!isLineDropped && (lineLen > 0))
+                {
+                    parseLine(line);
+                }
+
+                lineLen = 0;
+                isLineDropped = false;
+
+                /* A handler may have closed the channel */
+                if (fd < 0)
+                {
+                    return;
+                }
+            }
+            else if (lineLen < (sizeof(line) - 1))
+            {
+                line[lineLen++] = c;
+            }
+            else
+            {
+                isLineDropped = true;
+            }
+        }
+    }
+
+    if ((readNb < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                            (errno == EINTR)))
+    {
+        return;
+    }
+
+    failPort();
+}
+
+/*!
+ * @brief Parse a line received: the echo of the command sent is skipped,
+ * the intermediate lines are kept until the final response
+ *
+ * @param[in] text  Line, without its end
+ *
+ * @return None
+ * */
+void AtChannel::parseLine(const char* text)
+{
+    AtResult result;
+
+    if (!isSent)
+    {
+        unsolicitedNb++;
+        LE_DEBUG("Unsolicited AT line %s", text);
+        return;
+    }
+
+    if (strcasecmp(text, queue.front().text.c_str()) == 0)
+    {
+        return;
+    }
+
+    if (isFinalLine(text, &result))
+    {
+        complete(result, text);
+        return;
+    }
+
+    if ((lines.size() + strlen(text) + 1) < AT_RESPONSE_SIZE)
+    {
+        if (!lines.empty())
+        {
+            lines += '\n';
+        }
+        lines += text;
+    }
+}
+
+/*!
+ * @brief Complete the first command of the queue: its handler is called,
+ * and the next command is sent
+ *
+ * @param[in] result        Result of the command
+ * @param[in] finalLine     Final response, empty if there is none
+ *
+ * @return None
+ * */
+void AtChannel::complete(AtResult result, const char* finalLine)
+{
+    uint64_t nowMs = getNowMs();
+    Command command = queue.front();
+    std::string commandLines;
+    AtResponse response;
+
+    queue.pop_front();
+
+    if (isSent)
+    {
+        uint32_t commandMs = nowMs - sentMs;
+
+        /* Kept aside, the handler may send the next command */
+        commandLines.swap(lines);
+        isSent = false;
+        le_timer_Stop(timer);
+
+        commandNb++;
+        totalCommandMs += commandMs;
+        maxCommandMs = std::max(maxCommandMs, commandMs);
+    }
+
+    if (result == AT_RESULT_OK)
+    {
+        std::string key = getKey(command.text);
+
+        if (std::find(AT_STATIC_CMDS.begin(), AT_STATIC_CMDS.end(), key) !=
+                                                        AT_STATIC_CMDS.end())
+        {
+            cache[key] = commandLines;
+        }
+    }
+    else
+    {
+        LE_WARN("AT command %s failed: %s", command.text.c_str(),
+                (result == AT_RESULT_TIMEOUT) ? "timeout" :
+                (result == AT_RESULT_CLOSED) ? "port closed" : finalLine);
+        errorNb++;
+    }
+
+    if (command.handler != NULL)
+    {
+        response.result = result;
+        response.command = command.text.c_str();
+        response.lines = commandLines.c_str();
+        response.finalLine = finalLine;
+        response.durationMs = nowMs - command.queuedMs;
+        response.isCached = false;
+
+        command.handler(&response, command.contextPtr);
+    }
+
+    if (command.batchIndex >= 0)
+    {
+        completeBatch(command.batchIndex, result != AT_RESULT_OK);
+    }
+
+    sendNext();
+}
+
+/*!
+ * @brief Count a command of a batch as done, and call the handler of the
+ * batch once all its commands are
+ *
+ * @param[in] batchIndex    Batch of the command
+ * @param[in] isFailed      True if the command failed
+ *
+ * @return None
+ * */
+void AtChannel::completeBatch(int8_t batchIndex, bool isFailed)
+{
+    Batch& batch = batches[batchIndex];
+    uint32_t durationMs;
+
+    batch.doneNb++;
+
+    if (isFailed)
+    {
+        batch.failedNb++;
+    }
+
+    if (batch.doneNb < batch.commandNb)
+    {
+        return;
+    }
+
+    durationMs = getNowMs() - batch.startMs;
+
+    batch.isUsed = false;
+    batchNb++;
+    lastBatchMs = durationMs;
+    maxBatchMs = std::max(maxBatchMs, durationMs);
+
+    if (batch.handler != NULL)
+    {
+        batch.handler(batch.commandNb, batch.failedNb, durationMs,
+                        batch.contextPtr);
+    }
+}
+
+/*!
+ * @brief Handler of the timer: timeout of the command sent, or reopening of
+ * the port
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void AtChannel::timerHandler(le_timer_Ref_t timerRef)
+{
+    AtChannel* channelPtr = (AtChannel*) le_timer_GetContextPtr(timerRef);
+
+    if (channelPtr->fd < 0)
+    {
+        if (!channelPtr->path.empty() && !channelPtr->openPort())
+        {
+            channelPtr->armTimer(AT_REOPEN_MS);
+        }
+        return;
+    }
+
+    if (channelPtr->isSent)
+    {
+        channelPtr->timeoutNb++;
+
+        /* A late response would be taken for the next command's */
+        channelPtr->lineLen = 0;
+        tcflush(channelPtr->fd, TCIFLUSH);
+
+        channelPtr->complete(AT_RESULT_TIMEOUT, "");
+    }
+}
+
+/*!
+ * @brief Get the cached response of a command
+ *
+ * @param[in] command       AT command
+ * @param[out] responsePtr  Intermediate lines of the response
+ *
+ * @return False if the response of this command is not cached
+ * */
+bool AtChannel::getCached(const std::string& command,
+                            std::string* responsePtr) const
+{
+    std::unordered_map<std::string, std::string>::const_iterator it =
+                                                    cache.find(getKey(command));
+
+    if (it == cache.end())
+    {
+        return false;
+    }
+
+    *responsePtr = it->second;
+
+    return true;
+}
+
+/*!
+ * @brief Get the value of a response: its first intermediate line, without
+ * the "+CMD:" prefix
+ *
+ * @param[in] responsePtr   Response of a command
+ * @param[out] valuePtr     Value
+ *
+ * @return False if the command failed or gave no value
+ * */
+bool AtChannel::getValue(const AtResponse* responsePtr,
+                            std::string* valuePtr)
+{
+    std::string value = responsePtr->lines;
+    size_t end = value.find('\n');
+    size_t start = 0;
+
+    if (responsePtr->result != AT_RESULT_OK)
+    {
+        return false;
+    }
+
+    if (end != std::string::npos)
+    {
+        value.erase(end);
+    }
+
+    if (!value.empty() && (value[0] == '+') &&
+        (value.find(':') != std::string::npos))
+    {
+        start = value.find(':') + 1;
+    }
+
+    start = value.find_first_not_of(' ', start);
+    end = value.find_last_not_of(' ');
+
+    if (start == std::string::npos)
+    {
+        return false;
+    }
+
+    *valuePtr = value.substr(start, end - start + 1);
+
+    return true;
+}
+
+/*!
+ * @brief Get the number of commands queued, including the one sent
+ *
+ * @return Number of commands
+ * */
+uint8_t AtChannel::getQueuedNb(void) const
+{
+    return queue.size();
+}
+
+/*!
+ * @brief Log the statistics of the channel
+ *
+ * @return None
+ * */
+void AtChannel::logStats(void) const
+{
+    LE_INFO("AT channel: %u opens, %u commands, %u cached, %u failed "
+            "(%u timeouts), %u unsolicited lines", openNb, commandNb,
+            cacheHitNb, errorNb, timeoutNb, unsolicitedNb);
+    LE_INFO("AT commands: latency average %u ms max %u ms, queueing "
+            "average %u ms max %u ms",
+            commandNb ? (uint32_t) (totalCommandMs / commandNb) : 0,
+            maxCommandMs,
+            commandNb ? (uint32_t) (totalWaitMs / commandNb) : 0,
+            maxWaitMs);
+    LE_INFO("AT batches: %u, last %u ms, max %u ms", batchNb, lastBatchMs,
+            maxBatchMs);
+}
+
+/*** end of file ***/
@@ -0,0 +1,119 @@
+/** @file AtChannel.h
+ *
+ * @brief This class owns the AT command port of the modem: the commands of
+ * all the clients go through its queue, and the responses are parsed from
+ * the event loop
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef AT_CHANNEL_H
+#define AT_CHANNEL_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "CellularNetwork/AtChannelUtils.h"
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AtChannel
+{
+    private:
+        /* Command waiting in the queue, the first one is the one sent */
+        struct Command
+        {
+            std::string text;
+            uint32_t timeoutMs;
+            AtChannelTypes::AtHandler handler;
+            void* contextPtr;
+            /* Batch the command belongs to, -1 if none */
+            int8_t batchIndex;
+            uint64_t queuedMs;
+        };
+
+        struct Batch
+        {
+            bool isUsed;
+            uint8_t commandNb;
+            uint8_t doneNb;
+            uint8_t failedNb;
+            uint64_t startMs;
+            AtChannelTypes::AtBatchHandler handler;
+            void* contextPtr;
+        };
+
+        std::string path;
+        int fd;
+        le_fdMonitor_Ref_t fdMonitorRef;
+        /* Timeout of the command sent, or reopening of the port */
+        le_timer_Ref_t timer;
+        std::deque<Command> queue;
+        bool isSent;
+        uint64_t sentMs;
+        std::string output;
+        size_t outputOffset;
+        char line[AtChannelConstants::AT_LINE_SIZE];
+        uint16_t lineLen;
+        bool isLineDropped;
+        /* Intermediate lines of the command sent */
+        std::string lines;
+        std::unordered_map<std::string, std::string> cache;
+        Batch batches[AtChannelConstants::AT_MAX_BATCHES];
+        uint32_t openNb;
+        uint32_t commandNb;
+        uint32_t cacheHitNb;
+        uint32_t errorNb;
+        uint32_t timeoutNb;
+        uint32_t unsolicitedNb;
+        uint64_t totalCommandMs;
+        uint32_t maxCommandMs;
+        uint64_t totalWaitMs;
+        uint32_t maxWaitMs;
+        uint32_t batchNb;
+        uint32_t lastBatchMs;
+        uint32_t maxBatchMs;
+
+        static uint64_t getNowMs(void);
+        static std::string getKey(const std::string& command);
+        static bool isFinalLine(const char* text,
+                                AtChannelTypes::AtResult* resultPtr);
+        static void fdHandler(int fd, short events);
+        static void timerHandler(le_timer_Ref_t timerRef);
+        bool openPort(void);
+        void closePort(void);
+        void failPort(void);
+        void armTimer(uint32_t delayMs);
+        bool enqueue(const std::string& command, uint32_t timeoutMs,
+                        AtChannelTypes::AtHandler handler, void* contextPtr,
+                        int8_t batchIndex);
+        void sendNext(void);
+        void writePort(void);
+        void readPort(void);
+        void parseLine(const char* text);
+        void complete(AtChannelTypes::AtResult result, const char* finalLine);
+        void completeBatch(int8_t batchIndex, bool isFailed);
+
+    public:
+        AtChannel(void);
+        ~AtChannel(void);
+        bool open(const char* portPath);
+        void close(void);
+        bool send(const std::string& command, uint32_t timeoutMs,
+                    AtChannelTypes::AtHandler handler, void* contextPtr);
+        bool sendBatch(const std::vector<std::string>& commands,
+                        AtChannelTypes::AtBatchHandler handler,
+                        void* contextPtr);
+        bool getCached(const std::string& command,
+                        std::string* responsePtr) const;
+        static bool getValue(const AtChannelTypes::AtResponse* responsePtr,
+                                std::string* valuePtr);
+        uint8_t getQueuedNb(void) const;
+        void logStats(void) const;
+};
+
+#endif /* AT_CHANNEL_H */
+
+/*** end of file ***/
@@ -0,0 +1,92 @@
+/** @file AtChannelUtils.h
+ *
+ * @brief This file provides the types and constants of the AT command
+ * channel of the modem
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef AT_CHANNEL_UTILS_H
+#define AT_CHANNEL_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <string>
+#include <vector>
+
+namespace AtChannelTypes
+{
+    /* Result of a command */
+    enum AtResult
+    {
+        /* Final response OK */
+        AT_RESULT_OK,
+        /* Final response ERROR, +CME ERROR, +CMS ERROR or NO CARRIER */
+        AT_RESULT_ERROR,
+        /* No final response before the timeout of the command */
+        AT_RESULT_TIMEOUT,
+        /* The port is not open, or it failed while the command ran */
+        AT_RESULT_CLOSED
+    };
+
+    /* Response given to the handler of a command */
+    struct AtResponse
+    {
+        AtResult result;
+        const char* command;
+        /* Intermediate lines, separated by '\n', without the echo */
+        const char* lines;
+        const char* finalLine;
+        /* From the queueing of the command to its final response */
+        uint32_t durationMs;
+        bool isCached;
+    };
+
+    /* Function called with the response of a command */
+    typedef void (*AtHandler)(const AtResponse* responsePtr,
+                                void* contextPtr);
+
+    /* Function called once all the commands of a batch are done */
+    typedef void (*AtBatchHandler)(uint8_t commandNb, uint8_t failedNb,
+                                    uint32_t durationMs, void* contextPtr);
+}
+
+namespace AtChannelConstants
+{
+    /* Port of the AT commands of the modem */
+    const std::string AT_PORT_PATH = "/dev/ttyAT";
+
+    /* Commands queued, from all the clients, and batches in progress */
+    const uint8_t AT_MAX_QUEUED = 32;
+    const uint8_t AT_MAX_BATCHES = 4;
+
+    /* Time given to a command to get its final response */
+    const uint32_t AT_COMMAND_TIMEOUT_MS = 5000;
+
+    /* Wait before opening the port again after it failed */
+    const uint32_t AT_REOPEN_MS = 5000;
+
+    /* Longest command, and response kept for a command */
+    const uint16_t AT_COMMAND_SIZE = 128;
+    const uint16_t AT_RESPONSE_SIZE = 1024;
+
+    /* Longest line received, a longer one is dropped */
+    const uint16_t AT_LINE_SIZE = 512;
+
+    /* Identity of the modem and of the SIM: they don't change while the port
+     * is open, their responses are cached */
+    const std::string AT_CMD_IMEI = "AT+CGSN";
+    const std::string AT_CMD_ICCID = "AT+CCID";
+    const std::string AT_CMD_FIRMWARE_VERSION = "AT+CGMR";
+
+    const std::vector<std::string> AT_STATIC_CMDS = {
+            AT_CMD_IMEI,
+            AT_CMD_ICCID,
+            AT_CMD_FIRMWARE_VERSION
+    };
+}
+
+#endif /* AT_CHANNEL_UTILS_H */
+
+/*** end of file ***/
@@ -9,17 +9,30 @@
 #include "CellularNetwork/CellularNetwork.h"
 #include "CellularNetwork/CellularNetworkUtils.h"
 #include <curl/curl.h>
+#include <time.h>
 #include "HttpStatusCode/HttpStatusCode_C++.h"
 
 using namespace CellularNetworkConstants;
+using namespace CellularNetworkTypes;
 
 /*!
  * @brief Constructor for CellularNetwork
  *
  * */
-CellularNetwork::CellularNetwork()
+CellularNetwork::CellularNetwork() : profileRef(NULL), netRegHandlerRef(NULL),
+                                        sessionHandlerRef(NULL),
+                                        stepTimer(NULL), step(BRINGUP_IDLE),
+                                        isWaitingEvent(false),
+                                        isSessionStarting(false), attemptNb(0),
+                                        bringUpStartMs(0), stepStartMs(0),
+                                        bringUpDurationMs(0),
+                                        bringUpHandler(NULL),
+                                        bringUpContextPtr(NULL),
+                                        connectivityHandler(NULL),
+                                        connectivityContextPtr(NULL)
 {
-
+    memset(stepDurationsMs, 0, sizeof(stepDurationsMs));
+    memset(stepAttemptsNb, 0, sizeof(stepAttemptsNb));
 }
 
 /*!
@@ -28,78 +41,120 @@ CellularNetwork::CellularNetwork()
  * */
 CellularNetwork::~CellularNetwork()
 {
+    if (stepTimer != NULL)
+    {
+        le_timer_Delete(stepTimer);
+    }
 
+    if (sessionHandlerRef != NULL)
+    {
+        le_mdc_RemoveSessionStateHandler(sessionHandlerRef);
+    }
+
+    if (netRegHandlerRef != NULL)
+    {
+        le_mrc_RemoveNetRegStateEventHandler(netRegHandlerRef);
+    }
 }
 
 /*!
- * @brief Start the cellular connectivity
+ * @brief Get the monotonic time in milliseconds
  *
- * @return None
- */
-void CellularNetwork::open(void)
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t CellularNetwork::getNowMs(void)
 {
-    le_onoff_t power = LE_OFF;
-    le_mrc_GetRadioPower(&power);
-    if (power == LE_OFF)
-    {
-        LE_INFO("Turn radio ON");
-        le_mrc_SetRadioPower(LE_ON);
-    }
+    struct timespec now;
 
-    sleep(5);
+    clock_gettime(CLOCK_MONOTONIC, &now);
 
-    le_mdc_ConState_t state = LE_MDC_DISCONNECTED;
-    /* Check the state */
-    LE_ASSERT(LE_OK ==
-            le_mdc_GetSessionState(le_mdc_GetProfile(TWILIO_PROFILE_INDEX),
-                                    &state));
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
 
-    /* If already in use, disconnect the session */
-    if (LE_MDC_DISCONNECTED != state)
+/*!
+ * @brief Get the name of a bring-up step, for the logs
+ *
+ * @param[in] step  Bring-up step
+ *
+ * @return Name of the step
+ * */
+const char* CellularNetwork::getStepName(BringUpStep step)
+{
+    switch (step)
     {
-        LE_INFO("Already in use, disconnect");
-        LE_ASSERT(LE_OK ==
-                le_mdc_StopSession(le_mdc_GetProfile(TWILIO_PROFILE_INDEX)));
-    }
-
-    /* Sleeps between configuration steps seems necessary, otherwise the modem
-     * drivers might either not work at all or misbehave
-     */
-    sleep(2);
+        case BRINGUP_IDLE:
+            return "idle";
 
-    le_mdc_SetPDP(le_mdc_GetProfile(TWILIO_PROFILE_INDEX), TWILIO_PDP);
+        case BRINGUP_RADIO_ON:
+            return "radio on";
 
-    /* Refer to previous comment */
-    sleep(2);
+        case BRINGUP_STOP_SESSION:
+            return "stop session";
 
-    le_mdc_SetAPN(le_mdc_GetProfile(TWILIO_PROFILE_INDEX), TWILIO_APN.c_str());
+        case BRINGUP_CONFIGURE_PROFILE:
+            return "configure profile";
 
-    /* Refer to previous comment */
-    sleep(2);
+        case BRINGUP_START_SESSION:
+            return "start session";
 
-    LE_INFO("Connect");
+        case BRINGUP_CONFIGURE_NETWORK:
+            return "configure network";
 
-    le_result_t result =
-            le_mdc_StartSession(le_mdc_GetProfile(TWILIO_PROFILE_INDEX));
+        case BRINGUP_CONNECTED:
+            return "connected";
 
-    /* Refer to previous comment */
-    sleep(2);
+        case BRINGUP_FAILED:
+            return "failed";
 
-    if (result < 0)
-    {
-        LE_ERROR("Couldn't start session: %d", result);
-        le_mdc_StopSession(le_mdc_GetProfile(TWILIO_PROFILE_INDEX));
+        default:
+            return "unknown";
     }
-    else
+}
+
+/*!
+ * @brief Start the cellular connectivity. The bring-up runs from the event
+ * loop: each step ends on the modem event it waits for, and is attempted
+ * again on timeout or error.
+ *
+ * @param[in] handler       Called once the bring-up is over, may be NULL
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return None
+ */
+void CellularNetwork::open(BringUpHandler handler, void* contextPtr)
+{
+    if (stepTimer == NULL)
     {
-        LE_ASSERT_OK(le_mdc_ResetBytesCounter());
-        setNetworkConfiguration(le_mdc_GetProfile(TWILIO_PROFILE_INDEX));
-        setAMSConfig();
+        profileRef = le_mdc_GetProfile(TWILIO_PROFILE_INDEX);
+        LE_ASSERT(profileRef != NULL);
+
+        stepTimer = le_timer_Create("cellularStepTimer");
+        le_timer_SetRepeat(stepTimer, 1);
+        le_timer_SetHandler(stepTimer, onStepTimer);
+        le_timer_SetContextPtr(stepTimer, this);
+
+        netRegHandlerRef = le_mrc_AddNetRegStateEventHandler(onNetRegState,
+                                                                this);
+        sessionHandlerRef = le_mdc_AddSessionStateHandler(profileRef,
+                                                            onSessionState,
+                                                            this);
     }
+
+    le_timer_Stop(stepTimer);
+
+    bringUpHandler = handler;
+    bringUpContextPtr = contextPtr;
+    bringUpStartMs = getNowMs();
+    bringUpDurationMs = 0;
+    memset(stepDurationsMs, 0, sizeof(stepDurationsMs));
+    memset(stepAttemptsNb, 0, sizeof(stepAttemptsNb));
+
+    enterStep(BRINGUP_RADIO_ON);
 }
 
 /*!
- * @brief Stop the WiFi access point
+ * @brief Stop the cellular connectivity. A bring-up or a connectivity check
+ * in progress is cancelled, without calling its handler.
  *
  * @return None
  */
@@ -107,6 +162,17 @@ void CellularNetwork::close(void)
 {
     le_mdc_ConState_t state = LE_MDC_DISCONNECTED;
 
+    if (stepTimer != NULL)
+    {
+        le_timer_Stop(stepTimer);
+    }
+
+    step = BRINGUP_IDLE;
+    isWaitingEvent = false;
+
+    prober.cancel();
+    connectivityHandler = NULL;
+
     /* Check the state of the session */
     LE_ASSERT(LE_OK ==
             le_mdc_GetSessionState(le_mdc_GetProfile(TWILIO_PROFILE_INDEX),
@@ -132,76 +198,498 @@ void CellularNetwork::close(void)
     }
 }
 
+/*!
+ * @brief Get the name of the network interface of the data connection
+ *
+ * @param[out] name     Name of the interface
+ * @param[in] size      Size of the name buffer
+ *
+ * @return Status of the operation
+ * */
+bool CellularNetwork::getInterfaceName(char* name, size_t size) const
+{
+    if ((profileRef == NULL) ||
+        (le_mdc_GetInterfaceName(profileRef, name, size) != LE_OK))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Get the DNS cache, querying the DNS servers of the data connection.
+ * It resolves only the names looked up or prefetched by the clients of this
+ * process; no client of the cellular handler uses it yet.
+ *
+ * @return DNS cache
+ * */
+DnsCache& CellularNetwork::getDnsCache(void)
+{
+    return dnsCache;
+}
+
+/*!
+ * @brief Get the channel of the AT commands, shared by all the users of the
+ * modem
+ *
+ * @return AT channel
+ * */
+AtChannel& CellularNetwork::getAtChannel(void)
+{
+    return atChannel;
+}
+
+/*!
+ * @brief Get the current step of the bring-up
+ *
+ * @return Bring-up step
+ * */
+BringUpStep CellularNetwork::getBringUpStep(void) const
+{
+    return step;
+}
+
+/*!
+ * @brief Get the time taken by a step of the last bring-up
+ *
+ * @param[in] step  Bring-up step
+ *
+ * @return Duration in milliseconds, 0 if the step was not completed
+ * */
+uint32_t CellularNetwork::getStepDurationMs(BringUpStep step) const
+{
+    return (step < BRINGUP_STEP_NB) ? stepDurationsMs[step] : 0;
+}
+
+/*!
+ * @brief Handler of the network registration events
+ *
+ * @param[in] state         New registration state
+ * @param[in] contextPtr    CellularNetwork instance
+ *
+ * @return None
+ * */
+void CellularNetwork::onNetRegState(le_mrc_NetRegState_t state,
+                                    void* contextPtr)
+{
+    CellularNetwork* networkPtr = (CellularNetwork*) contextPtr;
+
+    LE_DEBUG("Registration state %d", state);
+
+    if ((networkPtr->step == BRINGUP_RADIO_ON) &&
+        ((state == LE_MRC_REG_HOME) || (state == LE_MRC_REG_ROAMING)))
+    {
+        networkPtr->completeStep();
+    }
+}
+
+/*!
+ * @brief Handler of the session state events of the profile
+ *
+ * @param[in] sessionProfileRef Profile of the session
+ * @param[in] state             New state of the session
+ * @param[in] contextPtr        CellularNetwork instance
+ *
+ * @return None
+ * */
+void CellularNetwork::onSessionState(le_mdc_ProfileRef_t sessionProfileRef,
+                                        le_mdc_ConState_t state,
+                                        void* contextPtr)
+{
+    CellularNetwork* networkPtr = (CellularNetwork*) contextPtr;
+
+    LE_DEBUG("Session state %d", state);
+
+    if (sessionProfileRef != networkPtr->profileRef)
+    {
+        return;
+    }
+
+    if (((networkPtr->step == BRINGUP_STOP_SESSION) &&
+            (state == LE_MDC_DISCONNECTED)) ||
+        ((networkPtr->step == BRINGUP_START_SESSION) &&
+            (state == LE_MDC_CONNECTED)))
+    {
+        networkPtr->completeStep();
+    }
+    else if ((networkPtr->step == BRINGUP_CONNECTED) &&
+                (state != LE_MDC_CONNECTED))
+    {
+        LE_WARN("Data session lost");
+    }
+}
+
+/*!
+ * @brief Handler of the result of the session start
+ *
+ * @param[in] sessionProfileRef Profile of the session
+ * @param[in] result            Result of the start
+ * @param[in] contextPtr        CellularNetwork instance
+ *
+ * @return None
+ * */
+void CellularNetwork::onSessionStarted(le_mdc_ProfileRef_t sessionProfileRef,
+                                        le_result_t result, void* contextPtr)
+{
+    CellularNetwork* networkPtr = (CellularNetwork*) contextPtr;
+
+    if (sessionProfileRef != networkPtr->profileRef)
+    {
+        return;
+    }
+
+    /* Another start may be requested from now on */
+    networkPtr->isSessionStarting = false;
+
+    if (networkPtr->step != BRINGUP_START_SESSION)
+    {
+        return;
+    }
+
+    if (result == LE_OK)
+    {
+        networkPtr->completeStep();
+    }
+    else
+    {
+        LE_ERROR("Couldn't start session: %d", result);
+        le_mdc_StopSession(networkPtr->profileRef);
+        networkPtr->failStep();
+    }
+}
+
+/*!
+ * @brief Handler of the step timer: either the step timed out, or its retry
+ * delay is over
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void CellularNetwork::onStepTimer(le_timer_Ref_t timerRef)
+{
+    CellularNetwork* networkPtr =
+                        (CellularNetwork*) le_timer_GetContextPtr(timerRef);
+
+    if (networkPtr->isWaitingEvent)
+    {
+        LE_WARN("Bring-up step %s timed out (attempt %u)",
+                getStepName(networkPtr->step), networkPtr->attemptNb);
+        networkPtr->failStep();
+    }
+    else
+    {
+        networkPtr->runStep();
+    }
+}
+
+/*!
+ * @brief Start a bring-up step
+ *
+ * @param[in] nextStep  Step to start
+ *
+ * @return None
+ * */
+void CellularNetwork::enterStep(BringUpStep nextStep)
+{
+    step = nextStep;
+    attemptNb = 0;
+    stepStartMs = getNowMs();
+
+    runStep();
+}
+
+/*!
+ * @brief Run an attempt of the current step. The step either completes
+ * at once, waits for its event, or fails and is attempted again later.
+ *
+ * @return None
+ * */
+void CellularNetwork::runStep(void)
+{
+    le_onoff_t power = LE_OFF;
+    le_mrc_NetRegState_t regState = LE_MRC_REG_NONE;
+    le_mdc_ConState_t state = LE_MDC_DISCONNECTED;
+
+    isWaitingEvent = false;
+    attemptNb++;
+
+    switch (step)
+    {
+        case BRINGUP_RADIO_ON:
+            le_mrc_GetRadioPower(&power);
+
+            if (power == LE_OFF)
+            {
+                LE_INFO("Turn radio ON");
+                le_mrc_SetRadioPower(LE_ON);
+            }
+
+            if ((le_mrc_GetNetRegState(&regState) == LE_OK) &&
+                ((regState == LE_MRC_REG_HOME) ||
+                    (regState == LE_MRC_REG_ROAMING)))
+            {
+                completeStep();
+            }
+            else
+            {
+                waitEvent();
+            }
+            break;
+
+        case BRINGUP_STOP_SESSION:
+            if (le_mdc_GetSessionState(profileRef, &state) != LE_OK)
+            {
+                failStep();
+            }
+            else if (state == LE_MDC_DISCONNECTED)
+            {
+                completeStep();
+            }
+            else
+            {
+                /* If already in use, disconnect the session */
+                LE_INFO("Already in use, disconnect");
+                le_mdc_StopSession(profileRef);
+                waitEvent();
+            }
+            break;
+
+        case BRINGUP_CONFIGURE_PROFILE:
+            /* The modem drivers may reject the settings while they are
+             * still busy with the previous step, they are set again later */
+            if ((le_mdc_SetPDP(profileRef, TWILIO_PDP) == LE_OK) &&
+                (le_mdc_SetAPN(profileRef, TWILIO_APN.c_str()) == LE_OK))
+            {
+                completeStep();
+            }
+            else
+            {
+                failStep();
+            }
+            break;
+
+        case BRINGUP_START_SESSION:
+            if ((le_mdc_GetSessionState(profileRef, &state) == LE_OK) &&
+                (state == LE_MDC_CONNECTED))
+            {
+                completeStep();
+            }
+            else if (isSessionStarting)
+            {
+                /* The modem is still handling the previous start: starting
+                 * again would overlap it, its result is awaited instead */
+                LE_WARN("Session start still pending");
+                waitEvent();
+            }
+            else
+            {
+                LE_INFO("Connect");
+                isSessionStarting = true;
+                le_mdc_StartSessionAsync(profileRef, onSessionStarted, this);
+                waitEvent();
+            }
+            break;
+
+        case BRINGUP_CONFIGURE_NETWORK:
+            /* The interface may not be ready right after the session is
+             * connected, the configuration is then set again later */
+            if (setNetworkConfiguration(profileRef))
+            {
+                completeStep();
+            }
+            else
+            {
+                failStep();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*!
+ * @brief Wait for the event ending the current step, until its timeout
+ *
+ * @return None
+ * */
+void CellularNetwork::waitEvent(void)
+{
+    isWaitingEvent = true;
+
+    le_timer_Stop(stepTimer);
+    le_timer_SetMsInterval(stepTimer, BRINGUP_STEP_CONFIGS[step].timeoutMs);
+    le_timer_Start(stepTimer);
+}
+
+/*!
+ * @brief End the current step successfully and start the next one
+ *
+ * @return None
+ * */
+void CellularNetwork::completeStep(void)
+{
+    le_timer_Stop(stepTimer);
+    isWaitingEvent = false;
+
+    stepDurationsMs[step] = getNowMs() - stepStartMs;
+    stepAttemptsNb[step] = attemptNb;
+
+    LE_DEBUG("Bring-up step %s done in %u ms", getStepName(step),
+                stepDurationsMs[step]);
+
+    switch (step)
+    {
+        case BRINGUP_RADIO_ON:
+            enterStep(BRINGUP_STOP_SESSION);
+            break;
+
+        case BRINGUP_STOP_SESSION:
+            enterStep(BRINGUP_CONFIGURE_PROFILE);
+            break;
+
+        case BRINGUP_CONFIGURE_PROFILE:
+            enterStep(BRINGUP_START_SESSION);
+            break;
+
+        case BRINGUP_START_SESSION:
+            LE_ASSERT_OK(le_mdc_ResetBytesCounter());
+            enterStep(BRINGUP_CONFIGURE_NETWORK);
+            break;
+
+        case BRINGUP_CONFIGURE_NETWORK:
+            setAMSConfig();
+            finish(true);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*!
+ * @brief Handle a failed attempt of the current step: attempt it again after
+ * a delay, or fail the bring-up once it is out of attempts
+ *
+ * @return None
+ * */
+void CellularNetwork::failStep(void)
+{
+    le_timer_Stop(stepTimer);
+    isWaitingEvent = false;
+
+    if (attemptNb >= BRINGUP_STEP_CONFIGS[step].attemptsNb)
+    {
+        LE_ERROR("Bring-up step %s failed after %u attempts",
+                    getStepName(step), attemptNb);
+        stepDurationsMs[step] = getNowMs() - stepStartMs;
+        stepAttemptsNb[step] = attemptNb;
+        finish(false);
+        return;
+    }
+
+    le_timer_SetMsInterval(stepTimer, BRINGUP_RETRY_DELAY_MS);
+    le_timer_Start(stepTimer);
+}
+
+/*!
+ * @brief End the bring-up and notify its handler
+ *
+ * @param[in] isConnected   True if the data connection is up
+ *
+ * @return None
+ * */
+void CellularNetwork::finish(bool isConnected)
+{
+    step = isConnected ? BRINGUP_CONNECTED : BRINGUP_FAILED;
+    bringUpDurationMs = getNowMs() - bringUpStartMs;
+
+    logStats();
+
+    if (bringUpHandler != NULL)
+    {
+        bringUpHandler(isConnected, bringUpContextPtr);
+    }
+}
+
 /*!
  * @brief Configure the network according to the given profile
  *
  * @param[in] profileRef      Modem data connection profile
  *
- * @return Void
+ * @return Status of the operation
  * */
-void CellularNetwork::setNetworkConfiguration(le_mdc_ProfileRef_t profileRef)
+bool CellularNetwork::setNetworkConfiguration(le_mdc_ProfileRef_t profileRef)
 {
     char ipAddr[100] = {0};
     char gatewayAddr[100] = {0};
     char dns1Addr[100] = {0};
     char dns2Addr[100] = {0};
-    char systemCmd[200] = {0};
+    char ifName[IFNAMSIZ] = {0};
     FILE* resolvFilePtr;
     le_mdc_ConState_t state = LE_MDC_DISCONNECTED;
     mode_t oldMask;
+    bool status = true;
 
     // Check the state
-    LE_ASSERT( le_mdc_GetSessionState(profileRef, &state) == LE_OK );
-    LE_ASSERT( state == LE_MDC_CONNECTED );
+    if ((le_mdc_GetSessionState(profileRef, &state) != LE_OK) ||
+        (state != LE_MDC_CONNECTED))
+    {
+        LE_ERROR("Session not connected");
+        return false;
+    }
 
     // Get IP, gateway and DNS addresses for IPv4 or IPv6 connectivity
     if ( le_mdc_IsIPv4(profileRef) )
     {
-        LE_ASSERT(le_mdc_GetIPv4Address(profileRef, ipAddr, sizeof(ipAddr))
+        status = (le_mdc_GetIPv4Address(profileRef, ipAddr,
+                                            sizeof(ipAddr)) == LE_OK) &&
+                    (le_mdc_GetIPv4GatewayAddress(profileRef, gatewayAddr,
+                                            sizeof(gatewayAddr)) == LE_OK) &&
+                    (le_mdc_GetIPv4DNSAddresses(profileRef,
+                                                dns1Addr, sizeof(dns1Addr),
+                                                dns2Addr, sizeof(dns2Addr))
                                                                     == LE_OK);
-        LE_INFO("%s", ipAddr);
-
-        LE_ASSERT(le_mdc_GetIPv4GatewayAddress(profileRef, gatewayAddr,
-                                                sizeof(gatewayAddr)) == LE_OK);
-        LE_INFO("%s", gatewayAddr);
-
-        LE_ASSERT(le_mdc_GetIPv4DNSAddresses( profileRef,
-                                              dns1Addr, sizeof(dns1Addr),
-                                              dns2Addr, sizeof(dns2Addr))
-                                              == LE_OK );
-        LE_INFO("%s", dns1Addr);
-        LE_INFO("%s", dns2Addr);
-
-        sleep(5);
-
-        snprintf(systemCmd, sizeof(systemCmd),
-                                "/sbin/route add default gw %s", gatewayAddr);
     }
     else if ( le_mdc_IsIPv6(profileRef) )
     {
-        LE_ASSERT(le_mdc_GetIPv6Address(profileRef, ipAddr,
-                                                sizeof(ipAddr)) == LE_OK);
-        LE_INFO("%s", ipAddr);
+        status = (le_mdc_GetIPv6Address(profileRef, ipAddr,
+                                            sizeof(ipAddr)) == LE_OK) &&
+                    (le_mdc_GetIPv6GatewayAddress(profileRef, gatewayAddr,
+                                            sizeof(gatewayAddr)) == LE_OK) &&
+                    (le_mdc_GetIPv6DNSAddresses(profileRef,
+                                                dns1Addr, sizeof(dns1Addr),
+                                                dns2Addr, sizeof(dns2Addr))
+                                                                    == LE_OK);
+    }
+    else
+    {
+        status = false;
+    }
 
-        LE_ASSERT(le_mdc_GetIPv6GatewayAddress(profileRef, gatewayAddr,
-                                                sizeof(gatewayAddr)) == LE_OK);
-        LE_INFO("%s", gatewayAddr);
+    if (!status || !getInterfaceName(ifName, sizeof(ifName)))
+    {
+        LE_ERROR("Couldn't get the session addresses");
+        return false;
+    }
 
-        LE_ASSERT(le_mdc_GetIPv6DNSAddresses( profileRef,
-                                              dns1Addr, sizeof(dns1Addr),
-                                              dns2Addr, sizeof(dns2Addr))
-                                                        == LE_OK );
-        LE_INFO("%s", dns1Addr);
-        LE_INFO("%s", dns2Addr);
+    LE_INFO("%s", ipAddr);
+    LE_INFO("%s", gatewayAddr);
+    LE_INFO("%s", dns1Addr);
+    LE_INFO("%s", dns2Addr);
 
-        snprintf(systemCmd, sizeof(systemCmd),
-                        "/sbin/route -A inet6 add default gw %s", gatewayAddr);
+    /* Set in process, without forking the route tool */
+    if (!netConfig.open() || !netConfig.addDefaultRoute(gatewayAddr, ifName) ||
+        !netConfig.apply())
+    {
+        netConfig.clear();
+        LE_ERROR("Couldn't set the default route");
+        return false;
     }
 
-    sleep(5);
-
-    LE_DEBUG("%s", systemCmd);
-    LE_ASSERT( system(systemCmd) == 0 );
+    LE_INFO("Default route set in %u us", netConfig.getLastApplyUs());
 
     // allow fopen to create file with mode=644
     oldMask = umask(022);
@@ -212,69 +700,102 @@ void CellularNetwork::setNetworkConfiguration(le_mdc_ProfileRef_t profileRef)
     if (resolvFilePtr == NULL)
     {
         LE_ERROR("Unable to open resolv.conf: %m");
+        status = false;
     }
-    LE_ASSERT( resolvFilePtr != NULL );
-
-    LE_ASSERT( fprintf(resolvFilePtr, "nameserver %s\n", dns1Addr) > 0 );
-
-    if (dns2Addr[0] != '\0')
+    else
     {
-        LE_ASSERT( fprintf(resolvFilePtr, "nameserver %s\n", dns2Addr) > 0 );
+        status = (fprintf(resolvFilePtr, "nameserver %s\n", dns1Addr) > 0) &&
+                    ((dns2Addr[0] == '\0') ||
+                    (fprintf(resolvFilePtr, "nameserver %s\n", dns2Addr) > 0));
+
+        if ((fclose(resolvFilePtr) != 0) || !status)
+        {
+            LE_ERROR("Unable to write resolv.conf: %m");
+            status = false;
+        }
     }
 
-    LE_ASSERT( fclose(resolvFilePtr) == 0 );
-
     // restore old mask
     umask(oldMask);
+
+    /* Queried in parallel by the cache, for the clients of this process
+     * given it with getDnsCache(). The other processes use resolv.conf. */
+    if (!dnsCache.setServers({dns1Addr, dns2Addr}))
+    {
+        LE_WARN("No DNS server for the cache");
+    }
+
+    return status;
 }
 
 /*!
- * @brief Check if the module is connected to the internet by  pinging
- * google's DNS
+ * @brief Check if the module is connected to the internet, by probing public
+ * DNS servers in parallel until the first one answers. The probes run from
+ * the event loop, the handler is called once the first one answers or the
+ * round times out.
+ *
+ * @param[in] handler       Function called with the result
+ * @param[in] contextPtr    Context given to the handler
  *
- * @return True if connected, false if not
+ * @return None
  * */
-bool CellularNetwork::checkConnectivity()
+void CellularNetwork::checkConnectivity(ConnectivityHandler handler,
+                                        void* contextPtr)
 {
-    bool status = true;
+    connectivityHandler = handler;
+    connectivityContextPtr = contextPtr;
 
-    char systemCmd[200] = {0};
+    /* A round in progress gives the result to the new handler */
+    if (prober.isProbing())
+    {
+        return;
+    }
 
     /* Something's wrong, but it might be Current Health server only */
-    /* Double check with google's DNS to confirm */
-    if (le_mdc_IsIPv4(le_mdc_GetProfile(TWILIO_PROFILE_INDEX)))
+    /* Double check with public DNS servers to confirm */
+    if (!prober.start(onProbeDone, this))
     {
-        snprintf(systemCmd, sizeof(systemCmd),
-                "ping -c 4 8.8.8.8");
+        onProbeDone(false, 0, this);
     }
-    else if (le_mdc_IsIPv6(le_mdc_GetProfile(TWILIO_PROFILE_INDEX)))
+}
+
+/*!
+ * @brief Handler of the end of the connectivity probe round
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    CellularNetwork instance
+ *
+ * @return None
+ * */
+void CellularNetwork::onProbeDone(bool isReachable, uint32_t rttMs,
+                                    void* contextPtr)
+{
+    CellularNetwork* networkPtr = (CellularNetwork*) contextPtr;
+    ConnectivityHandler handler = networkPtr->connectivityHandler;
+
+    networkPtr->connectivityHandler = NULL;
+
+    if (isReachable)
     {
-        snprintf(systemCmd, sizeof(systemCmd),
-                "ping6 -c 4 8.8.8.8");
+        LE_INFO("Connectivity probe success in %u ms", rttMs);
     }
     else
     {
-        LE_WARN("Couldn't get Session type. Consider it's IPV4");
-        snprintf(systemCmd, sizeof(systemCmd),
-                            "ping -c 4 8.8.8.8");
+        LE_ERROR("Connectivity probe failure");
+        networkPtr->prober.logStats();
     }
 
-    if(system(systemCmd))
-    {
-        LE_ERROR("Google DNS ping failure");
-        status = false;
-    }
-    else
+    if (handler != NULL)
     {
-        LE_INFO("Google DNS ping success");
+        handler(isReachable, networkPtr->connectivityContextPtr);
     }
-
-    return status;
 }
 
 /*!
  * @brief Configure the AirVantage Management Services settings using AT
- * commands
+ * commands. They are queued as one batch on the AT channel, the bring-up
+ * doesn't wait for them.
  *
  * @return Void
  * */
@@ -282,32 +803,56 @@ void CellularNetwork::setAMSConfig()
 {
     LE_INFO("AMS configuration");
 
-    /* Open the serial port used to send the AT commands */
-    int fd = ::open("/dev/ttyAT", O_RDWR | O_NOCTTY | O_NONBLOCK);
-
-    le_atClient_DeviceRef_t DevRef = le_atClient_Start(fd);
-
-    for (uint8_t cnt = 0 ; cnt < AT_STARTUP_CMDS.size(); cnt++)
+    if (!atChannel.sendBatch(AT_STARTUP_CMDS, onAMSConfig, this))
     {
-        le_atClient_CmdRef_t cmdRef = le_atClient_Create();
-
-        LE_ASSERT(le_atClient_SetDevice(cmdRef, DevRef) == LE_OK);
-
-        LE_ASSERT(le_atClient_SetCommand(cmdRef,
-                                AT_STARTUP_CMDS[cnt].c_str()) == LE_OK);
-
-        LE_ASSERT(le_atClient_SetFinalResponse(cmdRef, "OK") == LE_OK);
-
-        LE_ASSERT(le_atClient_Send(cmdRef) == LE_OK);
-
-        LE_ASSERT(le_atClient_Delete(cmdRef) == LE_OK);
+        LE_ERROR("Couldn't queue the AMS configuration");
     }
+}
 
-    le_atClient_Stop(DevRef);
+/*!
+ * @brief Handler of the end of the AMS configuration
+ *
+ * @param[in] commandNb     Number of commands of the configuration
+ * @param[in] failedNb      Number of commands which failed
+ * @param[in] durationMs    Time from the queueing of the batch to the last
+ *                          final response
+ * @param[in] contextPtr    Cellular network
+ *
+ * @return None
+ * */
+void CellularNetwork::onAMSConfig(uint8_t commandNb, uint8_t failedNb,
+                                    uint32_t durationMs, void* contextPtr)
+{
+    if (failedNb > 0)
+    {
+        LE_ERROR("AMS configuration: %u of %u commands failed, in %u ms",
+                    failedNb, commandNb, durationMs);
+        return;
+    }
 
-    ::close(fd);
+    LE_INFO("AMS configuration: %u commands in %u ms", commandNb,
+            durationMs);
 }
 
+/*!
+ * @brief Log the duration and attempts of each step of the last bring-up
+ *
+ * @return None
+ * */
+void CellularNetwork::logStats(void) const
+{
+    LE_INFO("Cellular bring-up %s in %u ms", getStepName(step),
+                bringUpDurationMs);
 
+    for (uint8_t i = BRINGUP_RADIO_ON; i < BRINGUP_CONNECTED; i++)
+    {
+        if (stepAttemptsNb[i] > 0)
+        {
+            LE_INFO("Bring-up step %s: %u ms, %u attempts",
+                        getStepName((BringUpStep) i), stepDurationsMs[i],
+                        stepAttemptsNb[i]);
+        }
+    }
+}
 
 /*** end of file ***/
@@ -11,19 +11,74 @@
 
 #include "legato.h"
 #include "interfaces.h"
+#include "CellularNetwork/AtChannel.h"
+#include "CellularNetwork/CellularNetworkUtils.h"
+#include "Network/ConnectivityProber.h"
+#include "Network/DnsCache.h"
+#include "Network/NetlinkConfigurator.h"
 
 class CellularNetwork
 {
     private:
-        void setNetworkConfiguration(le_mdc_ProfileRef_t profileRef);
+        le_mdc_ProfileRef_t profileRef;
+        le_mrc_NetRegStateEventHandlerRef_t netRegHandlerRef;
+        le_mdc_SessionStateHandlerRef_t sessionHandlerRef;
+        le_timer_Ref_t stepTimer;
+        CellularNetworkTypes::BringUpStep step;
+        bool isWaitingEvent;
+        bool isSessionStarting;
+        uint8_t attemptNb;
+        uint64_t bringUpStartMs;
+        uint64_t stepStartMs;
+        uint32_t stepDurationsMs[CellularNetworkTypes::BRINGUP_STEP_NB];
+        uint8_t stepAttemptsNb[CellularNetworkTypes::BRINGUP_STEP_NB];
+        uint32_t bringUpDurationMs;
+        CellularNetworkTypes::BringUpHandler bringUpHandler;
+        void* bringUpContextPtr;
+        CellularNetworkTypes::ConnectivityHandler connectivityHandler;
+        void* connectivityContextPtr;
+        ConnectivityProber prober;
+        NetlinkConfigurator netConfig;
+        DnsCache dnsCache;
+        AtChannel atChannel;
+
+        static uint64_t getNowMs(void);
+        static const char* getStepName(CellularNetworkTypes::BringUpStep step);
+        static void onNetRegState(le_mrc_NetRegState_t state,
+                                    void* contextPtr);
+        static void onSessionState(le_mdc_ProfileRef_t sessionProfileRef,
+                                    le_mdc_ConState_t state, void* contextPtr);
+        static void onSessionStarted(le_mdc_ProfileRef_t sessionProfileRef,
+                                        le_result_t result, void* contextPtr);
+        static void onStepTimer(le_timer_Ref_t timerRef);
+        static void onProbeDone(bool isReachable, uint32_t rttMs,
+                                void* contextPtr);
+        static void onAMSConfig(uint8_t commandNb, uint8_t failedNb,
+                                uint32_t durationMs, void* contextPtr);
+        void enterStep(CellularNetworkTypes::BringUpStep nextStep);
+        void runStep(void);
+        void waitEvent(void);
+        void completeStep(void);
+        void failStep(void);
+        void finish(bool isConnected);
+        bool setNetworkConfiguration(le_mdc_ProfileRef_t profileRef);
         void setAMSConfig();
 
     public:
         CellularNetwork(void);
         ~CellularNetwork(void);
-        void open(void);
+        void open(CellularNetworkTypes::BringUpHandler handler,
+                    void* contextPtr);
         void close(void);
-        bool checkConnectivity(void);
+        bool getInterfaceName(char* name, size_t size) const;
+        DnsCache& getDnsCache(void);
+        AtChannel& getAtChannel(void);
+        CellularNetworkTypes::BringUpStep getBringUpStep(void) const;
+        uint32_t getStepDurationMs(
+                            CellularNetworkTypes::BringUpStep step) const;
+        void checkConnectivity(CellularNetworkTypes::ConnectivityHandler
+                                handler, void* contextPtr);
+        void logStats(void) const;
 };
 
 #endif // CELLULAR_NETWORK_H
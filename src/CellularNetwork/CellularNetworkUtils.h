@@ -14,6 +14,46 @@
 #include <iostream>
 #include <vector>
 
+namespace CellularNetworkTypes
+{
+    /* Steps of the bring-up of the data connection, in order */
+    enum BringUpStep
+    {
+        /* No bring-up started */
+        BRINGUP_IDLE,
+        /* Radio powered, waiting for the registration to the network */
+        BRINGUP_RADIO_ON,
+        /* Waiting for a previous session to be stopped */
+        BRINGUP_STOP_SESSION,
+        /* PDP type and APN of the profile set */
+        BRINGUP_CONFIGURE_PROFILE,
+        /* Waiting for the session to be connected */
+        BRINGUP_START_SESSION,
+        /* Default route and DNS servers set */
+        BRINGUP_CONFIGURE_NETWORK,
+        /* Data connection up */
+        BRINGUP_CONNECTED,
+        /* A step ran out of attempts */
+        BRINGUP_FAILED,
+        BRINGUP_STEP_NB
+    };
+
+    /* Timeout and retries of a bring-up step */
+    struct BringUpStepConfig
+    {
+        /* Time to wait for the event ending the step */
+        uint32_t timeoutMs;
+        /* Attempts before the bring-up fails */
+        uint8_t attemptsNb;
+    };
+
+    /* Called once the bring-up is over, connected or failed */
+    typedef void (*BringUpHandler)(bool isConnected, void* contextPtr);
+
+    /* Called once the connectivity check is over */
+    typedef void (*ConnectivityHandler)(bool isConnected, void* contextPtr);
+}
+
 namespace CellularNetworkConstants
 {
     /* Twilio profile settings */
@@ -21,6 +61,33 @@ namespace CellularNetworkConstants
     const le_mdc_Pdp_t TWILIO_PDP = LE_MDC_PDP_IPV4;
     const std::string TWILIO_APN  = "wireless.twilio.com";
 
+    /* Timeout and attempts of each bring-up step, in the order of BringUpStep.
+     * The registration may take minutes on a cold start, the synchronous
+     * steps are retried when the modem is not ready yet. */
+    const CellularNetworkTypes::BringUpStepConfig
+                BRINGUP_STEP_CONFIGS[CellularNetworkTypes::BRINGUP_STEP_NB] =
+    {
+        /* BRINGUP_IDLE */
+        {0, 0},
+        /* BRINGUP_RADIO_ON */
+        {180000, 2},
+        /* BRINGUP_STOP_SESSION */
+        {10000, 3},
+        /* BRINGUP_CONFIGURE_PROFILE */
+        {0, 5},
+        /* BRINGUP_START_SESSION */
+        {60000, 3},
+        /* BRINGUP_CONFIGURE_NETWORK */
+        {0, 10},
+        /* BRINGUP_CONNECTED */
+        {0, 0},
+        /* BRINGUP_FAILED */
+        {0, 0}
+    };
+
+    /* Delay before a failed step is attempted again */
+    const uint32_t BRINGUP_RETRY_DELAY_MS = 500;
+
     /* This vector defines a number of seconds to wait a each stages of the
      * reconnect process. The point is to avoid looping in a 5 sec reconnect
      * process and allow for an OTA to happen if the reconnect process is
@@ -70,9 +137,6 @@ namespace CellularNetworkConstants
             PCKG_UNINSTALL_AUTO_AGREEMENT,
             CONNECT_TO_AIRVANTAGE
     };
-
-    /* Period between two connectivity check aka heartbeats */
-    const uint16_t HEARTBEAT_PERIOD_S = 600;
 }
 
 #endif /* CELLULAR_NETWORK_UTILS_H */
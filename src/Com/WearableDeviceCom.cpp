@@ -12,25 +12,59 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <time.h>
 #include "Com/WearableDeviceALPUtils.h"
+#include "Socket/SocketTuning.h"
 
 using namespace WearableDeviceALPConstants;
 
 /*!
  * @brief Constructor for WearableDeviceCom. This initialize the socket server
- * and launch it. A call to open() will then allow to receive the next
- * device connection.
+ * and launch it. Calls to serve() will then accept the devices and serve
+ * them, up to MAX_WEARABLE_DEVICES at once.
+ *
+ * @param[in] port              Port to listen on
+ * @param[in] addr              Address to listen on
+ * @param[in] device            Interface to bind the server to, if not empty
+ * @param[in] serverOptions     TCP features to use. The features not
+ *                              supported by the kernel are disabled.
  * */
-WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr, std::string device) : opt(1), addrlen(sizeof(address)), serverStatus(true)
+WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr,
+                        std::string device,
+                        const WearableDeviceALPTypes::ServerOptions& serverOptions) :
+                        opt(1), addrlen(sizeof(address)),
+                        serverStatus(true), interface(device),
+                        options(serverOptions), openNb(0),
+                        receiveHandler(NULL), receiveContextPtr(NULL),
+                        isAcceptPaused(false), acceptRetryMs(0),
+                        connectionNb(0), refusedNb(0), fastOpenNb(0),
+                        connAckNb(0), connAckLatencyMaxMs(0),
+                        connAckLatencySumMs(0), expiredNb(0), maxOpenNb(0),
+                        deadlineWheel(NULL)
 {
-    struct timeval alpTimeout;
-    alpTimeout.tv_sec = ALP_COMMUNICATION_TIMEOUT_SEC;
-    alpTimeout.tv_usec = 0;
+    for (uint8_t i = 0; i < MAX_WEARABLE_DEVICES; i++)
+    {
+        Connection& conn = connections[i];
+
+        conn.serverPtr = this;
+        conn.id = i;
+        conn.fd = -1;
+        conn.isClosing = false;
+        conn.isConnAckPending = false;
+
+        TimerWheel::initTimer(&conn.handshakeDeadline,
+                                handshakeDeadlineHandler, &conn);
+        TimerWheel::initTimer(&conn.idleDeadline, idleDeadlineHandler, &conn);
+        TimerWheel::initTimer(&conn.readDeadline, readDeadlineHandler, &conn);
+    }
 
     LE_INFO("Create socket");
 
-    /* Create the TCP socket file descriptor using IPv4 */
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    /* Create the TCP socket file descriptor using IPv4. It is non blocking
+     * so that serve() accepts all the pending connections at once. */
+    server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
 
     if (server_fd < 0)
     {
@@ -55,12 +89,6 @@ WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr, std::string devi
             LE_ERROR("setsockopt failure");
             serverStatus = false;
         }
-        else if (setsockopt(server_fd, SOL_SOCKET,
-                SO_RCVTIMEO, (const char*)&alpTimeout, sizeof(alpTimeout)))
-        {
-            LE_ERROR("setsockopt failure");
-            serverStatus = false;
-        }
 
         if (!device.empty() && serverStatus)
         {
@@ -73,6 +101,39 @@ WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr, std::string devi
         }
     }
 
+    if (serverStatus)
+    {
+        /* Set on the listening socket so that the buffer sizes are taken
+         * into account for the window scaling of the connections */
+        SocketTuning::apply(server_fd, interface);
+    }
+
+    if (serverStatus && options.deferAccept)
+    {
+        int deferSec = DEVICE_COM_DEFER_ACCEPT_SEC;
+
+        /* Only wake up accept() once the device has sent its CONNECT */
+        if (setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                                            &deferSec, sizeof(deferSec)))
+        {
+            LE_WARN("TCP_DEFER_ACCEPT not available: %s", strerror(errno));
+            options.deferAccept = false;
+        }
+    }
+
+    if (serverStatus && options.fastOpen)
+    {
+        int queueSize = DEVICE_COM_FASTOPEN_QUEUE_SIZE;
+
+        /* Let the returning devices send their CONNECT in the SYN */
+        if (setsockopt(server_fd, IPPROTO_TCP, TCP_FASTOPEN,
+                                            &queueSize, sizeof(queueSize)))
+        {
+            LE_WARN("TCP_FASTOPEN not available: %s", strerror(errno));
+            options.fastOpen = false;
+        }
+    }
+
     if (serverStatus)
     {
         address.sin_family = AF_INET;
@@ -96,7 +157,9 @@ WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr, std::string devi
         }
         else
         {
-            LE_INFO("Starting server on port %d", port);
+            LE_INFO("Starting server on port %d (fastopen %d, defer accept %d,"
+                    " %u connections)", port, options.fastOpen,
+                    options.deferAccept, MAX_WEARABLE_DEVICES);
         }
     }
 }
@@ -108,197 +171,792 @@ WearableDeviceCom::WearableDeviceCom (int port, in_addr_t addr, std::string devi
 WearableDeviceCom::~WearableDeviceCom(void)
 {
     LE_INFO("Server socket closed");
-    WearableDeviceCom::close();
+
+    for (uint8_t i = 0; i < MAX_WEARABLE_DEVICES; i++)
+    {
+        if (connections[i].fd >= 0)
+        {
+            drop(&connections[i]);
+        }
+    }
+
     ::close(server_fd);
 }
 
 /*!
- * @brief Wait and accept the next device connection to the server
+ * @brief Get the monotonic time in milliseconds
  *
- * @return Status of the operation.
+ * @return Number of milliseconds since an arbitrary point in the past
+ */
+uint64_t WearableDeviceCom::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Set the function called when data is received from a device
+ *
+ * @param[in] handler       Function called with the connection
+ * @param[in] contextPtr    Context given to the function
+ *
+ * @return None
+ */
+void WearableDeviceCom::setReceiveHandler(
+                                WearableDeviceALPTypes::ReceiveHandler handler,
+                                void* contextPtr)
+{
+    receiveHandler = handler;
+    receiveContextPtr = contextPtr;
+}
+
+/*!
+ * @brief Serve the devices: wait until a device connects, sends data or can
+ * take the data queued for it, or until a deadline expires, and handle it.
+ * Each connection only gets what it is ready for, so a slow device does not
+ * hold up the others. To be called in a loop.
+ *
+ * @param[in] timeoutMs     Longest wait, -1 to wait for an event
+ *
+ * @return False if the server failed and has to be created again
  */
-bool WearableDeviceCom::open(void)
+bool WearableDeviceCom::serve(int32_t timeoutMs)
 {
-    bool status = true;
+    struct pollfd pfds[MAX_WEARABLE_DEVICES + 2];
+    uint8_t connIds[MAX_WEARABLE_DEVICES + 2];
+    nfds_t pfdNb = 0;
+    int32_t listenIndex = -1;
 
     if (!serverStatus)
     {
         LE_ERROR("Server is not initialized successfully");
-        status = false;
+        return false;
     }
 
-    if (status)
+    if (deadlineWheel == NULL)
+    {
+        LE_ERROR("No deadline service, the devices could stall the server");
+        return false;
+    }
+
+    if (isAcceptPaused)
     {
-        LE_INFO("Waiting for a device to connect");
+        int64_t retryInMs = (int64_t) acceptRetryMs - (int64_t) getNowMs();
 
-        do
+        if (retryInMs <= 0)
+        {
+            isAcceptPaused = false;
+        }
+        else if ((timeoutMs < 0) || (retryInMs < timeoutMs))
         {
-            /* Wait for a device to connect */
-            com_fd = accept(server_fd, (struct sockaddr *) &address,
-                    (socklen_t*) &addrlen);
+            timeoutMs = retryInMs;
         }
-        while((com_fd < 0) && (errno == EAGAIN));
+    }
+
+    pfds[pfdNb].fd = deadlineWheel->getFd();
+    pfds[pfdNb].events = POLLIN;
+    pfdNb++;
+
+    if (!isAcceptPaused)
+    {
+        listenIndex = pfdNb;
+        pfds[pfdNb].fd = server_fd;
+        pfds[pfdNb].events = POLLIN;
+        pfdNb++;
+    }
 
-        if (com_fd < 0)
+    for (uint8_t i = 0; i < MAX_WEARABLE_DEVICES; i++)
+    {
+        Connection& conn = connections[i];
+        short events = 0;
+
+        if (conn.fd < 0)
         {
-            LE_ERROR("Failed to accept a new device: %s", strerror(errno));
-            status = false;
+            continue;
         }
-        else
+
+        /* Stop reading from a device which does not take what is sent to
+         * it, or whose data is not read */
+        if (!conn.isClosing && !conn.outputQueue.isReadPaused() &&
+            (conn.input.size() < DEVICE_COM_INPUT_MAX_SIZE))
         {
-            LE_INFO("New device connected");
+            events |= POLLIN;
         }
+
+        if (!conn.outputQueue.isEmpty())
+        {
+            events |= POLLOUT;
+        }
+
+        pfds[pfdNb].fd = conn.fd;
+        pfds[pfdNb].events = events;
+        connIds[pfdNb] = i;
+        pfdNb++;
     }
 
-    return status;
+    for (nfds_t i = 0; i < pfdNb; i++)
+    {
+        pfds[i].revents = 0;
+    }
+
+    int pollStatus = poll(pfds, pfdNb, timeoutMs);
+
+    if ((pollStatus < 0) && (errno == EINTR))
+    {
+        return true;
+    }
+    else if (pollStatus < 0)
+    {
+        LE_ERROR("Failed to wait for the devices: %s", strerror(errno));
+        return false;
+    }
+
+    /* The deadlines first, so that a device which missed one is not served
+     * anymore */
+    if (pfds[0].revents & POLLIN)
+    {
+        deadlineWheel->process();
+    }
+
+    if ((listenIndex >= 0) && (pfds[listenIndex].revents != 0) &&
+        !acceptAll())
+    {
+        return false;
+    }
+
+    for (nfds_t i = (listenIndex >= 0) ? 2 : 1; i < pfdNb; i++)
+    {
+        Connection* connPtr = &connections[connIds[i]];
+
+        /* Closed while serving another connection or by a deadline, the
+         * slot may even be used by a new connection */
+        if ((connPtr->fd != pfds[i].fd) || (pfds[i].revents == 0))
+        {
+            continue;
+        }
+
+        if ((pfds[i].revents & POLLOUT) && !send(connPtr))
+        {
+            continue;
+        }
+
+        /* Nothing more is read from a connection being closed */
+        if (connPtr->isClosing)
+        {
+            if (pfds[i].revents & (POLLERR | POLLHUP))
+            {
+                drop(connPtr);
+            }
+
+            continue;
+        }
+
+        if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP))
+        {
+            receive(connPtr);
+        }
+    }
+
+    return true;
 }
 
 /*!
- * @brief Send data to the wearable device
+ * @brief Accept all the connections waiting on the server
  *
- * @param[in] buf	Pointer to the buffer of bytes to be sent
- * @param[in] len	Number of bytes to send
+ * @return False if the server socket failed
+ */
+bool WearableDeviceCom::acceptAll(void)
+{
+    while (1)
+    {
+        int32_t fd = accept4(server_fd, (struct sockaddr *) &address,
+                                (socklen_t*) &addrlen,
+                                SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+        if (fd < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                (errno == EINTR) || (errno == ECONNABORTED) ||
+                (errno == EPROTO))
+            {
+                return true;
+            }
+
+            if ((errno == EMFILE) || (errno == ENFILE) ||
+                (errno == ENOBUFS) || (errno == ENOMEM))
+            {
+                LE_WARN("Failed to accept a new device: %s, retry in %u ms",
+                        strerror(errno), DEVICE_COM_ACCEPT_RETRY_MS);
+                isAcceptPaused = true;
+                acceptRetryMs = getNowMs() + DEVICE_COM_ACCEPT_RETRY_MS;
+                return true;
+            }
+
+            LE_ERROR("Failed to accept a new device: %s", strerror(errno));
+            return false;
+        }
+
+        Connection* connPtr = NULL;
+
+        for (uint8_t i = 0; (i < MAX_WEARABLE_DEVICES) && (connPtr == NULL);
+                                                                        i++)
+        {
+            if (connections[i].fd < 0)
+            {
+                connPtr = &connections[i];
+            }
+        }
+
+        if (connPtr == NULL)
+        {
+            LE_WARN("%u devices connected already, refuse a new one",
+                                                                    openNb);
+            ::close(fd);
+            refusedNb++;
+            continue;
+        }
+
+        struct tcp_info info;
+        socklen_t infoLen = sizeof(info);
+
+        connPtr->fd = fd;
+        connPtr->input.clear();
+        connPtr->outputQueue.clear();
+        connPtr->isClosing = false;
+        connPtr->acceptTime = le_clk_GetRelativeTime();
+        connPtr->isConnAckPending = true;
+        connectionNb++;
+        openNb++;
+
+        if (openNb > maxOpenNb)
+        {
+            maxOpenNb = openNb;
+        }
+
+        SocketTuning::apply(fd, interface);
+
+        startDeadline(&connPtr->handshakeDeadline, ALP_HANDSHAKE_TIMEOUT_SEC);
+        startDeadline(&connPtr->idleDeadline, ALP_IDLE_TIMEOUT_SEC);
+
+        /* Check if the CONNECT came in the SYN */
+        if ((getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0) &&
+            (info.tcpi_options & TCPI_OPT_SYN_DATA))
+        {
+            fastOpenNb++;
+        }
+
+        LE_INFO("New device connected (connection %u, %u open)",
+                                                        connPtr->id, openNb);
+    }
+}
+
+/*!
+ * @brief Receive what a device sent, then give it to the receive handler
  *
- * @return Status of the operation.
+ * @param[in] connPtr   Connection
+ *
+ * @return None
  */
-bool WearableDeviceCom::write(uint8_t* buf, uint32_t len)
+void WearableDeviceCom::receive(Connection* connPtr)
 {
-    bool status = true;
-    int32_t bytesSentNb = 0;
+    uint32_t inputNb = connPtr->input.size();
+    uint32_t chunkSize = DEVICE_COM_INPUT_MAX_SIZE - inputNb;
 
-    if (!serverStatus)
+    if (chunkSize > DEVICE_COM_RECEIVE_CHUNK_SIZE)
     {
-        LE_ERROR("Server is not initialized successfully");
-        status = false;
+        chunkSize = DEVICE_COM_RECEIVE_CHUNK_SIZE;
     }
 
-    if (buf == NULL)
+    connPtr->input.resize(inputNb + chunkSize);
+
+    /* Use "::" to explicitly refer to the global namespace
+     * socket recv() function from <sys/socket.h>*/
+    int32_t comStatus = ::recv(connPtr->fd, &connPtr->input[inputNb],
+                                chunkSize, 0);
+
+    connPtr->input.resize(inputNb + ((comStatus > 0) ? comStatus : 0));
+
+    if ((comStatus < 0) &&
+        ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
     {
-        LE_ERROR("Provided buffer is NULL");
-        status = false;
+        return;
+    }
+    else if (comStatus < 0)
+    {
+        LE_ERROR("Error reading from the socket: %s", strerror(errno));
+        drop(connPtr);
+        return;
+    }
+    else if (comStatus == 0)
+    {
+        LE_INFO("Socket was closed by the client");
+        drop(connPtr);
+        return;
     }
 
-    if (status)
+    startDeadline(&connPtr->idleDeadline, ALP_IDLE_TIMEOUT_SEC);
+
+    /* The whole message has to be received in time, not only each part */
+    if (inputNb == 0)
     {
-        if (com_fd < 0)
-        {
-            LE_ERROR("com_fd descriptor is not valid. "
-                    "Please make sure start method was successful.");
-            status = false;
-        }
+        startDeadline(&connPtr->readDeadline, ALP_COMMUNICATION_TIMEOUT_SEC);
     }
 
-    if (status)
+    if (receiveHandler != NULL)
+    {
+        receiveHandler(connPtr->id, receiveContextPtr);
+    }
+}
+
+/*!
+ * @brief Send what is queued for a device, as much as the socket takes
+ *
+ * @param[in] connPtr   Connection
+ *
+ * @return False if the connection failed, or was closed once all sent
+ */
+bool WearableDeviceCom::send(Connection* connPtr)
+{
+    uint32_t queuedBytesNb = connPtr->outputQueue.getQueuedBytesNb();
+    le_result_t result = connPtr->outputQueue.flush(connPtr->fd);
+    uint32_t bytesSentNb = queuedBytesNb -
+                            connPtr->outputQueue.getQueuedBytesNb();
+
+    if (bytesSentNb > 0)
     {
-        /* Send the buffer through the TCP socket */
-        bytesSentNb = send(com_fd, buf, len, 0);
+        startDeadline(&connPtr->idleDeadline, ALP_IDLE_TIMEOUT_SEC);
 
-        if (bytesSentNb < 0)
-        {
-            LE_ERROR("Error while transmitting to the device");
-            status = false;
-        }
-        else if ((uint32_t) bytesSentNb != len)
+        /* The CONNACK is the first message sent to the device */
+        if (connPtr->isConnAckPending)
         {
-            LE_ERROR("Error, only %d bytes transmitted out of %d", bytesSentNb,
-                    len);
-            status = false;
+            recordConnAckLatency(connPtr);
         }
     }
 
-    if (status)
+    if ((result != LE_OK) && (result != LE_WOULD_BLOCK))
     {
-        LE_INFO("%d bytes sent successfully", bytesSentNb);
+        LE_ERROR("Error, %u bytes still to transmit",
+                                connPtr->outputQueue.getQueuedBytesNb());
+        drop(connPtr);
+        return false;
     }
 
-    return status;
+    if ((result == LE_OK) && connPtr->isClosing)
+    {
+        drop(connPtr);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Get a connection from its identifier
+ *
+ * @param[in] connectionId  Connection given to the receive handler
+ *
+ * @return Connection, NULL if it is not open
+ */
+WearableDeviceCom::Connection* WearableDeviceCom::getConnection(
+                                                        uint8_t connectionId)
+{
+    if ((connectionId >= MAX_WEARABLE_DEVICES) ||
+        (connections[connectionId].fd < 0))
+    {
+        LE_ERROR("Connection %u is not open", connectionId);
+        return NULL;
+    }
+
+    return &connections[connectionId];
+}
+
+const WearableDeviceCom::Connection* WearableDeviceCom::getConnection(
+                                                uint8_t connectionId) const
+{
+    if ((connectionId >= MAX_WEARABLE_DEVICES) ||
+        (connections[connectionId].fd < 0))
+    {
+        LE_ERROR("Connection %u is not open", connectionId);
+        return NULL;
+    }
+
+    return &connections[connectionId];
 }
 
 /*!
- * @brief Receive data from the wearable device
+ * @brief Get the number of bytes received from a device and not read yet
  *
- * @param[out] buf	Pointer to the buffer to put the bytes read into
- * @param[in] len	Number of bytes to read
+ * @param[in] connectionId  Connection
+ *
+ * @return Number of bytes
+ */
+uint32_t WearableDeviceCom::getReceivedNb(uint8_t connectionId) const
+{
+    const Connection* connPtr = getConnection(connectionId);
+
+    return (connPtr == NULL) ? 0 : connPtr->input.size();
+}
+
+/*!
+ * @brief Copy the next bytes received from a device, leaving them to be read
+ *
+ * @param[in] connectionId  Connection
+ * @param[out] buf          Pointer to the buffer to put the bytes into
+ * @param[in] len           Number of bytes to copy
+ *
+ * @return False if fewer bytes were received
+ */
+bool WearableDeviceCom::peek(uint8_t connectionId, uint8_t* buf,
+                                uint32_t len) const
+{
+    const Connection* connPtr = getConnection(connectionId);
+
+    if ((connPtr == NULL) || (buf == NULL) || (connPtr->input.size() < len))
+    {
+        return false;
+    }
+
+    memcpy(buf, connPtr->input.data(), len);
+
+    return true;
+}
+
+/*!
+ * @brief Read the next bytes received from a device. Nothing is read if
+ * fewer bytes were received: the receive handler is called again when more
+ * arrive.
+ *
+ * @param[in] connectionId  Connection
+ * @param[out] buf          Pointer to the buffer to put the bytes read into
+ * @param[in] len           Number of bytes to read
  *
  * @return Status of the operation.
  */
-bool WearableDeviceCom::read(uint8_t* buf, uint32_t len)
+bool WearableDeviceCom::read(uint8_t connectionId, uint8_t* buf, uint32_t len)
 {
-    bool status = true;
-    uint32_t bytesReceivedNb = 0;
+    Connection* connPtr = getConnection(connectionId);
 
-    if (!serverStatus)
+    if ((connPtr == NULL) || (buf == NULL) || (connPtr->input.size() < len))
     {
-        LE_ERROR("Server is not initialized successfully");
-        status = false;
+        return false;
     }
 
-    if (buf == NULL)
+    memcpy(buf, connPtr->input.data(), len);
+    connPtr->input.erase(connPtr->input.begin(),
+                            connPtr->input.begin() + len);
+
+    /* The deadline of the next message starts with its first byte */
+    if (connPtr->input.empty())
     {
-        LE_ERROR("Provided buffer is NULL");
-        status = false;
+        cancelDeadline(&connPtr->readDeadline);
+    }
+    else
+    {
+        startDeadline(&connPtr->readDeadline, ALP_COMMUNICATION_TIMEOUT_SEC);
     }
 
+    LE_DEBUG("%u bytes read from connection %u", len, connectionId);
+
+    return true;
+}
+
+/*!
+ * @brief Send data to the wearable device. The data queued before with
+ * queue() goes out first. What the socket does not take now is sent by
+ * serve() when the device is ready for it.
+ *
+ * @param[in] connectionId  Connection
+ * @param[in] buf           Pointer to the buffer of bytes to be sent
+ * @param[in] len           Number of bytes to send
+ *
+ * @return Status of the operation.
+ */
+bool WearableDeviceCom::write(uint8_t connectionId, uint8_t* buf,
+                                uint32_t len)
+{
+    bool status = queue(connectionId, buf, len);
+
     if (status)
     {
-        if (com_fd < 0)
-        {
-            LE_ERROR("com_fd descriptor is not valid. "
-                    "Please make sure start method was successful.");
-            status = false;
-        }
+        status = flush(connectionId);
     }
 
-    /* Reading from the TCP socket might need to be in several parts
-     * depending on the size of the payload expected */
-    while (bytesReceivedNb != len)
+    if (status)
     {
-        /* Read from the TCP socket */
-        /* Use "::" to explicitly refer to the global namespace
-         * socket recv() function from <sys/socket.h>*/
-        int32_t comStatus = ::recv(com_fd, buf + bytesReceivedNb,
-                                    len - bytesReceivedNb, 0);
+        LE_INFO("%u bytes sent to connection %u", len, connectionId);
+    }
 
-        if (comStatus < 0)
-        {
-            LE_ERROR("Error reading from the socket");
-            status = false;
-            break;
-        }
-        else if (comStatus == 0)
-        {
-            LE_ERROR("Socket was closed by the client");
-            status = false;
-            break;
-        }
-        else
-        {
-            /* We successfully received another chunk of bytes */
-            bytesReceivedNb += comStatus;
-        }
+    return status;
+}
+
+/*!
+ * @brief Queue data to be sent to the wearable device with the next flush()
+ * or write(). Used to group small messages (acks) in a single send.
+ *
+ * @param[in] connectionId  Connection
+ * @param[in] buf           Pointer to the buffer of bytes to be sent
+ * @param[in] len           Number of bytes to send
+ *
+ * @return Status of the operation.
+ */
+bool WearableDeviceCom::queue(uint8_t connectionId, uint8_t* buf,
+                                uint32_t len)
+{
+    Connection* connPtr = getConnection(connectionId);
+
+    if (buf == NULL)
+    {
+        LE_ERROR("Provided buffer is NULL");
+        return false;
     }
 
-    if (status)
+    return ((connPtr != NULL) &&
+            (LE_OK == connPtr->outputQueue.push(buf, len)));
+}
+
+/*!
+ * @brief Send the queued data to the wearable device, as much as the socket
+ * takes without waiting. The rest is sent by serve().
+ *
+ * @param[in] connectionId  Connection
+ *
+ * @return False if the connection failed and was closed
+ */
+bool WearableDeviceCom::flush(uint8_t connectionId)
+{
+    Connection* connPtr = getConnection(connectionId);
+
+    return ((connPtr != NULL) && send(connPtr));
+}
+
+/*!
+ * @brief Close the TCP socket with the wearable device once the data queued
+ * for it is sent. Nothing more is read from it. The idle deadline still
+ * applies to a device which does not take the data.
+ *
+ * @param[in] connectionId  Connection
+ *
+ * @return None
+ */
+void WearableDeviceCom::close(uint8_t connectionId)
+{
+    Connection* connPtr = getConnection(connectionId);
+
+    if (connPtr == NULL)
     {
-        LE_INFO("%u bytes received successfully", bytesReceivedNb);
+        return;
+    }
+
+    if (connPtr->outputQueue.isEmpty())
+    {
+        drop(connPtr);
     }
     else
     {
-        LE_ERROR("%u bytes received, expected %u", bytesReceivedNb, len);
+        connPtr->isClosing = true;
+        cancelDeadline(&connPtr->readDeadline);
     }
-    return status;
 }
 
 /*!
- * @brief Close the TCP socket with the wearable device
+ * @brief Close the TCP socket with the wearable device now. What was left
+ * to send or to read is dropped, the connection starts empty when reused.
+ *
+ * @param[in] connPtr   Connection
+ *
+ * @return None
  */
-void WearableDeviceCom::close(void)
+void WearableDeviceCom::drop(Connection* connPtr)
 {
-    LE_INFO("Socket closed");
+    LE_INFO("Socket closed (connection %u)", connPtr->id);
 
     /* Use "::" to explicitly refer to the global namespace
      * close() function from <unistd.h>*/
-    ::close(com_fd);
+    ::close(connPtr->fd);
+    connPtr->fd = -1;
+    connPtr->isConnAckPending = false;
+    connPtr->isClosing = false;
+
+    /* A PUBLISH cut in the middle is not kept: ALP has no message telling
+     * the device an offset to resume from, so it always sends it again in
+     * full. Checkpointing the payloads waits for the firmware to have one */
+    connPtr->input.clear();
+    connPtr->outputQueue.clear();
+    openNb--;
+
+    cancelDeadline(&connPtr->handshakeDeadline);
+    cancelDeadline(&connPtr->idleDeadline);
+    cancelDeadline(&connPtr->readDeadline);
+}
+
+/*!
+ * @brief Get the number of devices connected
+ *
+ * @return Number of connections open
+ */
+uint8_t WearableDeviceCom::getConnectionNb(void) const
+{
+    return openNb;
+}
+
+/*!
+ * @brief Set the timer wheel enforcing the handshake, idle and read
+ * deadlines of the connections. It is required: serve() fails without it.
+ *
+ * @param[in] wheel     Timer wheel, may be shared with other servers of the
+ *                      thread
+ *
+ * @return None
+ */
+void WearableDeviceCom::setDeadlineService(TimerWheel* wheel)
+{
+    deadlineWheel = wheel;
+}
+
+/*!
+ * @brief Expiry handlers of the deadlines of the connections
+ *
+ * @param[in] contextPtr    Connection owning the deadline
+ *
+ * @return None
+ */
+void WearableDeviceCom::handshakeDeadlineHandler(void* contextPtr)
+{
+    Connection* connPtr = (Connection*) contextPtr;
+
+    connPtr->serverPtr->expireDeadline(connPtr, "handshake");
+}
+
+void WearableDeviceCom::idleDeadlineHandler(void* contextPtr)
+{
+    Connection* connPtr = (Connection*) contextPtr;
+
+    connPtr->serverPtr->expireDeadline(connPtr, "idle");
+}
+
+void WearableDeviceCom::readDeadlineHandler(void* contextPtr)
+{
+    Connection* connPtr = (Connection*) contextPtr;
+
+    connPtr->serverPtr->expireDeadline(connPtr, "read");
+}
+
+/*!
+ * @brief Close a connection after one of its deadlines expired
+ *
+ * @param[in] connPtr       Connection
+ * @param[in] deadlineName  Name of the deadline, for the logs
+ *
+ * @return None
+ */
+void WearableDeviceCom::expireDeadline(Connection* connPtr,
+                                        const char* deadlineName)
+{
+    LE_WARN("Device missed its %s deadline (connection %u)", deadlineName,
+                                                                connPtr->id);
+    expiredNb++;
+
+    if (connPtr->fd >= 0)
+    {
+        drop(connPtr);
+    }
+}
+
+/*!
+ * @brief Start or restart a deadline of a connection
+ *
+ * @param[in] timerPtr  Deadline to start
+ * @param[in] delaySec  Time left to the device
+ *
+ * @return None
+ */
+void WearableDeviceCom::startDeadline(TimerWheelTypes::Timer* timerPtr,
+                                        uint32_t delaySec)
+{
+    if (deadlineWheel != NULL)
+    {
+        deadlineWheel->start(timerPtr, delaySec * 1000);
+    }
+}
+
+/*!
+ * @brief Cancel a deadline of a connection
+ *
+ * @param[in] timerPtr  Deadline to cancel
+ *
+ * @return None
+ */
+void WearableDeviceCom::cancelDeadline(TimerWheelTypes::Timer* timerPtr)
+{
+    if (deadlineWheel != NULL)
+    {
+        deadlineWheel->cancel(timerPtr);
+    }
+}
+
+/*!
+ * @brief Record the time between the connection of the device and the
+ * CONNACK sent by the hub
+ *
+ * @param[in] connPtr   Connection
+ *
+ * @return None
+ */
+void WearableDeviceCom::recordConnAckLatency(Connection* connPtr)
+{
+    le_clk_Time_t elapsed = le_clk_Sub(le_clk_GetRelativeTime(),
+                                        connPtr->acceptTime);
+    uint32_t latencyMs = elapsed.sec * 1000 + elapsed.usec / 1000;
+    struct tcp_info info;
+    socklen_t infoLen = sizeof(info);
+    uint32_t rttUs = 0;
+
+    connPtr->isConnAckPending = false;
+    connAckNb++;
+
+    cancelDeadline(&connPtr->handshakeDeadline);
+
+    if (latencyMs > connAckLatencyMaxMs)
+    {
+        connAckLatencyMaxMs = latencyMs;
+    }
+    connAckLatencySumMs += latencyMs;
+
+    /* The handshake itself takes one round trip before accept() returns */
+    if (getsockopt(connPtr->fd, IPPROTO_TCP, TCP_INFO, &info, &infoLen) == 0)
+    {
+        rttUs = info.tcpi_rtt;
+    }
+
+    LE_INFO("Accept to CONNACK: %u ms, rtt %u us", latencyMs, rttUs);
+}
+
+/*!
+ * @brief Log the statistics of the connections accepted by the server
+ *
+ * @return None
+ */
+void WearableDeviceCom::logConnectStats(void)
+{
+    LE_INFO("Connections: %u (%u open, max %u, %u refused, %u deadlines "
+            "missed), fastopen: %u, accept to CONNACK avg %u ms max %u ms "
+            "(fastopen %d, defer accept %d)", connectionNb, openNb,
+            maxOpenNb, refusedNb, expiredNb, fastOpenNb,
+            connAckNb ? (uint32_t)(connAckLatencySumMs / connAckNb) : 0,
+            connAckLatencyMaxMs, options.fastOpen, options.deferAccept);
+
+    for (uint8_t i = 0; i < MAX_WEARABLE_DEVICES; i++)
+    {
+        if (connections[i].fd >= 0)
+        {
+            connections[i].outputQueue.logStats(interface.c_str());
+        }
+    }
+
+    SocketTuning::logStats();
 }
 
 /*** end of file ***/
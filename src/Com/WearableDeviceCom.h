@@ -11,23 +11,89 @@
 
 #include <netinet/in.h>
 #include <iostream>
+#include <vector>
+#include "Com/WearableDeviceALPUtils.h"
+#include "Utils/TimerWheel.h"
+#include "Socket/OutputQueue.h"
 
 class WearableDeviceCom
 {
     public:
-        WearableDeviceCom(int port, in_addr_t addr, std::string device);
+        WearableDeviceCom(int port, in_addr_t addr, std::string device,
+                            const WearableDeviceALPTypes::ServerOptions&
+                            serverOptions =
+                            WearableDeviceALPConstants::DEFAULT_SERVER_OPTIONS);
         ~WearableDeviceCom(void);
-        bool open(void);
-        bool read(uint8_t* buf, uint32_t len);
-        bool write(uint8_t* buf, uint32_t len);
-        void close(void);
+        void setReceiveHandler(WearableDeviceALPTypes::ReceiveHandler handler,
+                                void* contextPtr);
+        bool serve(int32_t timeoutMs);
+        uint32_t getReceivedNb(uint8_t connectionId) const;
+        bool peek(uint8_t connectionId, uint8_t* buf, uint32_t len) const;
+        bool read(uint8_t connectionId, uint8_t* buf, uint32_t len);
+        bool write(uint8_t connectionId, uint8_t* buf, uint32_t len);
+        bool queue(uint8_t connectionId, uint8_t* buf, uint32_t len);
+        bool flush(uint8_t connectionId);
+        void close(uint8_t connectionId);
+        uint8_t getConnectionNb(void) const;
+        void logConnectStats(void);
+        void setDeadlineService(TimerWheel* wheel);
     private:
+        /* Connection with a device */
+        struct Connection
+        {
+            WearableDeviceCom* serverPtr;
+            uint8_t id;
+            int32_t fd;
+            /* Bytes received and not read yet */
+            std::vector<uint8_t> input;
+            OutputQueue outputQueue;
+            /* Closed once the output queue is sent */
+            bool isClosing;
+            le_clk_Time_t acceptTime;
+            bool isConnAckPending;
+            TimerWheelTypes::Timer handshakeDeadline;
+            TimerWheelTypes::Timer idleDeadline;
+            TimerWheelTypes::Timer readDeadline;
+        };
+
+        static uint64_t getNowMs(void);
+        static void handshakeDeadlineHandler(void* contextPtr);
+        static void idleDeadlineHandler(void* contextPtr);
+        static void readDeadlineHandler(void* contextPtr);
+        Connection* getConnection(uint8_t connectionId);
+        const Connection* getConnection(uint8_t connectionId) const;
+        void expireDeadline(Connection* connPtr, const char* deadlineName);
+        void startDeadline(TimerWheelTypes::Timer* timerPtr, uint32_t delaySec);
+        void cancelDeadline(TimerWheelTypes::Timer* timerPtr);
+        bool acceptAll(void);
+        void receive(Connection* connPtr);
+        bool send(Connection* connPtr);
+        void drop(Connection* connPtr);
+        void recordConnAckLatency(Connection* connPtr);
         int32_t server_fd;
-        int32_t com_fd;
         int32_t opt;
         struct sockaddr_in address;
         int32_t addrlen;
         bool serverStatus;
+        std::string interface;
+        WearableDeviceALPTypes::ServerOptions options;
+        Connection
+            connections[WearableDeviceALPConstants::MAX_WEARABLE_DEVICES];
+        uint8_t openNb;
+        WearableDeviceALPTypes::ReceiveHandler receiveHandler;
+        void* receiveContextPtr;
+        /* Accepting is paused after running out of descriptors */
+        bool isAcceptPaused;
+        uint64_t acceptRetryMs;
+        uint32_t connectionNb;
+        uint32_t refusedNb;
+        uint32_t fastOpenNb;
+        uint32_t connAckNb;
+        uint32_t connAckLatencyMaxMs;
+        uint64_t connAckLatencySumMs;
+        uint32_t expiredNb;
+        uint8_t maxOpenNb;
+        TimerWheel* deadlineWheel;
 };
 
 #endif /* WEARABLEDEVICECOM_H */
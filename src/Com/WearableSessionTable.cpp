@@ -0,0 +1,279 @@
+/** @file WearableSessionTable.cpp
+ *
+ * @brief This class keeps the state of each wearable device known by a
+ * server, indexed by MAC address
+ *
+ * Each server is a process of its own serving its connections from one
+ * event loop, so the table is neither shared nor locked. The devices are
+ * found with a HashIndex on their MAC address, and the least recently seen
+ * one is dropped when MAX_WEARABLE_DEVICES are known.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Com/WearableSessionTable.h"
+
+using namespace WearableDeviceALPConstants;
+using namespace WearableSessionTypes;
+
+/*!
+ * @brief Constructor for WearableSessionTable
+ * */
+WearableSessionTable::WearableSessionTable(void) :
+                                        index(MAX_WEARABLE_DEVICES,
+                                                MAC_ADDRESS_SIZE)
+{
+
+}
+
+/*!
+ * @brief Destructor for WearableSessionTable
+ * */
+WearableSessionTable::~WearableSessionTable(void)
+{
+
+}
+
+/*!
+ * @brief Remove the device seen the longest time ago, preferring the devices
+ * that are not connected
+ *
+ * @return None
+ * */
+void WearableSessionTable::evictLeastRecentlySeen(void)
+{
+    int32_t oldest = -1;
+
+    for (uint16_t i = 0; i < MAX_WEARABLE_DEVICES; i++)
+    {
+        if (!index.isUsed(i))
+        {
+            continue;
+        }
+
+        if (oldest < 0)
+        {
+            oldest = i;
+            continue;
+        }
+
+        bool isConnected = (sessions[i].comFd >= 0);
+        bool isOldestConnected = (sessions[oldest].comFd >= 0);
+
+        if ((isOldestConnected && !isConnected) ||
+            ((isOldestConnected == isConnected) &&
+             (sessions[i].lastSeen < sessions[oldest].lastSeen)))
+        {
+            oldest = i;
+        }
+    }
+
+    if (oldest >= 0)
+    {
+        const uint8_t* mac = sessions[oldest].mac;
+
+        LE_WARN("Session table full, drop %02X:%02X:%02X:%02X:%02X:%02X",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+        index.remove(oldest);
+    }
+}
+
+/*!
+ * @brief Find the state of a device, creating it if the device is unknown
+ *
+ * @param[in] mac   MAC address of the device
+ *
+ * @return State of the device
+ * */
+WearableSession& WearableSessionTable::findOrInsert(const uint8_t* mac)
+{
+    int32_t entry = index.find(mac);
+
+    if (entry >= 0)
+    {
+        return sessions[entry];
+    }
+
+    if (index.isFull())
+    {
+        evictLeastRecentlySeen();
+    }
+
+    entry = index.insert(mac);
+    LE_ASSERT(entry >= 0);
+
+    WearableSession& session = sessions[entry];
+
+    memset(&session, 0, sizeof(session));
+    memcpy(session.mac, mac, MAC_ADDRESS_SIZE);
+    session.comFd = -1;
+
+    return session;
+}
+
+/*!
+ * @brief Associate a device with the connection it is using
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[in] comFd     Socket of the connection with the device
+ *
+ * @return True if the device was already known, false if it is new
+ * */
+bool WearableSessionTable::attach(const uint8_t* mac, int32_t comFd)
+{
+    bool isKnown = (index.find(mac) >= 0);
+    WearableSession& session = findOrInsert(mac);
+
+    session.comFd = comFd;
+    session.lastSeen = le_clk_GetRelativeTime().sec;
+
+    return isKnown;
+}
+
+/*!
+ * @brief Mark a device as disconnected. Its state is kept until its entry
+ * is needed by another device.
+ *
+ * @param[in] mac       MAC address of the device
+ *
+ * @return None
+ * */
+void WearableSessionTable::detach(const uint8_t* mac)
+{
+    int32_t entry = index.find(mac);
+
+    if (entry >= 0)
+    {
+        sessions[entry].comFd = -1;
+    }
+}
+
+/*!
+ * @brief Forget a device
+ *
+ * @param[in] mac       MAC address of the device
+ *
+ * @return None
+ * */
+void WearableSessionTable::remove(const uint8_t* mac)
+{
+    index.remove(index.find(mac));
+}
+
+/*!
+ * @brief Get a copy of the state of a device
+ *
+ * @param[in] mac           MAC address of the device
+ * @param[out] sessionPtr   State of the device
+ *
+ * @return True if the device is known, false otherwise
+ * */
+bool WearableSessionTable::get(const uint8_t* mac, WearableSession* sessionPtr)
+{
+    int32_t entry = index.find(mac);
+
+    if ((entry >= 0) && (sessionPtr != NULL))
+    {
+        *sessionPtr = sessions[entry];
+    }
+
+    return (entry >= 0);
+}
+
+/*!
+ * @brief Record that a device sent a HELLO message
+ *
+ * @param[in] mac       MAC address of the device
+ *
+ * @return None
+ * */
+void WearableSessionTable::recordHello(const uint8_t* mac)
+{
+    WearableSession& session = findOrInsert(mac);
+
+    session.lastHello = le_clk_GetRelativeTime().sec;
+    session.lastSeen = session.lastHello;
+}
+
+/*!
+ * @brief Record the last sequence number received from a device
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[in] sequence  Sequence number
+ *
+ * @return None
+ * */
+void WearableSessionTable::recordSequence(const uint8_t* mac,
+                                            uint32_t sequence)
+{
+    WearableSession& session = findOrInsert(mac);
+
+    session.lastSequence = sequence;
+    session.lastSeen = le_clk_GetRelativeTime().sec;
+}
+
+/*!
+ * @brief Set the options negotiated with a device
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[in] options   Bitfield of the negotiated options
+ *
+ * @return None
+ * */
+void WearableSessionTable::setOptions(const uint8_t* mac, uint32_t options)
+{
+    findOrInsert(mac).options = options;
+}
+
+/*!
+ * @brief Account the traffic exchanged with a device
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[in] rxBytes   Number of bytes received from the device
+ * @param[in] txBytes   Number of bytes sent to the device
+ * @param[in] isError   True if the exchange failed
+ *
+ * @return None
+ * */
+void WearableSessionTable::addTraffic(const uint8_t* mac, uint32_t rxBytes,
+                                        uint32_t txBytes, bool isError)
+{
+    WearableSession& session = findOrInsert(mac);
+
+    session.rxBytes += rxBytes;
+    session.txBytes += txBytes;
+    session.lastSeen = le_clk_GetRelativeTime().sec;
+
+    if (isError)
+    {
+        session.errorNb++;
+    }
+}
+
+/*!
+ * @brief Account a PDU received from a device
+ *
+ * @param[in] mac       MAC address of the device
+ *
+ * @return None
+ * */
+void WearableSessionTable::addPdu(const uint8_t* mac)
+{
+    findOrInsert(mac).pduNb++;
+}
+
+/*!
+ * @brief Get the number of devices in the table
+ *
+ * @return Number of devices
+ * */
+uint16_t WearableSessionTable::getSessionNb(void)
+{
+    return index.getUsedNb();
+}
+
+/*** end of file ***/
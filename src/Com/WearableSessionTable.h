@@ -0,0 +1,67 @@
+/** @file WearableSessionTable.h
+ *
+ * @brief This class keeps the state of each wearable device known by a
+ * server, indexed by MAC address
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef WEARABLE_SESSION_TABLE_H
+#define WEARABLE_SESSION_TABLE_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Com/WearableDeviceALPUtils.h"
+#include "Utils/HashIndex.h"
+
+namespace WearableSessionTypes
+{
+    /* State of a wearable device */
+    struct WearableSession
+    {
+        uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+        int32_t comFd;
+        uint32_t lastSequence;
+        time_t lastHello;
+        time_t lastSeen;
+        uint32_t options;
+        uint64_t rxBytes;
+        uint64_t txBytes;
+        uint32_t pduNb;
+        uint32_t errorNb;
+    };
+}
+
+class WearableSessionTable
+{
+    private:
+        /* Session of entry N of the index at index N */
+        HashIndex index;
+        WearableSessionTypes::WearableSession
+            sessions[WearableDeviceALPConstants::MAX_WEARABLE_DEVICES];
+
+        WearableSessionTypes::WearableSession& findOrInsert(
+                                                        const uint8_t* mac);
+        void evictLeastRecentlySeen(void);
+
+    public:
+        WearableSessionTable(void);
+        ~WearableSessionTable(void);
+        bool attach(const uint8_t* mac, int32_t comFd);
+        void detach(const uint8_t* mac);
+        void remove(const uint8_t* mac);
+        bool get(const uint8_t* mac,
+                    WearableSessionTypes::WearableSession* sessionPtr);
+        void recordHello(const uint8_t* mac);
+        void recordSequence(const uint8_t* mac, uint32_t sequence);
+        void setOptions(const uint8_t* mac, uint32_t options);
+        void addTraffic(const uint8_t* mac, uint32_t rxBytes,
+                        uint32_t txBytes, bool isError);
+        void addPdu(const uint8_t* mac);
+        uint16_t getSessionNb(void);
+};
+
+#endif /* WEARABLE_SESSION_TABLE_H */
+
+/*** end of file ***/
@@ -0,0 +1,1088 @@
+/** @file DspKernels.cpp
+ *
+ * @brief This class provides the kernels converting and reducing the sensor
+ * samples, using the SIMD instructions of the CPU when available
+ *
+ * Each kernel has a scalar reference implementation, a NEON one for the
+ * module and SSE2 / AVX2 ones for the host. The variant is chosen at run
+ * time from what the CPU supports, and benchmark() checks every variant
+ * against the scalar one.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Dsp/DspKernels.h"
+#include <math.h>
+#include <time.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DSP_KERNELS_NEON
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+#endif
+
+using namespace DspKernelsConstants;
+using namespace DspKernelsTypes;
+
+/* Implementation of the kernels for one variant */
+struct KernelTable
+{
+    void (*convertInt16)(const int16_t* in, float* out, uint32_t n,
+                            float scale);
+    void (*convertInt24)(const uint8_t* in, float* out, uint32_t n,
+                            float scale);
+    uint32_t (*firDecimate)(const float* in, uint32_t n, const float* taps,
+                            uint32_t tapNb, uint32_t factor, float* out);
+    Reduction (*reduce)(const float* in, uint32_t n);
+};
+
+KernelVariant DspKernels::variant = KERNEL_VARIANT_SCALAR;
+
+/*
+ * Scalar reference
+ */
+
+/*!
+ * @brief Read a packed little endian 24 bits sample
+ *
+ * @param[in] ptr   Sample
+ *
+ * @return Sign extended sample
+ * */
+static inline int32_t ReadInt24(const uint8_t* ptr)
+{
+    return (int32_t) ((uint32_t) ptr[0] | ((uint32_t) ptr[1] << 8) |
+                      ((uint32_t) (int32_t) (int8_t) ptr[2] << 16));
+}
+
+/*!
+ * @brief Scalar version of DspKernels::convertInt16()
+ * */
+static void ConvertInt16Scalar(const int16_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = in[i] * scale;
+    }
+}
+
+/*!
+ * @brief Scalar version of DspKernels::convertInt24()
+ * */
+static void ConvertInt24Scalar(const uint8_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        out[i] = ReadInt24(&in[i * DSP_INT24_SIZE]) * scale;
+    }
+}
+
+/*!
+ * @brief Scalar version of DspKernels::firDecimate()
+ * */
+static uint32_t FirDecimateScalar(const float* in, uint32_t n,
+                                    const float* taps, uint32_t tapNb,
+                                    uint32_t factor, float* out)
+{
+    uint32_t outNb = 0;
+
+    for (uint32_t start = 0; (start + tapNb) <= n; start += factor)
+    {
+        float acc = 0;
+
+        for (uint32_t j = 0; j < tapNb; j++)
+        {
+            acc += taps[j] * in[start + j];
+        }
+
+        out[outNb++] = acc;
+    }
+
+    return outNb;
+}
+
+/*!
+ * @brief Scalar version of DspKernels::reduce()
+ * */
+static Reduction ReduceScalar(const float* in, uint32_t n)
+{
+    Reduction result = {0, 0, 0};
+    double sum = 0;
+
+    if (n == 0)
+    {
+        return result;
+    }
+
+    result.min = in[0];
+    result.max = in[0];
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        result.min = (in[i] < result.min) ? in[i] : result.min;
+        result.max = (in[i] > result.max) ? in[i] : result.max;
+        sum += in[i];
+    }
+
+    result.mean = sum / n;
+
+    return result;
+}
+
+static const KernelTable SCALAR_KERNELS =
+{
+    ConvertInt16Scalar, ConvertInt24Scalar, FirDecimateScalar, ReduceScalar
+};
+
+#ifdef DSP_KERNELS_X86
+
+/*
+ * SSE2, available on every x86_64 CPU
+ */
+
+/*!
+ * @brief Add the lanes of an SSE vector
+ * */
+static inline float HorizontalSumSse(__m128 v)
+{
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+
+    return _mm_cvtss_f32(sums);
+}
+
+/*!
+ * @brief SSE2 version of DspKernels::convertInt16()
+ * */
+__attribute__((target("sse2")))
+static void ConvertInt16Sse2(const int16_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    __m128 scaleVector = _mm_set1_ps(scale);
+    uint32_t i = 0;
+
+    for (; (i + 8) <= n; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128((const __m128i*) &in[i]);
+        /* Sign extension: the sample goes in the upper half of each 32 bits
+         * lane and is shifted back down */
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(low), scaleVector));
+        _mm_storeu_ps(&out[i + 4],
+                            _mm_mul_ps(_mm_cvtepi32_ps(high), scaleVector));
+    }
+
+    ConvertInt16Scalar(&in[i], &out[i], n - i, scale);
+}
+
+/*!
+ * @brief SSE2 version of DspKernels::firDecimate()
+ * */
+__attribute__((target("sse2")))
+static uint32_t FirDecimateSse2(const float* in, uint32_t n,
+                                const float* taps, uint32_t tapNb,
+                                uint32_t factor, float* out)
+{
+    uint32_t outNb = 0;
+
+    for (uint32_t start = 0; (start + tapNb) <= n; start += factor)
+    {
+        __m128 acc = _mm_setzero_ps();
+        uint32_t j = 0;
+
+        for (; (j + 4) <= tapNb; j += 4)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&taps[j]),
+                                             _mm_loadu_ps(&in[start + j])));
+        }
+
+        float sum = HorizontalSumSse(acc);
+
+        for (; j < tapNb; j++)
+        {
+            sum += taps[j] * in[start + j];
+        }
+
+        out[outNb++] = sum;
+    }
+
+    return outNb;
+}
+
+/*!
+ * @brief SSE2 version of DspKernels::reduce()
+ * */
+__attribute__((target("sse2")))
+static Reduction ReduceSse2(const float* in, uint32_t n)
+{
+    Reduction result = {0, 0, 0};
+    uint32_t i = 0;
+    float lanes[4];
+
+    if (n < 4)
+    {
+        return ReduceScalar(in, n);
+    }
+
+    __m128 minVector = _mm_loadu_ps(in);
+    __m128 maxVector = minVector;
+    __m128 sumVector = _mm_setzero_ps();
+
+    for (; (i + 4) <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(&in[i]);
+
+        minVector = _mm_min_ps(minVector, v);
+        maxVector = _mm_max_ps(maxVector, v);
+        sumVector = _mm_add_ps(sumVector, v);
+    }
+
+    double sum = HorizontalSumSse(sumVector);
+
+    _mm_storeu_ps(lanes, minVector);
+    result.min = fminf(fminf(lanes[0], lanes[1]), fminf(lanes[2], lanes[3]));
+    _mm_storeu_ps(lanes, maxVector);
+    result.max = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+
+    for (; i < n; i++)
+    {
+        result.min = (in[i] < result.min) ? in[i] : result.min;
+        result.max = (in[i] > result.max) ? in[i] : result.max;
+        sum += in[i];
+    }
+
+    result.mean = sum / n;
+
+    return result;
+}
+
+static const KernelTable SSE2_KERNELS =
+{
+    /* Unpacking 24 bits samples needs byte shuffles, missing from SSE2 */
+    ConvertInt16Sse2, ConvertInt24Scalar, FirDecimateSse2, ReduceSse2
+};
+
+/*
+ * AVX2
+ */
+
+/*!
+ * @brief Add the lanes of an AVX vector
+ * */
+__attribute__((target("avx2")))
+static inline float HorizontalSumAvx(__m256 v)
+{
+    __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v),
+                             _mm256_extractf128_ps(v, 1));
+    __m128 shuffled = _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(2, 3, 0, 1));
+
+    sums = _mm_add_ps(sums, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+
+    return _mm_cvtss_f32(sums);
+}
+
+/*!
+ * @brief AVX2 version of DspKernels::convertInt16()
+ * */
+__attribute__((target("avx2")))
+static void ConvertInt16Avx2(const int16_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    __m256 scaleVector = _mm256_set1_ps(scale);
+    uint32_t i = 0;
+
+    for (; (i + 8) <= n; i += 8)
+    {
+        __m256i samples = _mm256_cvtepi16_epi32(
+                                _mm_loadu_si128((const __m128i*) &in[i]));
+
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(samples),
+                                                                scaleVector));
+    }
+
+    ConvertInt16Scalar(&in[i], &out[i], n - i, scale);
+}
+
+/*!
+ * @brief AVX2 version of DspKernels::convertInt24()
+ * */
+__attribute__((target("avx2")))
+static void ConvertInt24Avx2(const uint8_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    /* Each sample goes in the upper 3 bytes of a 32 bits lane, the
+     * arithmetic shift then sign extends it */
+    const __m256i shuffle = _mm256_setr_epi8(
+                        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m256 scaleVector = _mm256_set1_ps(scale);
+    uint32_t i = 0;
+
+    /* 8 samples are 24 bytes but the loads read 28 */
+    for (; (i + 10) <= n; i += 8)
+    {
+        const uint8_t* ptr = &in[i * DSP_INT24_SIZE];
+        __m256i bytes = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(
+                                    _mm_loadu_si128((const __m128i*) ptr)),
+                        _mm_loadu_si128((const __m128i*) (ptr + 12)), 1);
+        __m256i samples = _mm256_srai_epi32(
+                                    _mm256_shuffle_epi8(bytes, shuffle), 8);
+
+        _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(samples),
+                                                                scaleVector));
+    }
+
+    ConvertInt24Scalar(&in[i * DSP_INT24_SIZE], &out[i], n - i, scale);
+}
+
+/*!
+ * @brief AVX2 version of DspKernels::firDecimate()
+ * */
+__attribute__((target("avx2")))
+static uint32_t FirDecimateAvx2(const float* in, uint32_t n,
+                                const float* taps, uint32_t tapNb,
+                                uint32_t factor, float* out)
+{
+    uint32_t outNb = 0;
+
+    for (uint32_t start = 0; (start + tapNb) <= n; start += factor)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        uint32_t j = 0;
+
+        for (; (j + 8) <= tapNb; j += 8)
+        {
+            acc = _mm256_add_ps(acc,
+                                _mm256_mul_ps(_mm256_loadu_ps(&taps[j]),
+                                              _mm256_loadu_ps(&in[start + j])));
+        }
+
+        float sum = HorizontalSumAvx(acc);
+
+        for (; j < tapNb; j++)
+        {
+            sum += taps[j] * in[start + j];
+        }
+
+        out[outNb++] = sum;
+    }
+
+    return outNb;
+}
+
+/*!
+ * @brief AVX2 version of DspKernels::reduce()
+ * */
+__attribute__((target("avx2")))
+static Reduction ReduceAvx2(const float* in, uint32_t n)
+{
+    Reduction result = {0, 0, 0};
+    uint32_t i = 0;
+    float lanes[8];
+
+    if (n < 8)
+    {
+        return ReduceScalar(in, n);
+    }
+
+    __m256 minVector = _mm256_loadu_ps(in);
+    __m256 maxVector = minVector;
+    __m256 sumVector = _mm256_setzero_ps();
+
+    for (; (i + 8) <= n; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(&in[i]);
+
+        minVector = _mm256_min_ps(minVector, v);
+        maxVector = _mm256_max_ps(maxVector, v);
+        sumVector = _mm256_add_ps(sumVector, v);
+    }
+
+    double sum = HorizontalSumAvx(sumVector);
+
+    _mm256_storeu_ps(lanes, minVector);
+    result.min = lanes[0];
+    for (uint8_t k = 1; k < 8; k++)
+    {
+        result.min = (lanes[k] < result.min) ? lanes[k] : result.min;
+    }
+
+    _mm256_storeu_ps(lanes, maxVector);
+    result.max = lanes[0];
+    for (uint8_t k = 1; k < 8; k++)
+    {
+        result.max = (lanes[k] > result.max) ? lanes[k] : result.max;
+    }
+
+    for (; i < n; i++)
+    {
+        result.min = (in[i] < result.min) ? in[i] : result.min;
+        result.max = (in[i] > result.max) ? in[i] : result.max;
+        sum += in[i];
+    }
+
+    result.mean = sum / n;
+
+    return result;
+}
+
+static const KernelTable AVX2_KERNELS =
+{
+    ConvertInt16Avx2, ConvertInt24Avx2, FirDecimateAvx2, ReduceAvx2
+};
+
+#endif /* DSP_KERNELS_X86 */
+
+#ifdef DSP_KERNELS_NEON
+
+/*
+ * NEON, for the module
+ */
+
+/*!
+ * @brief Add the lanes of a NEON vector
+ * */
+static inline float HorizontalSumNeon(float32x4_t v)
+{
+    float32x2_t sums = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+
+    sums = vpadd_f32(sums, sums);
+
+    return vget_lane_f32(sums, 0);
+}
+
+/*!
+ * @brief NEON version of DspKernels::convertInt16()
+ * */
+static void ConvertInt16Neon(const int16_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    uint32_t i = 0;
+
+    for (; (i + 8) <= n; i += 8)
+    {
+        int16x8_t samples = vld1q_s16(&in[i]);
+        int32x4_t low = vmovl_s16(vget_low_s16(samples));
+        int32x4_t high = vmovl_s16(vget_high_s16(samples));
+
+        vst1q_f32(&out[i], vmulq_n_f32(vcvtq_f32_s32(low), scale));
+        vst1q_f32(&out[i + 4], vmulq_n_f32(vcvtq_f32_s32(high), scale));
+    }
+
+    ConvertInt16Scalar(&in[i], &out[i], n - i, scale);
+}
+
+/*!
+ * @brief NEON version of DspKernels::convertInt24()
+ * */
+static void ConvertInt24Neon(const uint8_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    uint32_t i = 0;
+
+    for (; (i + 8) <= n; i += 8)
+    {
+        /* De-interleave the 3 bytes of 8 samples */
+        uint8x8x3_t bytes = vld3_u8(&in[i * DSP_INT24_SIZE]);
+        uint16x8_t low16 = vorrq_u16(vmovl_u8(bytes.val[0]),
+                                     vshlq_n_u16(vmovl_u8(bytes.val[1]), 8));
+        int16x8_t high16 = vmovl_s8(vreinterpret_s8_u8(bytes.val[2]));
+
+        int32x4_t first = vorrq_s32(
+                    vshlq_n_s32(vmovl_s16(vget_low_s16(high16)), 16),
+                    vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(low16))));
+        int32x4_t second = vorrq_s32(
+                    vshlq_n_s32(vmovl_s16(vget_high_s16(high16)), 16),
+                    vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(low16))));
+
+        vst1q_f32(&out[i], vmulq_n_f32(vcvtq_f32_s32(first), scale));
+        vst1q_f32(&out[i + 4], vmulq_n_f32(vcvtq_f32_s32(second), scale));
+    }
+
+    ConvertInt24Scalar(&in[i * DSP_INT24_SIZE], &out[i], n - i, scale);
+}
+
+/*!
+ * @brief NEON version of DspKernels::firDecimate()
+ * */
+static uint32_t FirDecimateNeon(const float* in, uint32_t n,
+                                const float* taps, uint32_t tapNb,
+                                uint32_t factor, float* out)
+{
+    uint32_t outNb = 0;
+
+    for (uint32_t start = 0; (start + tapNb) <= n; start += factor)
+    {
+        float32x4_t acc = vdupq_n_f32(0);
+        uint32_t j = 0;
+
+        for (; (j + 4) <= tapNb; j += 4)
+        {
+            acc = vmlaq_f32(acc, vld1q_f32(&taps[j]),
+                                 vld1q_f32(&in[start + j]));
+        }
+
+        float sum = HorizontalSumNeon(acc);
+
+        for (; j < tapNb; j++)
+        {
+            sum += taps[j] * in[start + j];
+        }
+
+        out[outNb++] = sum;
+    }
+
+    return outNb;
+}
+
+/*!
+ * @brief NEON version of DspKernels::reduce()
+ * */
+static Reduction ReduceNeon(const float* in, uint32_t n)
+{
+    Reduction result = {0, 0, 0};
+    uint32_t i = 0;
+
+    if (n < 4)
+    {
+        return ReduceScalar(in, n);
+    }
+
+    float32x4_t minVector = vld1q_f32(in);
+    float32x4_t maxVector = minVector;
+    float32x4_t sumVector = vdupq_n_f32(0);
+
+    for (; (i + 4) <= n; i += 4)
+    {
+        float32x4_t v = vld1q_f32(&in[i]);
+
+        minVector = vminq_f32(minVector, v);
+        maxVector = vmaxq_f32(maxVector, v);
+        sumVector = vaddq_f32(sumVector, v);
+    }
+
+    double sum = HorizontalSumNeon(sumVector);
+    float32x2_t minPair = vpmin_f32(vget_low_f32(minVector),
+                                    vget_high_f32(minVector));
+    float32x2_t maxPair = vpmax_f32(vget_low_f32(maxVector),
+                                    vget_high_f32(maxVector));
+
+    result.min = vget_lane_f32(vpmin_f32(minPair, minPair), 0);
+    result.max = vget_lane_f32(vpmax_f32(maxPair, maxPair), 0);
+
+    for (; i < n; i++)
+    {
+        result.min = (in[i] < result.min) ? in[i] : result.min;
+        result.max = (in[i] > result.max) ? in[i] : result.max;
+        sum += in[i];
+    }
+
+    result.mean = sum / n;
+
+    return result;
+}
+
+static const KernelTable NEON_KERNELS =
+{
+    ConvertInt16Neon, ConvertInt24Neon, FirDecimateNeon, ReduceNeon
+};
+
+#endif /* DSP_KERNELS_NEON */
+
+/*!
+ * @brief Get the kernels of a variant
+ *
+ * @param[in] kernelVariant     Variant
+ *
+ * @return Kernels of the variant, the scalar ones if it is not built
+ * */
+static const KernelTable& GetKernels(KernelVariant kernelVariant)
+{
+    switch (kernelVariant)
+    {
+#ifdef DSP_KERNELS_X86
+        case KERNEL_VARIANT_SSE2:
+            return SSE2_KERNELS;
+        case KERNEL_VARIANT_AVX2:
+            return AVX2_KERNELS;
+#endif
+#ifdef DSP_KERNELS_NEON
+        case KERNEL_VARIANT_NEON:
+            return NEON_KERNELS;
+#endif
+        default:
+            return SCALAR_KERNELS;
+    }
+}
+
+/*!
+ * @brief Check if a variant is built and supported by the CPU
+ *
+ * @param[in] kernelVariant     Variant to check
+ *
+ * @return True if the variant can be used
+ * */
+bool DspKernels::isSupported(KernelVariant kernelVariant)
+{
+    bool status = false;
+
+    switch (kernelVariant)
+    {
+        case KERNEL_VARIANT_SCALAR:
+            status = true;
+            break;
+
+#ifdef DSP_KERNELS_X86
+        case KERNEL_VARIANT_SSE2:
+            status = __builtin_cpu_supports("sse2");
+            break;
+
+        case KERNEL_VARIANT_AVX2:
+            status = __builtin_cpu_supports("avx2");
+            break;
+#endif
+
+#ifdef DSP_KERNELS_NEON
+        case KERNEL_VARIANT_NEON:
+#if defined(__aarch64__)
+            status = true;
+#else
+            status = ((getauxval(AT_HWCAP) & HWCAP_NEON) != 0);
+#endif
+            break;
+#endif
+
+        default:
+            break;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Select the fastest variant supported by the CPU
+ *
+ * @return None
+ * */
+void DspKernels::init(void)
+{
+    static const KernelVariant PREFERENCE[] =
+    {
+        KERNEL_VARIANT_NEON, KERNEL_VARIANT_AVX2, KERNEL_VARIANT_SSE2
+    };
+
+    variant = KERNEL_VARIANT_SCALAR;
+
+    for (uint8_t i = 0; i < (sizeof(PREFERENCE) / sizeof(PREFERENCE[0])); i++)
+    {
+        if (isSupported(PREFERENCE[i]))
+        {
+            variant = PREFERENCE[i];
+            break;
+        }
+    }
+
+    LE_INFO("DSP kernels: %s", getVariantName(variant));
+}
+
+/*!
+ * @brief Force a variant, e.g. to compare them
+ *
+ * @param[in] kernelVariant     Variant to use
+ *
+ * @return False if the variant is not supported
+ * */
+bool DspKernels::setVariant(KernelVariant kernelVariant)
+{
+    if (!isSupported(kernelVariant))
+    {
+        return false;
+    }
+
+    variant = kernelVariant;
+
+    return true;
+}
+
+/*!
+ * @brief Get the variant in use
+ *
+ * @return Variant in use
+ * */
+KernelVariant DspKernels::getVariant(void)
+{
+    return variant;
+}
+
+/*!
+ * @brief Get the name of a variant
+ *
+ * @param[in] kernelVariant     Variant
+ *
+ * @return Name of the variant
+ * */
+const char* DspKernels::getVariantName(KernelVariant kernelVariant)
+{
+    static const char* NAMES[KERNEL_VARIANT_NB] =
+    {
+        "scalar", "SSE2", "AVX2", "NEON"
+    };
+
+    return (kernelVariant < KERNEL_VARIANT_NB) ? NAMES[kernelVariant] : "?";
+}
+
+/*!
+ * @brief Convert 16 bits samples to engineering units
+ *
+ * @param[in] in        Samples
+ * @param[out] out      Converted samples
+ * @param[in] n         Number of samples
+ * @param[in] scale     Value of one unit of the samples
+ *
+ * @return None
+ * */
+void DspKernels::convertInt16(const int16_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    GetKernels(variant).convertInt16(in, out, n, scale);
+}
+
+/*!
+ * @brief Convert packed little endian 24 bits samples to engineering units
+ *
+ * @param[in] in        Samples, DSP_INT24_SIZE bytes each
+ * @param[out] out      Converted samples
+ * @param[in] n         Number of samples
+ * @param[in] scale     Value of one unit of the samples
+ *
+ * @return None
+ * */
+void DspKernels::convertInt24(const uint8_t* in, float* out, uint32_t n,
+                                float scale)
+{
+    GetKernels(variant).convertInt24(in, out, n, scale);
+}
+
+/*!
+ * @brief Filter and decimate samples: out[k] is the sum of taps[j] *
+ * in[k * factor + j]
+ *
+ * @param[in] in        Samples
+ * @param[in] n         Number of samples
+ * @param[in] taps      Coefficients of the filter
+ * @param[in] tapNb     Number of coefficients
+ * @param[in] factor    Decimation factor
+ * @param[out] out      Filtered samples, (n - tapNb) / factor + 1 at most
+ *
+ * @return Number of filtered samples
+ * */
+uint32_t DspKernels::firDecimate(const float* in, uint32_t n,
+                                    const float* taps, uint32_t tapNb,
+                                    uint32_t factor, float* out)
+{
+    if ((factor == 0) || (tapNb == 0))
+    {
+        return 0;
+    }
+
+    return GetKernels(variant).firDecimate(in, n, taps, tapNb, factor, out);
+}
+
+/*!
+ * @brief Get the minimum, maximum and mean of samples
+ *
+ * @param[in] in    Samples
+ * @param[in] n     Number of samples
+ *
+ * @return Reduction of the samples, all 0 if there is none
+ * */
+Reduction DspKernels::reduce(const float* in, uint32_t n)
+{
+    return GetKernels(variant).reduce(in, n);
+}
+
+/*!
+ * @brief Check if two results match within the tolerance
+ *
+ * @param[in] reference     Scalar result
+ * @param[in] value         Result to check
+ * @param[in] magnitude     Magnitude of the terms added to get the result:
+ *                          the rounding errors scale with it, not with the
+ *                          result
+ *
+ * @return True if the results match
+ * */
+static bool IsClose(float reference, float value, float magnitude)
+{
+    magnitude = (fabsf(reference) > magnitude) ? fabsf(reference) : magnitude;
+    magnitude = (magnitude > 1) ? magnitude : 1;
+
+    return (fabsf(reference - value) <=
+                                    (DSP_EQUIVALENCE_TOLERANCE * magnitude));
+}
+
+/*!
+ * @brief Fill the benchmark input with a reproducible signal
+ *
+ * @param[out] samples16    16 bits samples
+ * @param[out] samples24    Packed 24 bits samples
+ * @param[out] taps         Filter coefficients
+ *
+ * @return None
+ * */
+static void FillBenchmarkInput(std::vector<int16_t>& samples16,
+                                std::vector<uint8_t>& samples24,
+                                std::vector<float>& taps)
+{
+    uint32_t seed = 12345;
+
+    samples16.resize(DSP_BENCHMARK_SAMPLE_NB);
+    samples24.resize(DSP_BENCHMARK_SAMPLE_NB * DSP_INT24_SIZE);
+    taps.resize(DSP_BENCHMARK_TAP_NB);
+
+    for (uint32_t i = 0; i < DSP_BENCHMARK_SAMPLE_NB; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        samples16[i] = seed >> 16;
+        samples24[i * DSP_INT24_SIZE] = seed >> 8;
+        samples24[i * DSP_INT24_SIZE + 1] = seed >> 16;
+        samples24[i * DSP_INT24_SIZE + 2] = seed >> 24;
+    }
+
+    for (uint8_t j = 0; j < DSP_BENCHMARK_TAP_NB; j++)
+    {
+        taps[j] = 1.0f / DSP_BENCHMARK_TAP_NB;
+    }
+}
+
+/*!
+ * @brief Compare the results of a variant with the scalar ones
+ *
+ * @param[in] kernelVariant     Variant to check
+ *
+ * @return True if all the kernels match: exactly for the conversions,
+ * within DSP_EQUIVALENCE_TOLERANCE for the others
+ * */
+bool DspKernels::checkEquivalence(KernelVariant kernelVariant)
+{
+    const KernelTable& reference = SCALAR_KERNELS;
+    const KernelTable& kernels = GetKernels(kernelVariant);
+    std::vector<int16_t> samples16;
+    std::vector<uint8_t> samples24;
+    std::vector<float> taps;
+    std::vector<float> expected(DSP_BENCHMARK_SAMPLE_NB);
+    std::vector<float> actual(DSP_BENCHMARK_SAMPLE_NB);
+    bool status = true;
+
+    FillBenchmarkInput(samples16, samples24, taps);
+
+    /* Odd sizes exercise the scalar tails of the SIMD loops */
+    for (uint32_t n = DSP_BENCHMARK_SAMPLE_NB - 7; n <= DSP_BENCHMARK_SAMPLE_NB;
+                                                                        n++)
+    {
+        reference.convertInt16(samples16.data(), expected.data(), n, 0.5f);
+        kernels.convertInt16(samples16.data(), actual.data(), n, 0.5f);
+
+        if (memcmp(expected.data(), actual.data(), n * sizeof(float)) != 0)
+        {
+            LE_ERROR("%s convertInt16 differs", getVariantName(kernelVariant));
+            status = false;
+        }
+
+        reference.convertInt24(samples24.data(), expected.data(), n, 0.5f);
+        kernels.convertInt24(samples24.data(), actual.data(), n, 0.5f);
+
+        if (memcmp(expected.data(), actual.data(), n * sizeof(float)) != 0)
+        {
+            LE_ERROR("%s convertInt24 differs", getVariantName(kernelVariant));
+            status = false;
+        }
+    }
+
+    std::vector<float> input(expected);
+    std::vector<float> filtered(DSP_BENCHMARK_SAMPLE_NB);
+    Reduction expectedReduction = reference.reduce(input.data(), input.size());
+    float peak = (fabsf(expectedReduction.min) > fabsf(expectedReduction.max)) ?
+                    fabsf(expectedReduction.min) : fabsf(expectedReduction.max);
+    float tapSum = 0;
+
+    for (uint8_t j = 0; j < taps.size(); j++)
+    {
+        tapSum += fabsf(taps[j]);
+    }
+
+    uint32_t expectedNb = reference.firDecimate(input.data(), input.size(),
+                                                taps.data(), taps.size(),
+                                                DSP_BENCHMARK_DECIMATION,
+                                                expected.data());
+    uint32_t actualNb = kernels.firDecimate(input.data(), input.size(),
+                                            taps.data(), taps.size(),
+                                            DSP_BENCHMARK_DECIMATION,
+                                            filtered.data());
+
+    for (uint32_t k = 0; k < expectedNb; k++)
+    {
+        if ((actualNb != expectedNb) ||
+            !IsClose(expected[k], filtered[k], peak * tapSum))
+        {
+            LE_ERROR("%s firDecimate differs at %u",
+                                        getVariantName(kernelVariant), k);
+            status = false;
+            break;
+        }
+    }
+
+    Reduction actualReduction = kernels.reduce(input.data(), input.size());
+
+    if ((expectedReduction.min != actualReduction.min) ||
+        (expectedReduction.max != actualReduction.max) ||
+        !IsClose(expectedReduction.mean, actualReduction.mean, peak))
+    {
+        LE_ERROR("%s reduce differs", getVariantName(kernelVariant));
+        status = false;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Get the time elapsed since a point
+ *
+ * @param[in] start     Start point
+ *
+ * @return Elapsed time in seconds
+ * */
+static double GetElapsedSec(const struct timespec& start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*!
+ * @brief Measure and log the throughput of the kernels of a variant
+ *
+ * @param[in] kernelVariant     Variant to measure
+ *
+ * @return None
+ * */
+void DspKernels::measureThroughput(KernelVariant kernelVariant)
+{
+    const KernelTable& kernels = GetKernels(kernelVariant);
+    std::vector<int16_t> samples16;
+    std::vector<uint8_t> samples24;
+    std::vector<float> taps;
+    std::vector<float> converted(DSP_BENCHMARK_SAMPLE_NB);
+    std::vector<float> filtered(DSP_BENCHMARK_SAMPLE_NB);
+    double totalNb = (double) DSP_BENCHMARK_SAMPLE_NB * DSP_BENCHMARK_ROUND_NB;
+    volatile float sink = 0;
+    double elapsedSec[4];
+    struct timespec start;
+
+    FillBenchmarkInput(samples16, samples24, taps);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t r = 0; r < DSP_BENCHMARK_ROUND_NB; r++)
+    {
+        kernels.convertInt16(samples16.data(), converted.data(),
+                                DSP_BENCHMARK_SAMPLE_NB, 0.5f);
+    }
+    elapsedSec[0] = GetElapsedSec(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t r = 0; r < DSP_BENCHMARK_ROUND_NB; r++)
+    {
+        kernels.convertInt24(samples24.data(), converted.data(),
+                                DSP_BENCHMARK_SAMPLE_NB, 0.5f);
+    }
+    elapsedSec[1] = GetElapsedSec(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t r = 0; r < DSP_BENCHMARK_ROUND_NB; r++)
+    {
+        kernels.firDecimate(converted.data(), DSP_BENCHMARK_SAMPLE_NB,
+                            taps.data(), taps.size(), DSP_BENCHMARK_DECIMATION,
+                            filtered.data());
+    }
+    elapsedSec[2] = GetElapsedSec(start);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t r = 0; r < DSP_BENCHMARK_ROUND_NB; r++)
+    {
+        sink = sink + kernels.reduce(converted.data(),
+                                        DSP_BENCHMARK_SAMPLE_NB).mean;
+    }
+    elapsedSec[3] = GetElapsedSec(start);
+
+    for (uint8_t k = 0; k < 4; k++)
+    {
+        if (elapsedSec[k] <= 0)
+        {
+            elapsedSec[k] = 1e-9;
+        }
+    }
+
+    LE_INFO("DSP %s: int16 %.1f, int24 %.1f, fir/%u %.1f, reduce %.1f "
+            "Msamples/s", getVariantName(kernelVariant),
+            totalNb / elapsedSec[0] / 1e6, totalNb / elapsedSec[1] / 1e6,
+            DSP_BENCHMARK_DECIMATION, totalNb / elapsedSec[2] / 1e6,
+            totalNb / elapsedSec[3] / 1e6);
+}
+
+/*!
+ * @brief Check every supported variant against the scalar one and log their
+ * throughput
+ *
+ * @return True if all the variants give the scalar results
+ * */
+bool DspKernels::benchmark(void)
+{
+    bool status = true;
+
+    for (uint8_t v = 0; v < KERNEL_VARIANT_NB; v++)
+    {
+        KernelVariant kernelVariant = (KernelVariant) v;
+
+        if (!isSupported(kernelVariant))
+        {
+            continue;
+        }
+
+        if (!checkEquivalence(kernelVariant))
+        {
+            status = false;
+        }
+
+        measureThroughput(kernelVariant);
+    }
+
+    return status;
+}
+
+/*** end of file ***/
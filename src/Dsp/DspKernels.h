@@ -0,0 +1,47 @@
+/** @file DspKernels.h
+ *
+ * @brief This class provides the kernels converting and reducing the sensor
+ * samples, using the SIMD instructions of the CPU when available
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Dsp/DspKernelsUtils.h"
+
+class DspKernels
+{
+    private:
+        static DspKernelsTypes::KernelVariant variant;
+
+        static bool isSupported(DspKernelsTypes::KernelVariant kernelVariant);
+        static bool checkEquivalence(DspKernelsTypes::KernelVariant
+                                                                kernelVariant);
+        static void measureThroughput(DspKernelsTypes::KernelVariant
+                                                                kernelVariant);
+
+    public:
+        static void init(void);
+        static bool setVariant(DspKernelsTypes::KernelVariant kernelVariant);
+        static DspKernelsTypes::KernelVariant getVariant(void);
+        static const char* getVariantName(DspKernelsTypes::KernelVariant
+                                                                kernelVariant);
+        static void convertInt16(const int16_t* in, float* out, uint32_t n,
+                                    float scale);
+        static void convertInt24(const uint8_t* in, float* out, uint32_t n,
+                                    float scale);
+        static uint32_t firDecimate(const float* in, uint32_t n,
+                                    const float* taps, uint32_t tapNb,
+                                    uint32_t factor, float* out);
+        static DspKernelsTypes::Reduction reduce(const float* in, uint32_t n);
+        static bool benchmark(void);
+};
+
+#endif /* DSP_KERNELS_H */
+
+/*** end of file ***/
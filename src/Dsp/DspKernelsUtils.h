@@ -0,0 +1,56 @@
+/** @file DspKernelsUtils.h
+ *
+ * @brief This file provides the types and constants of the sample processing
+ * kernels
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DSP_KERNELS_UTILS_H
+#define DSP_KERNELS_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace DspKernelsTypes
+{
+    /* Implementations of the kernels. Only the ones built for the target
+     * and supported by its CPU are used. */
+    enum KernelVariant
+    {
+        KERNEL_VARIANT_SCALAR,
+        KERNEL_VARIANT_SSE2,
+        KERNEL_VARIANT_AVX2,
+        KERNEL_VARIANT_NEON,
+        KERNEL_VARIANT_NB
+    };
+
+    /* Result of a reduction over a block of samples */
+    struct Reduction
+    {
+        float min;
+        float max;
+        float mean;
+    };
+}
+
+namespace DspKernelsConstants
+{
+    /* Benchmark run by DspKernels::benchmark() on each variant */
+    const uint32_t DSP_BENCHMARK_SAMPLE_NB = 4096;
+    const uint32_t DSP_BENCHMARK_ROUND_NB = 200;
+    const uint8_t DSP_BENCHMARK_TAP_NB = 16;
+    const uint8_t DSP_BENCHMARK_DECIMATION = 4;
+
+    /* The SIMD variants add the products in another order than the scalar
+     * one, the results are compared with this relative tolerance */
+    const float DSP_EQUIVALENCE_TOLERANCE = 1e-4f;
+
+    /* Size of a packed 24 bits sample */
+    const uint8_t DSP_INT24_SIZE = 3;
+}
+
+#endif /* DSP_KERNELS_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,368 @@
+/** @file ColumnarDecoder.cpp
+ *
+ * @brief This class decodes the columnar blocks of sensor samples made by
+ * ColumnarEncoder
+ *
+ * Two paths give the same result. decode() reads one varint at a time.
+ * decodeFast() reads the literal numbers 8 bytes at a time while they fit a
+ * byte each, which is the common case for delta columns, and undoes the
+ * zigzag in a separate loop the compiler can vectorize. verify() checks the
+ * two paths against each other.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Encoding/ColumnarDecoder.h"
+
+using namespace ColumnarEncodingConstants;
+using namespace ColumnarEncodingTypes;
+
+/* High bit of each byte of a 64 bits word */
+static const uint64_t VARINT_CONTINUATION_MASK = 0x8080808080808080ULL;
+
+/*!
+ * @brief Read a varint
+ *
+ * @param[in,out] ptr   Current position, moved after the varint
+ * @param[in] endPtr    End of the data
+ * @param[out] valuePtr Number read
+ *
+ * @return False if the varint is truncated or too long
+ * */
+bool ColumnarDecoder::readVarint(const uint8_t*& ptr, const uint8_t* endPtr,
+                                    uint64_t* valuePtr)
+{
+    uint64_t value = 0;
+
+    for (uint8_t shift = 0; shift < 64; shift += 7)
+    {
+        if (ptr >= endPtr)
+        {
+            return false;
+        }
+
+        uint8_t byte = *ptr++;
+
+        value |= (uint64_t) (byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            *valuePtr = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Read the numbers of a literal token
+ *
+ * @param[in,out] ptr   Current position, moved after the numbers
+ * @param[in] endPtr    End of the data
+ * @param[out] outPtr   Numbers read
+ * @param[in] count     Number of numbers to read
+ * @param[in] isFast    True to read 8 single byte numbers at once when
+ *                      possible
+ *
+ * @return False if the data is truncated
+ * */
+bool ColumnarDecoder::readLiterals(const uint8_t*& ptr, const uint8_t* endPtr,
+                                    uint64_t* outPtr, uint32_t count,
+                                    bool isFast)
+{
+    uint32_t i = 0;
+
+    while (i < count)
+    {
+        if (isFast && ((count - i) >= 8) && ((endPtr - ptr) >= 8))
+        {
+            uint64_t word;
+
+            memcpy(&word, ptr, sizeof(word));
+
+            if ((word & VARINT_CONTINUATION_MASK) == 0)
+            {
+                for (uint8_t j = 0; j < 8; j++)
+                {
+                    outPtr[i + j] = ptr[j];
+                }
+
+                ptr += 8;
+                i += 8;
+                continue;
+            }
+        }
+
+        if (!readVarint(ptr, endPtr, &outPtr[i]))
+        {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Read a run-length encoded column, see ColumnarEncoder::writeColumn()
+ *
+ * @param[in,out] ptr   Current position, moved after the column
+ * @param[in] endPtr    End of the data
+ * @param[in,out] column Numbers read, sized by the caller to the number of
+ *                      numbers expected
+ * @param[in] isFast    True to use the fast literal path
+ *
+ * @return False if the column is malformed
+ * */
+bool ColumnarDecoder::readColumn(const uint8_t*& ptr, const uint8_t* endPtr,
+                                    std::vector<uint64_t>& column, bool isFast)
+{
+    size_t i = 0;
+
+    while (i < column.size())
+    {
+        uint64_t token;
+        uint64_t value;
+
+        if (!readVarint(ptr, endPtr, &token))
+        {
+            return false;
+        }
+
+        uint64_t length = token >> 1;
+
+        if ((length == 0) || (length > (column.size() - i)))
+        {
+            return false;
+        }
+
+        if (token & 1)
+        {
+            if (!readVarint(ptr, endPtr, &value))
+            {
+                return false;
+            }
+
+            std::fill(column.begin() + i, column.begin() + i + length, value);
+        }
+        else if (!readLiterals(ptr, endPtr, &column[i], length, isFast))
+        {
+            return false;
+        }
+
+        i += length;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Undo the zigzag encoding of a column, in place. Branchless so that
+ * it can be vectorized.
+ *
+ * @param[in,out] column    Numbers to decode
+ *
+ * @return None
+ * */
+void ColumnarDecoder::unzigzag(std::vector<uint64_t>& column)
+{
+    uint64_t* dataPtr = column.data();
+    size_t count = column.size();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        dataPtr[i] = (dataPtr[i] >> 1) ^ (0 - (dataPtr[i] & 1));
+    }
+}
+
+/*!
+ * @brief Decode a block
+ *
+ * @param[in] buf       Block
+ * @param[in] len       Size of the block
+ * @param[out] channels Samples of the block, per channel
+ * @param[in] isFast    True to use the fast path
+ *
+ * @return False if the block is malformed
+ * */
+bool ColumnarDecoder::decodeBlock(const uint8_t* buf, uint32_t len,
+                                    std::vector<ChannelSamples>& channels,
+                                    bool isFast)
+{
+    const uint8_t* ptr = buf;
+    const uint8_t* endPtr = buf + len;
+    std::vector<uint64_t> column;
+    uint64_t channelNb;
+    uint32_t sampleNb = 0;
+
+    channels.clear();
+
+    if ((len < 1) || (*ptr++ != COLUMNAR_FORMAT_VERSION) ||
+        !readVarint(ptr, endPtr, &channelNb) ||
+        (channelNb > COLUMNAR_MAX_CHANNELS))
+    {
+        return false;
+    }
+
+    channels.resize(channelNb);
+
+    for (size_t c = 0; c < channelNb; c++)
+    {
+        ChannelSamples& channel = channels[c];
+        uint64_t count;
+        uint64_t timestamp;
+        uint64_t firstValue;
+
+        if (ptr >= endPtr)
+        {
+            return false;
+        }
+
+        channel.channelId = *ptr++;
+
+        /* Checked before allocating anything for the channel */
+        if (!readVarint(ptr, endPtr, &count) || (count == 0) ||
+            (count > (COLUMNAR_MAX_SAMPLES - sampleNb)) ||
+            !readVarint(ptr, endPtr, &timestamp) ||
+            !readVarint(ptr, endPtr, &firstValue))
+        {
+            return false;
+        }
+
+        sampleNb += count;
+
+        int64_t value = (int64_t) ((firstValue >> 1) ^ (0 - (firstValue & 1)));
+
+        if ((value < INT32_MIN) || (value > INT32_MAX))
+        {
+            return false;
+        }
+
+        channel.timestamps.resize(count);
+        channel.values.resize(count);
+        channel.timestamps[0] = timestamp;
+        channel.values[0] = value;
+
+        /* Timestamps: delta-of-delta summed twice */
+        column.resize(count - 1);
+
+        if (!readColumn(ptr, endPtr, column, isFast))
+        {
+            return false;
+        }
+
+        unzigzag(column);
+
+        /* Modulo 2^64, as encoded */
+        uint64_t delta = 0;
+
+        for (size_t i = 1; i < count; i++)
+        {
+            delta += column[i - 1];
+            timestamp += delta;
+            channel.timestamps[i] = timestamp;
+        }
+
+        /* Values: delta summed once */
+        if (!readColumn(ptr, endPtr, column, isFast))
+        {
+            return false;
+        }
+
+        unzigzag(column);
+
+        /* The delta of two int32 values fits 33 bits: a bigger one is
+         * rejected before it is added, which cannot overflow then */
+        for (size_t i = 1; i < count; i++)
+        {
+            int64_t valueDelta = (int64_t) column[i - 1];
+
+            if ((valueDelta < -(int64_t) UINT32_MAX) ||
+                (valueDelta > (int64_t) UINT32_MAX))
+            {
+                return false;
+            }
+
+            value += valueDelta;
+
+            if ((value < INT32_MIN) || (value > INT32_MAX))
+            {
+                return false;
+            }
+
+            channel.values[i] = value;
+        }
+    }
+
+    /* Trailing bytes mean the block is not what the encoder wrote */
+    return (ptr == endPtr);
+}
+
+/*!
+ * @brief Decode a block, one varint at a time (reference path)
+ *
+ * @param[in] buf       Block
+ * @param[in] len       Size of the block
+ * @param[out] channels Samples of the block, per channel
+ *
+ * @return False if the block is malformed
+ * */
+bool ColumnarDecoder::decode(const uint8_t* buf, uint32_t len,
+                                std::vector<ChannelSamples>& channels)
+{
+    return decodeBlock(buf, len, channels, false);
+}
+
+/*!
+ * @brief Decode a block, reading the single byte numbers by 8
+ *
+ * @param[in] buf       Block
+ * @param[in] len       Size of the block
+ * @param[out] channels Samples of the block, per channel
+ *
+ * @return False if the block is malformed
+ * */
+bool ColumnarDecoder::decodeFast(const uint8_t* buf, uint32_t len,
+                                    std::vector<ChannelSamples>& channels)
+{
+    return decodeBlock(buf, len, channels, true);
+}
+
+/*!
+ * @brief Check that a block decodes the same way on both paths
+ *
+ * @param[in] buf       Block
+ * @param[in] len       Size of the block
+ *
+ * @return True if the block is valid and both paths agree bit for bit
+ * */
+bool ColumnarDecoder::verify(const uint8_t* buf, uint32_t len)
+{
+    std::vector<ChannelSamples> reference;
+    std::vector<ChannelSamples> fast;
+
+    if (!decode(buf, len, reference) || !decodeFast(buf, len, fast) ||
+        (reference.size() != fast.size()))
+    {
+        return false;
+    }
+
+    for (size_t c = 0; c < reference.size(); c++)
+    {
+        if ((reference[c].channelId != fast[c].channelId) ||
+            (reference[c].timestamps != fast[c].timestamps) ||
+            (reference[c].values != fast[c].values))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*** end of file ***/
@@ -0,0 +1,46 @@
+/** @file ColumnarDecoder.h
+ *
+ * @brief This class decodes the columnar blocks of sensor samples made by
+ * ColumnarEncoder
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef COLUMNAR_DECODER_H
+#define COLUMNAR_DECODER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Encoding/ColumnarEncodingUtils.h"
+#include <vector>
+
+class ColumnarDecoder
+{
+    private:
+        static bool readVarint(const uint8_t*& ptr, const uint8_t* endPtr,
+                                uint64_t* valuePtr);
+        static bool readLiterals(const uint8_t*& ptr, const uint8_t* endPtr,
+                                    uint64_t* outPtr, uint32_t count,
+                                    bool isFast);
+        static bool readColumn(const uint8_t*& ptr, const uint8_t* endPtr,
+                                std::vector<uint64_t>& column, bool isFast);
+        static void unzigzag(std::vector<uint64_t>& column);
+        static bool decodeBlock(const uint8_t* buf, uint32_t len,
+                        std::vector<ColumnarEncodingTypes::ChannelSamples>&
+                                                                    channels,
+                        bool isFast);
+
+    public:
+        static bool decode(const uint8_t* buf, uint32_t len,
+                        std::vector<ColumnarEncodingTypes::ChannelSamples>&
+                                                                    channels);
+        static bool decodeFast(const uint8_t* buf, uint32_t len,
+                        std::vector<ColumnarEncodingTypes::ChannelSamples>&
+                                                                    channels);
+        static bool verify(const uint8_t* buf, uint32_t len);
+};
+
+#endif /* COLUMNAR_DECODER_H */
+
+/*** end of file ***/
@@ -0,0 +1,280 @@
+/** @file ColumnarEncoder.cpp
+ *
+ * @brief This class encodes the sensor samples of a device into a compact
+ * columnar block before upload
+ *
+ * The samples are periodic: the timestamps grow by an almost constant step
+ * and the values change slowly. Storing the delta-of-delta of the timestamps
+ * and the delta of the values gives mostly 0 and small numbers, which take a
+ * single byte as zigzag varints, and the runs of identical numbers are
+ * replaced by a count.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Encoding/ColumnarEncoder.h"
+
+using namespace ColumnarEncodingConstants;
+using namespace ColumnarEncodingTypes;
+
+/*!
+ * @brief Constructor for ColumnarEncoder
+ * */
+ColumnarEncoder::ColumnarEncoder(void) : sampleNb(0), rawBytesNb(0),
+                                            encodedBytesNb(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for ColumnarEncoder
+ * */
+ColumnarEncoder::~ColumnarEncoder(void)
+{
+
+}
+
+/*!
+ * @brief Append an unsigned number as a varint: 7 bits per byte, the high
+ * bit set on all the bytes but the last
+ *
+ * @param[out] block    Buffer to append to
+ * @param[in] value     Number to write
+ *
+ * @return None
+ * */
+void ColumnarEncoder::writeVarint(std::vector<uint8_t>& block, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        block.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+
+    block.push_back(value);
+}
+
+/*!
+ * @brief Map a signed number to an unsigned one so that small negative
+ * numbers stay small: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ *
+ * @param[in] value     Signed number
+ *
+ * @return Zigzag encoded number
+ * */
+uint64_t ColumnarEncoder::zigzag(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+/*!
+ * @brief Append a column of zigzag numbers, run-length encoded. The column
+ * is a list of tokens, each one a varint (length << 1 | isRun):
+ * - a run is followed by the number repeated length times
+ * - a literal is followed by length numbers
+ *
+ * @param[out] block    Buffer to append to
+ * @param[in] column    Numbers to write
+ *
+ * @return None
+ * */
+void ColumnarEncoder::writeColumn(std::vector<uint8_t>& block,
+                                    const std::vector<uint64_t>& column)
+{
+    size_t literalStart = 0;
+    size_t i = 0;
+
+    while (i < column.size())
+    {
+        size_t runEnd = i + 1;
+
+        while ((runEnd < column.size()) && (column[runEnd] == column[i]))
+        {
+            runEnd++;
+        }
+
+        if ((runEnd - i) < COLUMNAR_MIN_RUN)
+        {
+            i = runEnd;
+            continue;
+        }
+
+        /* Flush the numbers before the run as a literal */
+        if (literalStart < i)
+        {
+            writeVarint(block, (uint64_t) (i - literalStart) << 1);
+
+            for (size_t j = literalStart; j < i; j++)
+            {
+                writeVarint(block, column[j]);
+            }
+        }
+
+        writeVarint(block, ((uint64_t) (runEnd - i) << 1) | 1);
+        writeVarint(block, column[i]);
+
+        i = runEnd;
+        literalStart = i;
+    }
+
+    if (literalStart < column.size())
+    {
+        writeVarint(block, (uint64_t) (column.size() - literalStart) << 1);
+
+        for (size_t j = literalStart; j < column.size(); j++)
+        {
+            writeVarint(block, column[j]);
+        }
+    }
+}
+
+/*!
+ * @brief Add a sample to the next block
+ *
+ * @param[in] channelId     Channel of the sample
+ * @param[in] timestamp     Time of the sample
+ * @param[in] value         Value of the sample
+ *
+ * @return LE_OK on success, LE_OVERFLOW if the block is full and has to be
+ * encoded first
+ * */
+le_result_t ColumnarEncoder::addSample(uint8_t channelId, uint64_t timestamp,
+                                        int32_t value)
+{
+    ChannelSamples* channelPtr = NULL;
+
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        if (channels[i].channelId == channelId)
+        {
+            channelPtr = &channels[i];
+            break;
+        }
+    }
+
+    if (sampleNb >= COLUMNAR_MAX_SAMPLES)
+    {
+        return LE_OVERFLOW;
+    }
+
+    if (channelPtr == NULL)
+    {
+        if (channels.size() >= COLUMNAR_MAX_CHANNELS)
+        {
+            return LE_OVERFLOW;
+        }
+
+        channels.push_back(ChannelSamples());
+        channelPtr = &channels.back();
+        channelPtr->channelId = channelId;
+    }
+
+    channelPtr->timestamps.push_back(timestamp);
+    channelPtr->values.push_back(value);
+    sampleNb++;
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Encode the samples added since the last block and start a new one
+ *
+ * @param[out] block    Encoded block
+ *
+ * @return Status of the operation, false if there is no sample
+ * */
+bool ColumnarEncoder::encode(std::vector<uint8_t>& block)
+{
+    std::vector<uint64_t> column;
+
+    block.clear();
+
+    if (sampleNb == 0)
+    {
+        return false;
+    }
+
+    block.push_back(COLUMNAR_FORMAT_VERSION);
+    writeVarint(block, channels.size());
+
+    for (size_t c = 0; c < channels.size(); c++)
+    {
+        const ChannelSamples& channel = channels[c];
+        size_t count = channel.timestamps.size();
+        uint64_t prevDelta = 0;
+
+        block.push_back(channel.channelId);
+        writeVarint(block, count);
+        writeVarint(block, channel.timestamps[0]);
+        writeVarint(block, zigzag(channel.values[0]));
+
+        column.resize(count - 1);
+
+        /* Unsigned arithmetic wraps instead of overflowing, the decoder
+         * undoes it exactly whatever the timestamps */
+        for (size_t i = 1; i < count; i++)
+        {
+            uint64_t delta = channel.timestamps[i] - channel.timestamps[i - 1];
+
+            column[i - 1] = zigzag((int64_t) (delta - prevDelta));
+            prevDelta = delta;
+        }
+
+        writeColumn(block, column);
+
+        for (size_t i = 1; i < count; i++)
+        {
+            column[i - 1] = zigzag((int64_t) channel.values[i] -
+                                                        channel.values[i - 1]);
+        }
+
+        writeColumn(block, column);
+    }
+
+    rawBytesNb += (uint64_t) sampleNb * COLUMNAR_RAW_SAMPLE_SIZE;
+    encodedBytesNb += block.size();
+
+    reset();
+
+    return true;
+}
+
+/*!
+ * @brief Drop the samples added since the last block
+ *
+ * @return None
+ * */
+void ColumnarEncoder::reset(void)
+{
+    channels.clear();
+    sampleNb = 0;
+}
+
+/*!
+ * @brief Get the number of samples waiting to be encoded
+ *
+ * @return Number of samples
+ * */
+uint32_t ColumnarEncoder::getSampleNb(void) const
+{
+    return sampleNb;
+}
+
+/*!
+ * @brief Log the size of the blocks compared to samples sent as is
+ *
+ * @return None
+ * */
+void ColumnarEncoder::logStats(void) const
+{
+    LE_INFO("Columnar encoder: raw %llu bytes, encoded %llu bytes, ratio %u%%",
+            (unsigned long long) rawBytesNb,
+            (unsigned long long) encodedBytesNb,
+            (uint32_t) ((rawBytesNb > 0) ?
+                                    (100 * encodedBytesNb / rawBytesNb) : 0));
+}
+
+/*** end of file ***/
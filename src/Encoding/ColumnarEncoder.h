@@ -0,0 +1,44 @@
+/** @file ColumnarEncoder.h
+ *
+ * @brief This class encodes the sensor samples of a device into a compact
+ * columnar block before upload
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef COLUMNAR_ENCODER_H
+#define COLUMNAR_ENCODER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Encoding/ColumnarEncodingUtils.h"
+#include <vector>
+
+class ColumnarEncoder
+{
+    private:
+        std::vector<ColumnarEncodingTypes::ChannelSamples> channels;
+        uint32_t sampleNb;
+        uint64_t rawBytesNb;
+        uint64_t encodedBytesNb;
+
+        static void writeVarint(std::vector<uint8_t>& block, uint64_t value);
+        static uint64_t zigzag(int64_t value);
+        static void writeColumn(std::vector<uint8_t>& block,
+                                const std::vector<uint64_t>& column);
+
+    public:
+        ColumnarEncoder(void);
+        ~ColumnarEncoder(void);
+        le_result_t addSample(uint8_t channelId, uint64_t timestamp,
+                                int32_t value);
+        bool encode(std::vector<uint8_t>& block);
+        void reset(void);
+        uint32_t getSampleNb(void) const;
+        void logStats(void) const;
+};
+
+#endif /* COLUMNAR_ENCODER_H */
+
+/*** end of file ***/
@@ -0,0 +1,58 @@
+/** @file ColumnarEncodingUtils.h
+ *
+ * @brief This file provides the types and constants of the columnar encoding
+ * of the sensor samples
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef COLUMNAR_ENCODING_UTILS_H
+#define COLUMNAR_ENCODING_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <vector>
+
+namespace ColumnarEncodingTypes
+{
+    /* Samples of one channel of a device, in time order */
+    struct ChannelSamples
+    {
+        uint8_t channelId;
+        std::vector<uint64_t> timestamps;
+        std::vector<int32_t> values;
+    };
+}
+
+namespace ColumnarEncodingConstants
+{
+    /* Block layout:
+     *   version (1) | channel number (varint)
+     * then for each channel:
+     *   channel id (1) | sample number (varint) | first timestamp (varint) |
+     *   first value (zigzag varint) | timestamp column | value column
+     * The timestamp column holds the delta-of-delta of the timestamps,
+     * computed modulo 2^64, and the value column the delta of the values,
+     * both as run-length encoded zigzag varints (see
+     * ColumnarEncoder::writeColumn()). */
+    const uint8_t COLUMNAR_FORMAT_VERSION = 1;
+
+    /* Limits of a block, also checked when decoding untrusted data. The
+     * samples are counted over all the channels: a run token of a few bytes
+     * stands for any number of samples, so this bounds the memory a small
+     * block can make the decoder allocate (20 bytes per sample). */
+    const uint16_t COLUMNAR_MAX_CHANNELS = 64;
+    const uint32_t COLUMNAR_MAX_SAMPLES = 65536;
+
+    /* Identical values in a row from which a run is encoded rather than
+     * the values themselves */
+    const uint8_t COLUMNAR_MIN_RUN = 3;
+
+    /* Size of a sample sent as is: 8 bytes timestamp and 4 bytes value */
+    const uint8_t COLUMNAR_RAW_SAMPLE_SIZE = 12;
+}
+
+#endif /* COLUMNAR_ENCODING_UTILS_H */
+
+/*** end of file ***/
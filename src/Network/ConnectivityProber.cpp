@@ -0,0 +1,873 @@
+/** @file ConnectivityProber.cpp
+ *
+ * @brief This class checks the internet connectivity with ICMP, TCP and DNS
+ * probes sent in parallel from non-blocking sockets
+ *
+ * A round probes all the targets at once and ends at the first answer, so a
+ * working link is confirmed in one round trip instead of the seconds of a
+ * forked ping. The ICMP echo requests use datagram sockets when the kernel
+ * allows it (net.ipv4.ping_group_range), raw sockets otherwise. The datagram
+ * probes are sent again every PROBE_RESEND_MS until the round times out.
+ *
+ * A round runs from the Legato event loop with start(), which calls the
+ * handler once it is over. Nothing blocks, the prober can be used from any
+ * event handler.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/ConnectivityProber.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace ConnectivityProberConstants;
+using namespace ConnectivityProberTypes;
+
+/* Size of a DNS header, and of the query for the root name servers */
+static const uint8_t DNS_HEADER_SIZE = 12;
+static const uint8_t DNS_QUERY_SIZE = DNS_HEADER_SIZE + 5;
+
+/* Biggest answer read: an IPv4 header with options and an ICMP echo reply,
+ * or the beginning of a DNS answer */
+static const uint16_t PROBE_RECEIVE_SIZE = 512;
+
+/*!
+ * @brief Constructor for ConnectivityProber. The default targets are probed
+ * until setTargets() is called.
+ * */
+ConnectivityProber::ConnectivityProber(void) : isRunning(false), startMs(0),
+                                                timeoutMs(PROBE_TIMEOUT_MS),
+                                                roundTimer(NULL),
+                                                handler(NULL),
+                                                contextPtr(NULL),
+                                                roundNb(0),
+                                                reachableNb(0),
+                                                unreachableNb(0)
+{
+    setTargets(DEFAULT_PROBE_TARGETS);
+}
+
+/*!
+ * @brief Destructor for ConnectivityProber. A round in progress is
+ * cancelled.
+ * */
+ConnectivityProber::~ConnectivityProber(void)
+{
+    cancel();
+
+    if (roundTimer != NULL)
+    {
+        le_timer_Delete(roundTimer);
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t ConnectivityProber::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Compute the internet checksum of an ICMP message
+ *
+ * @param[in] data  Message, with a null checksum field
+ * @param[in] len   Size of the message
+ *
+ * @return Checksum, in network byte order
+ * */
+uint16_t ConnectivityProber::getChecksum(const uint8_t* data, uint32_t len)
+{
+    uint32_t sum = 0;
+    uint16_t word;
+
+    for (uint32_t i = 0; (i + 1) < len; i += 2)
+    {
+        memcpy(&word, &data[i], sizeof(word));
+        sum += word;
+    }
+
+    if (len & 1)
+    {
+        word = 0;
+        memcpy(&word, &data[len - 1], 1);
+        sum += word;
+    }
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return ~sum;
+}
+
+/*!
+ * @brief Set the targets probed by the next rounds. Their statistics are
+ * reset.
+ *
+ * @param[in] targets   Targets, with numeric addresses
+ *
+ * @return False if a round is in progress or there are too many targets
+ * */
+bool ConnectivityProber::setTargets(const std::vector<ProbeTarget>& targets)
+{
+    if (isRunning || (targets.size() > PROBE_MAX_TARGETS))
+    {
+        LE_ERROR("Couldn't set %zu probe targets", targets.size());
+        return false;
+    }
+
+    probes.resize(targets.size());
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        Probe& probe = probes[i];
+
+        probe.target = targets[i];
+        probe.fd = -1;
+        probe.isRaw = false;
+        probe.isDone = true;
+        probe.id = 0;
+        probe.sequence = 0;
+        probe.roundSequence = 0;
+        probe.firstSentMs = 0;
+        probe.lastSentMs = 0;
+        probe.fdMonitorRef = NULL;
+        memset(&probe.stats, 0, sizeof(probe.stats));
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Open the socket of a probe
+ *
+ * @param[in,out] probe     Probe
+ * @param[in] index         Index of the probe, to tell the answers apart
+ *
+ * @return False if the address is not valid or the socket couldn't be opened
+ * */
+bool ConnectivityProber::openProbe(Probe& probe, uint16_t index)
+{
+    struct sockaddr_in* addr4Ptr = (struct sockaddr_in*) &probe.addr;
+    struct sockaddr_in6* addr6Ptr = (struct sockaddr_in6*) &probe.addr;
+    const char* address = probe.target.address.c_str();
+    int family;
+    int flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+    memset(&probe.addr, 0, sizeof(probe.addr));
+
+    if (inet_pton(AF_INET, address, &addr4Ptr->sin_addr) == 1)
+    {
+        family = AF_INET;
+        addr4Ptr->sin_family = AF_INET;
+        addr4Ptr->sin_port = htons(probe.target.port);
+        probe.addrLen = sizeof(struct sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, address, &addr6Ptr->sin6_addr) == 1)
+    {
+        family = AF_INET6;
+        addr6Ptr->sin6_family = AF_INET6;
+        addr6Ptr->sin6_port = htons(probe.target.port);
+        probe.addrLen = sizeof(struct sockaddr_in6);
+    }
+    else
+    {
+        LE_ERROR("Invalid probe address %s", address);
+        return false;
+    }
+
+    probe.isRaw = false;
+    probe.id = (getpid() + index * 0x1000) & 0xFFFF;
+    probe.roundSequence = probe.sequence + 1;
+    probe.firstSentMs = 0;
+    probe.lastSentMs = 0;
+
+    switch (probe.target.type)
+    {
+        case PROBE_ICMP:
+        {
+            int protocol = (family == AF_INET) ? (int) IPPROTO_ICMP :
+                                                    (int) IPPROTO_ICMPV6;
+
+            probe.fd = socket(family, SOCK_DGRAM | flags, protocol);
+
+            if ((probe.fd < 0) && ((errno == EACCES) || (errno == EPERM)))
+            {
+                probe.fd = socket(family, SOCK_RAW | flags, protocol);
+                probe.isRaw = true;
+            }
+            break;
+        }
+
+        case PROBE_TCP:
+            probe.fd = socket(family, SOCK_STREAM | flags, 0);
+            break;
+
+        case PROBE_DNS:
+            probe.fd = socket(family, SOCK_DGRAM | flags, 0);
+
+            /* Connected, so that a port unreachable is reported */
+            if ((probe.fd >= 0) &&
+                (connect(probe.fd, (struct sockaddr*) &probe.addr,
+                            probe.addrLen) < 0))
+            {
+                LE_DEBUG("Couldn't reach %s: %m", address);
+                ::close(probe.fd);
+                probe.fd = -1;
+                return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    if (probe.fd < 0)
+    {
+        LE_ERROR("Couldn't open the probe socket of %s: %m", address);
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Close the socket of a probe
+ *
+ * @param[in,out] probe     Probe
+ *
+ * @return None
+ * */
+void ConnectivityProber::closeProbe(Probe& probe)
+{
+    if (probe.fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(probe.fdMonitorRef);
+        probe.fdMonitorRef = NULL;
+    }
+
+    if (probe.fd >= 0)
+    {
+        ::close(probe.fd);
+        probe.fd = -1;
+    }
+
+    probe.isDone = true;
+}
+
+/*!
+ * @brief Send a probe. A TCP probe connects once, the datagram probes are
+ * sent at each call.
+ *
+ * @param[in,out] probe     Probe
+ * @param[in] nowMs         Current time
+ *
+ * @return None
+ * */
+void ConnectivityProber::send(Probe& probe, uint64_t nowMs)
+{
+    uint8_t buffer[DNS_QUERY_SIZE + PROBE_ICMP_PAYLOAD_SIZE] = {0};
+    bool isIPv4 = (probe.addr.ss_family == AF_INET);
+    ssize_t sentNb = 0;
+    uint16_t value;
+
+    if ((probe.target.type == PROBE_TCP) && (probe.firstSentMs != 0))
+    {
+        return;
+    }
+
+    probe.sequence++;
+
+    if (probe.firstSentMs == 0)
+    {
+        probe.firstSentMs = nowMs;
+    }
+
+    probe.lastSentMs = nowMs;
+    probe.stats.sentNb++;
+
+    switch (probe.target.type)
+    {
+        case PROBE_ICMP:
+        {
+            uint32_t len = 8 + PROBE_ICMP_PAYLOAD_SIZE;
+
+            buffer[0] = isIPv4 ? ICMP_ECHO : ICMP6_ECHO_REQUEST;
+            value = htons(probe.id);
+            memcpy(&buffer[4], &value, sizeof(value));
+            value = htons(probe.sequence);
+            memcpy(&buffer[6], &value, sizeof(value));
+            memcpy(&buffer[8], &nowMs, sizeof(nowMs));
+
+            /* The kernel computes the checksum of ICMPv6 */
+            if (isIPv4)
+            {
+                value = getChecksum(buffer, len);
+                memcpy(&buffer[2], &value, sizeof(value));
+            }
+
+            sentNb = sendto(probe.fd, buffer, len, 0,
+                            (struct sockaddr*) &probe.addr, probe.addrLen);
+            break;
+        }
+
+        case PROBE_TCP:
+            if (connect(probe.fd, (struct sockaddr*) &probe.addr,
+                        probe.addrLen) == 0)
+            {
+                succeed(probe);
+                return;
+            }
+
+            sentNb = (errno == EINPROGRESS) ? 0 : -1;
+            break;
+
+        case PROBE_DNS:
+            /* Query for the name servers of the root, recursion desired */
+            value = htons(probe.id + probe.sequence);
+            memcpy(&buffer[0], &value, sizeof(value));
+            buffer[2] = 0x01;
+            buffer[5] = 1;
+            buffer[DNS_HEADER_SIZE + 2] = 2;
+            buffer[DNS_HEADER_SIZE + 4] = 1;
+
+            sentNb = ::send(probe.fd, buffer, DNS_QUERY_SIZE, 0);
+            break;
+
+        default:
+            break;
+    }
+
+    if ((sentNb < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+    {
+        fail(probe, errno);
+    }
+}
+
+/*!
+ * @brief Read the answers received by a probe
+ *
+ * @param[in,out] probe     Probe
+ *
+ * @return None
+ * */
+void ConnectivityProber::receive(Probe& probe)
+{
+    uint8_t buffer[PROBE_RECEIVE_SIZE];
+    int error = 0;
+    socklen_t errorLen = sizeof(error);
+    uint16_t value;
+
+    if (probe.target.type == PROBE_TCP)
+    {
+        if (getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &error,
+                        &errorLen) < 0)
+        {
+            error = errno;
+        }
+
+        /* A reset is an answer from the target as well */
+        if ((error == 0) || (error == ECONNREFUSED))
+        {
+            succeed(probe);
+        }
+        else if (error != EINPROGRESS)
+        {
+            fail(probe, error);
+        }
+
+        return;
+    }
+
+    while (isRunning && !probe.isDone)
+    {
+        ssize_t len = recv(probe.fd, buffer, sizeof(buffer), 0);
+
+        if (len < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                break;
+            }
+
+            /* A port unreachable for the DNS query comes from the target */
+            if ((errno == ECONNREFUSED) && (probe.target.type == PROBE_DNS))
+            {
+                succeed(probe);
+            }
+            else
+            {
+                fail(probe, errno);
+            }
+            break;
+        }
+
+        if (probe.target.type == PROBE_DNS)
+        {
+            if ((len >= DNS_HEADER_SIZE) && (buffer[2] & 0x80))
+            {
+                memcpy(&value, &buffer[0], sizeof(value));
+                value = ntohs(value) - probe.id;
+
+                if ((uint16_t) (value - probe.roundSequence) <=
+                    (uint16_t) (probe.sequence - probe.roundSequence))
+                {
+                    succeed(probe);
+                }
+            }
+            continue;
+        }
+
+        bool isIPv4 = (probe.addr.ss_family == AF_INET);
+        uint32_t offset = (probe.isRaw && isIPv4) ? (buffer[0] & 0x0F) * 4 : 0;
+
+        if (len < (ssize_t) (offset + 8))
+        {
+            continue;
+        }
+
+        if (buffer[offset] != (isIPv4 ? ICMP_ECHOREPLY : ICMP6_ECHO_REPLY))
+        {
+            continue;
+        }
+
+        /* The kernel sets the identifier of the datagram sockets, and only
+         * gives them their own answers */
+        memcpy(&value, &buffer[offset + 4], sizeof(value));
+
+        if (probe.isRaw && (ntohs(value) != probe.id))
+        {
+            continue;
+        }
+
+        memcpy(&value, &buffer[offset + 6], sizeof(value));
+        value = ntohs(value);
+
+        if ((uint16_t) (value - probe.roundSequence) <=
+            (uint16_t) (probe.sequence - probe.roundSequence))
+        {
+            succeed(probe);
+        }
+    }
+}
+
+/*!
+ * @brief End the round on the first answer
+ *
+ * @param[in,out] probe     Probe answered
+ *
+ * @return None
+ * */
+void ConnectivityProber::succeed(Probe& probe)
+{
+    /* The answer is taken for the last one sent, the round trip time is
+     * thus never overestimated */
+    uint32_t rttMs = getNowMs() - probe.lastSentMs;
+    ProbeStats& stats = probe.stats;
+
+    stats.successNb++;
+    stats.lastRttMs = rttMs;
+
+    if ((stats.successNb == 1) || (rttMs < stats.minRttMs))
+    {
+        stats.minRttMs = rttMs;
+    }
+
+    if (rttMs > stats.maxRttMs)
+    {
+        stats.maxRttMs = rttMs;
+    }
+
+    stats.smoothedRttMs = (stats.successNb == 1) ? rttMs :
+                            ((7 * stats.smoothedRttMs + rttMs) / 8);
+
+    LE_DEBUG("Probe of %s answered in %u ms", probe.target.address.c_str(),
+                rttMs);
+
+    finish(true, rttMs);
+}
+
+/*!
+ * @brief Give up a probe on a socket error. The round fails once all the
+ * probes failed.
+ *
+ * @param[in,out] probe     Probe
+ * @param[in] error         Error number
+ *
+ * @return None
+ * */
+void ConnectivityProber::fail(Probe& probe, int error)
+{
+    LE_DEBUG("Probe of %s failed: %s", probe.target.address.c_str(),
+                strerror(error));
+
+    closeProbe(probe);
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        if (!probes[i].isDone)
+        {
+            return;
+        }
+    }
+
+    finish(false, 0);
+}
+
+/*!
+ * @brief Send again the datagram probes not answered, and end the round
+ * once it timed out
+ *
+ * @return None
+ * */
+void ConnectivityProber::sendDue(void)
+{
+    uint64_t nowMs = getNowMs();
+
+    if ((nowMs - startMs) >= timeoutMs)
+    {
+        LE_DEBUG("Probe round timed out");
+        finish(false, 0);
+        return;
+    }
+
+    for (uint8_t i = 0; isRunning && (i < probes.size()); i++)
+    {
+        Probe& probe = probes[i];
+
+        if (!probe.isDone && (probe.target.type != PROBE_TCP) &&
+            ((nowMs - probe.lastSentMs) >= PROBE_RESEND_MS))
+        {
+            send(probe, nowMs);
+        }
+    }
+}
+
+/*!
+ * @brief Get the time until sendDue() has work to do
+ *
+ * @return Delay in milliseconds, -1 if no round is in progress
+ * */
+int32_t ConnectivityProber::getNextTimeoutMs(void) const
+{
+    if (!isRunning)
+    {
+        return -1;
+    }
+
+    uint64_t nowMs = getNowMs();
+    uint64_t dueMs = startMs + timeoutMs;
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        const Probe& probe = probes[i];
+
+        if (!probe.isDone && (probe.target.type != PROBE_TCP) &&
+            ((probe.lastSentMs + PROBE_RESEND_MS) < dueMs))
+        {
+            dueMs = probe.lastSentMs + PROBE_RESEND_MS;
+        }
+    }
+
+    return (dueMs > nowMs) ? (dueMs - nowMs) : 0;
+}
+
+/*!
+ * @brief Arm the round timer for the next resend or the timeout
+ *
+ * @return None
+ * */
+void ConnectivityProber::armTimer(void)
+{
+    int32_t delayMs = getNextTimeoutMs();
+
+    le_timer_Stop(roundTimer);
+    le_timer_SetMsInterval(roundTimer, (delayMs > 0) ? delayMs : 1);
+    le_timer_Start(roundTimer);
+}
+
+/*!
+ * @brief Handler of the probe sockets when monitored by the Legato event
+ * loop
+ *
+ * @param[in] fd        File descriptor of the socket
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void ConnectivityProber::fdHandler(int fd, short events)
+{
+    ConnectivityProber* proberPtr =
+                            (ConnectivityProber*) le_fdMonitor_GetContextPtr();
+
+    for (uint8_t i = 0; i < proberPtr->probes.size(); i++)
+    {
+        if (proberPtr->probes[i].fd == fd)
+        {
+            proberPtr->receive(proberPtr->probes[i]);
+            break;
+        }
+    }
+}
+
+/*!
+ * @brief Handler of the round timer
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void ConnectivityProber::timerHandler(le_timer_Ref_t timerRef)
+{
+    ConnectivityProber* proberPtr =
+                        (ConnectivityProber*) le_timer_GetContextPtr(timerRef);
+
+    proberPtr->sendDue();
+
+    if (proberPtr->isRunning)
+    {
+        proberPtr->armTimer();
+    }
+}
+
+/*!
+ * @brief End the round, close the sockets and notify the handler
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ *
+ * @return None
+ * */
+void ConnectivityProber::finish(bool isReachable, uint32_t rttMs)
+{
+    ProbeHandler roundHandler = handler;
+
+    isRunning = false;
+
+    if (isReachable)
+    {
+        reachableNb++;
+    }
+    else
+    {
+        unreachableNb++;
+    }
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        closeProbe(probes[i]);
+    }
+
+    if (roundTimer != NULL)
+    {
+        le_timer_Stop(roundTimer);
+    }
+
+    handler = NULL;
+
+    /* Called last, it may start the next round */
+    if (roundHandler != NULL)
+    {
+        roundHandler(isReachable, rttMs, contextPtr);
+    }
+}
+
+/*!
+ * @brief Open the probes of a round and send them
+ *
+ * @param[in] roundTimeoutMs    Time given to the targets to answer
+ *
+ * @return False if a round is already in progress or there is no target
+ * */
+bool ConnectivityProber::startRound(uint32_t roundTimeoutMs)
+{
+    if (isRunning || probes.empty())
+    {
+        return false;
+    }
+
+    isRunning = true;
+    startMs = getNowMs();
+    timeoutMs = roundTimeoutMs;
+    roundNb++;
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        probes[i].isDone = !openProbe(probes[i], i);
+    }
+
+    for (uint8_t i = 0; isRunning && (i < probes.size()); i++)
+    {
+        Probe& probe = probes[i];
+
+        if (probe.isDone)
+        {
+            continue;
+        }
+
+        char name[32];
+
+        snprintf(name, sizeof(name), "Probe%u", i);
+        probe.fdMonitorRef = le_fdMonitor_Create(name, probe.fd, fdHandler,
+                                                (probe.target.type == PROBE_TCP)
+                                                        ? POLLOUT : POLLIN);
+        le_fdMonitor_SetContextPtr(probe.fdMonitorRef, this);
+
+        send(probe, startMs);
+    }
+
+    /* All the probes failed at once, the network is unreachable */
+    if (isRunning)
+    {
+        bool isPending = false;
+
+        for (uint8_t i = 0; i < probes.size(); i++)
+        {
+            isPending = isPending || !probes[i].isDone;
+        }
+
+        if (!isPending)
+        {
+            finish(false, 0);
+        }
+    }
+
+    if (isRunning)
+    {
+        if (roundTimer == NULL)
+        {
+            roundTimer = le_timer_Create("ProbeRoundTimer");
+            le_timer_SetRepeat(roundTimer, 1);
+            le_timer_SetHandler(roundTimer, timerHandler);
+            le_timer_SetContextPtr(roundTimer, this);
+        }
+
+        armTimer();
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Start a probe round from the Legato event loop
+ *
+ * @param[in] roundHandler      Called once the round is over
+ * @param[in] roundContextPtr   Context given to the handler
+ *
+ * @return False if a round is already in progress or there is no target
+ * */
+bool ConnectivityProber::start(ProbeHandler roundHandler,
+                                void* roundContextPtr)
+{
+    if (isRunning)
+    {
+        return false;
+    }
+
+    handler = roundHandler;
+    contextPtr = roundContextPtr;
+
+    if (!startRound(PROBE_TIMEOUT_MS))
+    {
+        handler = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Cancel the round in progress, without calling its handler
+ *
+ * @return None
+ * */
+void ConnectivityProber::cancel(void)
+{
+    if (!isRunning)
+    {
+        return;
+    }
+
+    handler = NULL;
+    isRunning = false;
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        closeProbe(probes[i]);
+    }
+
+    if (roundTimer != NULL)
+    {
+        le_timer_Stop(roundTimer);
+    }
+}
+
+/*!
+ * @brief Check if a round is in progress
+ *
+ * @return True if a round is in progress
+ * */
+bool ConnectivityProber::isProbing(void) const
+{
+    return isRunning;
+}
+
+/*!
+ * @brief Get the statistics of a target
+ *
+ * @param[in] index     Index of the target
+ * @param[out] statsPtr Statistics of the target
+ *
+ * @return False if there is no such target
+ * */
+bool ConnectivityProber::getTargetStats(uint8_t index,
+                                        ProbeStats* statsPtr) const
+{
+    if ((index >= probes.size()) || (statsPtr == NULL))
+    {
+        return false;
+    }
+
+    *statsPtr = probes[index].stats;
+
+    return true;
+}
+
+/*!
+ * @brief Log the statistics of the rounds and of each target
+ *
+ * @return None
+ * */
+void ConnectivityProber::logStats(void) const
+{
+    LE_INFO("Connectivity probes: %u rounds, %u reachable, %u unreachable",
+            roundNb, reachableNb, unreachableNb);
+
+    for (uint8_t i = 0; i < probes.size(); i++)
+    {
+        const ProbeStats& stats = probes[i].stats;
+
+        LE_INFO("Probe %s: %u sent, %u answered, RTT last %u ms min %u ms "
+                "max %u ms smoothed %u ms", probes[i].target.address.c_str(),
+                stats.sentNb, stats.successNb, stats.lastRttMs,
+                stats.minRttMs, stats.maxRttMs, stats.smoothedRttMs);
+    }
+}
+
+/*** end of file ***/
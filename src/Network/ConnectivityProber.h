@@ -0,0 +1,84 @@
+/** @file ConnectivityProber.h
+ *
+ * @brief This class checks the internet connectivity with ICMP, TCP and DNS
+ * probes sent in parallel from non-blocking sockets
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef CONNECTIVITY_PROBER_H
+#define CONNECTIVITY_PROBER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/ConnectivityProberUtils.h"
+#include <sys/socket.h>
+#include <vector>
+
+class ConnectivityProber
+{
+    private:
+        /* Probe of a target during a round */
+        struct Probe
+        {
+            ConnectivityProberTypes::ProbeTarget target;
+            struct sockaddr_storage addr;
+            socklen_t addrLen;
+            int fd;
+            bool isRaw;
+            bool isDone;
+            uint16_t id;
+            uint16_t sequence;
+            uint16_t roundSequence;
+            uint64_t firstSentMs;
+            uint64_t lastSentMs;
+            le_fdMonitor_Ref_t fdMonitorRef;
+            ConnectivityProberTypes::ProbeStats stats;
+        };
+
+        std::vector<Probe> probes;
+        bool isRunning;
+        uint64_t startMs;
+        uint32_t timeoutMs;
+        le_timer_Ref_t roundTimer;
+        ConnectivityProberTypes::ProbeHandler handler;
+        void* contextPtr;
+        uint32_t roundNb;
+        uint32_t reachableNb;
+        uint32_t unreachableNb;
+
+        static uint64_t getNowMs(void);
+        static uint16_t getChecksum(const uint8_t* data, uint32_t len);
+        static void fdHandler(int fd, short events);
+        static void timerHandler(le_timer_Ref_t timerRef);
+        bool openProbe(Probe& probe, uint16_t index);
+        void closeProbe(Probe& probe);
+        void send(Probe& probe, uint64_t nowMs);
+        void receive(Probe& probe);
+        void succeed(Probe& probe);
+        void fail(Probe& probe, int error);
+        void sendDue(void);
+        int32_t getNextTimeoutMs(void) const;
+        void armTimer(void);
+        void finish(bool isReachable, uint32_t rttMs);
+        bool startRound(uint32_t roundTimeoutMs);
+
+    public:
+        ConnectivityProber(void);
+        ~ConnectivityProber(void);
+        bool setTargets(
+                const std::vector<ConnectivityProberTypes::ProbeTarget>&
+                                                                targets);
+        bool start(ConnectivityProberTypes::ProbeHandler roundHandler,
+                    void* roundContextPtr);
+        void cancel(void);
+        bool isProbing(void) const;
+        bool getTargetStats(uint8_t index,
+                        ConnectivityProberTypes::ProbeStats* statsPtr) const;
+        void logStats(void) const;
+};
+
+#endif /* CONNECTIVITY_PROBER_H */
+
+/*** end of file ***/
@@ -0,0 +1,90 @@
+/** @file ConnectivityProberUtils.h
+ *
+ * @brief This file provides the types and constants of the connectivity
+ * prober
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef CONNECTIVITY_PROBER_UTILS_H
+#define CONNECTIVITY_PROBER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <string>
+#include <vector>
+
+namespace ConnectivityProberTypes
+{
+    /* How a target is probed */
+    enum ProbeType
+    {
+        /* ICMP echo request, or ICMPv6 for an IPv6 address */
+        PROBE_ICMP,
+        /* TCP connection, a reset proves the target reachable too */
+        PROBE_TCP,
+        /* DNS query over UDP, any answer proves the target reachable */
+        PROBE_DNS
+    };
+
+    /* Target probed */
+    struct ProbeTarget
+    {
+        ProbeType type;
+        /* Numeric IPv4 or IPv6 address */
+        std::string address;
+        /* Port for PROBE_TCP and PROBE_DNS */
+        uint16_t port;
+    };
+
+    /* Statistics of a target */
+    struct ProbeStats
+    {
+        uint32_t sentNb;
+        uint32_t successNb;
+        uint32_t lastRttMs;
+        uint32_t minRttMs;
+        uint32_t maxRttMs;
+        /* Smoothed like the TCP SRTT, 1/8 gain */
+        uint32_t smoothedRttMs;
+    };
+
+    /* Called once a probe round is over: at the first answer, or once all
+     * the targets failed or the round timed out */
+    typedef void (*ProbeHandler)(bool isReachable, uint32_t rttMs,
+                                    void* contextPtr);
+}
+
+namespace ConnectivityProberConstants
+{
+    /* A round fails if no target answered within this delay */
+    const uint32_t PROBE_TIMEOUT_MS = 4000;
+
+    /* ICMP and DNS probes are sent again after this delay without answer,
+     * a single lost datagram must not fail the round */
+    const uint32_t PROBE_RESEND_MS = 1000;
+
+    /* Maximum number of targets probed in parallel */
+    const uint8_t PROBE_MAX_TARGETS = 8;
+
+    /* Size of the payload of the ICMP echo requests */
+    const uint8_t PROBE_ICMP_PAYLOAD_SIZE = 16;
+
+    /* Targets probed by default: public DNS servers, which answer both ICMP
+     * and DNS, in IPv4 and IPv6. The targets of the other family fail at
+     * once. */
+    const std::vector<ConnectivityProberTypes::ProbeTarget>
+                                                DEFAULT_PROBE_TARGETS =
+    {
+        {ConnectivityProberTypes::PROBE_ICMP, "8.8.8.8", 0},
+        {ConnectivityProberTypes::PROBE_DNS, "1.1.1.1", 53},
+        {ConnectivityProberTypes::PROBE_TCP, "8.8.4.4", 53},
+        {ConnectivityProberTypes::PROBE_ICMP, "2001:4860:4860::8888", 0},
+        {ConnectivityProberTypes::PROBE_DNS, "2606:4700:4700::1111", 53}
+    };
+}
+
+#endif /* CONNECTIVITY_PROBER_UTILS_H */
+
+/*** end of file ***/
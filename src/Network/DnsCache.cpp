@@ -0,0 +1,1228 @@
+/** @file DnsCache.cpp
+ *
+ * @brief This class resolves host names with a cache honoring the TTLs,
+ * querying the DNS servers of the bearer in parallel
+ *
+ * Each lookup the cache answers saves a round trip over the cellular bearer.
+ * A missing name is queried from all the servers at once, the first answer
+ * is used, and the query is sent again if no server answered within
+ * DNS_RESEND_MS. An entry is kept for its TTL, then served stale while it is
+ * refreshed in the background, so that a slow or failing server doesn't
+ * delay the connections. An entry used during the last part of its TTL is
+ * refreshed before it expires, and the names given to prefetch() are kept
+ * resolved all along.
+ *
+ * Only IPv4 addresses are resolved, as the uplink is. The queries run from
+ * the Legato event loop once monitor() is called, or during the calls to
+ * resolve() and process() otherwise.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/DnsCache.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <ctype.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace DnsCacheConstants;
+
+/* Fields of the DNS messages */
+static const uint8_t DNS_HEADER_SIZE = 12;
+static const uint16_t DNS_TYPE_A = 1;
+static const uint16_t DNS_CLASS_IN = 1;
+static const uint8_t DNS_RCODE_NXDOMAIN = 3;
+
+/*!
+ * @brief Read a 16 bits field of a DNS message
+ *
+ * @param[in] data  Field, in network byte order
+ *
+ * @return Value
+ * */
+static uint16_t readU16(const uint8_t* data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+/*!
+ * @brief Get the form of a name used as a key: lower case, without the
+ * final dot
+ *
+ * @param[in] name  Host name
+ *
+ * @return Key
+ * */
+static std::string getKey(const std::string& name)
+{
+    std::string key = name;
+
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+    if (!key.empty() && (key[key.size() - 1] == '.'))
+    {
+        key.erase(key.size() - 1);
+    }
+
+    return key;
+}
+
+/*!
+ * @brief Split the address of a DNS server from its port
+ *
+ * @param[in] server        Address, address:port, or [address]:port for
+ *                          IPv6
+ * @param[out] addressPtr   Address
+ * @param[out] portPtr      Port, DNS_PORT if none is given
+ *
+ * @return False if the port is invalid
+ * */
+static bool splitServer(const std::string& server, std::string* addressPtr,
+                        uint16_t* portPtr)
+{
+    size_t colonPos = server.rfind(':');
+    std::string portText;
+    char* endPtr;
+    unsigned long port;
+
+    *portPtr = DNS_PORT;
+
+    if (!server.empty() && (server[0] == '['))
+    {
+        size_t endPos = server.find(']');
+
+        if (endPos == std::string::npos)
+        {
+            return false;
+        }
+
+        *addressPtr = server.substr(1, endPos - 1);
+
+        if (endPos == (server.size() - 1))
+        {
+            return true;
+        }
+
+        if (server[endPos + 1] != ':')
+        {
+            return false;
+        }
+
+        portText = server.substr(endPos + 2);
+    }
+    else if ((colonPos != std::string::npos) &&
+             (server.find(':') == colonPos))
+    {
+        *addressPtr = server.substr(0, colonPos);
+        portText = server.substr(colonPos + 1);
+    }
+    else
+    {
+        /* No port, or an IPv6 address without brackets */
+        *addressPtr = server;
+        return true;
+    }
+
+    errno = 0;
+    port = strtoul(portText.c_str(), &endPtr, 10);
+
+    if (portText.empty() || !isdigit((unsigned char) portText[0]) ||
+        (*endPtr != '\0') || (errno != 0) || (port == 0) || (port > 0xFFFF))
+    {
+        return false;
+    }
+
+    *portPtr = port;
+
+    return true;
+}
+
+/*!
+ * @brief Constructor for DnsCache. Nothing is resolved until setServers()
+ * is called.
+ * */
+DnsCache::DnsCache(void) : serverNb(0), isMonitored(false), timer(NULL),
+                            nextId(0), lookupNb(0), freshHitNb(0),
+                            staleHitNb(0), missNb(0), queryNb(0),
+                            failureNb(0), evictionNb(0), totalQueryMs(0),
+                            maxQueryMs(0), resolveNb(0), totalResolveMs(0),
+                            maxResolveMs(0)
+{
+    struct timespec now;
+
+    /* The first query id is not guessable from the time the hub started */
+    clock_gettime(CLOCK_REALTIME, &now);
+    nextId = (getpid() ^ now.tv_nsec) & 0xFFFF;
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        queries[i].isUsed = false;
+    }
+
+    for (uint8_t i = 0; i < DNS_MAX_SERVERS; i++)
+    {
+        servers[i].fd = -1;
+        servers[i].fdMonitorRef = NULL;
+        servers[i].firstNb = 0;
+    }
+}
+
+/*!
+ * @brief Destructor for DnsCache
+ * */
+DnsCache::~DnsCache(void)
+{
+    closeServers();
+
+    if (timer != NULL)
+    {
+        le_timer_Delete(timer);
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t DnsCache::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Close the sockets of the servers, the queries in progress are
+ * dropped
+ *
+ * @return None
+ * */
+void DnsCache::closeServers(void)
+{
+    for (uint8_t i = 0; i < DNS_MAX_SERVERS; i++)
+    {
+        Server& server = servers[i];
+
+        if (server.fdMonitorRef != NULL)
+        {
+            le_fdMonitor_Delete(server.fdMonitorRef);
+            server.fdMonitorRef = NULL;
+        }
+
+        if (server.fd >= 0)
+        {
+            ::close(server.fd);
+            server.fd = -1;
+        }
+    }
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        queries[i].isUsed = false;
+    }
+
+    serverNb = 0;
+}
+
+/*!
+ * @brief Set the DNS servers queried, the cache is kept. The prefetched
+ * names are resolved again from the new servers.
+ *
+ * @param[in] addresses     Numeric IPv4 or IPv6 addresses, the empty ones
+ *                          are skipped. A port other than DNS_PORT is given
+ *                          as address:port, or [address]:port for IPv6.
+ *
+ * @return False if no server could be used
+ * */
+bool DnsCache::setServers(const std::vector<std::string>& addresses)
+{
+    uint64_t nowMs = getNowMs();
+
+    closeServers();
+
+    for (uint8_t i = 0; (i < addresses.size()) &&
+                        (serverNb < DNS_MAX_SERVERS); i++)
+    {
+        Server& server = servers[serverNb];
+        struct sockaddr_in* addr4Ptr = (struct sockaddr_in*) &server.addr;
+        struct sockaddr_in6* addr6Ptr = (struct sockaddr_in6*) &server.addr;
+        const char* address = addresses[i].c_str();
+        std::string host;
+        uint16_t port;
+
+        if (addresses[i].empty())
+        {
+            continue;
+        }
+
+        memset(&server.addr, 0, sizeof(server.addr));
+
+        if (!splitServer(addresses[i], &host, &port))
+        {
+            LE_ERROR("Invalid DNS server address %s", address);
+            continue;
+        }
+
+        if (inet_pton(AF_INET, host.c_str(), &addr4Ptr->sin_addr) == 1)
+        {
+            addr4Ptr->sin_family = AF_INET;
+            addr4Ptr->sin_port = htons(port);
+            server.addrLen = sizeof(struct sockaddr_in);
+        }
+        else if (inet_pton(AF_INET6, host.c_str(), &addr6Ptr->sin6_addr) == 1)
+        {
+            addr6Ptr->sin6_family = AF_INET6;
+            addr6Ptr->sin6_port = htons(port);
+            server.addrLen = sizeof(struct sockaddr_in6);
+        }
+        else
+        {
+            LE_ERROR("Invalid DNS server address %s", address);
+            continue;
+        }
+
+        server.fd = socket(server.addr.ss_family,
+                            SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        /* Connected, so that only this server's answers are received and
+         * a port unreachable is reported */
+        if ((server.fd < 0) ||
+            (connect(server.fd, (struct sockaddr*) &server.addr,
+                        server.addrLen) < 0))
+        {
+            LE_ERROR("Couldn't open the socket of DNS server %s: %m",
+                        address);
+
+            if (server.fd >= 0)
+            {
+                ::close(server.fd);
+                server.fd = -1;
+            }
+            continue;
+        }
+
+        if (isMonitored)
+        {
+            server.fdMonitorRef = le_fdMonitor_Create("DnsServer", server.fd,
+                                                        fdHandler, POLLIN);
+            le_fdMonitor_SetContextPtr(server.fdMonitorRef, this);
+        }
+
+        LE_INFO("DNS server %s", address);
+        serverNb++;
+    }
+
+    for (std::unordered_map<std::string, Entry>::iterator it =
+                                                            entries.begin();
+         it != entries.end(); it++)
+    {
+        if (it->second.isPrefetched)
+        {
+            it->second.refreshMs = nowMs;
+        }
+    }
+
+    runDue();
+    armTimer();
+
+    return serverNb > 0;
+}
+
+/*!
+ * @brief Run the queries from the Legato event loop
+ *
+ * @return None
+ * */
+void DnsCache::monitor(void)
+{
+    if (isMonitored)
+    {
+        return;
+    }
+
+    isMonitored = true;
+
+    timer = le_timer_Create("DnsCacheTimer");
+    le_timer_SetRepeat(timer, 1);
+    le_timer_SetHandler(timer, timerHandler);
+    le_timer_SetContextPtr(timer, this);
+
+    for (uint8_t i = 0; i < serverNb; i++)
+    {
+        servers[i].fdMonitorRef = le_fdMonitor_Create("DnsServer",
+                                                        servers[i].fd,
+                                                        fdHandler, POLLIN);
+        le_fdMonitor_SetContextPtr(servers[i].fdMonitorRef, this);
+    }
+
+    armTimer();
+}
+
+/*!
+ * @brief Find the entry of a name
+ *
+ * @param[in] name  Key of the name
+ *
+ * @return The entry, NULL if there is none
+ * */
+DnsCache::Entry* DnsCache::findEntry(const std::string& name)
+{
+    std::unordered_map<std::string, Entry>::iterator it = entries.find(name);
+
+    return (it != entries.end()) ? &it->second : NULL;
+}
+
+/*!
+ * @brief Get the entry of a name, created without answer if needed. The
+ * least recently used entry not prefetched is dropped if the cache is full.
+ *
+ * @param[in] name  Key of the name
+ *
+ * @return The entry
+ * */
+DnsCache::Entry& DnsCache::addEntry(const std::string& name)
+{
+    Entry* entryPtr = findEntry(name);
+
+    if (entryPtr != NULL)
+    {
+        return *entryPtr;
+    }
+
+    if (entries.size() >= DNS_MAX_ENTRIES)
+    {
+        std::unordered_map<std::string, Entry>::iterator oldest =
+                                                                entries.end();
+
+        for (std::unordered_map<std::string, Entry>::iterator it =
+                                                            entries.begin();
+             it != entries.end(); it++)
+        {
+            if (!it->second.isPrefetched &&
+                ((oldest == entries.end()) ||
+                 (it->second.lastUsedMs < oldest->second.lastUsedMs)))
+            {
+                oldest = it;
+            }
+        }
+
+        if (oldest != entries.end())
+        {
+            entries.erase(oldest);
+            evictionNb++;
+        }
+    }
+
+    Entry& entry = entries[name];
+
+    entry.hasAnswer = false;
+    entry.isPrefetched = false;
+    entry.ttlMs = 0;
+    entry.expiresMs = 0;
+    entry.staleMs = 0;
+    entry.refreshMs = 0;
+    entry.lastUsedMs = getNowMs();
+
+    return entry;
+}
+
+/*!
+ * @brief Find the query in progress of a name
+ *
+ * @param[in] name  Key of the name
+ *
+ * @return The query, NULL if there is none
+ * */
+DnsCache::Query* DnsCache::findQuery(const std::string& name)
+{
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        if (queries[i].isUsed && (queries[i].name == name))
+        {
+            return &queries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Start the query of a name, unless it is already in progress
+ *
+ * @param[in] name  Key of the name
+ *
+ * @return False if there is no server or too many queries in progress
+ * */
+bool DnsCache::startQuery(const std::string& name)
+{
+    if (findQuery(name) != NULL)
+    {
+        return true;
+    }
+
+    if ((serverNb == 0) || name.empty() || (name.size() > DNS_MAX_NAME_SIZE))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        Query& query = queries[i];
+
+        if (!query.isUsed)
+        {
+            query.isUsed = true;
+            query.name = name;
+            query.id = nextId;
+            query.failedMask = 0;
+            query.startMs = getNowMs();
+
+            /* Stepped by an odd number, ids are not reused before 65536
+             * queries */
+            nextId += 0x9E37;
+            queryNb++;
+
+            sendQuery(query, query.startMs);
+            armTimer();
+            return true;
+        }
+    }
+
+    LE_WARN("Too many DNS queries in progress for %s", name.c_str());
+
+    return false;
+}
+
+/*!
+ * @brief Send a query to all the servers which didn't fail it
+ *
+ * @param[in,out] query     Query
+ * @param[in] nowMs         Current time
+ *
+ * @return None
+ * */
+void DnsCache::sendQuery(Query& query, uint64_t nowMs)
+{
+    uint8_t message[DNS_MESSAGE_SIZE] = {0};
+    uint16_t len = DNS_HEADER_SIZE;
+    size_t labelStart = 0;
+
+    /* Header: id, recursion desired, one question */
+    message[0] = query.id >> 8;
+    message[1] = query.id & 0xFF;
+    message[2] = 0x01;
+    message[5] = 1;
+
+    while (labelStart <= query.name.size())
+    {
+        size_t labelEnd = query.name.find('.', labelStart);
+        size_t labelLen;
+
+        if (labelEnd == std::string::npos)
+        {
+            labelEnd = query.name.size();
+        }
+
+        labelLen = labelEnd - labelStart;
+
+        if ((labelLen == 0) || (labelLen > 63))
+        {
+            LE_ERROR("Invalid host name %s", query.name.c_str());
+            failQuery(query);
+            return;
+        }
+
+        message[len++] = labelLen;
+        memcpy(&message[len], query.name.c_str() + labelStart, labelLen);
+        len += labelLen;
+        labelStart = labelEnd + 1;
+    }
+
+    message[len++] = 0;
+    message[len++] = DNS_TYPE_A >> 8;
+    message[len++] = DNS_TYPE_A & 0xFF;
+    message[len++] = DNS_CLASS_IN >> 8;
+    message[len++] = DNS_CLASS_IN & 0xFF;
+
+    query.lastSentMs = nowMs;
+
+    for (uint8_t i = 0; i < serverNb; i++)
+    {
+        if ((query.failedMask & (1 << i)) == 0)
+        {
+            if (::send(servers[i].fd, message, len, 0) < 0)
+            {
+                LE_DEBUG("Couldn't send the DNS query of %s: %m",
+                            query.name.c_str());
+                query.failedMask |= (1 << i);
+            }
+        }
+    }
+
+    if (query.failedMask == ((1 << serverNb) - 1))
+    {
+        failQuery(query);
+    }
+}
+
+/*!
+ * @brief Read the answers of a server
+ *
+ * @param[in] serverIndex   Server
+ *
+ * @return None
+ * */
+void DnsCache::receive(uint8_t serverIndex)
+{
+    uint8_t message[DNS_MESSAGE_SIZE];
+    ssize_t len;
+
+    while ((len = recv(servers[serverIndex].fd, message, sizeof(message),
+                        0)) >= 0)
+    {
+        parseAnswer(serverIndex, message, len);
+    }
+
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+    {
+        return;
+    }
+
+    /* The server is unreachable: the queries only wait for the others */
+    LE_DEBUG("DNS server %u unreachable: %m", serverIndex);
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        Query& query = queries[i];
+
+        if (query.isUsed)
+        {
+            query.failedMask |= (1 << serverIndex);
+
+            if (query.failedMask == ((1 << serverNb) - 1))
+            {
+                failQuery(query);
+            }
+        }
+    }
+}
+
+/*!
+ * @brief Skip a name in a DNS message
+ *
+ * @param[in] message   Message
+ * @param[in] len       Size of the message
+ * @param[in] offset    Start of the name
+ *
+ * @return Offset after the name, -1 if it is malformed
+ * */
+int32_t DnsCache::skipName(const uint8_t* message, uint16_t len,
+                            uint16_t offset)
+{
+    while (offset < len)
+    {
+        uint8_t labelLen = message[offset];
+
+        if (labelLen == 0)
+        {
+            return offset + 1;
+        }
+
+        /* A compression pointer ends the name */
+        if ((labelLen & 0xC0) == 0xC0)
+        {
+            return ((offset + 2) <= len) ? (offset + 2) : -1;
+        }
+
+        offset += labelLen + 1;
+    }
+
+    return -1;
+}
+
+/*!
+ * @brief Check that the question of an answer is the name queried
+ *
+ * @param[in] message   Answer
+ * @param[in] len       Size of the answer
+ * @param[in] name      Key of the name queried
+ *
+ * @return True if it is the same name
+ * */
+bool DnsCache::isSameName(const uint8_t* message, uint16_t len,
+                            const std::string& name)
+{
+    std::string question;
+    uint16_t offset = DNS_HEADER_SIZE;
+
+    while ((offset < len) && (message[offset] != 0))
+    {
+        uint8_t labelLen = message[offset];
+
+        if (((labelLen & 0xC0) != 0) || ((offset + 1 + labelLen) > len))
+        {
+            return false;
+        }
+
+        if (!question.empty())
+        {
+            question += '.';
+        }
+
+        question.append((const char*) &message[offset + 1], labelLen);
+        offset += labelLen + 1;
+    }
+
+    return getKey(question) == name;
+}
+
+/*!
+ * @brief Parse an answer: the first valid one of a query completes it, an
+ * error only fails it once all the servers failed
+ *
+ * @param[in] serverIndex   Server which answered
+ * @param[in] message       Answer
+ * @param[in] len           Size of the answer
+ *
+ * @return None
+ * */
+void DnsCache::parseAnswer(uint8_t serverIndex, const uint8_t* message,
+                            uint16_t len)
+{
+    std::vector<std::string> addresses;
+    uint32_t ttlS = DNS_MAX_TTL_S;
+    Query* queryPtr = NULL;
+    int32_t offset = DNS_HEADER_SIZE;
+
+    if ((len < DNS_HEADER_SIZE) || ((message[2] & 0x80) == 0))
+    {
+        return;
+    }
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        if (queries[i].isUsed && (queries[i].id == readU16(message)))
+        {
+            queryPtr = &queries[i];
+            break;
+        }
+    }
+
+    /* Late answer of the other server, or not an answer to a query */
+    if ((queryPtr == NULL) || !isSameName(message, len, queryPtr->name))
+    {
+        return;
+    }
+
+    uint8_t rcode = message[3] & 0x0F;
+
+    if ((rcode != 0) && (rcode != DNS_RCODE_NXDOMAIN))
+    {
+        LE_DEBUG("DNS server %u failed %s (%u)", serverIndex,
+                    queryPtr->name.c_str(), rcode);
+
+        queryPtr->failedMask |= (1 << serverIndex);
+
+        if (queryPtr->failedMask == ((1 << serverNb) - 1))
+        {
+            failQuery(*queryPtr);
+        }
+        return;
+    }
+
+    uint16_t questionNb = readU16(&message[4]);
+    uint16_t answerNb = readU16(&message[6]);
+
+    for (uint16_t i = 0; (i < questionNb) && (offset >= 0); i++)
+    {
+        offset = skipName(message, len, offset);
+        offset = (offset >= 0) ? (offset + 4) : -1;
+    }
+
+    /* The address records follow the CNAME ones, if any */
+    for (uint16_t i = 0; (i < answerNb) && (offset >= 0); i++)
+    {
+        offset = skipName(message, len, offset);
+
+        if ((offset < 0) || ((offset + 10) > len))
+        {
+            break;
+        }
+
+        const uint8_t* recordPtr = &message[offset];
+        uint16_t dataLen = readU16(&recordPtr[8]);
+
+        if ((offset + 10 + dataLen) > len)
+        {
+            break;
+        }
+
+        if ((readU16(&recordPtr[0]) == DNS_TYPE_A) &&
+            (readU16(&recordPtr[2]) == DNS_CLASS_IN) && (dataLen == 4) &&
+            (addresses.size() < DNS_MAX_ADDRESSES))
+        {
+            char address[INET_ADDRSTRLEN];
+            uint32_t recordTtlS = ((uint32_t) readU16(&recordPtr[4]) << 16) |
+                                    readU16(&recordPtr[6]);
+
+            inet_ntop(AF_INET, &recordPtr[10], address, sizeof(address));
+            addresses.push_back(address);
+            ttlS = std::min(ttlS, recordTtlS);
+        }
+
+        offset += 10 + dataLen;
+    }
+
+    /* A name without address is cached as well, for a shorter time */
+    completeQuery(*queryPtr, serverIndex, addresses,
+                    addresses.empty() ? DNS_NEGATIVE_TTL_S :
+                                        std::max(ttlS, DNS_MIN_TTL_S));
+}
+
+/*!
+ * @brief Cache the answer of a query
+ *
+ * @param[in,out] query     Query, released
+ * @param[in] serverIndex   Server which answered first
+ * @param[in] addresses     Addresses of the name, empty if it has none
+ * @param[in] ttlS          Time the answer is valid
+ *
+ * @return None
+ * */
+void DnsCache::completeQuery(Query& query, uint8_t serverIndex,
+                                const std::vector<std::string>& addresses,
+                                uint32_t ttlS)
+{
+    uint64_t nowMs = getNowMs();
+    uint32_t queryMs = nowMs - query.startMs;
+    Entry& entry = addEntry(query.name);
+
+    totalQueryMs += queryMs;
+    maxQueryMs = std::max(maxQueryMs, queryMs);
+    servers[serverIndex].firstNb++;
+
+    entry.hasAnswer = true;
+    entry.addresses = addresses;
+    entry.ttlMs = ttlS * 1000;
+    entry.expiresMs = nowMs + entry.ttlMs;
+    entry.staleMs = entry.expiresMs + (addresses.empty() ? 0 : DNS_STALE_MS);
+    entry.refreshMs = entry.expiresMs -
+                        (uint64_t) entry.ttlMs * DNS_PREFETCH_PERCENT / 100;
+
+    LE_DEBUG("%s resolved in %u ms by server %u: %zu addresses, TTL %u s",
+                query.name.c_str(), queryMs, serverIndex, addresses.size(),
+                ttlS);
+
+    query.isUsed = false;
+}
+
+/*!
+ * @brief Give up a query. The entry of the name, if any, is kept and a
+ * prefetched name is resolved again later.
+ *
+ * @param[in,out] query     Query, released
+ *
+ * @return None
+ * */
+void DnsCache::failQuery(Query& query)
+{
+    Entry* entryPtr = findEntry(query.name);
+
+    LE_WARN("Couldn't resolve %s", query.name.c_str());
+
+    failureNb++;
+
+    if ((entryPtr != NULL) && entryPtr->isPrefetched)
+    {
+        entryPtr->refreshMs = getNowMs() + DNS_RETRY_MS;
+    }
+
+    query.isUsed = false;
+}
+
+/*!
+ * @brief Send again the queries without answer, give up the ones timed out,
+ * and refresh the prefetched names due
+ *
+ * @return None
+ * */
+void DnsCache::runDue(void)
+{
+    uint64_t nowMs = getNowMs();
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        Query& query = queries[i];
+
+        if (!query.isUsed)
+        {
+            continue;
+        }
+
+        if ((nowMs - query.startMs) >= DNS_TIMEOUT_MS)
+        {
+            failQuery(query);
+        }
+        else if ((nowMs - query.lastSentMs) >= DNS_RESEND_MS)
+        {
+            sendQuery(query, nowMs);
+        }
+    }
+
+    if (serverNb == 0)
+    {
+        return;
+    }
+
+    for (std::unordered_map<std::string, Entry>::iterator it =
+                                                            entries.begin();
+         it != entries.end(); it++)
+    {
+        Entry& entry = it->second;
+
+        if (entry.isPrefetched && (entry.refreshMs <= nowMs))
+        {
+            /* Moved by the answer, or by the failure of the query */
+            entry.refreshMs = nowMs + DNS_TIMEOUT_MS;
+
+            if (!startQuery(it->first))
+            {
+                entry.refreshMs = nowMs + DNS_RETRY_MS;
+            }
+        }
+    }
+}
+
+/*!
+ * @brief Get the time until the next query to send again or to give up, or
+ * the next prefetched name to refresh
+ *
+ * @return Delay in milliseconds, -1 if there is nothing to wait for
+ * */
+int32_t DnsCache::getNextTimeoutMs(void) const
+{
+    uint64_t nowMs = getNowMs();
+    uint64_t nextMs = UINT64_MAX;
+
+    for (uint8_t i = 0; i < DNS_MAX_QUERIES; i++)
+    {
+        const Query& query = queries[i];
+
+        if (query.isUsed)
+        {
+            nextMs = std::min(nextMs, std::min(query.lastSentMs + DNS_RESEND_MS,
+                                            query.startMs + DNS_TIMEOUT_MS));
+        }
+    }
+
+    for (std::unordered_map<std::string, Entry>::const_iterator it =
+                                                            entries.begin();
+         (serverNb > 0) && (it != entries.end()); it++)
+    {
+        if (it->second.isPrefetched)
+        {
+            nextMs = std::min(nextMs, it->second.refreshMs);
+        }
+    }
+
+    if (nextMs == UINT64_MAX)
+    {
+        return -1;
+    }
+
+    return (nextMs > nowMs) ? (int32_t) std::min(nextMs - nowMs,
+                                                    (uint64_t) INT32_MAX) : 0;
+}
+
+/*!
+ * @brief Arm the timer for the next work due, when run from the event loop
+ *
+ * @return None
+ * */
+void DnsCache::armTimer(void)
+{
+    int32_t delayMs;
+
+    if (!isMonitored)
+    {
+        return;
+    }
+
+    delayMs = getNextTimeoutMs();
+    le_timer_Stop(timer);
+
+    if (delayMs >= 0)
+    {
+        le_timer_SetMsInterval(timer, (delayMs > 0) ? delayMs : 1);
+        le_timer_Start(timer);
+    }
+}
+
+/*!
+ * @brief Handler of the server sockets when monitored by the Legato event
+ * loop
+ *
+ * @param[in] fd        File descriptor of the socket
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void DnsCache::fdHandler(int fd, short events)
+{
+    DnsCache* cachePtr = (DnsCache*) le_fdMonitor_GetContextPtr();
+
+    for (uint8_t i = 0; i < cachePtr->serverNb; i++)
+    {
+        if (cachePtr->servers[i].fd == fd)
+        {
+            cachePtr->receive(i);
+            break;
+        }
+    }
+
+    cachePtr->armTimer();
+}
+
+/*!
+ * @brief Handler of the timer of the queries and refreshes
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void DnsCache::timerHandler(le_timer_Ref_t timerRef)
+{
+    DnsCache* cachePtr = (DnsCache*) le_timer_GetContextPtr(timerRef);
+
+    cachePtr->runDue();
+    cachePtr->armTimer();
+}
+
+/*!
+ * @brief Keep a name resolved: it is resolved now, and refreshed before it
+ * expires
+ *
+ * @param[in] name  Host name
+ *
+ * @return None
+ * */
+void DnsCache::prefetch(const std::string& name)
+{
+    Entry& entry = addEntry(getKey(name));
+
+    entry.isPrefetched = true;
+
+    if (!entry.hasAnswer)
+    {
+        entry.refreshMs = 0;
+    }
+
+    runDue();
+    armTimer();
+}
+
+/*!
+ * @brief Look a name up in the cache, without waiting. An expired entry is
+ * still returned for a while, and refreshed. A missing name is queried, so
+ * that it is cached for the next lookups.
+ *
+ * @param[in] name              Host name
+ * @param[out] addressesPtr     IPv4 addresses of the name
+ *
+ * @return True if the cache knows addresses of the name
+ * */
+bool DnsCache::lookup(const std::string& name,
+                        std::vector<std::string>* addressesPtr)
+{
+    std::string key = getKey(name);
+    Entry* entryPtr = findEntry(key);
+    uint64_t nowMs = getNowMs();
+
+    lookupNb++;
+
+    if ((entryPtr != NULL) && entryPtr->hasAnswer &&
+        (nowMs < entryPtr->staleMs))
+    {
+        entryPtr->lastUsedMs = nowMs;
+
+        if (nowMs < entryPtr->expiresMs)
+        {
+            freshHitNb++;
+
+            /* Used near its expiry, it is likely to be used again */
+            if (nowMs >= entryPtr->refreshMs)
+            {
+                startQuery(key);
+            }
+        }
+        else
+        {
+            staleHitNb++;
+            startQuery(key);
+        }
+
+        if (addressesPtr != NULL)
+        {
+            *addressesPtr = entryPtr->addresses;
+        }
+
+        return !entryPtr->addresses.empty();
+    }
+
+    missNb++;
+    startQuery(key);
+
+    return false;
+}
+
+/*!
+ * @brief Resolve a name, from the cache or waiting for the servers
+ *
+ * @param[in] name              Host name
+ * @param[in] timeoutMs         Time given to the servers to answer
+ * @param[out] addressesPtr     IPv4 addresses of the name
+ *
+ * @return True if addresses of the name were found
+ * */
+bool DnsCache::resolve(const std::string& name, uint32_t timeoutMs,
+                        std::vector<std::string>* addressesPtr)
+{
+    std::string key = getKey(name);
+    uint64_t startMs = getNowMs();
+    bool status = lookup(name, addressesPtr);
+
+    /* Not cached: wait for the query started by the lookup */
+    while (!status && (findQuery(key) != NULL) &&
+           ((getNowMs() - startMs) < timeoutMs))
+    {
+        Entry* entryPtr;
+
+        process(timeoutMs - (getNowMs() - startMs));
+
+        entryPtr = findEntry(key);
+
+        if ((entryPtr != NULL) && entryPtr->hasAnswer &&
+            (entryPtr->expiresMs > startMs))
+        {
+            status = !entryPtr->addresses.empty();
+
+            if (addressesPtr != NULL)
+            {
+                *addressesPtr = entryPtr->addresses;
+            }
+            break;
+        }
+    }
+
+    uint32_t resolveMs = getNowMs() - startMs;
+
+    resolveNb++;
+    totalResolveMs += resolveMs;
+    maxResolveMs = std::max(maxResolveMs, resolveMs);
+
+    return status;
+}
+
+/*!
+ * @brief Wait for the answers of the servers and run the work due, when not
+ * run from the event loop
+ *
+ * @param[in] waitMs    Longest time to wait for an answer
+ *
+ * @return None
+ * */
+void DnsCache::process(uint32_t waitMs)
+{
+    struct pollfd pfds[DNS_MAX_SERVERS];
+    int32_t nextTimeoutMs = getNextTimeoutMs();
+
+    for (uint8_t i = 0; i < serverNb; i++)
+    {
+        pfds[i].fd = servers[i].fd;
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+    }
+
+    if ((nextTimeoutMs >= 0) && ((uint32_t) nextTimeoutMs < waitMs))
+    {
+        waitMs = nextTimeoutMs;
+    }
+
+    if ((poll(pfds, serverNb, waitMs) < 0) && (errno != EINTR))
+    {
+        LE_ERROR("Couldn't wait for the DNS servers: %m");
+    }
+
+    for (uint8_t i = 0; i < serverNb; i++)
+    {
+        if (pfds[i].revents != 0)
+        {
+            receive(i);
+        }
+    }
+
+    runDue();
+    armTimer();
+}
+
+/*!
+ * @brief Drop the cached answers. The prefetched names are resolved again.
+ *
+ * @return None
+ * */
+void DnsCache::flush(void)
+{
+    std::unordered_map<std::string, Entry>::iterator it = entries.begin();
+
+    while (it != entries.end())
+    {
+        if (it->second.isPrefetched)
+        {
+            it->second.hasAnswer = false;
+            it->second.refreshMs = 0;
+            it++;
+        }
+        else
+        {
+            it = entries.erase(it);
+        }
+    }
+
+    runDue();
+    armTimer();
+}
+
+/*!
+ * @brief Log the statistics of the cache
+ *
+ * @return None
+ * */
+void DnsCache::logStats(void) const
+{
+    uint32_t hitNb = freshHitNb + staleHitNb;
+    uint32_t answerNb = queryNb - failureNb;
+
+    LE_INFO("DNS cache: %u lookups, %u%% hits (%u fresh, %u stale), %u "
+            "misses, %u names, %u evicted", lookupNb,
+            (lookupNb > 0) ? (hitNb * 100 / lookupNb) : 0, freshHitNb,
+            staleHitNb, missNb, (uint32_t) entries.size(), evictionNb);
+    LE_INFO("DNS queries: %u sent, %u failed, latency average %llu ms max %u "
+            "ms, first answers %u/%u", queryNb, failureNb,
+            (unsigned long long) ((answerNb > 0) ?
+                                        (totalQueryMs / answerNb) : 0),
+            maxQueryMs, servers[0].firstNb, servers[1].firstNb);
+    LE_INFO("DNS resolves: %u, latency average %llu ms max %u ms", resolveNb,
+            (unsigned long long) ((resolveNb > 0) ?
+                                        (totalResolveMs / resolveNb) : 0),
+            maxResolveMs);
+}
+
+/*** end of file ***/
@@ -0,0 +1,121 @@
+/** @file DnsCache.h
+ *
+ * @brief This class resolves host names with a cache honoring the TTLs,
+ * querying the DNS servers of the bearer in parallel
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DNS_CACHE_H
+#define DNS_CACHE_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/DnsCacheUtils.h"
+#include <sys/socket.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class DnsCache
+{
+    private:
+        /* Answer kept for a name */
+        struct Entry
+        {
+            bool hasAnswer;
+            bool isPrefetched;
+            std::vector<std::string> addresses;
+            uint32_t ttlMs;
+            /* Fresh until expiresMs, then served stale until staleMs */
+            uint64_t expiresMs;
+            uint64_t staleMs;
+            /* When a prefetched name is resolved again */
+            uint64_t refreshMs;
+            uint64_t lastUsedMs;
+        };
+
+        /* Query in progress, sent to all the servers */
+        struct Query
+        {
+            bool isUsed;
+            std::string name;
+            uint16_t id;
+            uint8_t failedMask;
+            uint64_t startMs;
+            uint64_t lastSentMs;
+        };
+
+        struct Server
+        {
+            struct sockaddr_storage addr;
+            socklen_t addrLen;
+            int fd;
+            le_fdMonitor_Ref_t fdMonitorRef;
+            /* Queries this server answered first */
+            uint32_t firstNb;
+        };
+
+        std::unordered_map<std::string, Entry> entries;
+        Query queries[DnsCacheConstants::DNS_MAX_QUERIES];
+        Server servers[DnsCacheConstants::DNS_MAX_SERVERS];
+        uint8_t serverNb;
+        bool isMonitored;
+        le_timer_Ref_t timer;
+        uint16_t nextId;
+        uint32_t lookupNb;
+        uint32_t freshHitNb;
+        uint32_t staleHitNb;
+        uint32_t missNb;
+        uint32_t queryNb;
+        uint32_t failureNb;
+        uint32_t evictionNb;
+        uint64_t totalQueryMs;
+        uint32_t maxQueryMs;
+        uint32_t resolveNb;
+        uint64_t totalResolveMs;
+        uint32_t maxResolveMs;
+
+        static uint64_t getNowMs(void);
+        static void fdHandler(int fd, short events);
+        static void timerHandler(le_timer_Ref_t timerRef);
+        static int32_t skipName(const uint8_t* message, uint16_t len,
+                                uint16_t offset);
+        static bool isSameName(const uint8_t* message, uint16_t len,
+                                const std::string& name);
+        void closeServers(void);
+        Entry* findEntry(const std::string& name);
+        Entry& addEntry(const std::string& name);
+        Query* findQuery(const std::string& name);
+        bool startQuery(const std::string& name);
+        void sendQuery(Query& query, uint64_t nowMs);
+        void receive(uint8_t serverIndex);
+        void parseAnswer(uint8_t serverIndex, const uint8_t* message,
+                            uint16_t len);
+        void completeQuery(Query& query, uint8_t serverIndex,
+                            const std::vector<std::string>& addresses,
+                            uint32_t ttlS);
+        void failQuery(Query& query);
+        void runDue(void);
+        int32_t getNextTimeoutMs(void) const;
+        void armTimer(void);
+
+    public:
+        DnsCache(void);
+        ~DnsCache(void);
+        bool setServers(const std::vector<std::string>& addresses);
+        void monitor(void);
+        void prefetch(const std::string& name);
+        bool lookup(const std::string& name,
+                    std::vector<std::string>* addressesPtr);
+        bool resolve(const std::string& name, uint32_t timeoutMs,
+                        std::vector<std::string>* addressesPtr);
+        void process(uint32_t waitMs);
+        void flush(void);
+        void logStats(void) const;
+};
+
+#endif /* DNS_CACHE_H */
+
+/*** end of file ***/
@@ -0,0 +1,62 @@
+/** @file DnsCacheUtils.h
+ *
+ * @brief This file provides the constants of the caching DNS resolver
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DNS_CACHE_UTILS_H
+#define DNS_CACHE_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace DnsCacheConstants
+{
+    /* Servers queried in parallel, the first answer is used */
+    const uint8_t DNS_MAX_SERVERS = 2;
+
+    /* Port of the servers, unless another one is given with their address */
+    const uint16_t DNS_PORT = 53;
+
+    /* A query is sent again to all the servers after this delay without an
+     * answer, and fails after the timeout */
+    const uint32_t DNS_RESEND_MS = 1000;
+    const uint32_t DNS_TIMEOUT_MS = 5000;
+
+    /* Queries in progress at the same time */
+    const uint8_t DNS_MAX_QUERIES = 8;
+
+    /* Names kept, the least recently used one is dropped when it is full */
+    const uint16_t DNS_MAX_ENTRIES = 64;
+
+    /* Bounds of the TTL given by the servers, and TTL of a name which
+     * doesn't exist */
+    const uint32_t DNS_MIN_TTL_S = 30;
+    const uint32_t DNS_MAX_TTL_S = 86400;
+    const uint32_t DNS_NEGATIVE_TTL_S = 60;
+
+    /* An expired entry is still used for this long while it is refreshed,
+     * so that a slow or failing server doesn't delay the uploads (RFC 8767
+     * serve-stale) */
+    const uint32_t DNS_STALE_MS = 24 * 3600 * 1000;
+
+    /* An entry used, or prefetched, during the last part of its TTL is
+     * refreshed before it expires */
+    const uint8_t DNS_PREFETCH_PERCENT = 10;
+
+    /* Wait before resolving a prefetched name again after a failure */
+    const uint32_t DNS_RETRY_MS = 10000;
+
+    /* Size of a DNS message over UDP, without EDNS */
+    const uint16_t DNS_MESSAGE_SIZE = 512;
+
+    /* Longest name, and addresses kept per name */
+    const uint16_t DNS_MAX_NAME_SIZE = 253;
+    const uint8_t DNS_MAX_ADDRESSES = 4;
+}
+
+#endif /* DNS_CACHE_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,385 @@
+/** @file FirewallManager.cpp
+ *
+ * @brief This class keeps the wanted firewall rules in memory and applies
+ * only their changes, in a single iptables-restore batch
+ *
+ * The rules of each built-in chain of the filter table are kept in a chain
+ * named after the owner of the manager, jumped to from the built-in chain,
+ * so that several processes manage their rules without touching the others.
+ * The first batch flushes these chains and adds all the rules, the next ones
+ * only delete and add what changed since the last batch applied. Nothing is
+ * run when nothing changed. The rules are indexed by their text, they must
+ * be written the same way to be recognized.
+ *
+ * iptables-restore commits the whole batch of the table at once, or nothing.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/FirewallManager.h"
+#include "Utils/SystemUtils.h"
+#include <time.h>
+
+using namespace FirewallManagerConstants;
+using namespace std;
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Constructor for FirewallManager
+ *
+ * @param[in] ownerName     Name of the owner of the rules, prefixing its
+ *                          chains
+ * */
+FirewallManager::FirewallManager(const string& ownerName) : owner(ownerName),
+                                            isSynced(false), isModified(false),
+                                            applyNb(0), unchangedNb(0),
+                                            resyncNb(0), failureNb(0),
+                                            addedNb(0), removedNb(0),
+                                            lastApplyMs(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for FirewallManager
+ * */
+FirewallManager::~FirewallManager(void)
+{
+
+}
+
+/*!
+ * @brief Get the name of the chain holding the rules of a built-in chain
+ *
+ * @param[in] chainName     Built-in chain
+ *
+ * @return Name of the chain of the owner
+ * */
+string FirewallManager::getOwnChain(const string& chainName) const
+{
+    return (owner + "_" + chainName).substr(0, FIREWALL_MAX_CHAIN_NAME);
+}
+
+/*!
+ * @brief Check if a built-in chain already jumps to the chain of the owner
+ *
+ * @param[in] chainName     Built-in chain
+ *
+ * @return True if the jump is present
+ * */
+bool FirewallManager::isJumpPresent(const string& chainName) const
+{
+    return SystemUtils::GetCommandExecutor().run({FIREWALL_CHECK_CMD, "-C",
+                                                    chainName, "-j",
+                                                    getOwnChain(chainName)},
+                                                    FIREWALL_TIMEOUT_MS, NULL);
+}
+
+/*!
+ * @brief Set the policy of a built-in chain
+ *
+ * @param[in] chainName     Built-in chain of the filter table
+ * @param[in] policy        ACCEPT or DROP
+ *
+ * @return None
+ * */
+void FirewallManager::setPolicy(const string& chainName, const string& policy)
+{
+    Chain& chain = chains[chainName];
+
+    if (chain.policy != policy)
+    {
+        chain.policy = policy;
+        isModified = true;
+    }
+}
+
+/*!
+ * @brief Add a rule at the end of a chain. A rule already present is not
+ * added again.
+ *
+ * @param[in] chainName     Built-in chain of the filter table
+ * @param[in] rule          Rule, as given to iptables -A after the chain
+ *
+ * @return None
+ * */
+void FirewallManager::addRule(const string& chainName, const string& rule)
+{
+    Chain& chain = chains[chainName];
+
+    if (chain.ruleIndex.count(rule) != 0)
+    {
+        return;
+    }
+
+    chain.ruleIndex[rule] = chain.rules.insert(chain.rules.end(), rule);
+    isModified = true;
+}
+
+/*!
+ * @brief Remove a rule from a chain
+ *
+ * @param[in] chainName     Built-in chain of the filter table
+ * @param[in] rule          Rule, as given to addRule()
+ *
+ * @return None
+ * */
+void FirewallManager::removeRule(const string& chainName, const string& rule)
+{
+    map<string, Chain>::iterator chainIt = chains.find(chainName);
+
+    if (chainIt == chains.end())
+    {
+        return;
+    }
+
+    Chain& chain = chainIt->second;
+    unordered_map<string, list<string>::iterator>::iterator ruleIt =
+                                                    chain.ruleIndex.find(rule);
+
+    if (ruleIt != chain.ruleIndex.end())
+    {
+        chain.rules.erase(ruleIt->second);
+        chain.ruleIndex.erase(ruleIt);
+        isModified = true;
+    }
+}
+
+/*!
+ * @brief Check if a rule is wanted
+ *
+ * @param[in] chainName     Built-in chain of the filter table
+ * @param[in] rule          Rule, as given to addRule()
+ *
+ * @return True if the rule was added and not removed
+ * */
+bool FirewallManager::hasRule(const string& chainName,
+                                const string& rule) const
+{
+    map<string, Chain>::const_iterator chainIt = chains.find(chainName);
+
+    return (chainIt != chains.end()) &&
+            (chainIt->second.ruleIndex.count(rule) != 0);
+}
+
+/*!
+ * @brief Build the iptables-restore batch turning the applied rules into the
+ * wanted ones
+ *
+ * @param[out] addedNbPtr   Number of rules added by the batch
+ * @param[out] removedNbPtr Number of rules deleted by the batch
+ *
+ * @return Batch
+ * */
+string FirewallManager::buildBatch(uint32_t* addedNbPtr,
+                                    uint32_t* removedNbPtr) const
+{
+    string batch = "*filter\n";
+    string rules;
+
+    *addedNbPtr = 0;
+    *removedNbPtr = 0;
+
+    for (map<string, Chain>::const_iterator chainIt = chains.begin();
+         chainIt != chains.end(); chainIt++)
+    {
+        const string& chainName = chainIt->first;
+        const Chain& chain = chainIt->second;
+        string ownChain = getOwnChain(chainName);
+
+        if (!chain.policy.empty() &&
+            (!isSynced || (chain.policy != chain.appliedPolicy)))
+        {
+            batch += ":" + chainName + " " + chain.policy + " [0:0]\n";
+        }
+
+        if (chain.rules.empty() && chain.appliedRules.empty())
+        {
+            continue;
+        }
+
+        if (!isSynced || chain.appliedRules.empty())
+        {
+            /* Declaring the chain creates it, or flushes it if it remains
+             * from a previous run */
+            batch += ":" + ownChain + " - [0:0]\n";
+
+            if (!isJumpPresent(chainName))
+            {
+                rules += "-I " + chainName + " 1 -j " + ownChain + "\n";
+            }
+        }
+        else
+        {
+            for (unordered_set<string>::const_iterator ruleIt =
+                                                chain.appliedRules.begin();
+                 ruleIt != chain.appliedRules.end(); ruleIt++)
+            {
+                if (chain.ruleIndex.count(*ruleIt) == 0)
+                {
+                    rules += "-D " + ownChain + " " + *ruleIt + "\n";
+                    (*removedNbPtr)++;
+                }
+            }
+        }
+
+        for (list<string>::const_iterator ruleIt = chain.rules.begin();
+             ruleIt != chain.rules.end(); ruleIt++)
+        {
+            if (!isSynced || (chain.appliedRules.count(*ruleIt) == 0))
+            {
+                rules += "-A " + ownChain + " " + *ruleIt + "\n";
+                (*addedNbPtr)++;
+            }
+        }
+    }
+
+    return batch + rules + "COMMIT\n";
+}
+
+/*!
+ * @brief Apply a batch with iptables-restore
+ *
+ * @param[in] batch     Batch
+ *
+ * @return Status of the operation
+ * */
+bool FirewallManager::runBatch(const string& batch)
+{
+    char path[sizeof(FIREWALL_BATCH_TEMPLATE)];
+    bool status;
+
+    memcpy(path, FIREWALL_BATCH_TEMPLATE, sizeof(path));
+
+    int fd = mkstemp(path);
+
+    if (fd < 0)
+    {
+        LE_ERROR("Couldn't create the firewall batch: %m");
+        return false;
+    }
+
+    status = (write(fd, batch.c_str(), batch.size()) ==
+                                                    (ssize_t) batch.size());
+    ::close(fd);
+
+    if (!status)
+    {
+        LE_ERROR("Couldn't write the firewall batch: %m");
+    }
+    else
+    {
+        CommandExecutorTypes::CommandResult result;
+
+        /* The rules of the other owners are kept */
+        status = SystemUtils::GetCommandExecutor().run({FIREWALL_RESTORE_CMD,
+                                                        "--noflush", path},
+                                                        FIREWALL_TIMEOUT_MS,
+                                                        &result);
+
+        if (!status)
+        {
+            LE_ERROR("Firewall batch refused: %s\n%s", result.errors.c_str(),
+                        batch.c_str());
+        }
+    }
+
+    unlink(path);
+
+    return status;
+}
+
+/*!
+ * @brief Apply the changes of the wanted rules since the last call. Nothing
+ * is run if nothing changed.
+ *
+ * @return Status of the operation
+ * */
+bool FirewallManager::apply(void)
+{
+    uint32_t batchAddedNb = 0;
+    uint32_t batchRemovedNb = 0;
+
+    if (isSynced && !isModified)
+    {
+        unchangedNb++;
+        return true;
+    }
+
+    uint64_t startMs = getNowMs();
+
+    applyNb++;
+    resyncNb += isSynced ? 0 : 1;
+
+    if (!runBatch(buildBatch(&batchAddedNb, &batchRemovedNb)))
+    {
+        /* The rules in place are not known anymore */
+        failureNb++;
+        isSynced = false;
+        lastApplyMs = getNowMs() - startMs;
+        return false;
+    }
+
+    for (map<string, Chain>::iterator chainIt = chains.begin();
+         chainIt != chains.end(); chainIt++)
+    {
+        Chain& chain = chainIt->second;
+
+        chain.appliedPolicy = chain.policy;
+        chain.appliedRules.clear();
+        chain.appliedRules.insert(chain.rules.begin(), chain.rules.end());
+    }
+
+    isSynced = true;
+    isModified = false;
+    addedNb += batchAddedNb;
+    removedNb += batchRemovedNb;
+    lastApplyMs = getNowMs() - startMs;
+
+    LE_INFO("Firewall of %s applied in %u ms: %u rules added, %u deleted",
+            owner.c_str(), lastApplyMs, batchAddedNb, batchRemovedNb);
+
+    return true;
+}
+
+/*!
+ * @brief Forget what was applied, when the rules were changed by someone
+ * else: the next call to apply() sets all of them again
+ *
+ * @return None
+ * */
+void FirewallManager::invalidate(void)
+{
+    isSynced = false;
+}
+
+/*!
+ * @brief Log the statistics of the firewall
+ *
+ * @return None
+ * */
+void FirewallManager::logStats(void) const
+{
+    LE_INFO("Firewall of %s: %u batches (%u full), %u failed, %u calls "
+            "without change, %u rules added, %u deleted, last in %u ms",
+            owner.c_str(), applyNb, resyncNb, failureNb, unchangedNb, addedNb,
+            removedNb, lastApplyMs);
+}
+
+/*** end of file ***/
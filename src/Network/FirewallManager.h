@@ -0,0 +1,71 @@
+/** @file FirewallManager.h
+ *
+ * @brief This class keeps the wanted firewall rules in memory and applies
+ * only their changes, in a single iptables-restore batch
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef FIREWALL_MANAGER_H
+#define FIREWALL_MANAGER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/FirewallManagerUtils.h"
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+class FirewallManager
+{
+    private:
+        /* Rules of a built-in chain of the filter table, kept in a chain of
+         * their own jumped to from the built-in one */
+        struct Chain
+        {
+            std::string policy;
+            std::string appliedPolicy;
+            std::list<std::string> rules;
+            std::unordered_map<std::string,
+                                std::list<std::string>::iterator> ruleIndex;
+            std::unordered_set<std::string> appliedRules;
+        };
+
+        std::string owner;
+        std::map<std::string, Chain> chains;
+        bool isSynced;
+        bool isModified;
+        uint32_t applyNb;
+        uint32_t unchangedNb;
+        uint32_t resyncNb;
+        uint32_t failureNb;
+        uint32_t addedNb;
+        uint32_t removedNb;
+        uint32_t lastApplyMs;
+
+        std::string getOwnChain(const std::string& chainName) const;
+        bool isJumpPresent(const std::string& chainName) const;
+        std::string buildBatch(uint32_t* addedNbPtr,
+                                uint32_t* removedNbPtr) const;
+        bool runBatch(const std::string& batch);
+
+    public:
+        FirewallManager(const std::string& ownerName);
+        ~FirewallManager(void);
+        void setPolicy(const std::string& chainName,
+                        const std::string& policy);
+        void addRule(const std::string& chainName, const std::string& rule);
+        void removeRule(const std::string& chainName,
+                        const std::string& rule);
+        bool hasRule(const std::string& chainName,
+                        const std::string& rule) const;
+        bool apply(void);
+        void invalidate(void);
+        void logStats(void) const;
+};
+
+#endif /* FIREWALL_MANAGER_H */
+
+/*** end of file ***/
@@ -0,0 +1,35 @@
+/** @file FirewallManagerUtils.h
+ *
+ * @brief This file provides the constants of the management of the firewall
+ * rules
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef FIREWALL_MANAGER_UTILS_H
+#define FIREWALL_MANAGER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <iostream>
+
+namespace FirewallManagerConstants
+{
+    /* Tools applying the rules */
+    const std::string FIREWALL_RESTORE_CMD = "iptables-restore";
+    const std::string FIREWALL_CHECK_CMD = "iptables";
+
+    /* Where the batch is written before being applied */
+    const char FIREWALL_BATCH_TEMPLATE[] = "/tmp/firewallXXXXXX";
+
+    /* Time given to the tools before they are killed */
+    const uint32_t FIREWALL_TIMEOUT_MS = 10000;
+
+    /* Longest name of an iptables chain */
+    const uint8_t FIREWALL_MAX_CHAIN_NAME = 28;
+}
+
+#endif /* FIREWALL_MANAGER_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,370 @@
+/** @file LinkLivenessTracker.cpp
+ *
+ * @brief This class tracks the liveness of the uplink from the traffic, and
+ * only probes it when it is idle
+ *
+ * The traffic already tells whether the link works. The tracker learns it
+ * from the modem bearer counters, which count the traffic of every app, and
+ * from the VPN tunnel: bytes received, or the tunnel coming up or answering,
+ * prove the link alive. Bytes sent without any received, or the tunnel going
+ * down, make it suspect within seconds, and active probes then confirm the
+ * failure before the link is declared down. The probes are only sent on
+ * their own when nothing proved the link alive for LIVENESS_IDLE_PROBE_MS.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/LinkLivenessTracker.h"
+#include <time.h>
+
+using namespace ConnectivityProberConstants;
+using namespace LinkLivenessConstants;
+using namespace LinkLivenessTypes;
+
+/*!
+ * @brief Constructor for LinkLivenessTracker
+ *
+ * @param[in] linkProber    Prober used for the active probes
+ * */
+LinkLivenessTracker::LinkLivenessTracker(ConnectivityProber& linkProber) :
+                                prober(linkProber), tickTimer(NULL),
+                                isStarted(false), state(LINK_UNKNOWN),
+                                handler(NULL), contextPtr(NULL),
+                                lastAliveMs(0), suspectMs(0),
+                                isBearerSampled(false), rxBytesNb(0),
+                                txBytesNb(0), rxStallMs(0), probeFailureNb(0),
+                                probeNb(0), idleProbeNb(0), suspectNb(0),
+                                downNb(0), lastConfirmMs(0)
+{
+    memset(evidenceNb, 0, sizeof(evidenceNb));
+}
+
+/*!
+ * @brief Destructor for LinkLivenessTracker
+ * */
+LinkLivenessTracker::~LinkLivenessTracker(void)
+{
+    stop();
+
+    if (tickTimer != NULL)
+    {
+        le_timer_Delete(tickTimer);
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t LinkLivenessTracker::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Start tracking the link, once it is up
+ *
+ * @param[in] stateHandler      Called when the link becomes alive, or is
+ *                              confirmed down
+ * @param[in] stateContextPtr   Context given to the handler
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::start(LinkStateHandler stateHandler,
+                                void* stateContextPtr)
+{
+    if (tickTimer == NULL)
+    {
+        tickTimer = le_timer_Create("LinkLivenessTimer");
+        le_timer_SetRepeat(tickTimer, 0);
+        le_timer_SetMsInterval(tickTimer, LIVENESS_TICK_MS);
+        le_timer_SetHandler(tickTimer, tickHandler);
+        le_timer_SetContextPtr(tickTimer, this);
+    }
+
+    handler = stateHandler;
+    contextPtr = stateContextPtr;
+    state = LINK_UNKNOWN;
+    lastAliveMs = getNowMs();
+    isBearerSampled = false;
+    rxStallMs = 0;
+    probeFailureNb = 0;
+    isStarted = true;
+
+    le_timer_Start(tickTimer);
+}
+
+/*!
+ * @brief Stop tracking the link. A probe in progress is cancelled.
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::stop(void)
+{
+    if (!isStarted)
+    {
+        return;
+    }
+
+    isStarted = false;
+    le_timer_Stop(tickTimer);
+    prober.cancel();
+}
+
+/*!
+ * @brief Change the state of the link, and notify the handler when it
+ * becomes alive or is confirmed down
+ *
+ * @param[in] newState  New state
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::setState(LinkState newState)
+{
+    if (newState == state)
+    {
+        return;
+    }
+
+    state = newState;
+
+    if ((handler != NULL) &&
+        ((newState == LINK_ALIVE) || (newState == LINK_DOWN)))
+    {
+        handler(newState, contextPtr);
+    }
+}
+
+/*!
+ * @brief Record an evidence that the link works
+ *
+ * @param[in] evidence  Source of the evidence
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::markAlive(LivenessEvidence evidence)
+{
+    evidenceNb[evidence]++;
+    lastAliveMs = getNowMs();
+    probeFailureNb = 0;
+
+    setState(LINK_ALIVE);
+}
+
+/*!
+ * @brief Suspect the link of failing and probe it at once to confirm
+ *
+ * @param[in] reason    Why the link is suspected, for the logs
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::markSuspect(const char* reason)
+{
+    if ((state == LINK_SUSPECT) || (state == LINK_DOWN))
+    {
+        return;
+    }
+
+    LE_WARN("Link suspected: %s", reason);
+
+    suspectNb++;
+    suspectMs = getNowMs();
+    probeFailureNb = 0;
+
+    setState(LINK_SUSPECT);
+
+    /* A probe already in progress confirms as well */
+    if (!prober.isProbing())
+    {
+        startProbe();
+    }
+}
+
+/*!
+ * @brief Compare the bearer counters with their last sample: received bytes
+ * prove the link alive, sent bytes left without answer make it suspect
+ *
+ * @param[in] nowMs     Current time
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::sampleBearer(uint64_t nowMs)
+{
+    uint64_t rxNb = 0;
+    uint64_t txNb = 0;
+
+    if (le_mdc_GetBytesCounters(&rxNb, &txNb) != LE_OK)
+    {
+        return;
+    }
+
+    /* The counters are reset when a session starts */
+    if (!isBearerSampled || (rxNb < rxBytesNb) || (txNb < txBytesNb))
+    {
+        isBearerSampled = true;
+        rxStallMs = 0;
+    }
+    else if (rxNb > rxBytesNb)
+    {
+        rxStallMs = 0;
+        markAlive(EVIDENCE_BEARER);
+    }
+    else if ((txNb > txBytesNb) && (rxStallMs == 0))
+    {
+        rxStallMs = nowMs;
+    }
+
+    rxBytesNb = rxNb;
+    txBytesNb = txNb;
+
+    if ((rxStallMs != 0) && ((nowMs - rxStallMs) >= LIVENESS_RX_STALL_MS))
+    {
+        markSuspect("bytes sent without answer");
+    }
+}
+
+/*!
+ * @brief Start an active probe round
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::startProbe(void)
+{
+    if (prober.start(onProbeDone, this))
+    {
+        probeNb++;
+    }
+}
+
+/*!
+ * @brief Handler of the end of a probe round
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    LinkLivenessTracker instance
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::onProbeDone(bool isReachable, uint32_t rttMs,
+                                        void* contextPtr)
+{
+    LinkLivenessTracker* trackerPtr = (LinkLivenessTracker*) contextPtr;
+
+    if (!trackerPtr->isStarted)
+    {
+        return;
+    }
+
+    if (isReachable)
+    {
+        LE_DEBUG("Link probe answered in %u ms", rttMs);
+        trackerPtr->markAlive(EVIDENCE_PROBE);
+        return;
+    }
+
+    trackerPtr->markSuspect("probe failed");
+    trackerPtr->probeFailureNb++;
+
+    if ((trackerPtr->state == LINK_SUSPECT) &&
+        (trackerPtr->probeFailureNb >= LIVENESS_CONFIRM_ROUNDS))
+    {
+        trackerPtr->lastConfirmMs = getNowMs() - trackerPtr->suspectMs;
+        trackerPtr->downNb++;
+
+        LE_ERROR("Link down, confirmed in %u ms", trackerPtr->lastConfirmMs);
+
+        trackerPtr->setState(LINK_DOWN);
+    }
+}
+
+/*!
+ * @brief Handler of the tick timer: sample the bearer, confirm a suspected
+ * link and probe an idle one
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::tickHandler(le_timer_Ref_t timerRef)
+{
+    LinkLivenessTracker* trackerPtr =
+                    (LinkLivenessTracker*) le_timer_GetContextPtr(timerRef);
+    uint64_t nowMs = getNowMs();
+
+    trackerPtr->sampleBearer(nowMs);
+
+    if (trackerPtr->prober.isProbing())
+    {
+        return;
+    }
+
+    if (trackerPtr->state == LINK_SUSPECT)
+    {
+        trackerPtr->startProbe();
+    }
+    else if ((trackerPtr->state != LINK_DOWN) &&
+                ((nowMs - trackerPtr->lastAliveMs) >= LIVENESS_IDLE_PROBE_MS))
+    {
+        trackerPtr->idleProbeNb++;
+        trackerPtr->startProbe();
+    }
+}
+
+/*!
+ * @brief Learn from the VPN tunnel: coming up or answering its round trip
+ * measure proves the link alive, going down makes it suspect
+ *
+ * @param[in] isTunnelUp    True if the tunnel is up or answered
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::reportTunnel(bool isTunnelUp)
+{
+    if (!isStarted)
+    {
+        return;
+    }
+
+    if (isTunnelUp)
+    {
+        markAlive(EVIDENCE_TUNNEL);
+    }
+    else
+    {
+        markSuspect("VPN tunnel down");
+    }
+}
+
+/*!
+ * @brief Get what is known about the link
+ *
+ * @return State of the link
+ * */
+LinkState LinkLivenessTracker::getState(void) const
+{
+    return state;
+}
+
+/*!
+ * @brief Log the evidences collected and the probes sent
+ *
+ * @return None
+ * */
+void LinkLivenessTracker::logStats(void) const
+{
+    LE_INFO("Link liveness: state %d, evidences bearer %u tunnel %u probe %u,"
+            " %u probes (%u when idle), %u suspected, %u down (last confirmed"
+            " in %u ms)", state, evidenceNb[EVIDENCE_BEARER],
+            evidenceNb[EVIDENCE_TUNNEL], evidenceNb[EVIDENCE_PROBE], probeNb,
+            idleProbeNb, suspectNb, downNb, lastConfirmMs);
+}
+
+/*** end of file ***/
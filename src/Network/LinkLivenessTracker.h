@@ -0,0 +1,64 @@
+/** @file LinkLivenessTracker.h
+ *
+ * @brief This class tracks the liveness of the uplink from the traffic, and
+ * only probes it when it is idle
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef LINK_LIVENESS_TRACKER_H
+#define LINK_LIVENESS_TRACKER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/ConnectivityProber.h"
+#include "Network/LinkLivenessTrackerUtils.h"
+
+class LinkLivenessTracker
+{
+    private:
+        ConnectivityProber& prober;
+        le_timer_Ref_t tickTimer;
+        bool isStarted;
+        LinkLivenessTypes::LinkState state;
+        LinkLivenessTypes::LinkStateHandler handler;
+        void* contextPtr;
+        uint64_t lastAliveMs;
+        uint64_t suspectMs;
+        bool isBearerSampled;
+        uint64_t rxBytesNb;
+        uint64_t txBytesNb;
+        uint64_t rxStallMs;
+        uint8_t probeFailureNb;
+        uint32_t evidenceNb[LinkLivenessTypes::EVIDENCE_NB];
+        uint32_t probeNb;
+        uint32_t idleProbeNb;
+        uint32_t suspectNb;
+        uint32_t downNb;
+        uint32_t lastConfirmMs;
+
+        static uint64_t getNowMs(void);
+        static void tickHandler(le_timer_Ref_t timerRef);
+        static void onProbeDone(bool isReachable, uint32_t rttMs,
+                                void* contextPtr);
+        void setState(LinkLivenessTypes::LinkState newState);
+        void markAlive(LinkLivenessTypes::LivenessEvidence evidence);
+        void markSuspect(const char* reason);
+        void sampleBearer(uint64_t nowMs);
+        void startProbe(void);
+
+    public:
+        LinkLivenessTracker(ConnectivityProber& linkProber);
+        ~LinkLivenessTracker(void);
+        void start(LinkLivenessTypes::LinkStateHandler stateHandler,
+                    void* stateContextPtr);
+        void stop(void);
+        void reportTunnel(bool isTunnelUp);
+        LinkLivenessTypes::LinkState getState(void) const;
+        void logStats(void) const;
+};
+
+#endif /* LINK_LIVENESS_TRACKER_H */
+
+/*** end of file ***/
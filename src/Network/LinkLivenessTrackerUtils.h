@@ -0,0 +1,66 @@
+/** @file LinkLivenessTrackerUtils.h
+ *
+ * @brief This file provides the types and constants of the tracking of the
+ * liveness of the uplink
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef LINK_LIVENESS_TRACKER_UTILS_H
+#define LINK_LIVENESS_TRACKER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace LinkLivenessTypes
+{
+    /* What is known about the link */
+    enum LinkState
+    {
+        /* Nothing proved the link working since the tracking started */
+        LINK_UNKNOWN,
+        /* Recent traffic or probe answered */
+        LINK_ALIVE,
+        /* Traffic is failing, probes are confirming */
+        LINK_SUSPECT,
+        /* The probes confirmed the failure */
+        LINK_DOWN
+    };
+
+    /* Source of the evidence that the link works */
+    enum LivenessEvidence
+    {
+        /* Bytes received by the modem bearer */
+        EVIDENCE_BEARER,
+        /* VPN tunnel up, or its round trip measure answered */
+        EVIDENCE_TUNNEL,
+        /* Active probe answered */
+        EVIDENCE_PROBE,
+        EVIDENCE_NB
+    };
+
+    /* Called when the link becomes alive, or is confirmed down */
+    typedef void (*LinkStateHandler)(LinkState state, void* contextPtr);
+}
+
+namespace LinkLivenessConstants
+{
+    /* Period of the sampling of the bearer counters */
+    const uint32_t LIVENESS_TICK_MS = 1000;
+
+    /* An active probe is only sent when nothing proved the link working for
+     * this long: no probe data is used while the traffic succeeds */
+    const uint32_t LIVENESS_IDLE_PROBE_MS = 120000;
+
+    /* The link is suspected when the bearer sent bytes without receiving
+     * any for this long */
+    const uint32_t LIVENESS_RX_STALL_MS = 5000;
+
+    /* Probe rounds failed in a row before the link is declared down */
+    const uint8_t LIVENESS_CONFIRM_ROUNDS = 2;
+}
+
+#endif /* LINK_LIVENESS_TRACKER_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,890 @@
+/** @file NetlinkConfigurator.cpp
+ *
+ * @brief This class sets the addresses, routes and link states of the
+ * network interfaces with batches of rtnetlink messages
+ *
+ * The changes are queued, then sent to the kernel at once in a single
+ * datagram, each message being acknowledged with its own status. If one of
+ * them fails, the ones already done are undone in reverse order, so that the
+ * interfaces are left as they were found. Flushing the addresses of an
+ * interface reads them first, so that they can be restored as well.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkConfigurator.h"
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+
+using namespace NetlinkConfiguratorConstants;
+using namespace NetlinkConfiguratorTypes;
+
+/*!
+ * @brief Constructor for NetlinkConfigurator
+ * */
+NetlinkConfigurator::NetlinkConfigurator(void) : netlinkFd(-1), sequence(0),
+                                                isQueueValid(true), applyNb(0),
+                                                failureNb(0), rollbackNb(0),
+                                                messageNb(0), lastApplyUs(0),
+                                                maxApplyUs(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for NetlinkConfigurator
+ * */
+NetlinkConfigurator::~NetlinkConfigurator(void)
+{
+    close();
+}
+
+/*!
+ * @brief Get the monotonic time in microseconds
+ *
+ * @return Number of microseconds since an arbitrary point in the past
+ * */
+uint64_t NetlinkConfigurator::getNowUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*!
+ * @brief Open the rtnetlink socket
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::open(void)
+{
+    struct sockaddr_nl addr;
+
+    if (netlinkFd >= 0)
+    {
+        return true;
+    }
+
+    netlinkFd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+
+    if (netlinkFd < 0)
+    {
+        LE_ERROR("Couldn't open the netlink socket: %m");
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+
+    if (bind(netlinkFd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        LE_ERROR("Couldn't bind the netlink socket: %m");
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Close the rtnetlink socket. The queued changes are dropped.
+ *
+ * @return None
+ * */
+void NetlinkConfigurator::close(void)
+{
+    clear();
+
+    if (netlinkFd >= 0)
+    {
+        ::close(netlinkFd);
+        netlinkFd = -1;
+    }
+}
+
+/*!
+ * @brief Parse an IPv4 or IPv6 address
+ *
+ * @param[in] text          Address in text form
+ * @param[out] addressPtr   Address parsed
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::parseAddress(const char* text,
+                                        IpAddress* addressPtr)
+{
+    memset(addressPtr, 0, sizeof(IpAddress));
+
+    if ((text == NULL) || (text[0] == '\0'))
+    {
+        return false;
+    }
+
+    if (inet_pton(AF_INET, text, addressPtr->bytes) == 1)
+    {
+        addressPtr->family = AF_INET;
+    }
+    else if (inet_pton(AF_INET6, text, addressPtr->bytes) == 1)
+    {
+        addressPtr->family = AF_INET6;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Get the name of an operation, for the logs
+ *
+ * @param[in] type  Operation
+ *
+ * @return Name of the operation
+ * */
+const char* NetlinkConfigurator::getOperationName(ConfigOperationType type)
+{
+    switch (type)
+    {
+        case CONFIG_ADD_ADDRESS:        return "add address";
+        case CONFIG_DELETE_ADDRESS:     return "delete address";
+        case CONFIG_FLUSH_ADDRESSES:    return "flush addresses";
+        case CONFIG_SET_LINK:           return "set link";
+        case CONFIG_ADD_ROUTE:          return "add route";
+        case CONFIG_DELETE_ROUTE:       return "delete route";
+        default:                        return "unknown";
+    }
+}
+
+/*!
+ * @brief Queue a change. A change that can't be queued makes the whole
+ * batch fail when applied, without changing anything.
+ *
+ * @param[in] type          Operation
+ * @param[in] ifName        Interface, NULL or empty to let the kernel choose
+ *                          for a route
+ * @param[in,out] operation Parameters of the operation, completed
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::queue(ConfigOperationType type, const char* ifName,
+                                Operation& operation)
+{
+    operation.type = type;
+    operation.ifIndex = 0;
+    operation.ifName[0] = '\0';
+
+    if ((ifName != NULL) && (ifName[0] != '\0'))
+    {
+        snprintf(operation.ifName, sizeof(operation.ifName), "%s", ifName);
+        operation.ifIndex = if_nametoindex(ifName);
+
+        if (operation.ifIndex == 0)
+        {
+            LE_ERROR("Unknown interface %s", ifName);
+            isQueueValid = false;
+            return false;
+        }
+    }
+
+    operations.push_back(operation);
+
+    return true;
+}
+
+/*!
+ * @brief Queue the deletion of all the addresses of an interface
+ *
+ * @param[in] ifName    Interface
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::flushAddresses(const char* ifName)
+{
+    Operation operation;
+
+    memset(&operation, 0, sizeof(operation));
+
+    return queue(CONFIG_FLUSH_ADDRESSES, ifName, operation);
+}
+
+/*!
+ * @brief Queue the addition of an address to an interface
+ *
+ * @param[in] ifName    Interface
+ * @param[in] address   IPv4 or IPv6 address
+ * @param[in] prefixLen Length of the network prefix
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::addAddress(const char* ifName, const char* address,
+                                        uint8_t prefixLen)
+{
+    Operation operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.prefixLen = prefixLen;
+    operation.scope = RT_SCOPE_UNIVERSE;
+
+    if (!parseAddress(address, &operation.address) ||
+        (prefixLen > ((operation.address.family == AF_INET) ? 32 : 128)))
+    {
+        LE_ERROR("Invalid address %s/%u", address, prefixLen);
+        isQueueValid = false;
+        return false;
+    }
+
+    return queue(CONFIG_ADD_ADDRESS, ifName, operation);
+}
+
+/*!
+ * @brief Queue bringing an interface up or down
+ *
+ * @param[in] ifName    Interface
+ * @param[in] isUp      True to bring it up
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::setLinkUp(const char* ifName, bool isUp)
+{
+    Operation operation;
+
+    memset(&operation, 0, sizeof(operation));
+    operation.isUp = isUp;
+
+    return queue(CONFIG_SET_LINK, ifName, operation);
+}
+
+/*!
+ * @brief Queue the addition of a default route
+ *
+ * @param[in] gateway   IPv4 or IPv6 address of the gateway
+ * @param[in] ifName    Interface of the route, NULL or empty to let the
+ *                      kernel find it from the gateway
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::addDefaultRoute(const char* gateway,
+                                            const char* ifName)
+{
+    Operation operation;
+
+    memset(&operation, 0, sizeof(operation));
+
+    if (!parseAddress(gateway, &operation.address))
+    {
+        LE_ERROR("Invalid gateway %s", (gateway != NULL) ? gateway : "");
+        isQueueValid = false;
+        return false;
+    }
+
+    return queue(CONFIG_ADD_ROUTE, ifName, operation);
+}
+
+/*!
+ * @brief Drop the queued changes
+ *
+ * @return None
+ * */
+void NetlinkConfigurator::clear(void)
+{
+    operations.clear();
+    isQueueValid = true;
+}
+
+/*!
+ * @brief Read the current state of a link, to restore it on rollback
+ *
+ * @param[in,out] operation     Link operation
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::readLinkState(Operation& operation)
+{
+    struct ifreq request;
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        LE_ERROR("Couldn't open the socket: %m");
+        return false;
+    }
+
+    memset(&request, 0, sizeof(request));
+    snprintf(request.ifr_name, sizeof(request.ifr_name), "%s",
+                operation.ifName);
+
+    bool status = (ioctl(fd, SIOCGIFFLAGS, &request) == 0);
+
+    if (!status)
+    {
+        LE_ERROR("Couldn't read the state of %s: %m", operation.ifName);
+    }
+
+    operation.wasUp = status && (request.ifr_flags & IFF_UP);
+
+    ::close(fd);
+
+    return status;
+}
+
+/*!
+ * @brief Replace the flush of an interface by the deletion of each of its
+ * current addresses
+ *
+ * @param[in] flush         Flush operation
+ * @param[out] expanded     Deletions appended
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::expandFlush(const Operation& flush,
+                                        std::vector<Operation>& expanded)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct ifaddrmsg message;
+    } request;
+    uint8_t buffer[NETCONF_RECEIVE_SIZE] __attribute__((aligned(4)));
+    uint64_t deadlineUs = getNowUs() + NETCONF_ANSWER_TIMEOUT_MS * 1000;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+    request.header.nlmsg_type = RTM_GETADDR;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++sequence;
+    request.message.ifa_family = AF_UNSPEC;
+    request.message.ifa_index = flush.ifIndex;
+
+    if (::send(netlinkFd, &request, request.header.nlmsg_len, 0) < 0)
+    {
+        LE_ERROR("Couldn't request the addresses: %m");
+        return false;
+    }
+
+    messageNb++;
+
+    while (1)
+    {
+        struct pollfd pfd = {netlinkFd, POLLIN, 0};
+        uint64_t nowUs = getNowUs();
+
+        if ((nowUs >= deadlineUs) ||
+            (poll(&pfd, 1, (deadlineUs - nowUs + 999) / 1000) <= 0))
+        {
+            LE_ERROR("No answer to the address request");
+            return false;
+        }
+
+        ssize_t len = recv(netlinkFd, buffer, sizeof(buffer), 0);
+
+        if (len < 0)
+        {
+            LE_ERROR("Couldn't read the addresses: %m");
+            return false;
+        }
+
+        for (struct nlmsghdr* headerPtr = (struct nlmsghdr*) buffer;
+             NLMSG_OK(headerPtr, (uint32_t) len);
+             headerPtr = NLMSG_NEXT(headerPtr, len))
+        {
+            if (headerPtr->nlmsg_seq != request.header.nlmsg_seq)
+            {
+                continue;
+            }
+
+            if (headerPtr->nlmsg_type == NLMSG_DONE)
+            {
+                return true;
+            }
+
+            if (headerPtr->nlmsg_type == NLMSG_ERROR)
+            {
+                LE_ERROR("Address request refused");
+                return false;
+            }
+
+            if (headerPtr->nlmsg_type != RTM_NEWADDR)
+            {
+                continue;
+            }
+
+            struct ifaddrmsg* infoPtr =
+                                (struct ifaddrmsg*) NLMSG_DATA(headerPtr);
+            int32_t attrLen = IFA_PAYLOAD(headerPtr);
+            const void* addressPtr = NULL;
+
+            /* Older kernels don't filter the dump by interface */
+            if ((int32_t) infoPtr->ifa_index != flush.ifIndex)
+            {
+                continue;
+            }
+
+            for (struct rtattr* attrPtr = IFA_RTA(infoPtr);
+                 RTA_OK(attrPtr, attrLen);
+                 attrPtr = RTA_NEXT(attrPtr, attrLen))
+            {
+                if ((attrPtr->rta_type == IFA_LOCAL) ||
+                    ((attrPtr->rta_type == IFA_ADDRESS) &&
+                        (addressPtr == NULL)))
+                {
+                    addressPtr = RTA_DATA(attrPtr);
+                }
+            }
+
+            if (addressPtr == NULL)
+            {
+                continue;
+            }
+
+            Operation deletion = flush;
+
+            deletion.type = CONFIG_DELETE_ADDRESS;
+            deletion.address.family = infoPtr->ifa_family;
+            memcpy(deletion.address.bytes, addressPtr,
+                    (infoPtr->ifa_family == AF_INET) ? 4 : 16);
+            deletion.prefixLen = infoPtr->ifa_prefixlen;
+            deletion.scope = infoPtr->ifa_scope;
+
+            expanded.push_back(deletion);
+        }
+    }
+}
+
+/*!
+ * @brief Append an attribute to a message
+ *
+ * @param[in,out] headerPtr     Message, of NETCONF_MESSAGE_SIZE bytes
+ * @param[in] type              Type of the attribute
+ * @param[in] data              Value of the attribute
+ * @param[in] len               Size of the value
+ *
+ * @return None
+ * */
+static void addAttribute(struct nlmsghdr* headerPtr, uint16_t type,
+                            const void* data, uint16_t len)
+{
+    struct rtattr* attrPtr = (struct rtattr*) (((uint8_t*) headerPtr) +
+                                        NLMSG_ALIGN(headerPtr->nlmsg_len));
+
+    LE_ASSERT(NLMSG_ALIGN(headerPtr->nlmsg_len) + RTA_SPACE(len) <=
+                NETCONF_MESSAGE_SIZE);
+
+    attrPtr->rta_type = type;
+    attrPtr->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(attrPtr), data, len);
+
+    headerPtr->nlmsg_len = NLMSG_ALIGN(headerPtr->nlmsg_len) + RTA_SPACE(len);
+}
+
+/*!
+ * @brief Append the message of an operation to a batch
+ *
+ * @param[in] operation     Operation
+ * @param[in] seq           Sequence number of the message
+ * @param[in,out] batch     Batch
+ *
+ * @return None
+ * */
+void NetlinkConfigurator::buildMessage(const Operation& operation,
+                                        uint32_t seq,
+                                        std::vector<uint8_t>& batch)
+{
+    uint8_t message[NETCONF_MESSAGE_SIZE] __attribute__((aligned(4)));
+    struct nlmsghdr* headerPtr = (struct nlmsghdr*) message;
+    uint16_t addressLen = (operation.address.family == AF_INET) ? 4 : 16;
+
+    memset(message, 0, sizeof(message));
+    headerPtr->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    headerPtr->nlmsg_seq = seq;
+
+    switch (operation.type)
+    {
+        case CONFIG_ADD_ADDRESS:
+        case CONFIG_DELETE_ADDRESS:
+        {
+            struct ifaddrmsg* infoPtr =
+                                (struct ifaddrmsg*) NLMSG_DATA(headerPtr);
+
+            headerPtr->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+            infoPtr->ifa_family = operation.address.family;
+            infoPtr->ifa_prefixlen = operation.prefixLen;
+            infoPtr->ifa_scope = operation.scope;
+            infoPtr->ifa_index = operation.ifIndex;
+
+            if (operation.type == CONFIG_ADD_ADDRESS)
+            {
+                headerPtr->nlmsg_type = RTM_NEWADDR;
+                headerPtr->nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+            }
+            else
+            {
+                headerPtr->nlmsg_type = RTM_DELADDR;
+            }
+
+            if (operation.address.family == AF_INET)
+            {
+                addAttribute(headerPtr, IFA_LOCAL, operation.address.bytes,
+                                addressLen);
+            }
+
+            addAttribute(headerPtr, IFA_ADDRESS, operation.address.bytes,
+                            addressLen);
+
+            /* Same broadcast address as ifconfig would set */
+            if ((operation.type == CONFIG_ADD_ADDRESS) &&
+                (operation.address.family == AF_INET) &&
+                (operation.prefixLen < 31))
+            {
+                uint32_t broadcast;
+
+                memcpy(&broadcast, operation.address.bytes, 4);
+                broadcast |= htonl(0xFFFFFFFF >> operation.prefixLen);
+                addAttribute(headerPtr, IFA_BROADCAST, &broadcast, 4);
+            }
+            break;
+        }
+
+        case CONFIG_SET_LINK:
+        {
+            struct ifinfomsg* infoPtr =
+                                (struct ifinfomsg*) NLMSG_DATA(headerPtr);
+
+            headerPtr->nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+            headerPtr->nlmsg_type = RTM_NEWLINK;
+            infoPtr->ifi_family = AF_UNSPEC;
+            infoPtr->ifi_index = operation.ifIndex;
+            infoPtr->ifi_flags = operation.isUp ? IFF_UP : 0;
+            infoPtr->ifi_change = IFF_UP;
+            break;
+        }
+
+        case CONFIG_ADD_ROUTE:
+        case CONFIG_DELETE_ROUTE:
+        {
+            struct rtmsg* infoPtr = (struct rtmsg*) NLMSG_DATA(headerPtr);
+
+            headerPtr->nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+            infoPtr->rtm_family = operation.address.family;
+            infoPtr->rtm_table = RT_TABLE_MAIN;
+            infoPtr->rtm_type = RTN_UNICAST;
+
+            if (operation.type == CONFIG_ADD_ROUTE)
+            {
+                /* Like route add: fails only if the same route exists */
+                headerPtr->nlmsg_type = RTM_NEWROUTE;
+                headerPtr->nlmsg_flags |= NLM_F_CREATE;
+                infoPtr->rtm_protocol = RTPROT_BOOT;
+                infoPtr->rtm_scope = RT_SCOPE_UNIVERSE;
+            }
+            else
+            {
+                headerPtr->nlmsg_type = RTM_DELROUTE;
+                infoPtr->rtm_scope = RT_SCOPE_NOWHERE;
+            }
+
+            addAttribute(headerPtr, RTA_GATEWAY, operation.address.bytes,
+                            addressLen);
+
+            if (operation.ifIndex > 0)
+            {
+                addAttribute(headerPtr, RTA_OIF, &operation.ifIndex,
+                                sizeof(operation.ifIndex));
+            }
+            break;
+        }
+
+        default:
+            return;
+    }
+
+    batch.insert(batch.end(), message,
+                    message + NLMSG_ALIGN(headerPtr->nlmsg_len));
+}
+
+/*!
+ * @brief Read the acknowledgements of a batch
+ *
+ * @param[in] firstSeq              Sequence number of the first message
+ * @param[in,out] batchOperations   Operations of the batch, completed with
+ *                                  their status
+ *
+ * @return False if some acknowledgements are missing
+ * */
+bool NetlinkConfigurator::receiveAnswers(uint32_t firstSeq,
+                                    std::vector<Operation>& batchOperations)
+{
+    uint8_t buffer[NETCONF_RECEIVE_SIZE] __attribute__((aligned(4)));
+    uint32_t pendingNb = batchOperations.size();
+    uint64_t deadlineUs = getNowUs() + NETCONF_ANSWER_TIMEOUT_MS * 1000;
+
+    while (pendingNb > 0)
+    {
+        struct pollfd pfd = {netlinkFd, POLLIN, 0};
+        uint64_t nowUs = getNowUs();
+
+        if ((nowUs >= deadlineUs) ||
+            (poll(&pfd, 1, (deadlineUs - nowUs + 999) / 1000) <= 0))
+        {
+            LE_ERROR("%u changes not acknowledged", pendingNb);
+            return false;
+        }
+
+        ssize_t len = recv(netlinkFd, buffer, sizeof(buffer), 0);
+
+        if (len < 0)
+        {
+            LE_ERROR("Couldn't read the acknowledgements: %m");
+            return false;
+        }
+
+        for (struct nlmsghdr* headerPtr = (struct nlmsghdr*) buffer;
+             NLMSG_OK(headerPtr, (uint32_t) len);
+             headerPtr = NLMSG_NEXT(headerPtr, len))
+        {
+            uint32_t index = headerPtr->nlmsg_seq - firstSeq;
+
+            if ((headerPtr->nlmsg_type != NLMSG_ERROR) ||
+                (index >= batchOperations.size()) ||
+                batchOperations[index].isAnswered)
+            {
+                continue;
+            }
+
+            struct nlmsgerr* errorPtr =
+                                (struct nlmsgerr*) NLMSG_DATA(headerPtr);
+
+            batchOperations[index].isAnswered = true;
+            batchOperations[index].error = -errorPtr->error;
+            pendingNb--;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Send operations in a single datagram, and get their status
+ *
+ * @param[in,out] batchOperations   Operations, completed with their status
+ *
+ * @return True if all of them succeeded
+ * */
+bool NetlinkConfigurator::sendBatch(std::vector<Operation>& batchOperations)
+{
+    std::vector<uint8_t> batch;
+    uint32_t firstSeq = sequence + 1;
+    bool status = true;
+
+    if (batchOperations.empty())
+    {
+        return true;
+    }
+
+    for (uint32_t i = 0; i < batchOperations.size(); i++)
+    {
+        batchOperations[i].isAnswered = false;
+        batchOperations[i].isChanged = false;
+        batchOperations[i].error = 0;
+        buildMessage(batchOperations[i], ++sequence, batch);
+    }
+
+    if (::send(netlinkFd, &batch[0], batch.size(), 0) < 0)
+    {
+        LE_ERROR("Couldn't send the changes: %m");
+        return false;
+    }
+
+    messageNb += batchOperations.size();
+    status = receiveAnswers(firstSeq, batchOperations);
+
+    for (uint32_t i = 0; i < batchOperations.size(); i++)
+    {
+        Operation& operation = batchOperations[i];
+
+        /* What is already as wanted is not an error, nor undone */
+        if ((operation.error == EEXIST) &&
+            ((operation.type == CONFIG_ADD_ADDRESS) ||
+                (operation.type == CONFIG_ADD_ROUTE)))
+        {
+            operation.error = 0;
+        }
+        else if ((operation.error == EADDRNOTAVAIL) &&
+                    (operation.type == CONFIG_DELETE_ADDRESS))
+        {
+            /* Secondary addresses go with the primary one */
+            operation.error = 0;
+            operation.isChanged = true;
+        }
+        else if (operation.isAnswered && (operation.error == 0))
+        {
+            operation.isChanged = (operation.type != CONFIG_SET_LINK) ||
+                                    (operation.isUp != operation.wasUp);
+        }
+        else if (operation.isAnswered)
+        {
+            LE_ERROR("Couldn't %s on %s: %s",
+                        getOperationName(operation.type),
+                        (operation.ifName[0] != '\0') ?
+                                                operation.ifName : "default",
+                        strerror(operation.error));
+            status = false;
+        }
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Undo the operations done, in reverse order
+ *
+ * @param[in] batchOperations   Operations of the failed batch
+ *
+ * @return None
+ * */
+void NetlinkConfigurator::rollback(
+                                const std::vector<Operation>& batchOperations)
+{
+    std::vector<Operation> undo;
+
+    for (int32_t i = batchOperations.size() - 1; i >= 0; i--)
+    {
+        Operation operation = batchOperations[i];
+
+        if (!operation.isChanged)
+        {
+            continue;
+        }
+
+        switch (operation.type)
+        {
+            case CONFIG_ADD_ADDRESS:
+                operation.type = CONFIG_DELETE_ADDRESS;
+                break;
+
+            case CONFIG_DELETE_ADDRESS:
+                operation.type = CONFIG_ADD_ADDRESS;
+                break;
+
+            case CONFIG_SET_LINK:
+                operation.isUp = operation.wasUp;
+                break;
+
+            case CONFIG_ADD_ROUTE:
+                operation.type = CONFIG_DELETE_ROUTE;
+                break;
+
+            default:
+                continue;
+        }
+
+        undo.push_back(operation);
+    }
+
+    rollbackNb++;
+
+    if (!sendBatch(undo))
+    {
+        LE_ERROR("Rollback incomplete, the configuration is inconsistent");
+    }
+}
+
+/*!
+ * @brief Apply the queued changes at once. If one of them fails, the others
+ * are undone. The queue is empty afterwards.
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkConfigurator::apply(void)
+{
+    std::vector<Operation> batchOperations;
+    uint64_t startUs = getNowUs();
+    bool status = isQueueValid && (netlinkFd >= 0);
+
+    applyNb++;
+
+    if (!status)
+    {
+        LE_ERROR("Changes not applied: %s", (netlinkFd < 0) ?
+                                        "not open" : "invalid parameters");
+    }
+
+    for (uint32_t i = 0; status && (i < operations.size()); i++)
+    {
+        if (operations[i].type == CONFIG_FLUSH_ADDRESSES)
+        {
+            status = expandFlush(operations[i], batchOperations);
+            continue;
+        }
+
+        if (operations[i].type == CONFIG_SET_LINK)
+        {
+            status = readLinkState(operations[i]);
+        }
+
+        batchOperations.push_back(operations[i]);
+    }
+
+    operations.clear();
+    isQueueValid = true;
+
+    if (!status)
+    {
+        failureNb++;
+        return false;
+    }
+
+    if (!sendBatch(batchOperations))
+    {
+        failureNb++;
+        rollback(batchOperations);
+        status = false;
+    }
+
+    lastApplyUs = getNowUs() - startUs;
+
+    if (lastApplyUs > maxApplyUs)
+    {
+        maxApplyUs = lastApplyUs;
+    }
+
+    LE_DEBUG("%u network changes applied in %u us",
+                (uint32_t) batchOperations.size(),
+                lastApplyUs);
+
+    return status;
+}
+
+/*!
+ * @brief Get the duration of the last batch applied, rollback included
+ *
+ * @return Duration in microseconds
+ * */
+uint32_t NetlinkConfigurator::getLastApplyUs(void) const
+{
+    return lastApplyUs;
+}
+
+/*!
+ * @brief Log the statistics of the configuration
+ *
+ * @return None
+ * */
+void NetlinkConfigurator::logStats(void) const
+{
+    LE_INFO("Netlink configuration: %u batches, %u failed, %u rolled back, "
+            "%u messages, last %u us, max %u us", applyNb, failureNb,
+            rollbackNb, messageNb, lastApplyUs, maxApplyUs);
+}
+
+/*** end of file ***/
@@ -0,0 +1,83 @@
+/** @file NetlinkConfigurator.h
+ *
+ * @brief This class sets the addresses, routes and link states of the
+ * network interfaces with batches of rtnetlink messages
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef NETLINK_CONFIGURATOR_H
+#define NETLINK_CONFIGURATOR_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkConfiguratorUtils.h"
+#include <vector>
+
+class NetlinkConfigurator
+{
+    private:
+        /* Change queued, then its result once applied */
+        struct Operation
+        {
+            NetlinkConfiguratorTypes::ConfigOperationType type;
+            char ifName[IFNAMSIZ];
+            int32_t ifIndex;
+            NetlinkConfiguratorTypes::IpAddress address;
+            uint8_t prefixLen;
+            uint8_t scope;
+            bool isUp;
+            bool wasUp;
+            bool isAnswered;
+            bool isChanged;
+            int32_t error;
+        };
+
+        int32_t netlinkFd;
+        uint32_t sequence;
+        std::vector<Operation> operations;
+        bool isQueueValid;
+        uint32_t applyNb;
+        uint32_t failureNb;
+        uint32_t rollbackNb;
+        uint32_t messageNb;
+        uint32_t lastApplyUs;
+        uint32_t maxApplyUs;
+
+        static uint64_t getNowUs(void);
+        static bool parseAddress(const char* text,
+                            NetlinkConfiguratorTypes::IpAddress* addressPtr);
+        static const char* getOperationName(
+                            NetlinkConfiguratorTypes::ConfigOperationType type);
+        bool queue(NetlinkConfiguratorTypes::ConfigOperationType type,
+                    const char* ifName, Operation& operation);
+        bool readLinkState(Operation& operation);
+        bool expandFlush(const Operation& flush,
+                            std::vector<Operation>& expanded);
+        void buildMessage(const Operation& operation, uint32_t seq,
+                            std::vector<uint8_t>& batch);
+        bool receiveAnswers(uint32_t firstSeq,
+                            std::vector<Operation>& batchOperations);
+        bool sendBatch(std::vector<Operation>& batchOperations);
+        void rollback(const std::vector<Operation>& batchOperations);
+
+    public:
+        NetlinkConfigurator(void);
+        ~NetlinkConfigurator(void);
+        bool open(void);
+        void close(void);
+        bool flushAddresses(const char* ifName);
+        bool addAddress(const char* ifName, const char* address,
+                        uint8_t prefixLen);
+        bool setLinkUp(const char* ifName, bool isUp);
+        bool addDefaultRoute(const char* gateway, const char* ifName);
+        void clear(void);
+        bool apply(void);
+        uint32_t getLastApplyUs(void) const;
+        void logStats(void) const;
+};
+
+#endif /* NETLINK_CONFIGURATOR_H */
+
+/*** end of file ***/
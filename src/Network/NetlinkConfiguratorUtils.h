@@ -0,0 +1,54 @@
+/** @file NetlinkConfiguratorUtils.h
+ *
+ * @brief This file provides the types and constants of the configuration of
+ * the network interfaces through rtnetlink
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef NETLINK_CONFIGURATOR_UTILS_H
+#define NETLINK_CONFIGURATOR_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <net/if.h>
+#include <netinet/in.h>
+
+namespace NetlinkConfiguratorTypes
+{
+    /* Change of the network configuration */
+    enum ConfigOperationType
+    {
+        CONFIG_ADD_ADDRESS,
+        CONFIG_DELETE_ADDRESS,
+        /* Replaced by the deletion of each address when applied */
+        CONFIG_FLUSH_ADDRESSES,
+        CONFIG_SET_LINK,
+        CONFIG_ADD_ROUTE,
+        CONFIG_DELETE_ROUTE
+    };
+
+    /* IPv4 or IPv6 address in network order */
+    struct IpAddress
+    {
+        uint8_t family;
+        uint8_t bytes[16];
+    };
+}
+
+namespace NetlinkConfiguratorConstants
+{
+    /* Time given to the kernel to answer a batch or a dump */
+    const uint32_t NETCONF_ANSWER_TIMEOUT_MS = 1000;
+
+    /* Size of the buffer an answer is read into */
+    const uint16_t NETCONF_RECEIVE_SIZE = 8192;
+
+    /* Largest message of a batch */
+    const uint16_t NETCONF_MESSAGE_SIZE = 128;
+}
+
+#endif /* NETLINK_CONFIGURATOR_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,722 @@
+/** @file NetlinkMonitor.cpp
+ *
+ * @brief This class delivers the link, address and default route changes of
+ * the network interfaces, as the kernel reports them through rtnetlink
+ *
+ * The kernel multicasts the changes to the socket as they happen, so the
+ * components learn about an interface coming up or losing its address
+ * without polling it. The link states are dumped when the socket is opened,
+ * and dumped again if the receive buffer overran, so that only the actual
+ * up and down transitions are delivered.
+ *
+ * The monitor runs either from the Legato event loop with monitor(), or
+ * from a blocking loop with process() and waitEvent().
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkMonitor.h"
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace NetlinkMonitorConstants;
+using namespace NetlinkMonitorTypes;
+
+/*!
+ * @brief Constructor for NetlinkMonitor
+ * */
+NetlinkMonitor::NetlinkMonitor(void) : netlinkFd(-1), fdMonitorRef(NULL),
+                                        sequence(0), isDumping(false),
+                                        linkNb(0), eventNb(0), messageNb(0),
+                                        overrunNb(0)
+{
+    memset(links, 0, sizeof(links));
+    memset(subscribers, 0, sizeof(subscribers));
+}
+
+/*!
+ * @brief Destructor for NetlinkMonitor
+ * */
+NetlinkMonitor::~NetlinkMonitor(void)
+{
+    close();
+}
+
+/*!
+ * @brief Open the rtnetlink socket, subscribe to the link, address and
+ * route groups, and read the current link states
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkMonitor::open(void)
+{
+    struct sockaddr_nl addr;
+    int32_t size = NETLINK_RCVBUF_SIZE;
+
+    if (netlinkFd >= 0)
+    {
+        return true;
+    }
+
+    netlinkFd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_ROUTE);
+
+    if (netlinkFd < 0)
+    {
+        LE_ERROR("Couldn't open the netlink socket: %m");
+        return false;
+    }
+
+    if (setsockopt(netlinkFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+    {
+        LE_WARN("Couldn't set the netlink receive buffer: %m");
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                        RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+
+    if (bind(netlinkFd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        LE_ERROR("Couldn't bind the netlink socket: %m");
+        close();
+        return false;
+    }
+
+    /* The states read from the dump are not delivered, only the changes
+     * from them are */
+    linkNb = 0;
+    isDumping = requestDump(RTM_GETLINK);
+
+    struct pollfd pfd = {netlinkFd, POLLIN, 0};
+    struct timespec start;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (isDumping)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        int32_t elapsedMs = (now.tv_sec - start.tv_sec) * 1000 +
+                            (now.tv_nsec - start.tv_nsec) / 1000000;
+
+        if ((elapsedMs >= (int32_t) NETLINK_DUMP_TIMEOUT_MS) ||
+            (poll(&pfd, 1, NETLINK_DUMP_TIMEOUT_MS - elapsedMs) <= 0))
+        {
+            LE_WARN("Link dump not complete");
+            isDumping = false;
+            break;
+        }
+
+        readMessages();
+    }
+
+    LE_INFO("Netlink monitor open, %u links", linkNb);
+
+    return true;
+}
+
+/*!
+ * @brief Close the rtnetlink socket
+ *
+ * @return None
+ * */
+void NetlinkMonitor::close(void)
+{
+    if (fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(fdMonitorRef);
+        fdMonitorRef = NULL;
+    }
+
+    if (netlinkFd >= 0)
+    {
+        ::close(netlinkFd);
+        netlinkFd = -1;
+    }
+}
+
+/*!
+ * @brief Get the file descriptor of the socket, to wait on it in an event
+ * loop and call process() when it is readable
+ *
+ * @return File descriptor of the socket, -1 if not open
+ * */
+int32_t NetlinkMonitor::getFd(void) const
+{
+    return netlinkFd;
+}
+
+/*!
+ * @brief Let the Legato event loop call process() when needed
+ *
+ * @return None
+ * */
+void NetlinkMonitor::monitor(void)
+{
+    if ((fdMonitorRef == NULL) && (netlinkFd >= 0))
+    {
+        fdMonitorRef = le_fdMonitor_Create("NetlinkMonitor", netlinkFd,
+                                            fdHandler, POLLIN);
+        le_fdMonitor_SetContextPtr(fdMonitorRef, this);
+    }
+}
+
+/*!
+ * @brief Handler of the socket when monitored by the Legato event loop
+ *
+ * @param[in] fd        File descriptor of the socket
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void NetlinkMonitor::fdHandler(int fd, short events)
+{
+    NetlinkMonitor* monitorPtr =
+                            (NetlinkMonitor*) le_fdMonitor_GetContextPtr();
+
+    monitorPtr->readMessages();
+}
+
+/*!
+ * @brief Subscribe to the events of an interface
+ *
+ * @param[in] ifName        Name of the interface, empty for all of them
+ * @param[in] eventMask     Events wanted, from NetlinkEventType
+ * @param[in] handler       Function called on the events
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return Identifier of the subscription, -1 if there is no room left
+ * */
+int32_t NetlinkMonitor::subscribe(const char* ifName, uint32_t eventMask,
+                                    NetlinkHandler handler, void* contextPtr)
+{
+    if ((ifName == NULL) || (handler == NULL))
+    {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < NETLINK_MAX_SUBSCRIBERS; i++)
+    {
+        Subscriber& subscriber = subscribers[i];
+
+        if (!subscriber.isUsed)
+        {
+            subscriber.isUsed = true;
+            snprintf(subscriber.ifName, sizeof(subscriber.ifName), "%s",
+                        ifName);
+            subscriber.eventMask = eventMask;
+            subscriber.handler = handler;
+            subscriber.contextPtr = contextPtr;
+
+            return i;
+        }
+    }
+
+    LE_ERROR("No room for a netlink subscriber");
+
+    return -1;
+}
+
+/*!
+ * @brief Cancel a subscription
+ *
+ * @param[in] subscriberId  Identifier returned by subscribe()
+ *
+ * @return None
+ * */
+void NetlinkMonitor::unsubscribe(int32_t subscriberId)
+{
+    if ((subscriberId >= 0) && (subscriberId < NETLINK_MAX_SUBSCRIBERS))
+    {
+        subscribers[subscriberId].isUsed = false;
+    }
+}
+
+/*!
+ * @brief Find the last known state of a link
+ *
+ * @param[in] index     Index of the interface
+ *
+ * @return The link, NULL if not known
+ * */
+NetlinkMonitor::Link* NetlinkMonitor::findLink(int32_t index)
+{
+    for (uint8_t i = 0; i < linkNb; i++)
+    {
+        if (links[i].index == index)
+        {
+            return &links[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Get the name of an interface
+ *
+ * @param[in] index     Index of the interface
+ * @param[out] name     Name of the interface, empty if not found. Must hold
+ *                      IFNAMSIZ bytes.
+ *
+ * @return None
+ * */
+void NetlinkMonitor::getLinkName(int32_t index, char* name)
+{
+    Link* linkPtr = findLink(index);
+
+    if (linkPtr != NULL)
+    {
+        memcpy(name, linkPtr->name, IFNAMSIZ);
+    }
+    else if (if_indextoname(index, name) == NULL)
+    {
+        name[0] = '\0';
+    }
+}
+
+/*!
+ * @brief Ask the kernel for a dump of the links, addresses or routes
+ *
+ * @param[in] type  RTM_GETLINK, RTM_GETADDR or RTM_GETROUTE
+ *
+ * @return Status of the operation
+ * */
+bool NetlinkMonitor::requestDump(uint16_t type)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct rtgenmsg message;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++sequence;
+    request.message.rtgen_family = AF_UNSPEC;
+
+    if (::send(netlinkFd, &request, request.header.nlmsg_len, 0) < 0)
+    {
+        LE_ERROR("Couldn't request the netlink dump: %m");
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Give an event to its subscribers
+ *
+ * @param[in] event     Event
+ *
+ * @return None
+ * */
+void NetlinkMonitor::dispatch(NetlinkEvent& event)
+{
+    if (isDumping)
+    {
+        return;
+    }
+
+    eventNb++;
+
+    LE_DEBUG("Netlink event 0x%02X on %s %s", event.type, event.ifName,
+                event.address);
+
+    for (uint8_t i = 0; i < NETLINK_MAX_SUBSCRIBERS; i++)
+    {
+        Subscriber& subscriber = subscribers[i];
+
+        if (subscriber.isUsed && (subscriber.eventMask & event.type) &&
+            ((subscriber.ifName[0] == '\0') ||
+                (strcmp(subscriber.ifName, event.ifName) == 0)))
+        {
+            subscriber.handler(&event, subscriber.contextPtr);
+        }
+    }
+}
+
+/*!
+ * @brief Handle a link message: deliver the up and down transitions
+ *
+ * @param[in] headerPtr     Message
+ *
+ * @return None
+ * */
+void NetlinkMonitor::parseLink(const struct nlmsghdr* headerPtr)
+{
+    struct ifinfomsg* infoPtr = (struct ifinfomsg*) NLMSG_DATA(headerPtr);
+    int32_t len = IFLA_PAYLOAD(headerPtr);
+    NetlinkEvent event;
+
+    memset(&event, 0, sizeof(event));
+    event.ifIndex = infoPtr->ifi_index;
+
+    for (struct rtattr* attrPtr = IFLA_RTA(infoPtr); RTA_OK(attrPtr, len);
+         attrPtr = RTA_NEXT(attrPtr, len))
+    {
+        if (attrPtr->rta_type == IFLA_IFNAME)
+        {
+            snprintf(event.ifName, sizeof(event.ifName), "%s",
+                        (const char*) RTA_DATA(attrPtr));
+        }
+    }
+
+    bool isUp = (headerPtr->nlmsg_type == RTM_NEWLINK) &&
+                (infoPtr->ifi_flags & IFF_UP) &&
+                (infoPtr->ifi_flags & IFF_RUNNING);
+    Link* linkPtr = findLink(infoPtr->ifi_index);
+    bool wasUp = (linkPtr != NULL) && linkPtr->isUp;
+
+    if ((linkPtr == NULL) && (headerPtr->nlmsg_type == RTM_NEWLINK))
+    {
+        if (linkNb < NETLINK_MAX_LINKS)
+        {
+            linkPtr = &links[linkNb++];
+            linkPtr->index = infoPtr->ifi_index;
+        }
+        else
+        {
+            LE_WARN("Too many links, %s not tracked", event.ifName);
+        }
+    }
+
+    if (linkPtr != NULL)
+    {
+        if (event.ifName[0] != '\0')
+        {
+            memcpy(linkPtr->name, event.ifName, IFNAMSIZ);
+        }
+        else
+        {
+            memcpy(event.ifName, linkPtr->name, IFNAMSIZ);
+        }
+
+        linkPtr->isUp = isUp;
+    }
+
+    if (isUp != wasUp)
+    {
+        event.type = isUp ? NETLINK_LINK_UP : NETLINK_LINK_DOWN;
+        dispatch(event);
+    }
+
+    /* The removed link may have been moved during the dispatch */
+    if ((headerPtr->nlmsg_type == RTM_DELLINK) &&
+        ((linkPtr = findLink(infoPtr->ifi_index)) != NULL))
+    {
+        *linkPtr = links[--linkNb];
+    }
+}
+
+/*!
+ * @brief Handle an address message
+ *
+ * @param[in] headerPtr     Message
+ *
+ * @return None
+ * */
+void NetlinkMonitor::parseAddress(const struct nlmsghdr* headerPtr)
+{
+    struct ifaddrmsg* infoPtr = (struct ifaddrmsg*) NLMSG_DATA(headerPtr);
+    int32_t len = IFA_PAYLOAD(headerPtr);
+    const void* addressPtr = NULL;
+    NetlinkEvent event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = (headerPtr->nlmsg_type == RTM_NEWADDR) ?
+                                NETLINK_ADDRESS_ADDED : NETLINK_ADDRESS_REMOVED;
+    event.ifIndex = infoPtr->ifa_index;
+    event.family = infoPtr->ifa_family;
+    event.prefixLen = infoPtr->ifa_prefixlen;
+
+    for (struct rtattr* attrPtr = IFA_RTA(infoPtr); RTA_OK(attrPtr, len);
+         attrPtr = RTA_NEXT(attrPtr, len))
+    {
+        /* The local address, the peer one on point to point links */
+        if ((attrPtr->rta_type == IFA_LOCAL) ||
+            ((attrPtr->rta_type == IFA_ADDRESS) && (addressPtr == NULL)))
+        {
+            addressPtr = RTA_DATA(attrPtr);
+        }
+    }
+
+    if ((addressPtr == NULL) ||
+        (inet_ntop(event.family, addressPtr, event.address,
+                    sizeof(event.address)) == NULL))
+    {
+        return;
+    }
+
+    getLinkName(event.ifIndex, event.ifName);
+    dispatch(event);
+}
+
+/*!
+ * @brief Handle a route message: only the default routes of the main table
+ * are delivered
+ *
+ * @param[in] headerPtr     Message
+ *
+ * @return None
+ * */
+void NetlinkMonitor::parseRoute(const struct nlmsghdr* headerPtr)
+{
+    struct rtmsg* infoPtr = (struct rtmsg*) NLMSG_DATA(headerPtr);
+    int32_t len = RTM_PAYLOAD(headerPtr);
+    NetlinkEvent event;
+
+    if ((infoPtr->rtm_dst_len != 0) || (infoPtr->rtm_table != RT_TABLE_MAIN) ||
+        (infoPtr->rtm_type != RTN_UNICAST))
+    {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.type = (headerPtr->nlmsg_type == RTM_NEWROUTE) ?
+                    NETLINK_DEFAULT_ROUTE_ADDED : NETLINK_DEFAULT_ROUTE_REMOVED;
+    event.ifIndex = -1;
+    event.family = infoPtr->rtm_family;
+
+    for (struct rtattr* attrPtr = RTM_RTA(infoPtr); RTA_OK(attrPtr, len);
+         attrPtr = RTA_NEXT(attrPtr, len))
+    {
+        if (attrPtr->rta_type == RTA_GATEWAY)
+        {
+            inet_ntop(event.family, RTA_DATA(attrPtr), event.address,
+                        sizeof(event.address));
+        }
+        else if (attrPtr->rta_type == RTA_OIF)
+        {
+            memcpy(&event.ifIndex, RTA_DATA(attrPtr), sizeof(event.ifIndex));
+        }
+    }
+
+    if (event.ifIndex >= 0)
+    {
+        getLinkName(event.ifIndex, event.ifName);
+    }
+
+    dispatch(event);
+}
+
+/*!
+ * @brief Read and handle all the messages received
+ *
+ * @return Number of messages read, -1 on error
+ * */
+int32_t NetlinkMonitor::readMessages(void)
+{
+    uint8_t buffer[NETLINK_RECEIVE_SIZE] __attribute__((aligned(4)));
+    int32_t readNb = 0;
+
+    if (netlinkFd < 0)
+    {
+        return -1;
+    }
+
+    while (1)
+    {
+        struct sockaddr_nl addr;
+        socklen_t addrLen = sizeof(addr);
+        ssize_t len = recvfrom(netlinkFd, buffer, sizeof(buffer), 0,
+                                (struct sockaddr*) &addr, &addrLen);
+
+        if (len < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            {
+                break;
+            }
+
+            if (errno == ENOBUFS)
+            {
+                /* Events were lost, the link states are read again */
+                LE_WARN("Netlink receive buffer overrun");
+                overrunNb++;
+                requestDump(RTM_GETLINK);
+                continue;
+            }
+
+            LE_ERROR("Couldn't read the netlink socket: %m");
+            return -1;
+        }
+
+        /* Only the kernel is listened to */
+        if (addr.nl_pid != 0)
+        {
+            continue;
+        }
+
+        for (struct nlmsghdr* headerPtr = (struct nlmsghdr*) buffer;
+             NLMSG_OK(headerPtr, (uint32_t) len);
+             headerPtr = NLMSG_NEXT(headerPtr, len))
+        {
+            readNb++;
+            messageNb++;
+
+            switch (headerPtr->nlmsg_type)
+            {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                    parseLink(headerPtr);
+                    break;
+
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                    parseAddress(headerPtr);
+                    break;
+
+                case RTM_NEWROUTE:
+                case RTM_DELROUTE:
+                    parseRoute(headerPtr);
+                    break;
+
+                case NLMSG_ERROR:
+                    LE_WARN("Netlink error answer");
+                    isDumping = false;
+                    break;
+
+                case NLMSG_DONE:
+                    isDumping = false;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    return readNb;
+}
+
+/*!
+ * @brief Handle the messages received, waiting for them first if asked
+ *
+ * @param[in] waitMs    Maximum time to wait for a message, 0 to only handle
+ *                      what is ready
+ *
+ * @return Number of messages read, -1 on error
+ * */
+int32_t NetlinkMonitor::process(uint32_t waitMs)
+{
+    if (netlinkFd < 0)
+    {
+        return -1;
+    }
+
+    if (waitMs > 0)
+    {
+        struct pollfd pfd = {netlinkFd, POLLIN, 0};
+
+        if ((poll(&pfd, 1, waitMs) < 0) && (errno != EINTR))
+        {
+            LE_ERROR("Couldn't wait for the netlink socket: %m");
+            return -1;
+        }
+    }
+
+    return readMessages();
+}
+
+/*!
+ * @brief Handler used by waitEvent() to note the event
+ *
+ * @param[in] eventPtr      Event
+ * @param[in] contextPtr    Flag to set
+ *
+ * @return None
+ * */
+static void noteEvent(const NetlinkEvent* eventPtr, void* contextPtr)
+{
+    *((bool*) contextPtr) = true;
+}
+
+/*!
+ * @brief Block until an event of an interface, for the components running a
+ * blocking loop. The other subscribers get the events received meanwhile.
+ *
+ * @param[in] ifName        Name of the interface, empty for all of them
+ * @param[in] eventMask     Events waited for, from NetlinkEventType
+ * @param[in] timeoutMs     Maximum time to wait
+ *
+ * @return True if the event happened, false on timeout or error
+ * */
+bool NetlinkMonitor::waitEvent(const char* ifName, uint32_t eventMask,
+                                uint32_t timeoutMs)
+{
+    bool isReceived = false;
+    int32_t subscriberId = subscribe(ifName, eventMask, noteEvent,
+                                        &isReceived);
+    struct timespec start;
+    struct timespec now;
+
+    if (subscriberId < 0)
+    {
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (!isReceived)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        uint32_t elapsedMs = (now.tv_sec - start.tv_sec) * 1000 +
+                                (now.tv_nsec - start.tv_nsec) / 1000000;
+
+        if ((elapsedMs >= timeoutMs) ||
+            (process(timeoutMs - elapsedMs) < 0))
+        {
+            break;
+        }
+    }
+
+    unsubscribe(subscriberId);
+
+    return isReceived;
+}
+
+/*!
+ * @brief Check the last known state of a link
+ *
+ * @param[in] ifName    Name of the interface
+ *
+ * @return True if the link is up and running
+ * */
+bool NetlinkMonitor::isLinkUp(const char* ifName) const
+{
+    for (uint8_t i = 0; i < linkNb; i++)
+    {
+        if (strcmp(links[i].name, ifName) == 0)
+        {
+            return links[i].isUp;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Log the statistics of the monitor
+ *
+ * @return None
+ * */
+void NetlinkMonitor::logStats(void) const
+{
+    LE_INFO("Netlink monitor: %u links, %u messages, %u events delivered, "
+            "%u overruns", linkNb, messageNb, eventNb, overrunNb);
+}
+
+/*** end of file ***/
@@ -0,0 +1,81 @@
+/** @file NetlinkMonitor.h
+ *
+ * @brief This class delivers the link, address and default route changes of
+ * the network interfaces, as the kernel reports them through rtnetlink
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef NETLINK_MONITOR_H
+#define NETLINK_MONITOR_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkMonitorUtils.h"
+
+struct nlmsghdr;
+
+class NetlinkMonitor
+{
+    private:
+        /* Last known state of a link */
+        struct Link
+        {
+            int32_t index;
+            char name[IFNAMSIZ];
+            bool isUp;
+        };
+
+        struct Subscriber
+        {
+            bool isUsed;
+            char ifName[IFNAMSIZ];
+            uint32_t eventMask;
+            NetlinkMonitorTypes::NetlinkHandler handler;
+            void* contextPtr;
+        };
+
+        int32_t netlinkFd;
+        le_fdMonitor_Ref_t fdMonitorRef;
+        uint32_t sequence;
+        bool isDumping;
+        Link links[NetlinkMonitorConstants::NETLINK_MAX_LINKS];
+        uint8_t linkNb;
+        Subscriber
+            subscribers[NetlinkMonitorConstants::NETLINK_MAX_SUBSCRIBERS];
+        uint32_t eventNb;
+        uint32_t messageNb;
+        uint32_t overrunNb;
+
+        static void fdHandler(int fd, short events);
+        Link* findLink(int32_t index);
+        void getLinkName(int32_t index, char* name);
+        bool requestDump(uint16_t type);
+        void dispatch(NetlinkMonitorTypes::NetlinkEvent& event);
+        void parseLink(const struct nlmsghdr* headerPtr);
+        void parseAddress(const struct nlmsghdr* headerPtr);
+        void parseRoute(const struct nlmsghdr* headerPtr);
+        int32_t readMessages(void);
+
+    public:
+        NetlinkMonitor(void);
+        ~NetlinkMonitor(void);
+        bool open(void);
+        void close(void);
+        int32_t getFd(void) const;
+        void monitor(void);
+        int32_t subscribe(const char* ifName, uint32_t eventMask,
+                            NetlinkMonitorTypes::NetlinkHandler handler,
+                            void* contextPtr);
+        void unsubscribe(int32_t subscriberId);
+        int32_t process(uint32_t waitMs);
+        bool waitEvent(const char* ifName, uint32_t eventMask,
+                        uint32_t timeoutMs);
+        bool isLinkUp(const char* ifName) const;
+        void logStats(void) const;
+};
+
+#endif /* NETLINK_MONITOR_H */
+
+/*** end of file ***/
@@ -0,0 +1,69 @@
+/** @file NetlinkMonitorUtils.h
+ *
+ * @brief This file provides the types and constants of the monitoring of the
+ * network interfaces through rtnetlink
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef NETLINK_MONITOR_UTILS_H
+#define NETLINK_MONITOR_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <net/if.h>
+#include <netinet/in.h>
+
+namespace NetlinkMonitorTypes
+{
+    /* Change of a network interface, usable as a mask */
+    enum NetlinkEventType
+    {
+        NETLINK_LINK_UP                 = 0x01,
+        NETLINK_LINK_DOWN               = 0x02,
+        NETLINK_ADDRESS_ADDED           = 0x04,
+        NETLINK_ADDRESS_REMOVED         = 0x08,
+        NETLINK_DEFAULT_ROUTE_ADDED     = 0x10,
+        NETLINK_DEFAULT_ROUTE_REMOVED   = 0x20,
+        NETLINK_ALL_EVENTS              = 0x3F
+    };
+
+    /* Event given to the subscribers */
+    struct NetlinkEvent
+    {
+        NetlinkEventType type;
+        char ifName[IFNAMSIZ];
+        int32_t ifIndex;
+        /* AF_INET or AF_INET6 for the address and route events */
+        uint8_t family;
+        /* Address added or removed, or gateway of the default route */
+        char address[INET6_ADDRSTRLEN];
+        uint8_t prefixLen;
+    };
+
+    /* Function called on the events subscribed to */
+    typedef void (*NetlinkHandler)(const NetlinkEvent* eventPtr,
+                                    void* contextPtr);
+}
+
+namespace NetlinkMonitorConstants
+{
+    /* Interfaces whose link state is tracked, and subscribers */
+    const uint8_t NETLINK_MAX_LINKS = 32;
+    const uint8_t NETLINK_MAX_SUBSCRIBERS = 8;
+
+    /* Receive buffer of the socket: a burst of events must not overrun it,
+     * the link states are dumped again if it does */
+    const int32_t NETLINK_RCVBUF_SIZE = 256 * 1024;
+
+    /* Size of the buffer a datagram is read into */
+    const uint16_t NETLINK_RECEIVE_SIZE = 8192;
+
+    /* Time given to the kernel to answer the dump of the links */
+    const uint32_t NETLINK_DUMP_TIMEOUT_MS = 1000;
+}
+
+#endif /* NETLINK_MONITOR_UTILS_H */
+
+/*** end of file ***/
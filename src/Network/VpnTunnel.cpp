@@ -0,0 +1,807 @@
+/** @file VpnTunnel.cpp
+ *
+ * @brief This class supervises the OpenVPN tunnel of the hub: it runs
+ * OpenVPN, follows its state through the management interface, restarts it
+ * with a back-off and publishes the tunnel events
+ *
+ * OpenVPN is started from the event loop by the command executor, with its
+ * management interface on a Unix socket and held until the supervisor is
+ * connected to it, so that no state change is missed. The current state is
+ * read again if the connection to the management interface is lost. The
+ * tunnel is up once OpenVPN reports the CONNECTED state, and down when it
+ * reconnects or exits.
+ * OpenVPN is killed if its management socket can't be reached, or the tunnel
+ * isn't established, in time. It is restarted once it exited, after a delay
+ * doubled at each restart and reset once the tunnel stayed up long enough.
+ *
+ * While the tunnel is up, its round trip time is measured periodically by a
+ * probe of the VPN server, or of the target given with setRttTarget().
+ *
+ * Nothing blocks: the connectivity checks run on the same event loop.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/VpnTunnel.h"
+#include "Utils/SystemUtils.h"
+#include <algorithm>
+#include <ctype.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+using namespace ConnectivityProberTypes;
+using namespace CommandExecutorTypes;
+using namespace VpnTunnelConstants;
+using namespace VpnTunnelTypes;
+
+/*!
+ * @brief Constructor for VpnTunnel. OpenVPN runs with the configuration of
+ * the hub until setCommand() is called.
+ * */
+VpnTunnel::VpnTunnel(void) : state(TUNNEL_STOPPED), commandId(-1),
+                                managementFd(-1), fdMonitorRef(NULL),
+                                supervisionTimer(NULL), rttTimer(NULL),
+                                lineLen(0), isLineDropped(false), startMs(0),
+                                upMs(0), restartDelayMs(VPN_RESTART_MIN_MS),
+                                lastRttMs(0), smoothedRttMs(0), rxBytesNb(0),
+                                txBytesNb(0), startNb(0), upNb(0), downNb(0),
+                                killNb(0), lastConnectMs(0)
+{
+    args = {VPN_COMMAND, "--config", VPN_CONFIG_PATH};
+    rttTarget = {PROBE_ICMP, "", 0};
+    localAddress[0] = '\0';
+    remoteAddress[0] = '\0';
+    memset(subscribers, 0, sizeof(subscribers));
+}
+
+/*!
+ * @brief Destructor for VpnTunnel. OpenVPN is stopped.
+ * */
+VpnTunnel::~VpnTunnel(void)
+{
+    stop();
+
+    if (supervisionTimer != NULL)
+    {
+        le_timer_Delete(supervisionTimer);
+    }
+
+    if (rttTimer != NULL)
+    {
+        le_timer_Delete(rttTimer);
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t VpnTunnel::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Set the command running the VPN, from the next start. The options
+ * of the management interface are added to it.
+ *
+ * @param[in] commandArgs   Program and its arguments
+ *
+ * @return None
+ * */
+void VpnTunnel::setCommand(const std::vector<std::string>& commandArgs)
+{
+    args = commandArgs;
+}
+
+/*!
+ * @brief Set the target probed to measure the round trip time of the
+ * tunnel. By default, the VPN server is pinged.
+ *
+ * @param[in] target    Target, reached through the tunnel
+ *
+ * @return None
+ * */
+void VpnTunnel::setRttTarget(const ProbeTarget& target)
+{
+    rttTarget = target;
+}
+
+/*!
+ * @brief Start supervising the tunnel. Nothing is done if it is already
+ * supervised.
+ *
+ * @return True if the tunnel is supervised
+ * */
+bool VpnTunnel::start(void)
+{
+    if (state != TUNNEL_STOPPED)
+    {
+        return true;
+    }
+
+    if (supervisionTimer == NULL)
+    {
+        supervisionTimer = le_timer_Create("VpnSupervisionTimer");
+        le_timer_SetHandler(supervisionTimer, supervisionHandler);
+        le_timer_SetContextPtr(supervisionTimer, this);
+
+        rttTimer = le_timer_Create("VpnRttTimer");
+        le_timer_SetRepeat(rttTimer, 0);
+        le_timer_SetMsInterval(rttTimer, VPN_RTT_PERIOD_MS);
+        le_timer_SetHandler(rttTimer, rttHandler);
+        le_timer_SetContextPtr(rttTimer, this);
+    }
+
+    restartDelayMs = VPN_RESTART_MIN_MS;
+
+    /* The previous OpenVPN is still being stopped, the next one is started
+     * once it exited */
+    if (commandId >= 0)
+    {
+        state = TUNNEL_WAITING;
+        return true;
+    }
+
+    launch();
+
+    return true;
+}
+
+/*!
+ * @brief Stop supervising the tunnel, and stop OpenVPN
+ *
+ * @return None
+ * */
+void VpnTunnel::stop(void)
+{
+    if (state == TUNNEL_STOPPED)
+    {
+        return;
+    }
+
+    if (state == TUNNEL_UP)
+    {
+        setDown();
+    }
+
+    state = TUNNEL_STOPPED;
+    le_timer_Stop(supervisionTimer);
+    closeManagement();
+
+    if (commandId >= 0)
+    {
+        SystemUtils::GetCommandExecutor().cancel(commandId);
+    }
+}
+
+/*!
+ * @brief Arm the supervision timer
+ *
+ * @param[in] delayMs   Delay before the next check
+ *
+ * @return None
+ * */
+void VpnTunnel::armSupervision(uint32_t delayMs)
+{
+    le_timer_Stop(supervisionTimer);
+    le_timer_SetMsInterval(supervisionTimer, (delayMs > 0) ? delayMs : 1);
+    le_timer_Start(supervisionTimer);
+}
+
+/*!
+ * @brief Start OpenVPN, held until the management interface is connected
+ *
+ * @return None
+ * */
+void VpnTunnel::launch(void)
+{
+    std::vector<std::string> commandArgs = args;
+
+    /* A socket left by a killed OpenVPN would refuse the connections */
+    unlink(VPN_MANAGEMENT_PATH.c_str());
+
+    commandArgs.insert(commandArgs.end(), {"--management",
+                                            VPN_MANAGEMENT_PATH, "unix",
+                                            "--management-hold"});
+
+    startNb++;
+    startMs = getNowMs();
+    upMs = 0;
+    commandId = SystemUtils::GetCommandExecutor().start(commandArgs, 0,
+                                                        onExit, this);
+
+    if (commandId < 0)
+    {
+        LE_ERROR("Couldn't start %s, retried in %u ms", args[0].c_str(),
+                    restartDelayMs);
+
+        state = TUNNEL_WAITING;
+        armSupervision(restartDelayMs);
+        restartDelayMs = std::min(restartDelayMs * 2, VPN_RESTART_MAX_MS);
+        return;
+    }
+
+    state = TUNNEL_CONNECTING;
+    armSupervision(VPN_MANAGEMENT_RETRY_MS);
+}
+
+/*!
+ * @brief Connect to the management interface, and ask for the current state,
+ * its changes and the traffic counters
+ *
+ * @return False if OpenVPN didn't create the socket yet
+ * */
+bool VpnTunnel::connectManagement(void)
+{
+    struct sockaddr_un addr;
+    char command[32];
+
+    managementFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                            0);
+
+    if (managementFd < 0)
+    {
+        LE_ERROR("Couldn't open the VPN management socket: %m");
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+                VPN_MANAGEMENT_PATH.c_str());
+
+    if (connect(managementFd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+    {
+        ::close(managementFd);
+        managementFd = -1;
+        return false;
+    }
+
+    lineLen = 0;
+    isLineDropped = false;
+
+    fdMonitorRef = le_fdMonitor_Create("VpnManagement", managementFd,
+                                        fdHandler, POLLIN);
+    le_fdMonitor_SetContextPtr(fdMonitorRef, this);
+
+    sendCommand("state");
+    sendCommand("state on");
+    snprintf(command, sizeof(command), "bytecount %u",
+                VPN_BYTECOUNT_PERIOD_S);
+    sendCommand(command);
+
+    return true;
+}
+
+/*!
+ * @brief Close the connection to the management interface
+ *
+ * @return None
+ * */
+void VpnTunnel::closeManagement(void)
+{
+    if (fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(fdMonitorRef);
+        fdMonitorRef = NULL;
+    }
+
+    if (managementFd >= 0)
+    {
+        ::close(managementFd);
+        managementFd = -1;
+    }
+}
+
+/*!
+ * @brief Send a command to the management interface
+ *
+ * @param[in] command   Command, without the end of line
+ *
+ * @return None
+ * */
+void VpnTunnel::sendCommand(const char* command)
+{
+    std::string text = std::string(command) + "\n";
+
+    if (write(managementFd, text.c_str(), text.size()) < 0)
+    {
+        LE_WARN("Couldn't send '%s' to OpenVPN: %m", command);
+    }
+}
+
+/*!
+ * @brief Handler of the end of OpenVPN: it is restarted after the back-off
+ * delay, unless the supervision was stopped
+ *
+ * @param[in] resultPtr     Outcome of OpenVPN
+ * @param[in] contextPtr    Tunnel
+ *
+ * @return None
+ * */
+void VpnTunnel::onExit(const CommandResult* resultPtr, void* contextPtr)
+{
+    VpnTunnel* tunnelPtr = (VpnTunnel*) contextPtr;
+
+    tunnelPtr->commandId = -1;
+    tunnelPtr->closeManagement();
+
+    if (tunnelPtr->state == TUNNEL_STOPPED)
+    {
+        return;
+    }
+
+    if (tunnelPtr->state == TUNNEL_UP)
+    {
+        tunnelPtr->setDown();
+    }
+
+    LE_WARN("OpenVPN exited after %u ms (%d, signal %d), restarted in %u ms",
+            resultPtr->durationMs, resultPtr->exitCode, resultPtr->signal,
+            tunnelPtr->restartDelayMs);
+
+    tunnelPtr->state = TUNNEL_WAITING;
+    tunnelPtr->armSupervision(tunnelPtr->restartDelayMs);
+    tunnelPtr->restartDelayMs = std::min(tunnelPtr->restartDelayMs * 2,
+                                            VPN_RESTART_MAX_MS);
+}
+
+/*!
+ * @brief Handler of the supervision timer: connect to the management
+ * interface, kill an OpenVPN late to connect, or restart it
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void VpnTunnel::supervisionHandler(le_timer_Ref_t timerRef)
+{
+    VpnTunnel* tunnelPtr = (VpnTunnel*) le_timer_GetContextPtr(timerRef);
+    uint32_t elapsedMs = getNowMs() - tunnelPtr->startMs;
+
+    switch (tunnelPtr->state)
+    {
+        case TUNNEL_CONNECTING:
+            if (tunnelPtr->managementFd < 0)
+            {
+                if (tunnelPtr->connectManagement())
+                {
+                    tunnelPtr->armSupervision(VPN_CONNECT_TIMEOUT_MS -
+                                                elapsedMs);
+                    break;
+                }
+
+                if (elapsedMs < VPN_MANAGEMENT_TIMEOUT_MS)
+                {
+                    tunnelPtr->armSupervision(VPN_MANAGEMENT_RETRY_MS);
+                    break;
+                }
+            }
+
+            LE_WARN("VPN tunnel not established after %u ms, OpenVPN killed",
+                    elapsedMs);
+
+            tunnelPtr->killNb++;
+            SystemUtils::GetCommandExecutor().cancel(tunnelPtr->commandId);
+            break;
+
+        case TUNNEL_WAITING:
+            tunnelPtr->launch();
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*!
+ * @brief Handler of the management socket
+ *
+ * @param[in] fd        File descriptor of the socket
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void VpnTunnel::fdHandler(int fd, short events)
+{
+    VpnTunnel* tunnelPtr = (VpnTunnel*) le_fdMonitor_GetContextPtr();
+
+    tunnelPtr->readManagement();
+}
+
+/*!
+ * @brief Read the management interface, and parse its complete lines. If
+ * OpenVPN closes it, it is connected to again: OpenVPN is killed if that
+ * fails, unless it exits first.
+ *
+ * @return None
+ * */
+void VpnTunnel::readManagement(void)
+{
+    char buffer[VPN_LINE_SIZE];
+    ssize_t readNb;
+
+    while ((readNb = read(managementFd, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t i = 0; i < readNb; i++)
+        {
+            char c = buffer[i];
+
+            if (c == '\n')
+            {
+                line[lineLen] = '\0';
+
+                if (!isLineDropped)
+                {
+                    parseLine(line);
+                }
+
+                lineLen = 0;
+                isLineDropped = false;
+
+                /* A subscriber may have stopped the supervision */
+                if (managementFd < 0)
+                {
+                    return;
+                }
+            }
+            else if (c == '\r')
+            {
+                continue;
+            }
+            else if (lineLen < (sizeof(line) - 1))
+            {
+                line[lineLen++] = c;
+            }
+            else
+            {
+                isLineDropped = true;
+            }
+        }
+    }
+
+    if ((readNb < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+    {
+        return;
+    }
+
+    LE_DEBUG("OpenVPN closed its management interface");
+
+    closeManagement();
+
+    if ((state == TUNNEL_STOPPED) || (state == TUNNEL_WAITING))
+    {
+        return;
+    }
+
+    if (state == TUNNEL_UP)
+    {
+        setDown();
+    }
+
+    state = TUNNEL_CONNECTING;
+    startMs = getNowMs();
+    armSupervision(VPN_MANAGEMENT_RETRY_MS);
+}
+
+/*!
+ * @brief Parse a line of the management interface
+ *
+ * @param[in] text  Line, without the end of line
+ *
+ * @return None
+ * */
+void VpnTunnel::parseLine(const char* text)
+{
+    unsigned long long rxNb;
+    unsigned long long txNb;
+
+    if (strncmp(text, ">STATE:", 7) == 0)
+    {
+        parseState(text + 7);
+    }
+    else if (isdigit((unsigned char) text[0]) && (strchr(text, ',') != NULL))
+    {
+        /* Answer to the state command */
+        parseState(text);
+    }
+    else if (strncmp(text, ">HOLD:", 6) == 0)
+    {
+        sendCommand("hold release");
+    }
+    else if (sscanf(text, ">BYTECOUNT:%llu,%llu", &rxNb, &txNb) == 2)
+    {
+        rxBytesNb = rxNb;
+        txBytesNb = txNb;
+    }
+    else if (strncmp(text, ">FATAL:", 7) == 0)
+    {
+        LE_ERROR("OpenVPN: %s", text + 7);
+    }
+    else if (strncmp(text, "ERROR:", 6) == 0)
+    {
+        LE_WARN("OpenVPN: %s", text);
+    }
+    else
+    {
+        LE_DEBUG("OpenVPN: %s", text);
+    }
+}
+
+/*!
+ * @brief Parse a state, or a state change: time, name, description, local
+ * address and remote address, separated by commas
+ *
+ * @param[in] text  State, after the >STATE: prefix
+ *
+ * @return None
+ * */
+void VpnTunnel::parseState(const char* text)
+{
+    char fields[5][INET6_ADDRSTRLEN] = {{0}};
+    const char* fieldPtr = text;
+
+    for (uint8_t i = 0; (i < 5) && (fieldPtr != NULL); i++)
+    {
+        const char* endPtr = strchr(fieldPtr, ',');
+        size_t len = (endPtr != NULL) ? (size_t) (endPtr - fieldPtr) :
+                                        strlen(fieldPtr);
+
+        snprintf(fields[i], sizeof(fields[i]), "%.*s", (int) len, fieldPtr);
+        fieldPtr = (endPtr != NULL) ? (endPtr + 1) : NULL;
+    }
+
+    const char* name = fields[1];
+
+    LE_DEBUG("OpenVPN state %s", name);
+
+    if (strcmp(name, "CONNECTED") == 0)
+    {
+        snprintf(localAddress, sizeof(localAddress), "%s", fields[3]);
+        snprintf(remoteAddress, sizeof(remoteAddress), "%s", fields[4]);
+        setUp();
+    }
+    else if ((strcmp(name, "RECONNECTING") == 0) ||
+             (strcmp(name, "EXITING") == 0))
+    {
+        if (state == TUNNEL_UP)
+        {
+            setDown();
+        }
+
+        /* OpenVPN reconnects by itself, it is only watched */
+        state = TUNNEL_CONNECTING;
+        startMs = getNowMs();
+        armSupervision(VPN_CONNECT_TIMEOUT_MS);
+    }
+}
+
+/*!
+ * @brief Account for the tunnel established, and start measuring its round
+ * trip time
+ *
+ * @return None
+ * */
+void VpnTunnel::setUp(void)
+{
+    ProbeTarget target = rttTarget;
+
+    if (state == TUNNEL_UP)
+    {
+        return;
+    }
+
+    state = TUNNEL_UP;
+    upMs = getNowMs();
+    upNb++;
+    lastConnectMs = upMs - startMs;
+    le_timer_Stop(supervisionTimer);
+
+    LE_INFO("VPN tunnel up in %u ms: %s to %s", lastConnectMs, localAddress,
+            remoteAddress);
+
+    publish(TUNNEL_EVENT_UP);
+
+    if (target.address.empty())
+    {
+        target.address = remoteAddress;
+    }
+
+    if (!target.address.empty() && rttProber.setTargets({target}))
+    {
+        le_timer_Start(rttTimer);
+        rttHandler(rttTimer);
+    }
+}
+
+/*!
+ * @brief Account for the tunnel lost. The back-off delay is reset if it
+ * stayed up long enough.
+ *
+ * @return None
+ * */
+void VpnTunnel::setDown(void)
+{
+    uint32_t uptimeMs = getNowMs() - upMs;
+
+    downNb++;
+    le_timer_Stop(rttTimer);
+    rttProber.cancel();
+
+    if (uptimeMs >= VPN_STABLE_MS)
+    {
+        restartDelayMs = VPN_RESTART_MIN_MS;
+    }
+
+    LE_WARN("VPN tunnel down after %u ms", uptimeMs);
+
+    /* Set before publishing, the subscribers may check it */
+    state = TUNNEL_CONNECTING;
+
+    publish(TUNNEL_EVENT_DOWN);
+}
+
+/*!
+ * @brief Handler of the round trip time timer
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void VpnTunnel::rttHandler(le_timer_Ref_t timerRef)
+{
+    VpnTunnel* tunnelPtr = (VpnTunnel*) le_timer_GetContextPtr(timerRef);
+
+    if ((tunnelPtr->state == TUNNEL_UP) && !tunnelPtr->rttProber.isProbing())
+    {
+        tunnelPtr->rttProber.start(onRttDone, tunnelPtr);
+    }
+}
+
+/*!
+ * @brief Handler of a round trip time measurement. A lost probe doesn't
+ * bring the tunnel down, OpenVPN detects it with its own keepalive.
+ *
+ * @param[in] isReachable   True if the target answered
+ * @param[in] rttMs         Round trip time
+ * @param[in] contextPtr    Tunnel
+ *
+ * @return None
+ * */
+void VpnTunnel::onRttDone(bool isReachable, uint32_t rttMs, void* contextPtr)
+{
+    VpnTunnel* tunnelPtr = (VpnTunnel*) contextPtr;
+
+    if (!isReachable || (tunnelPtr->state != TUNNEL_UP))
+    {
+        LE_DEBUG("No answer through the VPN tunnel");
+        return;
+    }
+
+    tunnelPtr->lastRttMs = rttMs;
+    tunnelPtr->smoothedRttMs = (tunnelPtr->smoothedRttMs == 0) ? rttMs :
+                                (tunnelPtr->smoothedRttMs * 7 + rttMs) / 8;
+
+    tunnelPtr->publish(TUNNEL_EVENT_RTT);
+}
+
+/*!
+ * @brief Call the subscribers of an event
+ *
+ * @param[in] type  Event
+ *
+ * @return None
+ * */
+void VpnTunnel::publish(TunnelEventType type)
+{
+    TunnelEvent event;
+
+    event.type = type;
+    snprintf(event.localAddress, sizeof(event.localAddress), "%s",
+                localAddress);
+    snprintf(event.remoteAddress, sizeof(event.remoteAddress), "%s",
+                remoteAddress);
+    event.rttMs = lastRttMs;
+    event.smoothedRttMs = smoothedRttMs;
+
+    for (uint8_t i = 0; i < VPN_MAX_SUBSCRIBERS; i++)
+    {
+        Subscriber& subscriber = subscribers[i];
+
+        if (subscriber.isUsed && (subscriber.eventMask & type))
+        {
+            subscriber.handler(&event, subscriber.contextPtr);
+        }
+    }
+}
+
+/*!
+ * @brief Subscribe to the tunnel events. The handlers are called from the
+ * event loop.
+ *
+ * @param[in] eventMask     Events wanted, TunnelEventType values or'ed
+ * @param[in] handler       Function called on these events
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return Identifier of the subscription, -1 if there is no room left
+ * */
+int32_t VpnTunnel::subscribe(uint32_t eventMask, TunnelHandler handler,
+                                void* contextPtr)
+{
+    if (handler == NULL)
+    {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < VPN_MAX_SUBSCRIBERS; i++)
+    {
+        Subscriber& subscriber = subscribers[i];
+
+        if (!subscriber.isUsed)
+        {
+            subscriber.isUsed = true;
+            subscriber.eventMask = eventMask;
+            subscriber.handler = handler;
+            subscriber.contextPtr = contextPtr;
+
+            return i;
+        }
+    }
+
+    LE_ERROR("No room for a VPN tunnel subscriber");
+
+    return -1;
+}
+
+/*!
+ * @brief Cancel a subscription
+ *
+ * @param[in] subscriberId  Identifier returned by subscribe()
+ *
+ * @return None
+ * */
+void VpnTunnel::unsubscribe(int32_t subscriberId)
+{
+    if ((subscriberId >= 0) && (subscriberId < VPN_MAX_SUBSCRIBERS))
+    {
+        subscribers[subscriberId].isUsed = false;
+    }
+}
+
+/*!
+ * @brief Get the state of the tunnel
+ *
+ * @return State
+ * */
+TunnelState VpnTunnel::getState(void) const
+{
+    return state;
+}
+
+/*!
+ * @brief Log the statistics of the tunnel
+ *
+ * @return None
+ * */
+void VpnTunnel::logStats(void) const
+{
+    LE_INFO("VPN tunnel state %d: %u starts, %u killed, %u up, %u down, "
+            "last connection in %u ms", state, startNb, killNb, upNb, downNb,
+            lastConnectMs);
+    LE_INFO("VPN tunnel RTT %u ms (smoothed %u ms), %llu bytes received, "
+            "%llu sent", lastRttMs, smoothedRttMs,
+            (unsigned long long) rxBytesNb, (unsigned long long) txBytesNb);
+}
+
+/*** end of file ***/
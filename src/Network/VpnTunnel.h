@@ -0,0 +1,97 @@
+/** @file VpnTunnel.h
+ *
+ * @brief This class supervises the OpenVPN tunnel of the hub: it runs
+ * OpenVPN, follows its state through the management interface, restarts it
+ * with a back-off and publishes the tunnel events
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef VPN_TUNNEL_H
+#define VPN_TUNNEL_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/ConnectivityProber.h"
+#include "Network/VpnTunnelUtils.h"
+#include "Utils/CommandExecutorUtils.h"
+#include <vector>
+
+class VpnTunnel
+{
+    private:
+        struct Subscriber
+        {
+            bool isUsed;
+            uint32_t eventMask;
+            VpnTunnelTypes::TunnelHandler handler;
+            void* contextPtr;
+        };
+
+        std::vector<std::string> args;
+        VpnTunnelTypes::TunnelState state;
+        int32_t commandId;
+        int managementFd;
+        le_fdMonitor_Ref_t fdMonitorRef;
+        le_timer_Ref_t supervisionTimer;
+        le_timer_Ref_t rttTimer;
+        char line[VpnTunnelConstants::VPN_LINE_SIZE];
+        uint16_t lineLen;
+        bool isLineDropped;
+        uint64_t startMs;
+        uint64_t upMs;
+        uint32_t restartDelayMs;
+        char localAddress[INET6_ADDRSTRLEN];
+        char remoteAddress[INET6_ADDRSTRLEN];
+        ConnectivityProber rttProber;
+        ConnectivityProberTypes::ProbeTarget rttTarget;
+        uint32_t lastRttMs;
+        uint32_t smoothedRttMs;
+        uint64_t rxBytesNb;
+        uint64_t txBytesNb;
+        Subscriber subscribers[VpnTunnelConstants::VPN_MAX_SUBSCRIBERS];
+        uint32_t startNb;
+        uint32_t upNb;
+        uint32_t downNb;
+        uint32_t killNb;
+        uint32_t lastConnectMs;
+
+        static uint64_t getNowMs(void);
+        static void onExit(const CommandExecutorTypes::CommandResult* resultPtr,
+                            void* contextPtr);
+        static void fdHandler(int fd, short events);
+        static void supervisionHandler(le_timer_Ref_t timerRef);
+        static void rttHandler(le_timer_Ref_t timerRef);
+        static void onRttDone(bool isReachable, uint32_t rttMs,
+                                void* contextPtr);
+        void armSupervision(uint32_t delayMs);
+        void launch(void);
+        bool connectManagement(void);
+        void closeManagement(void);
+        void sendCommand(const char* command);
+        void readManagement(void);
+        void parseLine(const char* text);
+        void parseState(const char* text);
+        void setUp(void);
+        void setDown(void);
+        void publish(VpnTunnelTypes::TunnelEventType type);
+
+    public:
+        VpnTunnel(void);
+        ~VpnTunnel(void);
+        void setCommand(const std::vector<std::string>& commandArgs);
+        void setRttTarget(const ConnectivityProberTypes::ProbeTarget& target);
+        bool start(void);
+        void stop(void);
+        int32_t subscribe(uint32_t eventMask,
+                            VpnTunnelTypes::TunnelHandler handler,
+                            void* contextPtr);
+        void unsubscribe(int32_t subscriberId);
+        VpnTunnelTypes::TunnelState getState(void) const;
+        void logStats(void) const;
+};
+
+#endif /* VPN_TUNNEL_H */
+
+/*** end of file ***/
@@ -0,0 +1,97 @@
+/** @file VpnTunnelUtils.h
+ *
+ * @brief This file provides the types and constants of the supervision of
+ * the VPN tunnel
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef VPN_TUNNEL_UTILS_H
+#define VPN_TUNNEL_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <netinet/in.h>
+#include <string>
+
+namespace VpnTunnelTypes
+{
+    /* State of the tunnel */
+    enum TunnelState
+    {
+        /* Not supervised */
+        TUNNEL_STOPPED,
+        /* OpenVPN is running, the tunnel is not established yet */
+        TUNNEL_CONNECTING,
+        /* OpenVPN reported the tunnel connected */
+        TUNNEL_UP,
+        /* OpenVPN exited, it is restarted after the back-off delay */
+        TUNNEL_WAITING
+    };
+
+    /* Event published to the subscribers, usable as a mask */
+    enum TunnelEventType
+    {
+        TUNNEL_EVENT_UP         = 0x01,
+        TUNNEL_EVENT_DOWN       = 0x02,
+        TUNNEL_EVENT_RTT        = 0x04,
+        TUNNEL_ALL_EVENTS       = 0x07
+    };
+
+    struct TunnelEvent
+    {
+        TunnelEventType type;
+        /* Address of the hub in the tunnel, and of the VPN server */
+        char localAddress[INET6_ADDRSTRLEN];
+        char remoteAddress[INET6_ADDRSTRLEN];
+        /* Last and smoothed round trip times, for TUNNEL_EVENT_RTT */
+        uint32_t rttMs;
+        uint32_t smoothedRttMs;
+    };
+
+    /* Function called on the events subscribed to */
+    typedef void (*TunnelHandler)(const TunnelEvent* eventPtr,
+                                    void* contextPtr);
+}
+
+namespace VpnTunnelConstants
+{
+    /* OpenVPN and the configuration of the hub tunnel */
+    const std::string VPN_COMMAND = "openvpn";
+    const std::string VPN_CONFIG_PATH = "/home/root/client_hub.ovpn";
+
+    /* Unix socket of the management interface of OpenVPN */
+    const std::string VPN_MANAGEMENT_PATH = "/tmp/openvpn_hub.sock";
+
+    /* Wait between two connections to the management socket while OpenVPN
+     * creates it */
+    const uint32_t VPN_MANAGEMENT_RETRY_MS = 100;
+
+    /* OpenVPN is restarted if its management socket can't be reached, or
+     * the tunnel isn't established, within these delays */
+    const uint32_t VPN_MANAGEMENT_TIMEOUT_MS = 10000;
+    const uint32_t VPN_CONNECT_TIMEOUT_MS = 120000;
+
+    /* Delay before restarting OpenVPN, doubled at each restart up to the
+     * maximum. It is reset once the tunnel stayed up long enough. */
+    const uint32_t VPN_RESTART_MIN_MS = 1000;
+    const uint32_t VPN_RESTART_MAX_MS = 300000;
+    const uint32_t VPN_STABLE_MS = 60000;
+
+    /* Period of the round trip time measurement while the tunnel is up */
+    const uint32_t VPN_RTT_PERIOD_MS = 30000;
+
+    /* Period of the traffic counters reported by OpenVPN, in seconds */
+    const uint8_t VPN_BYTECOUNT_PERIOD_S = 10;
+
+    /* Longest line read from the management interface, longer ones are
+     * dropped */
+    const uint16_t VPN_LINE_SIZE = 512;
+
+    const uint8_t VPN_MAX_SUBSCRIBERS = 4;
+}
+
+#endif /* VPN_TUNNEL_UTILS_H */
+
+/*** end of file ***/
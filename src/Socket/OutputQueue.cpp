@@ -0,0 +1,240 @@
+/** @file OutputQueue.cpp
+ *
+ * @brief This class buffers the data to be sent on a connection until the
+ * socket can take it
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Socket/OutputQueue.h"
+#include "Socket/OutputQueueUtils.h"
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+using namespace OutputQueueConstants;
+
+/*!
+ * @brief Constructor for OutputQueue
+ * */
+OutputQueue::OutputQueue(void) : headOffset(0), queuedBytesNb(0),
+                                    isPaused(false), maxQueuedBytesNb(0),
+                                    pauseNb(0), sendCallNb(0),
+                                    coalescedWriteNb(0), wouldBlockNb(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for OutputQueue
+ * */
+OutputQueue::~OutputQueue(void)
+{
+
+}
+
+/*!
+ * @brief Update the read pause state from the queue depth, with hysteresis
+ *
+ * @return None
+ * */
+void OutputQueue::updatePause(void)
+{
+    if (!isPaused && (queuedBytesNb > OUTPUT_QUEUE_HIGH_WATER_MARK))
+    {
+        LE_WARN("Output queue above high water mark (%u bytes), pause reading",
+                                                            queuedBytesNb);
+        isPaused = true;
+        pauseNb++;
+    }
+    else if (isPaused && (queuedBytesNb < OUTPUT_QUEUE_LOW_WATER_MARK))
+    {
+        LE_INFO("Output queue drained (%u bytes), resume reading",
+                                                            queuedBytesNb);
+        isPaused = false;
+    }
+}
+
+/*!
+ * @brief Add data at the end of the queue. Small writes are merged with the
+ * previous pending segment so that they go out in a single send.
+ *
+ * @param[in] buf   Data to send
+ * @param[in] len   Number of bytes, nothing is queued for 0
+ *
+ * @return LE_OK on success, LE_OVERFLOW if the queue is full
+ * */
+le_result_t OutputQueue::push(const uint8_t* buf, uint32_t len)
+{
+    /* An empty segment would be sent as an empty iovec, for ever */
+    if (len == 0)
+    {
+        return LE_OK;
+    }
+
+    if ((queuedBytesNb + len) > OUTPUT_QUEUE_MAX_SIZE)
+    {
+        LE_ERROR("Output queue full, %u bytes refused", len);
+        return LE_OVERFLOW;
+    }
+
+    if ((len <= OUTPUT_QUEUE_COALESCE_MAX_WRITE) && !segments.empty() &&
+        ((segments.back().size() + len) <= OUTPUT_QUEUE_COALESCE_MAX_SEGMENT))
+    {
+        segments.back().insert(segments.back().end(), buf, buf + len);
+        coalescedWriteNb++;
+    }
+    else
+    {
+        segments.push_back(std::vector<uint8_t>(buf, buf + len));
+    }
+
+    queuedBytesNb += len;
+
+    if (queuedBytesNb > maxQueuedBytesNb)
+    {
+        maxQueuedBytesNb = queuedBytesNb;
+    }
+
+    updatePause();
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Send as much of the queue as the socket takes, without blocking
+ *
+ * @param[in] fd    Socket
+ *
+ * @return LE_OK if the queue is empty, LE_WOULD_BLOCK if the socket is full
+ * and the rest has to be sent once it is writable, LE_FAULT on error
+ * */
+le_result_t OutputQueue::flush(int32_t fd)
+{
+    while (!segments.empty())
+    {
+        struct iovec iov[OUTPUT_QUEUE_MAX_IOV];
+        struct msghdr msg;
+        size_t iovNb = 0;
+
+        for (std::deque< std::vector<uint8_t> >::iterator it = segments.begin();
+             (it != segments.end()) && (iovNb < OUTPUT_QUEUE_MAX_IOV); it++)
+        {
+            uint32_t offset = (iovNb == 0) ? headOffset : 0;
+
+            iov[iovNb].iov_base = &(*it)[offset];
+            iov[iovNb].iov_len = it->size() - offset;
+            iovNb++;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovNb;
+
+        ssize_t sentNb = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        sendCallNb++;
+
+        if (sentNb < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                wouldBlockNb++;
+                return LE_WOULD_BLOCK;
+            }
+            else if (errno == EINTR)
+            {
+                continue;
+            }
+
+            LE_ERROR("Failed to send: %s", strerror(errno));
+            return LE_FAULT;
+        }
+
+        queuedBytesNb -= sentNb;
+
+        /* Drop the segments fully sent */
+        while ((sentNb > 0) && !segments.empty())
+        {
+            uint32_t leftNb = segments.front().size() - headOffset;
+
+            if ((uint32_t) sentNb >= leftNb)
+            {
+                sentNb -= leftNb;
+                segments.pop_front();
+                headOffset = 0;
+            }
+            else
+            {
+                headOffset += sentNb;
+                sentNb = 0;
+            }
+        }
+
+        updatePause();
+    }
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Drop the pending data, when the connection is closed
+ *
+ * @return None
+ * */
+void OutputQueue::clear(void)
+{
+    segments.clear();
+    headOffset = 0;
+    queuedBytesNb = 0;
+    isPaused = false;
+}
+
+/*!
+ * @brief Check if all the data was sent
+ *
+ * @return True if the queue is empty
+ * */
+bool OutputQueue::isEmpty(void) const
+{
+    return segments.empty();
+}
+
+/*!
+ * @brief Check if the peer should not be read until the queue drains
+ *
+ * @return True if the queue went above the high water mark and is not back
+ * under the low water mark yet
+ * */
+bool OutputQueue::isReadPaused(void) const
+{
+    return isPaused;
+}
+
+/*!
+ * @brief Get the number of bytes waiting to be sent
+ *
+ * @return Number of bytes
+ * */
+uint32_t OutputQueue::getQueuedBytesNb(void) const
+{
+    return queuedBytesNb;
+}
+
+/*!
+ * @brief Log the statistics of the queue
+ *
+ * @param[in] name  Name of the connection
+ *
+ * @return None
+ * */
+void OutputQueue::logStats(const char* name) const
+{
+    LE_INFO("Output queue %s: depth %u, max %u, sends %u, coalesced writes %u,"
+            " would block %u, read pauses %u", name, queuedBytesNb,
+            maxQueuedBytesNb, sendCallNb, coalescedWriteNb, wouldBlockNb,
+            pauseNb);
+}
+
+/*** end of file ***/
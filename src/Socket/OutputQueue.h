@@ -0,0 +1,47 @@
+/** @file OutputQueue.h
+ *
+ * @brief This class buffers the data to be sent on a connection until the
+ * socket can take it
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <deque>
+#include <vector>
+
+class OutputQueue
+{
+    private:
+        std::deque< std::vector<uint8_t> > segments;
+        uint32_t headOffset;
+        uint32_t queuedBytesNb;
+        bool isPaused;
+        uint32_t maxQueuedBytesNb;
+        uint32_t pauseNb;
+        uint32_t sendCallNb;
+        uint32_t coalescedWriteNb;
+        uint32_t wouldBlockNb;
+
+        void updatePause(void);
+
+    public:
+        OutputQueue(void);
+        ~OutputQueue(void);
+        le_result_t push(const uint8_t* buf, uint32_t len);
+        le_result_t flush(int32_t fd);
+        void clear(void);
+        bool isEmpty(void) const;
+        bool isReadPaused(void) const;
+        uint32_t getQueuedBytesNb(void) const;
+        void logStats(const char* name) const;
+};
+
+#endif /* OUTPUT_QUEUE_H */
+
+/*** end of file ***/
@@ -0,0 +1,41 @@
+/** @file OutputQueueUtils.h
+ *
+ * @brief This file is used to define constants for the socket output queue
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef OUTPUT_QUEUE_UTILS_H
+#define OUTPUT_QUEUE_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace OutputQueueConstants
+{
+    /* Writes up to this size are merged with the previous pending segment
+     * (ALP acks, timestamps) */
+    const uint32_t OUTPUT_QUEUE_COALESCE_MAX_WRITE = 256;
+
+    /* Maximum size of a segment built by merging small writes */
+    const uint32_t OUTPUT_QUEUE_COALESCE_MAX_SEGMENT = 1460;
+
+    /* Maximum number of segments given to a single sendmsg() */
+    const uint8_t OUTPUT_QUEUE_MAX_IOV = 16;
+
+    /* Above the high water mark, the peer is not read anymore until the
+     * queue is back under the low water mark */
+    const uint32_t OUTPUT_QUEUE_HIGH_WATER_MARK = 64 * 1024;
+    const uint32_t OUTPUT_QUEUE_LOW_WATER_MARK = 16 * 1024;
+
+    /* Hard limit of the queue, writes beyond it are refused */
+    const uint32_t OUTPUT_QUEUE_MAX_SIZE = 512 * 1024;
+
+    /* Time to wait for a congested socket to accept more data */
+    const uint32_t OUTPUT_QUEUE_FLUSH_TIMEOUT_MS = 5000;
+}
+
+#endif /* OUTPUT_QUEUE_UTILS_H */
+
+/*** end of file ***/
@@ -10,9 +10,14 @@
 #include "interfaces.h"
 #include "Utils/SystemUtils.h"
 #include "Socket/SocketClient.h"
+#include "Socket/SocketTuning.h"
+#include "Socket/OutputQueueUtils.h"
+#include <poll.h>
 #include <signal.h>
 #include <arpa/inet.h>
 
+using namespace OutputQueueConstants;
+
 /*!
  * @brief Constructor for SocketClient. This initialize the socket client
  * and launch it.
@@ -20,7 +25,8 @@
 SocketClient::SocketClient (int port,
                             const std::string& ipAddr,
                             const std::string& device) :
-                            addrlen(sizeof(address)), socketStatus(true)
+                            addrlen(sizeof(address)), socketStatus(true),
+                            interface(device)
 {
     LE_INFO("Create socket");
 
@@ -52,6 +58,11 @@ SocketClient::SocketClient (int port,
         }
     }
 
+    if (socketStatus)
+    {
+        SocketTuning::apply(socket_fd, interface);
+    }
+
     if (socketStatus)
     {
         address.sin_family = AF_INET;
@@ -103,7 +114,8 @@ bool SocketClient::open(void)
 }
 
 /*!
- * @brief Send data to the socket
+ * @brief Send data to the socket. If the link is congested, the data is
+ * queued and sent as soon as the socket is writable.
  *
  * @param[in] buf   Pointer to the buffer of bytes to be sent
  * @param[in] len   Number of bytes to send
@@ -113,7 +125,7 @@ bool SocketClient::open(void)
 bool SocketClient::write(uint8_t* buf, uint32_t len)
 {
     bool status = true;
-    int32_t bytesSentNb = 0;
+    le_result_t result = LE_WOULD_BLOCK;
 
     if (!socketStatus)
     {
@@ -139,25 +151,39 @@ bool SocketClient::write(uint8_t* buf, uint32_t len)
 
     if (status)
     {
-        /* Send the buffer through the TCP socket */
-        bytesSentNb = send(socket_fd, buf, len, 0);
+        status = (LE_OK == outputQueue.push(buf, len));
+    }
+
+    /* Send the queue through the TCP socket */
+    while (status && (result == LE_WOULD_BLOCK))
+    {
+        result = outputQueue.flush(socket_fd);
 
-        if (bytesSentNb < 0)
+        if (result == LE_WOULD_BLOCK)
         {
-            LE_ERROR("Error while transmitting to the socket");
-            status = false;
+            struct pollfd pfd;
+
+            pfd.fd = socket_fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+
+            if (poll(&pfd, 1, OUTPUT_QUEUE_FLUSH_TIMEOUT_MS) <= 0)
+            {
+                LE_ERROR("Socket not writable, %u bytes still queued",
+                                            outputQueue.getQueuedBytesNb());
+                status = false;
+            }
         }
-        else if ((uint32_t) bytesSentNb != len)
+        else if (result != LE_OK)
         {
-            LE_ERROR("Error, only %d bytes transmitted out of %d", bytesSentNb,
-                    len);
+            LE_ERROR("Error while transmitting to the socket");
             status = false;
         }
     }
 
     if (status)
     {
-        LE_INFO("%d bytes sent successfully", bytesSentNb);
+        LE_INFO("%u bytes sent successfully", len);
     }
 
     return status;
@@ -248,6 +274,9 @@ void SocketClient::close(void)
     /* Use "::" to explicitly refer to the global namespace
      * close() function from <unistd.h>*/
     ::shutdown(socket_fd, SHUT_RDWR);
+
+    outputQueue.logStats("client");
+    outputQueue.clear();
 }
 
 /*** end of file ***/
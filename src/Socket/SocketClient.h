@@ -13,6 +13,7 @@
 #include "interfaces.h"
 #include <iostream>
 #include <netinet/in.h>
+#include "Socket/OutputQueue.h"
 
 class SocketClient
 {
@@ -22,6 +23,8 @@ class SocketClient
         struct sockaddr_in address;
         int32_t addrlen;
         bool socketStatus;
+        std::string interface;
+        OutputQueue outputQueue;
     public:
         SocketClient(int port,
                     const std::string& ipAddr,
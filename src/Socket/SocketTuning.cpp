@@ -0,0 +1,358 @@
+/** @file SocketTuning.cpp
+ *
+ * @brief This class applies the socket tuning profile of an interface to the
+ * sockets using it
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Socket/SocketTuning.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fstream>
+#include <algorithm>
+
+using namespace SocketTuningConstants;
+using namespace SocketTuningTypes;
+
+/* Initialize the static members of SocketTuning. The profiles are loaded the
+ * first time they are needed. */
+std::vector<SocketProfile> SocketTuning::profiles;
+std::vector<SocketTuning::ProfileStats> SocketTuning::stats;
+bool SocketTuning::isLoaded = false;
+
+/*!
+ * @brief Remove the leading and trailing blanks of a string
+ *
+ * @param[in] str   String to trim
+ *
+ * @return The trimmed string
+ * */
+static std::string Trim(const std::string& str)
+{
+    size_t first = str.find_first_not_of(" \t\r\n");
+    size_t last = str.find_last_not_of(" \t\r\n");
+
+    if (first == std::string::npos)
+    {
+        return "";
+    }
+
+    return str.substr(first, last - first + 1);
+}
+
+/*!
+ * @brief Load the default profiles and apply the overrides of
+ * SOCKET_TUNING_CONFIG_FILE
+ *
+ * @return None
+ * */
+void SocketTuning::load(void)
+{
+    std::ifstream configFile(SOCKET_TUNING_CONFIG_FILE.c_str());
+    std::string line;
+    uint32_t lineNb = 0;
+
+    profiles = DEFAULT_PROFILES;
+
+    while (std::getline(configFile, line))
+    {
+        lineNb++;
+        line = Trim(line);
+
+        if (line.empty() || (line[0] == '#'))
+        {
+            continue;
+        }
+
+        size_t dotPos = line.find('.');
+        size_t equalPos = line.find('=');
+
+        if ((dotPos == std::string::npos) || (equalPos == std::string::npos) ||
+            (dotPos > equalPos))
+        {
+            LE_WARN("%s:%u: malformed line", SOCKET_TUNING_CONFIG_FILE.c_str(),
+                                                                    lineNb);
+            continue;
+        }
+
+        std::string name = Trim(line.substr(0, dotPos));
+        std::string key = Trim(line.substr(dotPos + 1, equalPos - dotPos - 1));
+        std::string value = Trim(line.substr(equalPos + 1));
+        std::vector<SocketProfile>::iterator it;
+
+        for (it = profiles.begin(); it != profiles.end(); it++)
+        {
+            if (it->name == name)
+            {
+                break;
+            }
+        }
+
+        if (it == profiles.end())
+        {
+            /* New profile, starting from the kernel defaults */
+            SocketProfile profile = profiles.back();
+
+            profile.name = name;
+            profile.interface = name;
+            profiles.insert(profiles.end() - 1, profile);
+            it = profiles.end() - 2;
+        }
+
+        if (!setProfileValue(*it, key, value))
+        {
+            LE_WARN("%s:%u: unknown key %s", SOCKET_TUNING_CONFIG_FILE.c_str(),
+                                                    lineNb, key.c_str());
+        }
+    }
+
+    stats.assign(profiles.size(), ProfileStats());
+
+    for (size_t i = 0; i < profiles.size(); i++)
+    {
+        LE_INFO("Socket profile %s (%s): nodelay %d, keepalive "
+                "%u/%u/%u, buffers %u, user timeout %u ms",
+                profiles[i].name.c_str(), profiles[i].interface.c_str(),
+                profiles[i].noDelay,
+                profiles[i].keepIdleSec, profiles[i].keepIntvlSec,
+                profiles[i].keepCnt, getBufferSize(profiles[i]),
+                profiles[i].userTimeoutMs);
+    }
+
+    isLoaded = true;
+}
+
+/*!
+ * @brief Set a value of a profile from its configuration key
+ *
+ * @param[in,out] profile   Profile to update
+ * @param[in] key           Name of the value
+ * @param[in] value         Value, as read from the configuration file
+ *
+ * @return True if the key is known, false otherwise
+ * */
+bool SocketTuning::setProfileValue(SocketProfile& profile,
+                                    const std::string& key,
+                                    const std::string& value)
+{
+    uint32_t number = strtoul(value.c_str(), NULL, 0);
+    bool flag = (value == "true") || (value == "1");
+
+    if (key == "interface")
+    {
+        profile.interface = value;
+    }
+    else if (key == "noDelay")
+    {
+        profile.noDelay = flag;
+    }
+    else if (key == "keepIdleSec")
+    {
+        profile.keepIdleSec = number;
+    }
+    else if (key == "keepIntvlSec")
+    {
+        profile.keepIntvlSec = number;
+    }
+    else if (key == "keepCnt")
+    {
+        profile.keepCnt = number;
+    }
+    else if (key == "bandwidthKbps")
+    {
+        profile.bandwidthKbps = number;
+    }
+    else if (key == "rttMs")
+    {
+        profile.rttMs = number;
+    }
+    else if (key == "userTimeoutMs")
+    {
+        profile.userTimeoutMs = number;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Find the profile of an interface
+ *
+ * @param[in] interface     Name of the interface
+ *
+ * @return Index of the profile, the default profile if none matches
+ * */
+size_t SocketTuning::getProfileIndex(const std::string& interface)
+{
+    if (!isLoaded)
+    {
+        load();
+    }
+
+    for (size_t i = 0; i < profiles.size(); i++)
+    {
+        if (profiles[i].interface == interface)
+        {
+            return i;
+        }
+    }
+
+    /* The default profile is always the last one */
+    return profiles.size() - 1;
+}
+
+/*!
+ * @brief Compute the socket buffer size from the bandwidth-delay product of
+ * the link
+ *
+ * @param[in] profile   Profile of the link
+ *
+ * @return Size of the buffers in bytes, 0 to keep the kernel default
+ * */
+uint32_t SocketTuning::getBufferSize(const SocketProfile& profile)
+{
+    uint64_t bdp = ((uint64_t) profile.bandwidthKbps * profile.rttMs) / 8;
+
+    if (bdp == 0)
+    {
+        return 0;
+    }
+
+    return std::min(std::max(bdp, (uint64_t) SOCKET_BUFFER_MIN_SIZE),
+                    (uint64_t) SOCKET_BUFFER_MAX_SIZE);
+}
+
+/*!
+ * @brief Get the profile of an interface
+ *
+ * @param[in] interface     Name of the interface
+ *
+ * @return The profile, the default profile if none matches
+ * */
+const SocketProfile& SocketTuning::getProfile(const std::string& interface)
+{
+    return profiles[getProfileIndex(interface)];
+}
+
+/*!
+ * @brief Apply the profile of an interface to a TCP socket
+ *
+ * @param[in] fd            Socket
+ * @param[in] interface     Interface the socket is bound to
+ *
+ * @return Status of the operation. The options which could be set stay set
+ * even if others failed.
+ * */
+bool SocketTuning::apply(int32_t fd, const std::string& interface)
+{
+    size_t index = getProfileIndex(interface);
+    const SocketProfile& profile = profiles[index];
+    ProfileStats& profileStats = stats[index];
+    uint32_t bufferSize = getBufferSize(profile);
+    bool status = true;
+    int value;
+    socklen_t valueLen = sizeof(value);
+
+    if (profile.noDelay)
+    {
+        value = 1;
+        status &= (0 == setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+                                                    &value, sizeof(value)));
+    }
+
+    if (profile.keepIdleSec > 0)
+    {
+        value = 1;
+        status &= (0 == setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,
+                                                    &value, sizeof(value)));
+        value = profile.keepIdleSec;
+        status &= (0 == setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE,
+                                                    &value, sizeof(value)));
+    }
+
+    if (profile.keepIntvlSec > 0)
+    {
+        value = profile.keepIntvlSec;
+        status &= (0 == setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                                                    &value, sizeof(value)));
+    }
+
+    if (profile.keepCnt > 0)
+    {
+        value = profile.keepCnt;
+        status &= (0 == setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT,
+                                                    &value, sizeof(value)));
+    }
+
+    if (bufferSize > 0)
+    {
+        value = bufferSize;
+        status &= (0 == setsockopt(fd, SOL_SOCKET, SO_RCVBUF,
+                                                    &value, sizeof(value)));
+        status &= (0 == setsockopt(fd, SOL_SOCKET, SO_SNDBUF,
+                                                    &value, sizeof(value)));
+    }
+
+    if (profile.userTimeoutMs > 0)
+    {
+        value = profile.userTimeoutMs;
+        status &= (0 == setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                                                    &value, sizeof(value)));
+    }
+
+    /* Keep the sizes actually granted by the kernel for the stats */
+    if (0 == getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, &valueLen))
+    {
+        profileStats.effectiveRcvBuf = value;
+    }
+
+    valueLen = sizeof(value);
+    if (0 == getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &value, &valueLen))
+    {
+        profileStats.effectiveSndBuf = value;
+    }
+
+    if (status)
+    {
+        profileStats.appliedNb++;
+    }
+    else
+    {
+        LE_ERROR("Failed to apply socket profile %s: %s",
+                                    profile.name.c_str(), strerror(errno));
+        profileStats.failureNb++;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Log the use of each profile
+ *
+ * @return None
+ * */
+void SocketTuning::logStats(void)
+{
+    if (!isLoaded)
+    {
+        load();
+    }
+
+    for (size_t i = 0; i < profiles.size(); i++)
+    {
+        LE_INFO("Socket profile %s: applied %u, failed %u, rcvbuf %d,"
+                " sndbuf %d", profiles[i].name.c_str(), stats[i].appliedNb,
+                stats[i].failureNb, stats[i].effectiveRcvBuf,
+                stats[i].effectiveSndBuf);
+    }
+}
+
+/*** end of file ***/
@@ -0,0 +1,51 @@
+/** @file SocketTuning.h
+ *
+ * @brief This class applies the socket tuning profile of an interface to the
+ * sockets using it
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef SOCKET_TUNING_H
+#define SOCKET_TUNING_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Socket/SocketTuningUtils.h"
+#include <iostream>
+#include <vector>
+
+class SocketTuning
+{
+    private:
+        struct ProfileStats
+        {
+            uint32_t appliedNb;
+            uint32_t failureNb;
+            int32_t effectiveRcvBuf;
+            int32_t effectiveSndBuf;
+        };
+
+        static std::vector<SocketTuningTypes::SocketProfile> profiles;
+        static std::vector<ProfileStats> stats;
+        static bool isLoaded;
+
+        static void load(void);
+        static bool setProfileValue(SocketTuningTypes::SocketProfile& profile,
+                                    const std::string& key,
+                                    const std::string& value);
+        static size_t getProfileIndex(const std::string& interface);
+        static uint32_t getBufferSize(
+                            const SocketTuningTypes::SocketProfile& profile);
+
+    public:
+        static const SocketTuningTypes::SocketProfile& getProfile(
+                                            const std::string& interface);
+        static bool apply(int32_t fd, const std::string& interface);
+        static void logStats(void);
+};
+
+#endif /* SOCKET_TUNING_H */
+
+/*** end of file ***/
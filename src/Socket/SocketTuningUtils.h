@@ -0,0 +1,90 @@
+/** @file SocketTuningUtils.h
+ *
+ * @brief This file is used to define the types and default values of the
+ * socket tuning profiles
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef SOCKET_TUNING_UTILS_H
+#define SOCKET_TUNING_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <iostream>
+#include <vector>
+
+namespace SocketTuningTypes
+{
+    /* Socket options applied to the connections of an interface.
+     * A value of 0 keeps the kernel default. */
+    struct SocketProfile
+    {
+        /* Name of the profile */
+        std::string name;
+
+        /* Interface the profile is applied to */
+        std::string interface;
+
+        /* Disable Nagle's algorithm (TCP_NODELAY) */
+        bool noDelay;
+
+        /* Idle time before the first keepalive probe (TCP_KEEPIDLE) */
+        uint32_t keepIdleSec;
+
+        /* Interval between two keepalive probes (TCP_KEEPINTVL) */
+        uint32_t keepIntvlSec;
+
+        /* Number of unanswered probes before dropping (TCP_KEEPCNT) */
+        uint32_t keepCnt;
+
+        /* Bandwidth and round trip time of the link. Their product sizes
+         * the socket buffers (SO_RCVBUF, SO_SNDBUF) */
+        uint32_t bandwidthKbps;
+        uint32_t rttMs;
+
+        /* Maximum time unacknowledged data may stay (TCP_USER_TIMEOUT) */
+        uint32_t userTimeoutMs;
+    };
+}
+
+namespace SocketTuningConstants
+{
+    /* File overriding the default profiles. One "<profile>.<key> = <value>"
+     * per line, lines starting with '#' are ignored. Example:
+     *      wlan0.keepIdleSec = 20 */
+    const std::string SOCKET_TUNING_CONFIG_FILE =
+                                        "/home/root/socket_tuning.conf";
+
+    /* Interface used by the cellular data connection */
+    const std::string CELLULAR_INTERFACE = "rmnet_data0";
+
+    /* Name of the profile used when no profile matches the interface */
+    const std::string DEFAULT_PROFILE_NAME = "default";
+
+    /* Bounds of the socket buffer size computed from the link */
+    const uint32_t SOCKET_BUFFER_MIN_SIZE = 8 * 1024;
+    const uint32_t SOCKET_BUFFER_MAX_SIZE = 512 * 1024;
+
+    /* Default profiles */
+    const std::vector<SocketTuningTypes::SocketProfile> DEFAULT_PROFILES =
+    {
+        /* name,      interface,  nodelay, idle, intvl, cnt,
+         *                                  kbps,  rtt, user timeout */
+        { "eth0",     "eth0",     true,    10,   5,    3,
+                                            100000, 2,   20000 },
+        { "wlan0",    "wlan0",    true,    15,   5,    3,
+                                            20000,  10,  30000 },
+        { "cellular", CELLULAR_INTERFACE,
+                                  true,    60,   15,   4,
+                                            2000,   300, 120000 },
+        { DEFAULT_PROFILE_NAME, "",
+                                  false,   0,    0,    0,
+                                            0,      0,   0 }
+    };
+}
+
+#endif /* SOCKET_TUNING_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,1340 @@
+/** @file PduJournal.cpp
+ *
+ * @brief This class stores the PDUs received from the wearable devices on
+ * flash until they are uploaded (store and forward journal)
+ *
+ * The journal is a list of segment files of JOURNAL_SEGMENT_SIZE bytes, mapped
+ * in memory. Records are appended one after the other, each one protected by
+ * a CRC so that a record torn by a crash is detected and dropped when the
+ * journal is opened again. The segments fully consumed are deleted.
+ *
+ * The segments not read by the consumer yet can be rewritten, e.g. to make
+ * room under storage pressure. The records kept are written to a new file
+ * which replaces one or more consecutive segments. A small rewrite file
+ * records the replaced segments, so that an interrupted rewrite is completed
+ * or rolled back when the journal is opened again.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/PduJournal.h"
+#include "Utils/Crc32.h"
+#include <sys/mman.h>
+#include <dirent.h>
+#include <algorithm>
+
+using namespace PduJournalConstants;
+using namespace PduJournalTypes;
+
+/*!
+ * @brief Round a size up to the record alignment
+ *
+ * @param[in] size  Size in bytes
+ *
+ * @return Aligned size
+ * */
+static uint32_t AlignRecord(uint32_t size)
+{
+    return (size + JOURNAL_RECORD_ALIGN - 1) & ~(JOURNAL_RECORD_ALIGN - 1);
+}
+
+/*!
+ * @brief Compute the CRC of a record
+ *
+ * @param[in] header    Header of the record
+ * @param[in] data      Payload of the record
+ *
+ * @return CRC of the record
+ * */
+static uint32_t ComputeRecordCrc(RecordHeader header, const uint8_t* data)
+{
+    header.crc = 0;
+
+    uint32_t crc = Crc32::compute((const uint8_t*) &header, sizeof(header));
+
+    return Crc32::compute(data, header.length, crc);
+}
+
+/*!
+ * @brief Constructor for PduJournal. open() must be called before use.
+ *
+ * @param[in] name  Name of the journal, used as directory name
+ * */
+PduJournal::PduJournal(const std::string& name) :
+                        dir(JOURNAL_ROOT_DIR + "/" + name), writeOffset(0),
+                        nextSequence(0), cursorSequence(0),
+                        unsavedConfirmNb(0), pendingRecordNb(0),
+                        dirtyOffset(0), commitTimer(NULL), isOpen(false),
+                        appendNb(0), commitNb(0), refusedNb(0),
+                        readHorizonId(0), rewriteOffset(0)
+{
+    cursor.segmentId = 0;
+    cursor.offset = 0;
+    rewrite.id = 0;
+    rewrite.fd = -1;
+    rewrite.mapPtr = NULL;
+    rewrite.endOffset = 0;
+}
+
+/*!
+ * @brief Destructor for PduJournal. Commit the pending records.
+ * */
+PduJournal::~PduJournal(void)
+{
+    close();
+
+    if (commitTimer != NULL)
+    {
+        le_timer_Delete(commitTimer);
+    }
+}
+
+/*!
+ * @brief Commit the records which waited JOURNAL_COMMIT_DELAY_MS, even if
+ * nothing was appended since. Retried after the same delay on error.
+ *
+ * @param[in] timerRef  Reference to the commit timer
+ *
+ * @return None
+ * */
+void PduJournal::commitTimerHandler(le_timer_Ref_t timerRef)
+{
+    PduJournal* journalPtr = (PduJournal*) le_timer_GetContextPtr(timerRef);
+
+    if (!journalPtr->commit())
+    {
+        le_timer_Start(timerRef);
+    }
+}
+
+/*!
+ * @brief Get the path of a segment file
+ *
+ * @param[in] id    Identifier of the segment
+ *
+ * @return Path of the file
+ * */
+std::string PduJournal::getSegmentPath(uint32_t id) const
+{
+    char name[20];
+
+    snprintf(name, sizeof(name), "/%08u.seg", id);
+
+    return dir + name;
+}
+
+/*!
+ * @brief Open and map a segment file
+ *
+ * @param[in] path          Path of the file
+ * @param[in] isNew         True to create the file
+ * @param[in,out] segment   Segment, its file and mapping are set on success
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::mapSegment(const std::string& path, bool isNew,
+                            Segment& segment)
+{
+    struct stat fileStat;
+
+    segment.mapPtr = NULL;
+    segment.fd = ::open(path.c_str(),
+                        O_RDWR | O_CLOEXEC | (isNew ? (O_CREAT | O_EXCL) : 0),
+                        0644);
+
+    if (segment.fd < 0)
+    {
+        LE_ERROR("Failed to open %s: %m", path.c_str());
+        return false;
+    }
+
+    if (isNew)
+    {
+        /* Reserve the blocks now: writing to a sparse mapping of a full
+         * file system would raise SIGBUS */
+        int result = posix_fallocate(segment.fd, 0, JOURNAL_SEGMENT_SIZE);
+
+        if (result != 0)
+        {
+            LE_ERROR("Failed to allocate %s: %s", path.c_str(),
+                                                        strerror(result));
+            ::close(segment.fd);
+            unlink(path.c_str());
+            return false;
+        }
+    }
+    else if ((fstat(segment.fd, &fileStat) < 0) ||
+             (fileStat.st_size != (off_t) JOURNAL_SEGMENT_SIZE))
+    {
+        LE_ERROR("Segment %s has an invalid size, dropped", path.c_str());
+        ::close(segment.fd);
+        unlink(path.c_str());
+        return false;
+    }
+
+    void* mapPtr = mmap(NULL, JOURNAL_SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, segment.fd, 0);
+
+    if (mapPtr == MAP_FAILED)
+    {
+        LE_ERROR("Failed to map %s: %m", path.c_str());
+        ::close(segment.fd);
+        return false;
+    }
+
+    segment.mapPtr = (uint8_t*) mapPtr;
+
+    return true;
+}
+
+/*!
+ * @brief Open and map a segment file, at the end of the segment list
+ *
+ * @param[in] id        Identifier of the segment
+ * @param[in] isNew     True to create the file
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::openSegment(uint32_t id, bool isNew)
+{
+    Segment segment;
+
+    segment.id = id;
+    segment.endOffset = 0;
+
+    if (!mapSegment(getSegmentPath(id), isNew, segment))
+    {
+        return false;
+    }
+
+    segments.push_back(segment);
+
+    return true;
+}
+
+/*!
+ * @brief Unmap and close a segment file
+ *
+ * @param[in] segment   Segment to close
+ *
+ * @return None
+ * */
+void PduJournal::closeSegment(Segment& segment)
+{
+    if (segment.mapPtr != NULL)
+    {
+        munmap(segment.mapPtr, JOURNAL_SEGMENT_SIZE);
+        segment.mapPtr = NULL;
+    }
+
+    if (segment.fd >= 0)
+    {
+        ::close(segment.fd);
+        segment.fd = -1;
+    }
+}
+
+/*!
+ * @brief Find an open segment
+ *
+ * @param[in] id    Identifier of the segment
+ *
+ * @return The segment, NULL if it is not in the journal
+ * */
+PduJournal::Segment* PduJournal::findSegment(uint32_t id)
+{
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (segments[i].id == id)
+        {
+            return &segments[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Find the first open segment following an identifier, which may not
+ * be open anymore
+ *
+ * @param[in] id    Identifier of a segment
+ *
+ * @return Pointer to the segment, or NULL if there is none after it
+ * */
+PduJournal::Segment* PduJournal::findNextSegment(uint32_t id)
+{
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (segments[i].id > id)
+        {
+            return &segments[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Start a new segment for the next records
+ *
+ * @param[in] isAlert   True if the segment is started for an alert record,
+ *                      which can use the reserved segments
+ *
+ * @return Status of the operation, false if the journal is full
+ * */
+bool PduJournal::addSegment(bool isAlert)
+{
+    uint32_t id = segments.empty() ? 0 : (segments.back().id + 1);
+    uint16_t maxSegmentNb = JOURNAL_MAX_SEGMENTS +
+                                (isAlert ? JOURNAL_ALERT_RESERVE_SEGMENTS : 0);
+
+    if (segments.size() >= maxSegmentNb)
+    {
+        return false;
+    }
+
+    if (!segments.empty())
+    {
+        segments.back().endOffset = writeOffset;
+    }
+
+    if (!openSegment(id, true))
+    {
+        return false;
+    }
+
+    writeOffset = 0;
+    dirtyOffset = 0;
+
+    return true;
+}
+
+/*!
+ * @brief Get the offset following the last record of a segment
+ *
+ * @param[in] segment   Segment
+ *
+ * @return End of the records of the segment
+ * */
+uint32_t PduJournal::getSegmentEnd(const Segment& segment) const
+{
+    return (&segment == &segments.back()) ? writeOffset : segment.endOffset;
+}
+
+/*!
+ * @brief Write a record. The payload is written first, the record is only
+ * valid once its header is there.
+ *
+ * @param[out] ptr      Place of the record in a segment
+ * @param[in] header    Header of the record, its magic and CRC are set here
+ * @param[in] data      Payload of the record
+ *
+ * @return Aligned size of the record
+ * */
+uint32_t PduJournal::writeRecord(uint8_t* ptr, RecordHeader header,
+                                    const uint8_t* data)
+{
+    header.magic = JOURNAL_RECORD_MAGIC;
+    header.crc = ComputeRecordCrc(header, data);
+
+    memcpy(ptr + sizeof(header), data, header.length);
+    memcpy(ptr, &header, sizeof(header));
+
+    return AlignRecord(sizeof(header) + header.length);
+}
+
+/*!
+ * @brief Check if a valid record starts at a given place
+ *
+ * @param[in] ptr           Start of the record
+ * @param[in] availableNb   Number of bytes until the end of the segment
+ * @param[out] headerPtr    Header of the record, if valid
+ *
+ * @return True if the record is complete and its CRC matches
+ * */
+bool PduJournal::checkRecord(const uint8_t* ptr, uint32_t availableNb,
+                                RecordHeader* headerPtr)
+{
+    RecordHeader header;
+
+    if (availableNb < sizeof(header))
+    {
+        return false;
+    }
+
+    memcpy(&header, ptr, sizeof(header));
+
+    if ((header.magic != JOURNAL_RECORD_MAGIC) ||
+        (header.length > (availableNb - sizeof(header))) ||
+        (header.crc != ComputeRecordCrc(header, ptr + sizeof(header))))
+    {
+        return false;
+    }
+
+    *headerPtr = header;
+
+    return true;
+}
+
+/*!
+ * @brief Find the end of the valid records of a segment
+ *
+ * @param[in] segment           Segment to scan
+ * @param[out] lastSequencePtr  Sequence of the last valid record, unchanged
+ *                              if the segment is empty
+ *
+ * @return Offset following the last valid record
+ * */
+uint32_t PduJournal::scanSegment(const Segment& segment,
+                                    uint64_t* lastSequencePtr)
+{
+    uint32_t offset = 0;
+    RecordHeader header;
+
+    while (checkRecord(segment.mapPtr + offset, JOURNAL_SEGMENT_SIZE - offset,
+                                                                    &header))
+    {
+        *lastSequencePtr = header.sequence;
+        offset += AlignRecord(sizeof(header) + header.length);
+    }
+
+    return offset;
+}
+
+/*!
+ * @brief Load the consumer cursor saved on flash
+ *
+ * @return True if a valid cursor was loaded
+ * */
+bool PduJournal::loadCursor(void)
+{
+    CursorFile cursorFile;
+    int fd = ::open((dir + "/cursor").c_str(), O_RDONLY | O_CLOEXEC);
+    bool status = false;
+
+    if (fd >= 0)
+    {
+        if ((::read(fd, &cursorFile, sizeof(cursorFile)) ==
+                                            (ssize_t) sizeof(cursorFile)) &&
+            (cursorFile.magic == JOURNAL_CURSOR_MAGIC) &&
+            (cursorFile.crc == Crc32::compute((const uint8_t*) &cursorFile,
+                                    offsetof(CursorFile, crc))))
+        {
+            cursor = cursorFile.position;
+            cursorSequence = cursorFile.sequence;
+            status = true;
+        }
+
+        ::close(fd);
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Save the consumer cursor on flash. The file is replaced atomically
+ * so that a crash leaves either the old or the new cursor.
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::saveCursor(void)
+{
+    CursorFile cursorFile;
+    std::string tmpPath = dir + "/cursor.tmp";
+    bool status = true;
+
+    memset(&cursorFile, 0, sizeof(cursorFile));
+    cursorFile.magic = JOURNAL_CURSOR_MAGIC;
+    cursorFile.position = cursor;
+    cursorFile.sequence = cursorSequence;
+    cursorFile.crc = Crc32::compute((const uint8_t*) &cursorFile,
+                                    offsetof(CursorFile, crc));
+
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                                                        0644);
+
+    if (fd < 0)
+    {
+        LE_ERROR("Failed to save the cursor: %m");
+        return false;
+    }
+
+    if ((::write(fd, &cursorFile, sizeof(cursorFile)) !=
+                                            (ssize_t) sizeof(cursorFile)) ||
+        (fdatasync(fd) < 0))
+    {
+        LE_ERROR("Failed to write the cursor: %m");
+        status = false;
+    }
+
+    ::close(fd);
+
+    if (status && (rename(tmpPath.c_str(), (dir + "/cursor").c_str()) < 0))
+    {
+        LE_ERROR("Failed to replace the cursor: %m");
+        status = false;
+    }
+
+    if (status)
+    {
+        unsavedConfirmNb = 0;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Delete the segments the consumer is done with. The segment being
+ * written is always kept.
+ *
+ * @return None
+ * */
+void PduJournal::releaseConsumedSegments(void)
+{
+    while ((segments.size() > 1) && (segments.front().id < cursor.segmentId))
+    {
+        LE_DEBUG("Segment %u consumed", segments.front().id);
+
+        closeSegment(segments.front());
+        unlink(getSegmentPath(segments.front().id).c_str());
+        segments.pop_front();
+    }
+}
+
+/*!
+ * @brief Save the segments replaced by the rewrite in progress
+ *
+ * @param[in] lastId    Last segment replaced
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::saveRewriteFile(uint32_t lastId)
+{
+    RewriteFile rewriteFile;
+    bool status = true;
+
+    memset(&rewriteFile, 0, sizeof(rewriteFile));
+    rewriteFile.magic = JOURNAL_REWRITE_MAGIC;
+    rewriteFile.firstId = rewrite.id;
+    rewriteFile.lastId = lastId;
+    rewriteFile.crc = Crc32::compute((const uint8_t*) &rewriteFile,
+                                        offsetof(RewriteFile, crc));
+
+    int fd = ::open((dir + "/rewrite").c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        LE_ERROR("Failed to save the rewrite: %m");
+        return false;
+    }
+
+    if ((::write(fd, &rewriteFile, sizeof(rewriteFile)) !=
+                                            (ssize_t) sizeof(rewriteFile)) ||
+        (fdatasync(fd) < 0))
+    {
+        LE_ERROR("Failed to write the rewrite: %m");
+        status = false;
+    }
+
+    ::close(fd);
+
+    return status;
+}
+
+/*!
+ * @brief Complete or roll back a rewrite interrupted by a stop or crash. If
+ * the new file was not installed yet, the old segments are kept, otherwise
+ * the segments it replaces are deleted.
+ *
+ * @return None
+ * */
+void PduJournal::recoverRewrite(void)
+{
+    RewriteFile rewriteFile;
+    std::string rewritePath = dir + "/rewrite";
+    int fd = ::open(rewritePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if ((::read(fd, &rewriteFile, sizeof(rewriteFile)) ==
+                                        (ssize_t) sizeof(rewriteFile)) &&
+        (rewriteFile.magic == JOURNAL_REWRITE_MAGIC) &&
+        (rewriteFile.crc == Crc32::compute((const uint8_t*) &rewriteFile,
+                                            offsetof(RewriteFile, crc))))
+    {
+        std::string tmpPath = getSegmentPath(rewriteFile.firstId) + ".tmp";
+
+        if (access(tmpPath.c_str(), F_OK) == 0)
+        {
+            LE_WARN("Rewrite of segment %u rolled back", rewriteFile.firstId);
+            unlink(tmpPath.c_str());
+        }
+        else
+        {
+            LE_WARN("Rewrite of segments %u to %u completed",
+                    rewriteFile.firstId, rewriteFile.lastId);
+
+            for (uint32_t id = rewriteFile.firstId + 1;
+                 id <= rewriteFile.lastId; id++)
+            {
+                unlink(getSegmentPath(id).c_str());
+            }
+        }
+    }
+
+    ::close(fd);
+    unlink(rewritePath.c_str());
+}
+
+/*!
+ * @brief Delete a range of segments, except the one being written
+ *
+ * @param[in] firstId   First segment to delete
+ * @param[in] lastId    Last segment to delete
+ *
+ * @return None
+ * */
+void PduJournal::dropSegments(uint32_t firstId, uint32_t lastId)
+{
+    size_t i = 0;
+
+    while (i < (segments.size() - 1))
+    {
+        if ((segments[i].id >= firstId) && (segments[i].id <= lastId))
+        {
+            closeSegment(segments[i]);
+            unlink(getSegmentPath(segments[i].id).c_str());
+            segments.erase(segments.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/*!
+ * @brief Check if a segment can be rewritten: the consumer did not read any
+ * of its records, and it is not the segment being written
+ *
+ * @param[in] id    Identifier of the segment
+ *
+ * @return True if the segment can be rewritten
+ * */
+bool PduJournal::isRewritable(uint32_t id) const
+{
+    return isOpen && (id > cursor.segmentId) && (id > readHorizonId) &&
+           (id < segments.back().id);
+}
+
+/*!
+ * @brief Open the journal, recovering the records written before the last
+ * stop or crash
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::open(void)
+{
+    std::vector<uint32_t> ids;
+    uint64_t lastSequence = 0;
+    bool hasRecords = false;
+
+    if (isOpen)
+    {
+        return true;
+    }
+
+    mkdir(JOURNAL_ROOT_DIR.c_str(), 0755);
+    mkdir(dir.c_str(), 0755);
+
+    recoverRewrite();
+
+    DIR* dirPtr = opendir(dir.c_str());
+
+    if (dirPtr == NULL)
+    {
+        LE_ERROR("Failed to open %s: %m", dir.c_str());
+        return false;
+    }
+
+    struct dirent* entryPtr;
+
+    while ((entryPtr = readdir(dirPtr)) != NULL)
+    {
+        uint32_t id;
+        char suffix[8] = {0};
+
+        if (sscanf(entryPtr->d_name, "%8u.%7s", &id, suffix) != 2)
+        {
+            continue;
+        }
+
+        if (strcmp(suffix, "seg") == 0)
+        {
+            ids.push_back(id);
+        }
+        else if (strcmp(suffix, "seg.tmp") == 0)
+        {
+            /* Left by a rewrite interrupted before it was recorded */
+            unlink((dir + "/" + entryPtr->d_name).c_str());
+        }
+    }
+
+    closedir(dirPtr);
+    std::sort(ids.begin(), ids.end());
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        openSegment(ids[i], false);
+    }
+
+    if (segments.empty())
+    {
+        if (!addSegment(false))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        /* Only the last segment can have a torn record, the others were
+         * completed before a new one was started */
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            uint64_t sequence = lastSequence;
+
+            writeOffset = scanSegment(segments[i], &sequence);
+            segments[i].endOffset = writeOffset;
+
+            if (writeOffset > 0)
+            {
+                lastSequence = sequence;
+                hasRecords = true;
+            }
+        }
+
+        /* Clear what follows the last valid record, a torn record must not
+         * be mistaken for a valid one once partially overwritten */
+        memset(segments.back().mapPtr + writeOffset, 0,
+                                        JOURNAL_SEGMENT_SIZE - writeOffset);
+        dirtyOffset = writeOffset;
+    }
+
+    if (!loadCursor() || (findSegment(cursor.segmentId) == NULL))
+    {
+        cursor.segmentId = segments.front().id;
+        cursor.offset = 0;
+    }
+
+    nextSequence = std::max(hasRecords ? (lastSequence + 1) : 0,
+                            cursorSequence + 1);
+
+    if (commitTimer == NULL)
+    {
+        commitTimer = le_timer_Create("JournalCommitTimer");
+        le_timer_SetMsInterval(commitTimer, JOURNAL_COMMIT_DELAY_MS);
+        le_timer_SetHandler(commitTimer, commitTimerHandler);
+        le_timer_SetContextPtr(commitTimer, this);
+    }
+
+    isOpen = true;
+
+    LE_INFO("Journal %s opened: %u segments, pending %llu bytes, next "
+            "sequence %llu", dir.c_str(), (uint32_t) segments.size(),
+            (unsigned long long) getPendingBytesNb(),
+            (unsigned long long) nextSequence);
+
+    return true;
+}
+
+/*!
+ * @brief Commit the pending records, save the cursor and close the journal
+ *
+ * @return None
+ * */
+void PduJournal::close(void)
+{
+    if (!isOpen)
+    {
+        return;
+    }
+
+    commit();
+    abortRewrite();
+
+    if (unsavedConfirmNb > 0)
+    {
+        saveCursor();
+    }
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        closeSegment(segments[i]);
+    }
+
+    segments.clear();
+    isOpen = false;
+}
+
+/*!
+ * @brief Append a record to the journal. The record can be read right away,
+ * it is on flash after the next commit.
+ *
+ * @param[in] type      Type of the PDU
+ * @param[in] mac       MAC address of the device which sent the PDU
+ * @param[in] data      Payload of the PDU
+ * @param[in] len       Size of the payload
+ * @param[in] flags     Flags to keep with the record, JOURNAL_FLAG_ALERT
+ *                      lets the record use the reserved segments
+ *
+ * @return LE_OK on success, LE_NO_MEMORY if the journal is full,
+ * LE_OVERFLOW if the record is bigger than a segment, LE_FAULT on error
+ * */
+le_result_t PduJournal::append(uint8_t type, const uint8_t* mac,
+                                const uint8_t* data, uint32_t len,
+                                uint8_t flags)
+{
+    RecordHeader header;
+    uint32_t recordSize = AlignRecord(sizeof(header) + len);
+
+    if (!isOpen || (mac == NULL) || ((data == NULL) && (len > 0)))
+    {
+        return LE_FAULT;
+    }
+
+    if (recordSize > JOURNAL_SEGMENT_SIZE)
+    {
+        LE_ERROR("Record of %u bytes too big for the journal", len);
+        return LE_OVERFLOW;
+    }
+
+    if ((writeOffset + recordSize) > JOURNAL_SEGMENT_SIZE)
+    {
+        /* The current segment is complete */
+        commit();
+
+        if (!addSegment((flags & JOURNAL_FLAG_ALERT) != 0))
+        {
+            refusedNb++;
+            return LE_NO_MEMORY;
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.length = len;
+    header.type = type;
+    header.flags = flags;
+    memcpy(header.mac, mac, sizeof(header.mac));
+    header.sequence = nextSequence;
+    header.timestamp = time(NULL);
+
+    writeOffset += writeRecord(segments.back().mapPtr + writeOffset, header,
+                                                                        data);
+    nextSequence++;
+    appendNb++;
+
+    if (pendingRecordNb == 0)
+    {
+        /* Bounds the time the record waits when no other one follows */
+        firstPendingTime = le_clk_GetRelativeTime();
+        le_timer_Start(commitTimer);
+    }
+    pendingRecordNb++;
+
+    commitIfDue();
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Flush the records appended since the last commit to flash
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::commit(void)
+{
+    bool status = true;
+
+    if (!isOpen || (pendingRecordNb == 0))
+    {
+        return true;
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uint32_t start = dirtyOffset & ~(pageSize - 1);
+
+    if (msync(segments.back().mapPtr + start, writeOffset - start, MS_SYNC) < 0)
+    {
+        LE_ERROR("Failed to commit the journal: %m");
+        status = false;
+    }
+    else
+    {
+        dirtyOffset = writeOffset;
+        pendingRecordNb = 0;
+        commitNb++;
+        le_timer_Stop(commitTimer);
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Commit the pending records if enough of them were appended, or if
+ * the oldest one waited long enough (group commit). The commit timer does
+ * the same when no record is appended.
+ *
+ * @return None
+ * */
+void PduJournal::commitIfDue(void)
+{
+    if (pendingRecordNb == 0)
+    {
+        return;
+    }
+
+    le_clk_Time_t elapsed = le_clk_Sub(le_clk_GetRelativeTime(),
+                                                        firstPendingTime);
+    uint32_t elapsedMs = elapsed.sec * 1000 + elapsed.usec / 1000;
+
+    if ((pendingRecordNb >= JOURNAL_COMMIT_RECORDS) ||
+        (elapsedMs >= JOURNAL_COMMIT_DELAY_MS))
+    {
+        commit();
+    }
+}
+
+/*!
+ * @brief Get the number of records appended and not on flash yet
+ *
+ * @return Number of records not committed
+ * */
+uint32_t PduJournal::getUncommittedNb(void) const
+{
+    return pendingRecordNb;
+}
+
+/*!
+ * @brief Get the position of the first record not confirmed by the consumer
+ *
+ * @return Position of the cursor
+ * */
+Position PduJournal::getCursor(void) const
+{
+    return cursor;
+}
+
+/*!
+ * @brief Read the record at a position and move the position to the next
+ * record
+ *
+ * @param[in,out] position  Position of the record to read
+ * @param[out] headerPtr    Header of the record
+ * @param[out] payload      Payload of the record
+ *
+ * @return LE_OK on success, LE_NOT_FOUND if there is no more record
+ * */
+le_result_t PduJournal::read(Position& position, RecordHeader* headerPtr,
+                                std::vector<uint8_t>& payload)
+{
+    if (!isOpen || (headerPtr == NULL))
+    {
+        return LE_FAULT;
+    }
+
+    while (true)
+    {
+        Segment* segmentPtr = findSegment(position.segmentId);
+
+        /* The segment was deleted once consumed, or evicted after the
+         * position reached it: continue with the next one */
+        if (segmentPtr == NULL)
+        {
+            segmentPtr = findNextSegment(position.segmentId);
+
+            if (segmentPtr == NULL)
+            {
+                return LE_NOT_FOUND;
+            }
+
+            position.segmentId = segmentPtr->id;
+            position.offset = 0;
+        }
+
+        bool isWriteSegment = (segmentPtr == &segments.back());
+
+        if ((!isWriteSegment || (position.offset < writeOffset)) &&
+            checkRecord(segmentPtr->mapPtr + position.offset,
+                        JOURNAL_SEGMENT_SIZE - position.offset, headerPtr))
+        {
+            const uint8_t* dataPtr = segmentPtr->mapPtr + position.offset +
+                                                        sizeof(RecordHeader);
+
+            payload.assign(dataPtr, dataPtr + headerPtr->length);
+            readHorizonId = std::max(readHorizonId, position.segmentId);
+            position.offset += AlignRecord(sizeof(RecordHeader) +
+                                                        headerPtr->length);
+
+            return LE_OK;
+        }
+
+        if (isWriteSegment)
+        {
+            return LE_NOT_FOUND;
+        }
+
+        /* End of a completed segment, continue with the next one. Ids can
+         * have gaps if a damaged segment was dropped when opening. */
+        position.segmentId = findNextSegment(position.segmentId)->id;
+        position.offset = 0;
+    }
+}
+
+/*!
+ * @brief Move the consumer cursor once the records before a position were
+ * uploaded. The segments fully consumed are deleted.
+ *
+ * @param[in] position  Position following the last record uploaded
+ * @param[in] sequence  Sequence of the last record uploaded
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::confirm(const Position& position, uint64_t sequence)
+{
+    bool status = true;
+
+    if (!isOpen)
+    {
+        return false;
+    }
+
+    cursor = position;
+    cursorSequence = sequence;
+    unsavedConfirmNb++;
+
+    if (unsavedConfirmNb >= JOURNAL_CURSOR_SAVE_RECORDS)
+    {
+        status = saveCursor();
+    }
+
+    /* The cursor must be on flash before the segments are deleted */
+    if ((segments.front().id < cursor.segmentId) && (unsavedConfirmNb > 0))
+    {
+        status = saveCursor();
+    }
+
+    if (status)
+    {
+        releaseConsumedSegments();
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Get the number of segments used by the journal
+ *
+ * @return Number of segments
+ * */
+uint16_t PduJournal::getSegmentNb(void) const
+{
+    return segments.size();
+}
+
+/*!
+ * @brief Get the number of bytes between the consumer cursor and the end of
+ * the journal
+ *
+ * @return Number of bytes still to be consumed
+ * */
+uint64_t PduJournal::getPendingBytesNb(void) const
+{
+    uint64_t pendingNb = 0;
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        uint32_t endOffset = getSegmentEnd(segments[i]);
+
+        if (segments[i].id > cursor.segmentId)
+        {
+            pendingNb += endOffset;
+        }
+        else if ((segments[i].id == cursor.segmentId) &&
+                 (endOffset > cursor.offset))
+        {
+            pendingNb += endOffset - cursor.offset;
+        }
+    }
+
+    return pendingNb;
+}
+
+/*!
+ * @brief Get the segments which can be rewritten, oldest first
+ *
+ * @param[out] ids  Identifiers of the segments
+ *
+ * @return None
+ * */
+void PduJournal::getRewritableSegments(std::vector<uint32_t>& ids) const
+{
+    ids.clear();
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (isRewritable(segments[i].id))
+        {
+            ids.push_back(segments[i].id);
+        }
+    }
+}
+
+/*!
+ * @brief Get the record at a position of a segment without copying it, and
+ * move the position to the next record. Unlike read(), the position does
+ * not move to the next segment.
+ *
+ * @param[in,out] position  Position of the record
+ * @param[out] headerPtr    Header of the record
+ * @param[out] dataPtr      Payload of the record, valid until the segment
+ *                          is rewritten or deleted
+ *
+ * @return LE_OK on success, LE_NOT_FOUND at the end of the segment
+ * */
+le_result_t PduJournal::peekRecord(Position& position,
+                                    RecordHeader* headerPtr,
+                                    const uint8_t** dataPtr) const
+{
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        const Segment& segment = segments[i];
+
+        if (segment.id != position.segmentId)
+        {
+            continue;
+        }
+
+        if ((position.offset >= getSegmentEnd(segment)) ||
+            !checkRecord(segment.mapPtr + position.offset,
+                            JOURNAL_SEGMENT_SIZE - position.offset,
+                            headerPtr))
+        {
+            return LE_NOT_FOUND;
+        }
+
+        *dataPtr = segment.mapPtr + position.offset + sizeof(RecordHeader);
+        position.offset += AlignRecord(sizeof(RecordHeader) +
+                                                        headerPtr->length);
+
+        return LE_OK;
+    }
+
+    return LE_NOT_FOUND;
+}
+
+/*!
+ * @brief Start the rewrite of segments. The records kept are appended with
+ * appendRewrite(), then commitRewrite() replaces the segments.
+ *
+ * @param[in] firstId   First segment to rewrite, the new file takes its place
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::beginRewrite(uint32_t firstId)
+{
+    if (rewrite.mapPtr != NULL)
+    {
+        LE_ERROR("Rewrite of segment %u already in progress", rewrite.id);
+        return false;
+    }
+
+    if (!isRewritable(firstId))
+    {
+        return false;
+    }
+
+    std::string tmpPath = getSegmentPath(firstId) + ".tmp";
+
+    unlink(tmpPath.c_str());
+
+    rewrite.id = firstId;
+
+    if (!mapSegment(tmpPath, true, rewrite))
+    {
+        rewrite.fd = -1;
+        return false;
+    }
+
+    rewriteOffset = 0;
+
+    return true;
+}
+
+/*!
+ * @brief Append a record to the rewrite in progress
+ *
+ * @param[in] header    Header of the record, the sequence, timestamp, type,
+ *                      flags and MAC address are kept
+ * @param[in] data      Payload of the record
+ *
+ * @return LE_OK on success, LE_OVERFLOW if the new segment is full,
+ * LE_FAULT if no rewrite is in progress
+ * */
+le_result_t PduJournal::appendRewrite(const RecordHeader& header,
+                                        const uint8_t* data)
+{
+    if ((rewrite.mapPtr == NULL) || ((data == NULL) && (header.length > 0)))
+    {
+        return LE_FAULT;
+    }
+
+    if ((rewriteOffset + AlignRecord(sizeof(header) + header.length)) >
+                                                        JOURNAL_SEGMENT_SIZE)
+    {
+        return LE_OVERFLOW;
+    }
+
+    rewriteOffset += writeRecord(rewrite.mapPtr + rewriteOffset, header, data);
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Get the size of the records appended to the rewrite in progress
+ *
+ * @return Offset following the last record appended
+ * */
+uint32_t PduJournal::getRewriteOffset(void) const
+{
+    return rewriteOffset;
+}
+
+/*!
+ * @brief Drop the records appended to the rewrite after an offset
+ *
+ * @param[in] offset    Offset returned by getRewriteOffset() earlier
+ *
+ * @return None
+ * */
+void PduJournal::truncateRewrite(uint32_t offset)
+{
+    if ((rewrite.mapPtr != NULL) && (offset < rewriteOffset))
+    {
+        memset(rewrite.mapPtr + offset, 0, rewriteOffset - offset);
+        rewriteOffset = offset;
+    }
+}
+
+/*!
+ * @brief Replace the segments from the first one given to beginRewrite() up
+ * to lastId with the records appended. The segments are only deleted if no
+ * record is kept. The rewrite is aborted if the consumer read one of the
+ * segments meanwhile.
+ *
+ * @param[in] lastId    Last segment replaced
+ *
+ * @return Status of the operation
+ * */
+bool PduJournal::commitRewrite(uint32_t lastId)
+{
+    uint32_t firstId = rewrite.id;
+
+    if (rewrite.mapPtr == NULL)
+    {
+        return false;
+    }
+
+    if ((lastId < firstId) || !isRewritable(firstId) ||
+        !isRewritable(lastId) || (findSegment(firstId) == NULL))
+    {
+        LE_WARN("Segments %u to %u not rewritable anymore", firstId, lastId);
+        abortRewrite();
+        return false;
+    }
+
+    if (rewriteOffset == 0)
+    {
+        abortRewrite();
+        dropSegments(firstId, lastId);
+        return true;
+    }
+
+    std::string tmpPath = getSegmentPath(firstId) + ".tmp";
+
+    if ((msync(rewrite.mapPtr, rewriteOffset, MS_SYNC) < 0) ||
+        (fdatasync(rewrite.fd) < 0))
+    {
+        LE_ERROR("Failed to write the rewrite of segment %u: %m", firstId);
+        abortRewrite();
+        return false;
+    }
+
+    if (!saveRewriteFile(lastId))
+    {
+        abortRewrite();
+        return false;
+    }
+
+    if (rename(tmpPath.c_str(), getSegmentPath(firstId).c_str()) < 0)
+    {
+        LE_ERROR("Failed to replace segment %u: %m", firstId);
+        unlink((dir + "/rewrite").c_str());
+        abortRewrite();
+        return false;
+    }
+
+    Segment* segmentPtr = findSegment(firstId);
+
+    closeSegment(*segmentPtr);
+    segmentPtr->fd = rewrite.fd;
+    segmentPtr->mapPtr = rewrite.mapPtr;
+    segmentPtr->endOffset = rewriteOffset;
+    rewrite.fd = -1;
+    rewrite.mapPtr = NULL;
+    rewriteOffset = 0;
+
+    dropSegments(firstId + 1, lastId);
+    unlink((dir + "/rewrite").c_str());
+
+    return true;
+}
+
+/*!
+ * @brief Abort the rewrite in progress, the segments are left unchanged
+ *
+ * @return None
+ * */
+void PduJournal::abortRewrite(void)
+{
+    if (rewrite.mapPtr == NULL)
+    {
+        return;
+    }
+
+    closeSegment(rewrite);
+    unlink((getSegmentPath(rewrite.id) + ".tmp").c_str());
+    rewriteOffset = 0;
+}
+
+/*!
+ * @brief Log the statistics of the journal
+ *
+ * @return None
+ * */
+void PduJournal::logStats(void) const
+{
+    LE_INFO("Journal %s: %u segments, pending %llu bytes, appended %u, "
+            "commits %u, refused %u", dir.c_str(), (uint32_t) segments.size(),
+            (unsigned long long) getPendingBytesNb(), appendNb, commitNb,
+            refusedNb);
+}
+
+/*** end of file ***/
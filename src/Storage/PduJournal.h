@@ -0,0 +1,107 @@
+/** @file PduJournal.h
+ *
+ * @brief This class stores the PDUs received from the wearable devices on
+ * flash until they are uploaded (store and forward journal)
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef PDU_JOURNAL_H
+#define PDU_JOURNAL_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/PduJournalUtils.h"
+#include <deque>
+#include <vector>
+
+class PduJournal
+{
+    private:
+        struct Segment
+        {
+            uint32_t id;
+            int32_t fd;
+            uint8_t* mapPtr;
+            uint32_t endOffset;
+        };
+
+        std::string dir;
+        std::deque<Segment> segments;
+        uint32_t writeOffset;
+        uint64_t nextSequence;
+        PduJournalTypes::Position cursor;
+        uint64_t cursorSequence;
+        uint16_t unsavedConfirmNb;
+        uint32_t pendingRecordNb;
+        uint32_t dirtyOffset;
+        le_clk_Time_t firstPendingTime;
+        le_timer_Ref_t commitTimer;
+        bool isOpen;
+        uint32_t appendNb;
+        uint32_t commitNb;
+        uint32_t refusedNb;
+        uint32_t readHorizonId;
+        Segment rewrite;
+        uint32_t rewriteOffset;
+
+        static void commitTimerHandler(le_timer_Ref_t timerRef);
+        std::string getSegmentPath(uint32_t id) const;
+        bool mapSegment(const std::string& path, bool isNew, Segment& segment);
+        bool openSegment(uint32_t id, bool isNew);
+        void closeSegment(Segment& segment);
+        Segment* findSegment(uint32_t id);
+        Segment* findNextSegment(uint32_t id);
+        bool addSegment(bool isAlert);
+        uint32_t getSegmentEnd(const Segment& segment) const;
+        static uint32_t writeRecord(uint8_t* ptr,
+                                    PduJournalTypes::RecordHeader header,
+                                    const uint8_t* data);
+        static bool checkRecord(const uint8_t* ptr, uint32_t availableNb,
+                                PduJournalTypes::RecordHeader* headerPtr);
+        uint32_t scanSegment(const Segment& segment, uint64_t* lastSequencePtr);
+        bool loadCursor(void);
+        bool saveCursor(void);
+        void releaseConsumedSegments(void);
+        bool saveRewriteFile(uint32_t lastId);
+        void recoverRewrite(void);
+        void dropSegments(uint32_t firstId, uint32_t lastId);
+
+    public:
+        PduJournal(const std::string& name);
+        ~PduJournal(void);
+        bool open(void);
+        void close(void);
+        le_result_t append(uint8_t type, const uint8_t* mac,
+                            const uint8_t* data, uint32_t len,
+                            uint8_t flags = 0);
+        bool commit(void);
+        void commitIfDue(void);
+        uint32_t getUncommittedNb(void) const;
+        PduJournalTypes::Position getCursor(void) const;
+        le_result_t read(PduJournalTypes::Position& position,
+                            PduJournalTypes::RecordHeader* headerPtr,
+                            std::vector<uint8_t>& payload);
+        bool confirm(const PduJournalTypes::Position& position,
+                        uint64_t sequence);
+        uint16_t getSegmentNb(void) const;
+        uint64_t getPendingBytesNb(void) const;
+        bool isRewritable(uint32_t id) const;
+        void getRewritableSegments(std::vector<uint32_t>& ids) const;
+        le_result_t peekRecord(PduJournalTypes::Position& position,
+                                PduJournalTypes::RecordHeader* headerPtr,
+                                const uint8_t** dataPtr) const;
+        bool beginRewrite(uint32_t firstId);
+        le_result_t appendRewrite(const PduJournalTypes::RecordHeader& header,
+                                    const uint8_t* data);
+        uint32_t getRewriteOffset(void) const;
+        void truncateRewrite(uint32_t offset);
+        bool commitRewrite(uint32_t lastId);
+        void abortRewrite(void);
+        void logStats(void) const;
+};
+
+#endif /* PDU_JOURNAL_H */
+
+/*** end of file ***/
@@ -0,0 +1,105 @@
+/** @file PduJournalUtils.h
+ *
+ * @brief This file is used to define the types and constants of the PDU
+ * journal
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef PDU_JOURNAL_UTILS_H
+#define PDU_JOURNAL_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Com/WearableDeviceALPUtils.h"
+#include <iostream>
+
+namespace PduJournalTypes
+{
+    /* Header written in front of each record. The CRC covers the header,
+     * with the crc field set to 0, and the payload. */
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t length;
+        uint32_t crc;
+        uint8_t type;
+        uint8_t flags;
+        uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+        uint64_t sequence;
+        uint32_t timestamp;
+        uint32_t reserved;
+    };
+
+    /* Position of a record in the journal */
+    struct Position
+    {
+        uint32_t segmentId;
+        uint32_t offset;
+    };
+
+    /* Cursor of the consumer, as stored on flash */
+    struct CursorFile
+    {
+        uint32_t magic;
+        Position position;
+        uint64_t sequence;
+        uint32_t crc;
+    };
+
+    /* Segments being replaced by a rewrite, as stored on flash while the
+     * replacement is installed */
+    struct RewriteFile
+    {
+        uint32_t magic;
+        uint32_t firstId;
+        uint32_t lastId;
+        uint32_t crc;
+    };
+}
+
+namespace PduJournalConstants
+{
+    /* Directory holding the journals, one sub-directory per journal */
+    const std::string JOURNAL_ROOT_DIR = "/home/root/journal";
+
+    /* Size of a segment file */
+    const uint32_t JOURNAL_SEGMENT_SIZE = 1024 * 1024;
+
+    /* Maximum number of segments of a journal, bounding its flash usage */
+    const uint16_t JOURNAL_MAX_SEGMENTS = 16;
+
+    /* Segments only usable by the alert records, so that alerts are still
+     * stored once the journal is full of other records */
+    const uint16_t JOURNAL_ALERT_RESERVE_SEGMENTS = 1;
+
+    /* Magic numbers identifying the records and the cursor file */
+    const uint32_t JOURNAL_RECORD_MAGIC = 0x4A524543;
+    const uint32_t JOURNAL_CURSOR_MAGIC = 0x4A435552;
+    const uint32_t JOURNAL_REWRITE_MAGIC = 0x4A525752;
+
+    /* Record flags */
+    /* Alert class record, never dropped to make room */
+    const uint8_t JOURNAL_FLAG_ALERT = 0x01;
+    /* Record holding several PDUs packed by the retention, its payload is
+     * an uplink batch (see UplinkBatcherUtils.h) and its MAC address is 0 */
+    const uint8_t JOURNAL_FLAG_COMPACTED = 0x02;
+
+    /* Records are aligned on this size in the segments */
+    const uint32_t JOURNAL_RECORD_ALIGN = 8;
+
+    /* The appended records are flushed to flash once this many are pending
+     * (group commit), or when the oldest one waited JOURNAL_COMMIT_DELAY_MS */
+    const uint16_t JOURNAL_COMMIT_RECORDS = 32;
+    const uint32_t JOURNAL_COMMIT_DELAY_MS = 200;
+
+    /* The consumer cursor is saved every JOURNAL_CURSOR_SAVE_RECORDS
+     * confirmed records. Less frequent saves mean more records uploaded
+     * again after a restart. */
+    const uint16_t JOURNAL_CURSOR_SAVE_RECORDS = 16;
+}
+
+#endif /* PDU_JOURNAL_UTILS_H */
+
+/*** end of file ***/
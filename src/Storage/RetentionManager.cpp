@@ -0,0 +1,510 @@
+/** @file RetentionManager.cpp
+ *
+ * @brief This class keeps the PDU journal within its flash budget during a
+ * long outage of the uplink, by compacting then evicting the records not
+ * uploaded yet. The alert records are never dropped.
+ *
+ * The work is done by rewriting consecutive segments the consumer did not
+ * read yet into one. Under compaction, consecutive PDUs are packed into
+ * compacted records holding a deflated uplink batch, which lets their
+ * segments be merged. Under eviction, only the alert records of the oldest
+ * segments are kept. A rewrite is only committed if it frees at least one
+ * segment.
+ *
+ * step() does a bounded amount of work and is meant to be called from a
+ * timer, so that a rewrite of several megabytes is spread over many short
+ * steps.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/RetentionManager.h"
+#include "Uplink/UplinkBatcherUtils.h"
+#include <zlib.h>
+#include <time.h>
+
+using namespace PduJournalConstants;
+using namespace PduJournalTypes;
+using namespace RetentionManagerConstants;
+using namespace RetentionManagerTypes;
+using namespace UplinkBatcherConstants;
+
+/*!
+ * @brief Constructor for RetentionManager
+ *
+ * @param[in] retainedJournal   Journal to keep within its flash budget
+ * */
+RetentionManager::RetentionManager(PduJournal& retainedJournal) :
+                                    journal(retainedJournal),
+                                    jobMode(JOB_NONE), sourceIndex(0),
+                                    boundaryOffset(0), boundarySourceNb(0),
+                                    compactSkipId(0), evictSkipId(0),
+                                    groupLastSequence(0), groupTimestamp(0),
+                                    rewriteNb(0), abortNb(0),
+                                    freedSegmentNb(0), reclaimedBytesNb(0),
+                                    maxStepUs(0)
+{
+    readPosition.segmentId = 0;
+    readPosition.offset = 0;
+    memset(&sourceCounters, 0, sizeof(sourceCounters));
+    memset(&jobCounters, 0, sizeof(jobCounters));
+    memset(&totalCounters, 0, sizeof(totalCounters));
+    resetGroup();
+}
+
+/*!
+ * @brief Destructor for RetentionManager. The rewrite in progress, if any,
+ * is aborted.
+ * */
+RetentionManager::~RetentionManager(void)
+{
+    if (jobMode != JOB_NONE)
+    {
+        journal.abortRewrite();
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in microseconds
+ *
+ * @return Number of microseconds since an arbitrary point in the past
+ * */
+uint64_t RetentionManager::getNowUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*!
+ * @brief Add counters to others and reset them
+ *
+ * @param[in,out] total     Counters to add to
+ * @param[in,out] counters  Counters to add, reset
+ *
+ * @return None
+ * */
+void RetentionManager::addCounters(Counters& total, Counters& counters)
+{
+    total.compactedPduNb += counters.compactedPduNb;
+    total.compactedRecordNb += counters.compactedRecordNb;
+    total.evictedNb += counters.evictedNb;
+
+    memset(&counters, 0, sizeof(counters));
+}
+
+/*!
+ * @brief Get the storage pressure on the journal
+ *
+ * @return Pressure
+ * */
+RetentionPressure RetentionManager::getPressure(void) const
+{
+    uint16_t segmentNb = journal.getSegmentNb();
+
+    if (segmentNb >= RETENTION_EVICT_SEGMENTS)
+    {
+        return RETENTION_PRESSURE_EVICT;
+    }
+
+    if (segmentNb >= RETENTION_COMPACT_SEGMENTS)
+    {
+        return RETENTION_PRESSURE_COMPACT;
+    }
+
+    return RETENTION_PRESSURE_NONE;
+}
+
+/*!
+ * @brief Start a rewrite if the pressure requires one. Compaction comes
+ * first, eviction only once there is nothing left to compact.
+ *
+ * @return True if a rewrite was started
+ * */
+bool RetentionManager::startJob(void)
+{
+    RetentionPressure pressure = getPressure();
+
+    if (pressure == RETENTION_PRESSURE_NONE)
+    {
+        return false;
+    }
+
+    /* The segments a previous rewrite could not shrink are skipped, they
+     * are full of records which cannot be compacted further */
+    journal.getRewritableSegments(sourceIds);
+
+    while (!sourceIds.empty() && (sourceIds.front() <= compactSkipId))
+    {
+        sourceIds.erase(sourceIds.begin());
+    }
+
+    jobMode = JOB_COMPACT;
+
+    /* A rewrite needs two segments to free one */
+    if ((sourceIds.size() < 2) && (pressure == RETENTION_PRESSURE_EVICT))
+    {
+        journal.getRewritableSegments(sourceIds);
+
+        while (!sourceIds.empty() && (sourceIds.front() <= evictSkipId))
+        {
+            sourceIds.erase(sourceIds.begin());
+        }
+
+        jobMode = JOB_EVICT;
+    }
+
+    if ((sourceIds.size() < 2) || !journal.beginRewrite(sourceIds.front()))
+    {
+        jobMode = JOB_NONE;
+        return false;
+    }
+
+    LE_DEBUG("%s from segment %u",
+             (jobMode == JOB_COMPACT) ? "Compaction" : "Eviction",
+             sourceIds.front());
+
+    sourceIndex = 0;
+    readPosition.segmentId = sourceIds.front();
+    readPosition.offset = 0;
+    boundaryOffset = 0;
+    boundarySourceNb = 0;
+    memset(&sourceCounters, 0, sizeof(sourceCounters));
+    memset(&jobCounters, 0, sizeof(jobCounters));
+    resetGroup();
+
+    return true;
+}
+
+/*!
+ * @brief End the rewrite in progress. The segments fully processed are
+ * replaced if that frees at least one of them, the records of the segment
+ * being processed are dropped from the rewrite.
+ *
+ * @return None
+ * */
+void RetentionManager::finishJob(void)
+{
+    uint16_t segmentNb = journal.getSegmentNb();
+    uint64_t pendingBytesNb = journal.getPendingBytesNb();
+
+    resetGroup();
+    journal.truncateRewrite(boundaryOffset);
+
+    if ((boundarySourceNb == 0) ||
+        ((boundarySourceNb == 1) && (boundaryOffset > 0)))
+    {
+        /* The records kept from the first segment fill a whole segment */
+        journal.abortRewrite();
+
+        if (jobMode == JOB_COMPACT)
+        {
+            compactSkipId = sourceIds.front();
+        }
+        else
+        {
+            evictSkipId = sourceIds.front();
+        }
+    }
+    else if (journal.commitRewrite(sourceIds[boundarySourceNb - 1]))
+    {
+        addCounters(totalCounters, jobCounters);
+        rewriteNb++;
+        freedSegmentNb += segmentNb - journal.getSegmentNb();
+
+        uint64_t newPendingBytesNb = journal.getPendingBytesNb();
+
+        if (pendingBytesNb > newPendingBytesNb)
+        {
+            reclaimedBytesNb += pendingBytesNb - newPendingBytesNb;
+        }
+    }
+    else
+    {
+        abortNb++;
+    }
+
+    jobMode = JOB_NONE;
+}
+
+/*!
+ * @brief Empty the group of PDUs being packed
+ *
+ * @return None
+ * */
+void RetentionManager::resetGroup(void)
+{
+    group.assign(BATCH_HEADER_SIZE, 0);
+    groupPositions.clear();
+}
+
+/*!
+ * @brief Copy the records of the group as they are, when packing them does
+ * not save enough
+ *
+ * @return False if the new segment is full
+ * */
+bool RetentionManager::copyGroup(void)
+{
+    for (size_t i = 0; i < groupPositions.size(); i++)
+    {
+        Position position = groupPositions[i];
+        RecordHeader header;
+        const uint8_t* data;
+
+        if (journal.peekRecord(position, &header, &data) != LE_OK)
+        {
+            continue;
+        }
+
+        if (journal.appendRewrite(header, data) != LE_OK)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Write the group of PDUs to the new segment, as one compacted
+ * record holding an uplink batch
+ *
+ * @return False if the new segment is full
+ * */
+bool RetentionManager::flushGroup(void)
+{
+    uint32_t rawBytesNb = group.size() - BATCH_HEADER_SIZE;
+    uint16_t pduNb = groupPositions.size();
+    uLongf deflatedNb = compressBound(rawBytesNb);
+    bool status;
+
+    if (pduNb == 0)
+    {
+        return true;
+    }
+
+    deflated.resize(BATCH_HEADER_SIZE + deflatedNb);
+
+    uint64_t maxPackedNb = (uint64_t) rawBytesNb *
+                            (100 - RETENTION_MIN_SAVING_PERCENT) / 100;
+
+    if ((pduNb < 2) ||
+        (compress2(&deflated[BATCH_HEADER_SIZE], &deflatedNb,
+                   &group[BATCH_HEADER_SIZE], rawBytesNb,
+                   RETENTION_COMPRESSION_LEVEL) != Z_OK) ||
+        ((BATCH_HEADER_SIZE + deflatedNb) > maxPackedNb))
+    {
+        status = copyGroup();
+    }
+    else
+    {
+        RecordHeader header;
+
+        deflated[0] = BATCH_FORMAT_VERSION;
+        deflated[1] = BATCH_FLAG_DEFLATE;
+        deflated[2] = pduNb & 0xFF;
+        deflated[3] = (pduNb >> 8) & 0xFF;
+        deflated[4] = rawBytesNb & 0xFF;
+        deflated[5] = (rawBytesNb >> 8) & 0xFF;
+        deflated[6] = (rawBytesNb >> 16) & 0xFF;
+        deflated[7] = (rawBytesNb >> 24) & 0xFF;
+
+        memset(&header, 0, sizeof(header));
+        header.length = BATCH_HEADER_SIZE + deflatedNb;
+        header.flags = JOURNAL_FLAG_COMPACTED;
+        header.sequence = groupLastSequence;
+        header.timestamp = groupTimestamp;
+
+        status = (journal.appendRewrite(header, &deflated[0]) == LE_OK);
+
+        if (status)
+        {
+            sourceCounters.compactedPduNb += pduNb;
+            sourceCounters.compactedRecordNb++;
+        }
+    }
+
+    resetGroup();
+
+    return status;
+}
+
+/*!
+ * @brief Process a record of the segment being rewritten
+ *
+ * @param[in] position  Position of the record
+ * @param[in] header    Header of the record
+ * @param[in] data      Payload of the record
+ *
+ * @return False if the new segment is full
+ * */
+bool RetentionManager::processRecord(const Position& position,
+                                        const RecordHeader& header,
+                                        const uint8_t* data)
+{
+    uint32_t frameNb = BATCH_PDU_HEADER_SIZE + header.length;
+
+    if (jobMode == JOB_EVICT)
+    {
+        if ((header.flags & JOURNAL_FLAG_ALERT) == 0)
+        {
+            sourceCounters.evictedNb++;
+            return true;
+        }
+
+        return (journal.appendRewrite(header, data) == LE_OK);
+    }
+
+    /* Alerts are kept as they are, the records already compacted and the
+     * PDUs too big for a group are copied */
+    uint8_t copiedFlags = JOURNAL_FLAG_ALERT | JOURNAL_FLAG_COMPACTED;
+
+    if (((header.flags & copiedFlags) != 0) ||
+        (frameNb > RETENTION_GROUP_BYTES))
+    {
+        return flushGroup() && (journal.appendRewrite(header, data) == LE_OK);
+    }
+
+    uint32_t groupBytesNb = group.size() - BATCH_HEADER_SIZE;
+
+    if (((groupBytesNb + frameNb) > RETENTION_GROUP_BYTES) && !flushGroup())
+    {
+        return false;
+    }
+
+    if (groupPositions.empty())
+    {
+        groupTimestamp = header.timestamp;
+    }
+
+    group.push_back(header.type);
+    group.insert(group.end(), header.mac,
+                    header.mac + WearableDeviceALPConstants::MAC_ADDRESS_SIZE);
+    group.push_back(header.length & 0xFF);
+    group.push_back((header.length >> 8) & 0xFF);
+    group.push_back((header.length >> 16) & 0xFF);
+    group.push_back((header.length >> 24) & 0xFF);
+    group.insert(group.end(), data, data + header.length);
+
+    groupPositions.push_back(position);
+    groupLastSequence = header.sequence;
+
+    return true;
+}
+
+/*!
+ * @brief Complete a segment of the rewrite and move to the next one
+ *
+ * @return False if the rewrite is over
+ * */
+bool RetentionManager::endSource(void)
+{
+    if (!flushGroup())
+    {
+        return false;
+    }
+
+    boundaryOffset = journal.getRewriteOffset();
+    boundarySourceNb = sourceIndex + 1;
+    addCounters(jobCounters, sourceCounters);
+    sourceIndex++;
+
+    /* Evict one segment at a time, the pressure is checked again before the
+     * next one */
+    if ((jobMode == JOB_EVICT) &&
+        ((boundarySourceNb > 1) || (boundaryOffset == 0)))
+    {
+        return false;
+    }
+
+    if (sourceIndex >= sourceIds.size())
+    {
+        return false;
+    }
+
+    readPosition.segmentId = sourceIds[sourceIndex];
+    readPosition.offset = 0;
+
+    return true;
+}
+
+/*!
+ * @brief Do a bounded part of the retention work: at most
+ * RETENTION_STEP_RECORDS records or RETENTION_STEP_BUDGET_US of processing
+ *
+ * @return True if there is more work to do, false if the journal is within
+ * its budget or nothing more can be done for now
+ * */
+bool RetentionManager::step(void)
+{
+    uint64_t startUs = getNowUs();
+    uint16_t recordNb = 0;
+
+    if ((jobMode == JOB_NONE) && !startJob())
+    {
+        return false;
+    }
+
+    /* The consumer caught up with the segments being rewritten */
+    if (!journal.isRewritable(sourceIds.front()))
+    {
+        LE_DEBUG("Rewrite from segment %u aborted", sourceIds.front());
+        journal.abortRewrite();
+        abortNb++;
+        jobMode = JOB_NONE;
+        return true;
+    }
+
+    while ((recordNb < RETENTION_STEP_RECORDS) &&
+           ((getNowUs() - startUs) < RETENTION_STEP_BUDGET_US))
+    {
+        Position position = readPosition;
+        RecordHeader header;
+        const uint8_t* data;
+
+        if (journal.peekRecord(readPosition, &header, &data) == LE_OK)
+        {
+            recordNb++;
+
+            if (!processRecord(position, header, data))
+            {
+                finishJob();
+                break;
+            }
+        }
+        else if (!endSource())
+        {
+            finishJob();
+            break;
+        }
+    }
+
+    uint32_t elapsedUs = getNowUs() - startUs;
+
+    maxStepUs = (elapsedUs > maxStepUs) ? elapsedUs : maxStepUs;
+
+    return true;
+}
+
+/*!
+ * @brief Log the statistics of the retention
+ *
+ * @return None
+ * */
+void RetentionManager::logStats(void) const
+{
+    LE_INFO("Retention: %u rewrites (%u aborted), %u segments freed, %llu KB "
+            "reclaimed, %u PDUs compacted into %u records, %u records "
+            "evicted, longest step %u us", rewriteNb, abortNb,
+            freedSegmentNb, (unsigned long long) (reclaimedBytesNb / 1024),
+            totalCounters.compactedPduNb, totalCounters.compactedRecordNb,
+            totalCounters.evictedNb, maxStepUs);
+}
+
+/*** end of file ***/
@@ -0,0 +1,82 @@
+/** @file RetentionManager.h
+ *
+ * @brief This class keeps the PDU journal within its flash budget during a
+ * long outage of the uplink, by compacting then evicting the records not
+ * uploaded yet. The alert records are never dropped.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef RETENTION_MANAGER_H
+#define RETENTION_MANAGER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/PduJournal.h"
+#include "Storage/RetentionManagerUtils.h"
+#include <vector>
+
+class RetentionManager
+{
+    private:
+        enum JobMode
+        {
+            JOB_NONE, JOB_COMPACT, JOB_EVICT
+        };
+
+        /* Counters of the work done, only added to the totals once the
+         * rewrite doing it is committed */
+        struct Counters
+        {
+            uint32_t compactedPduNb;
+            uint32_t compactedRecordNb;
+            uint32_t evictedNb;
+        };
+
+        PduJournal& journal;
+        JobMode jobMode;
+        std::vector<uint32_t> sourceIds;
+        size_t sourceIndex;
+        PduJournalTypes::Position readPosition;
+        uint32_t boundaryOffset;
+        size_t boundarySourceNb;
+        uint32_t compactSkipId;
+        uint32_t evictSkipId;
+        std::vector<uint8_t> group;
+        std::vector<uint8_t> deflated;
+        std::vector<PduJournalTypes::Position> groupPositions;
+        uint64_t groupLastSequence;
+        uint32_t groupTimestamp;
+        Counters sourceCounters;
+        Counters jobCounters;
+        Counters totalCounters;
+        uint32_t rewriteNb;
+        uint32_t abortNb;
+        uint32_t freedSegmentNb;
+        uint64_t reclaimedBytesNb;
+        uint32_t maxStepUs;
+
+        static uint64_t getNowUs(void);
+        static void addCounters(Counters& total, Counters& counters);
+        bool startJob(void);
+        void finishJob(void);
+        void resetGroup(void);
+        bool copyGroup(void);
+        bool flushGroup(void);
+        bool processRecord(const PduJournalTypes::Position& position,
+                            const PduJournalTypes::RecordHeader& header,
+                            const uint8_t* data);
+        bool endSource(void);
+
+    public:
+        RetentionManager(PduJournal& retainedJournal);
+        ~RetentionManager(void);
+        RetentionManagerTypes::RetentionPressure getPressure(void) const;
+        bool step(void);
+        void logStats(void) const;
+};
+
+#endif /* RETENTION_MANAGER_H */
+
+/*** end of file ***/
@@ -0,0 +1,61 @@
+/** @file RetentionManagerUtils.h
+ *
+ * @brief This file provides the types and constants of the retention of the
+ * PDU journal under storage pressure
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef RETENTION_MANAGER_UTILS_H
+#define RETENTION_MANAGER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/PduJournalUtils.h"
+
+namespace RetentionManagerTypes
+{
+    /* Storage pressure on the journal, from the number of segments used */
+    enum RetentionPressure
+    {
+        /* Nothing to do */
+        RETENTION_PRESSURE_NONE,
+        /* The records not read yet are compacted, nothing is lost */
+        RETENTION_PRESSURE_COMPACT,
+        /* The oldest records not read yet are dropped, except the alerts */
+        RETENTION_PRESSURE_EVICT
+    };
+}
+
+namespace RetentionManagerConstants
+{
+    /* Number of segments from which the journal is compacted, then from
+     * which the oldest records are evicted */
+    const uint16_t RETENTION_COMPACT_SEGMENTS =
+                            PduJournalConstants::JOURNAL_MAX_SEGMENTS * 3 / 4;
+    const uint16_t RETENTION_EVICT_SEGMENTS =
+                            PduJournalConstants::JOURNAL_MAX_SEGMENTS * 7 / 8;
+
+    /* A step stops after RETENTION_STEP_RECORDS records or
+     * RETENTION_STEP_BUDGET_US, whichever comes first, so that the ALP server
+     * is not delayed. */
+    const uint16_t RETENTION_STEP_RECORDS = 64;
+    const uint32_t RETENTION_STEP_BUDGET_US = 2000;
+
+    /* Consecutive PDUs are packed into a compacted record until they reach
+     * this size, uncompressed */
+    const uint32_t RETENTION_GROUP_BYTES = 32 * 1024;
+
+    /* A group is only compacted if this share of its size is saved, the
+     * records are copied as they are otherwise */
+    const uint8_t RETENTION_MIN_SAVING_PERCENT = 20;
+
+    /* Compression level: the fastest, the CPU budget matters more than the
+     * last percents */
+    const int8_t RETENTION_COMPRESSION_LEVEL = 1;
+}
+
+#endif /* RETENTION_MANAGER_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,474 @@
+/** @file DeviceFairQueue.cpp
+ *
+ * @brief This class shares the uplink between the wearable devices, with a
+ * deficit round robin on their PDUs weighted per device
+ *
+ * Each device has its own queue. The devices with PDUs queued take turns:
+ * at its turn a device gets its weight times FAIR_QUEUE_QUANTUM bytes of
+ * credit, sends PDUs as long as the credit covers the next one, and keeps
+ * the rest for its next turn. A device dumping a backlog thus gets its share
+ * of the uplink and no more.
+ *
+ * The quantum is at least the biggest PDU, so a turn always sends a PDU: a
+ * dequeue costs at most one move in the list of the devices with PDUs
+ * queued, whatever the number of devices. The devices are found with a
+ * HashIndex on their MAC address.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/DeviceFairQueue.h"
+#include <time.h>
+
+using namespace WearableDeviceALPConstants;
+using namespace DeviceFairQueueConstants;
+using namespace DeviceFairQueueTypes;
+
+/*!
+ * @brief Constructor for DeviceFairQueue
+ * */
+DeviceFairQueue::DeviceFairQueue(void) : flowIndex(FAIR_QUEUE_MAX_DEVICES,
+                                                    MAC_ADDRESS_SIZE),
+                                            activeHead(-1), activeNb(0),
+                                            isHeadCredited(false),
+                                            queuedBytesNb(0), servedBytesNb(0),
+                                            servedPduNb(0), refusedNb(0)
+{
+    LE_ASSERT(FAIR_QUEUE_MAX_DEVICES >= MAX_WEARABLE_DEVICES);
+}
+
+/*!
+ * @brief Destructor for DeviceFairQueue. The PDUs queued are dropped.
+ * */
+DeviceFairQueue::~DeviceFairQueue(void)
+{
+
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t DeviceFairQueue::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Release the queue of the device idle for the longest time. The
+ * devices with a configured weight are kept.
+ *
+ * @return False if all the devices have PDUs queued or a configured weight
+ * */
+bool DeviceFairQueue::evictIdle(void)
+{
+    int32_t oldest = -1;
+
+    for (uint16_t i = 0; i < FAIR_QUEUE_MAX_DEVICES; i++)
+    {
+        const Flow& flow = flows[i];
+
+        if (flowIndex.isUsed(i) && flow.pdus.empty() && !flow.isConfigured &&
+            ((oldest < 0) || (flow.lastActiveMs < flows[oldest].lastActiveMs)))
+        {
+            oldest = i;
+        }
+    }
+
+    if (oldest < 0)
+    {
+        return false;
+    }
+
+    flowIndex.remove(oldest);
+
+    return true;
+}
+
+/*!
+ * @brief Find the queue of a device, creating it if the device has none
+ *
+ * @param[in] mac   MAC address of the device
+ *
+ * @return Index of the queue, -1 if all the queues are in use
+ * */
+int32_t DeviceFairQueue::findOrInsertFlow(const uint8_t* mac)
+{
+    int32_t index = flowIndex.find(mac);
+
+    if (index >= 0)
+    {
+        return index;
+    }
+
+    if (flowIndex.isFull() && !evictIdle())
+    {
+        return -1;
+    }
+
+    index = flowIndex.insert(mac);
+    LE_ASSERT(index >= 0);
+
+    Flow& flow = flows[index];
+
+    memcpy(flow.mac, mac, MAC_ADDRESS_SIZE);
+    flow.weight = FAIR_QUEUE_DEFAULT_WEIGHT;
+    flow.isConfigured = false;
+    flow.deficit = 0;
+    flow.pdus.clear();
+    flow.queuedBytesNb = 0;
+    flow.next = -1;
+    flow.prev = -1;
+    flow.lastActiveMs = getNowMs();
+    flow.servedPduNb = 0;
+    flow.servedBytesNb = 0;
+    flow.refusedNb = 0;
+    flow.totalWaitMs = 0;
+    flow.maxWaitMs = 0;
+
+    return index;
+}
+
+/*!
+ * @brief Add a device to the end of the round
+ *
+ * @param[in] index     Index of the device
+ *
+ * @return None
+ * */
+void DeviceFairQueue::activate(int16_t index)
+{
+    Flow& flow = flows[index];
+
+    flow.deficit = 0;
+
+    if (activeHead < 0)
+    {
+        flow.next = index;
+        flow.prev = index;
+        activeHead = index;
+        isHeadCredited = false;
+    }
+    else
+    {
+        int16_t tail = flows[activeHead].prev;
+
+        flow.next = activeHead;
+        flow.prev = tail;
+        flows[tail].next = index;
+        flows[activeHead].prev = index;
+    }
+
+    activeNb++;
+}
+
+/*!
+ * @brief Remove a device from the round once its queue is empty. Its unused
+ * credit is lost, as in the classic deficit round robin.
+ *
+ * @param[in] index     Index of the device
+ *
+ * @return None
+ * */
+void DeviceFairQueue::deactivate(int16_t index)
+{
+    Flow& flow = flows[index];
+
+    if (flow.next == index)
+    {
+        activeHead = -1;
+    }
+    else
+    {
+        flows[flow.prev].next = flow.next;
+        flows[flow.next].prev = flow.prev;
+
+        if (activeHead == index)
+        {
+            activeHead = flow.next;
+            isHeadCredited = false;
+        }
+    }
+
+    flow.next = -1;
+    flow.prev = -1;
+    flow.deficit = 0;
+    activeNb--;
+}
+
+/*!
+ * @brief Find the device whose PDU is sent next. The device at the head of
+ * the round gets its credit when its turn starts, and its turn ends when
+ * the credit left does not cover its next PDU.
+ *
+ * @return Index of the device, -1 if nothing is queued
+ * */
+int16_t DeviceFairQueue::selectFlow(void)
+{
+    if (activeHead < 0)
+    {
+        return -1;
+    }
+
+    for (uint8_t turnNb = 0; turnNb < 2; turnNb++)
+    {
+        Flow& flow = flows[activeHead];
+
+        if (!isHeadCredited)
+        {
+            flow.deficit += (int64_t) flow.weight * FAIR_QUEUE_QUANTUM;
+            isHeadCredited = true;
+        }
+
+        if ((int64_t) flow.pdus.front().data.size() <= flow.deficit)
+        {
+            return activeHead;
+        }
+
+        /* End of the turn, a new turn always covers a PDU */
+        activeHead = flow.next;
+        isHeadCredited = false;
+    }
+
+    LE_FATAL("PDU bigger than the quantum");
+}
+
+/*!
+ * @brief Set the weight of a device: its share of the uplink is
+ * proportional to it when several devices have PDUs queued
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[in] weight    Weight, from 1 to FAIR_QUEUE_MAX_WEIGHT
+ *
+ * @return False if the device table is full
+ * */
+bool DeviceFairQueue::setWeight(const uint8_t* mac, uint8_t weight)
+{
+    int32_t index = findOrInsertFlow(mac);
+
+    if (index < 0)
+    {
+        LE_ERROR("No room for the weight of a device");
+        return false;
+    }
+
+    if (weight < 1)
+    {
+        weight = 1;
+    }
+
+    flows[index].weight = (weight > FAIR_QUEUE_MAX_WEIGHT) ?
+                                                FAIR_QUEUE_MAX_WEIGHT : weight;
+    flows[index].isConfigured = true;
+
+    return true;
+}
+
+/*!
+ * @brief Queue a PDU of a device
+ *
+ * @param[in] mac   MAC address of the device which sent the PDU
+ * @param[in] type  Type of the PDU
+ * @param[in] data  Payload of the PDU, copied
+ * @param[in] len   Size of the payload
+ *
+ * @return LE_OK on success, LE_NO_MEMORY if the queue of the device or all
+ * the queues are full, LE_OVERFLOW if the PDU is too big, LE_FAULT on error
+ * */
+le_result_t DeviceFairQueue::enqueue(const uint8_t* mac, uint8_t type,
+                                        const uint8_t* data, uint32_t len)
+{
+    if ((mac == NULL) || ((data == NULL) && (len > 0)))
+    {
+        return LE_FAULT;
+    }
+
+    if (len > FAIR_QUEUE_QUANTUM)
+    {
+        return LE_OVERFLOW;
+    }
+
+    int32_t index = findOrInsertFlow(mac);
+
+    if ((index < 0) || ((queuedBytesNb + len) > FAIR_QUEUE_MAX_BYTES) ||
+        ((flows[index].queuedBytesNb + len) > FAIR_QUEUE_DEVICE_MAX_BYTES))
+    {
+        if (index >= 0)
+        {
+            flows[index].refusedNb++;
+        }
+
+        refusedNb++;
+        return LE_NO_MEMORY;
+    }
+
+    Flow& flow = flows[index];
+
+    flow.pdus.push_back(QueuedPdu());
+
+    QueuedPdu& pdu = flow.pdus.back();
+
+    memcpy(pdu.mac, mac, MAC_ADDRESS_SIZE);
+    pdu.type = type;
+    pdu.data.assign(data, data + len);
+    pdu.enqueueMs = getNowMs();
+
+    flow.queuedBytesNb += len;
+    flow.lastActiveMs = pdu.enqueueMs;
+    queuedBytesNb += len;
+
+    if (flow.pdus.size() == 1)
+    {
+        activate(index);
+    }
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Get the next PDU to send, without removing it
+ *
+ * @return The PDU, valid until pop() is called, NULL if nothing is queued
+ * */
+const QueuedPdu* DeviceFairQueue::peek(void)
+{
+    int16_t index = selectFlow();
+
+    return (index < 0) ? NULL : &flows[index].pdus.front();
+}
+
+/*!
+ * @brief Remove the PDU returned by peek(), once it is sent
+ *
+ * @return None
+ * */
+void DeviceFairQueue::pop(void)
+{
+    int16_t index = selectFlow();
+
+    if (index < 0)
+    {
+        return;
+    }
+
+    Flow& flow = flows[index];
+    QueuedPdu& pdu = flow.pdus.front();
+    uint32_t len = pdu.data.size();
+    uint64_t nowMs = getNowMs();
+    uint32_t waitMs = nowMs - pdu.enqueueMs;
+
+    flow.deficit -= len;
+    flow.queuedBytesNb -= len;
+    flow.servedPduNb++;
+    flow.servedBytesNb += len;
+    flow.totalWaitMs += waitMs;
+    flow.maxWaitMs = (waitMs > flow.maxWaitMs) ? waitMs : flow.maxWaitMs;
+    flow.lastActiveMs = nowMs;
+    queuedBytesNb -= len;
+    servedPduNb++;
+    servedBytesNb += len;
+
+    flow.pdus.pop_front();
+
+    if (flow.pdus.empty())
+    {
+        deactivate(index);
+    }
+}
+
+/*!
+ * @brief Check if no PDU is queued
+ *
+ * @return True if all the queues are empty
+ * */
+bool DeviceFairQueue::isEmpty(void) const
+{
+    return (activeHead < 0);
+}
+
+/*!
+ * @brief Get the number of bytes queued for all the devices
+ *
+ * @return Number of bytes
+ * */
+uint32_t DeviceFairQueue::getQueuedBytesNb(void) const
+{
+    return queuedBytesNb;
+}
+
+/*!
+ * @brief Get the statistics of a device
+ *
+ * @param[in] mac       MAC address of the device
+ * @param[out] statsPtr Statistics of the device
+ *
+ * @return False if the device is not known
+ * */
+bool DeviceFairQueue::getDeviceStats(const uint8_t* mac,
+                                        DeviceStats* statsPtr) const
+{
+    int32_t index = flowIndex.find(mac);
+
+    if ((index < 0) || (statsPtr == NULL))
+    {
+        return false;
+    }
+
+    const Flow& flow = flows[index];
+
+    statsPtr->weight = flow.weight;
+    statsPtr->queuedPduNb = flow.pdus.size();
+    statsPtr->queuedBytesNb = flow.queuedBytesNb;
+    statsPtr->servedPduNb = flow.servedPduNb;
+    statsPtr->servedBytesNb = flow.servedBytesNb;
+    statsPtr->refusedNb = flow.refusedNb;
+    statsPtr->sharePercent = (servedBytesNb > 0) ?
+                                (100 * flow.servedBytesNb / servedBytesNb) : 0;
+    statsPtr->averageWaitMs = (flow.servedPduNb > 0) ?
+                                (flow.totalWaitMs / flow.servedPduNb) : 0;
+    statsPtr->maxWaitMs = flow.maxWaitMs;
+
+    return true;
+}
+
+/*!
+ * @brief Log the statistics of the queue and of each device
+ *
+ * @return None
+ * */
+void DeviceFairQueue::logStats(void) const
+{
+    LE_INFO("Fair queue: %u devices (%u with PDUs queued), %u bytes queued, "
+            "%u PDUs served (%llu bytes), %u refused", flowIndex.getUsedNb(),
+            activeNb, queuedBytesNb, servedPduNb,
+            (unsigned long long) servedBytesNb, refusedNb);
+
+    for (uint16_t i = 0; i < FAIR_QUEUE_MAX_DEVICES; i++)
+    {
+        DeviceStats stats;
+
+        if (!flowIndex.isUsed(i) ||
+            !getDeviceStats(flows[i].mac, &stats))
+        {
+            continue;
+        }
+
+        LE_INFO("Fair queue %02X:%02X:%02X:%02X:%02X:%02X: weight %u, share "
+                "%u%%, served %u PDUs, queued %u bytes, refused %u, wait "
+                "average %u ms max %u ms", flows[i].mac[0], flows[i].mac[1],
+                flows[i].mac[2], flows[i].mac[3], flows[i].mac[4],
+                flows[i].mac[5], stats.weight, stats.sharePercent,
+                stats.servedPduNb, stats.queuedBytesNb, stats.refusedNb,
+                stats.averageWaitMs, stats.maxWaitMs);
+    }
+}
+
+/*** end of file ***/
@@ -0,0 +1,78 @@
+/** @file DeviceFairQueue.h
+ *
+ * @brief This class shares the uplink between the wearable devices, with a
+ * deficit round robin on their PDUs weighted per device
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DEVICE_FAIR_QUEUE_H
+#define DEVICE_FAIR_QUEUE_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/DeviceFairQueueUtils.h"
+#include "Utils/HashIndex.h"
+#include <list>
+
+class DeviceFairQueue
+{
+    private:
+        /* Queue of a device. The devices with PDUs queued are linked in a
+         * circular list, in round robin order. */
+        struct Flow
+        {
+            uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+            uint8_t weight;
+            bool isConfigured;
+            int64_t deficit;
+            std::list<DeviceFairQueueTypes::QueuedPdu> pdus;
+            uint32_t queuedBytesNb;
+            int16_t next;
+            int16_t prev;
+            uint64_t lastActiveMs;
+            uint32_t servedPduNb;
+            uint64_t servedBytesNb;
+            uint32_t refusedNb;
+            uint64_t totalWaitMs;
+            uint32_t maxWaitMs;
+        };
+
+        /* Queue of entry N of the index at index N. The entries don't move,
+         * so the round links them by index. */
+        HashIndex flowIndex;
+        Flow flows[DeviceFairQueueConstants::FAIR_QUEUE_MAX_DEVICES];
+        int16_t activeHead;
+        uint16_t activeNb;
+        bool isHeadCredited;
+        uint32_t queuedBytesNb;
+        uint64_t servedBytesNb;
+        uint32_t servedPduNb;
+        uint32_t refusedNb;
+
+        static uint64_t getNowMs(void);
+        int32_t findOrInsertFlow(const uint8_t* mac);
+        bool evictIdle(void);
+        void activate(int16_t index);
+        void deactivate(int16_t index);
+        int16_t selectFlow(void);
+
+    public:
+        DeviceFairQueue(void);
+        ~DeviceFairQueue(void);
+        bool setWeight(const uint8_t* mac, uint8_t weight);
+        le_result_t enqueue(const uint8_t* mac, uint8_t type,
+                            const uint8_t* data, uint32_t len);
+        const DeviceFairQueueTypes::QueuedPdu* peek(void);
+        void pop(void);
+        bool isEmpty(void) const;
+        uint32_t getQueuedBytesNb(void) const;
+        bool getDeviceStats(const uint8_t* mac,
+                            DeviceFairQueueTypes::DeviceStats* statsPtr) const;
+        void logStats(void) const;
+};
+
+#endif /* DEVICE_FAIR_QUEUE_H */
+
+/*** end of file ***/
@@ -0,0 +1,70 @@
+/** @file DeviceFairQueueUtils.h
+ *
+ * @brief This file provides the types and constants of the fair queuing of
+ * the wearable devices on the uplink
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef DEVICE_FAIR_QUEUE_UTILS_H
+#define DEVICE_FAIR_QUEUE_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Com/WearableDeviceALPUtils.h"
+#include <vector>
+
+namespace DeviceFairQueueTypes
+{
+    /* PDU waiting for the uplink */
+    struct QueuedPdu
+    {
+        uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+        uint8_t type;
+        std::vector<uint8_t> data;
+        uint64_t enqueueMs;
+    };
+
+    /* Statistics of a device */
+    struct DeviceStats
+    {
+        uint8_t weight;
+        uint32_t queuedPduNb;
+        uint32_t queuedBytesNb;
+        uint32_t servedPduNb;
+        uint64_t servedBytesNb;
+        uint32_t refusedNb;
+        /* Share of the bytes served to all the devices, in percent */
+        uint8_t sharePercent;
+        /* Time spent in the queue by the PDUs served */
+        uint32_t averageWaitMs;
+        uint32_t maxWaitMs;
+    };
+}
+
+namespace DeviceFairQueueConstants
+{
+    /* Devices with a queue, at least MAX_WEARABLE_DEVICES. The idle device
+     * not configured is dropped to make room for a new one. */
+    const uint16_t FAIR_QUEUE_MAX_DEVICES = 64;
+
+    /* Bytes a device of weight 1 may send per round. It is at least the
+     * biggest PDU, so that each turn sends at least one PDU. */
+    const uint32_t FAIR_QUEUE_QUANTUM =
+                        WearableDeviceALPConstants::MAX_ALP_PAYLOAD_SIZE;
+
+    /* Weight given to the devices not configured, and the maximum one */
+    const uint8_t FAIR_QUEUE_DEFAULT_WEIGHT = 1;
+    const uint8_t FAIR_QUEUE_MAX_WEIGHT = 16;
+
+    /* Bytes queued for all the devices, and for a single one. A device over
+     * its limit has its PDUs refused, they stay in the journal. */
+    const uint32_t FAIR_QUEUE_MAX_BYTES = 2 * 1024 * 1024;
+    const uint32_t FAIR_QUEUE_DEVICE_MAX_BYTES =
+                        2 * WearableDeviceALPConstants::MAX_ALP_PAYLOAD_SIZE;
+}
+
+#endif /* DEVICE_FAIR_QUEUE_UTILS_H */
+
+/*** end of file ***/
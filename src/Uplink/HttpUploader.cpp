@@ -0,0 +1,1100 @@
+/** @file HttpUploader.cpp
+ *
+ * @brief This class uploads data to the Current Health server over HTTP,
+ * running several requests at the same time from a single thread
+ *
+ * All the requests go through one curl multi handle: its connection cache
+ * keeps the connection to the server open between uploads, HTTP/2 is used
+ * when the server offers it so that the requests in flight share that
+ * connection, and the TLS sessions are shared between the requests so that
+ * a new connection resumes the previous session.
+ *
+ * Each request has a traffic class with its own queue. The next request to
+ * start is chosen by class, a connection is kept for the urgent classes,
+ * and the bulk bodies are streamed by chunks so that they can be paused
+ * while an alert or control request goes through.
+ *
+ * When a DNS cache is given, the address of the server is taken from it so
+ * that a new connection doesn't wait for a lookup over the bearer. curl
+ * resolves the name itself when the cache doesn't know it yet.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/HttpUploader.h"
+#include "HttpStatusCode/HttpStatusCode_C++.h"
+#include <arpa/inet.h>
+#include <time.h>
+
+using namespace HttpUploaderConstants;
+using namespace HttpUploaderTypes;
+
+/* Names of the traffic classes, for the logs */
+static const char* TRAFFIC_CLASS_NAMES[TRAFFIC_CLASS_NB] =
+{
+    "alert", "control", "bulk"
+};
+
+/*!
+ * @brief Constructor for HttpUploader. init() must be called before use.
+ *
+ * @param[in] serverUrl     URL the data is posted to
+ * */
+HttpUploader::HttpUploader(const std::string& serverUrl) :
+                            url(serverUrl), multiHandle(NULL),
+                            shareHandle(NULL), headerList(NULL),
+                            schedulingMode(UPLOADER_DEFAULT_SCHEDULING),
+                            activeNb(0),
+                            nextRequestId(1), jitterGenerator(getNowMs()),
+                            requestNb(0), attemptNb(0), successNb(0),
+                            retryNb(0), rejectedNb(0), flaggedNb(0),
+                            exhaustedNb(0), newConnectionNb(0),
+                            reusedConnectionNb(0), http2Nb(0),
+                            sentBytesNb(0), onAirBytesNb(0),
+                            totalLatencyMs(0), preemptionNb(0),
+                            throughputKbps(0), activityHandler(NULL),
+                            activityContextPtr(NULL), resolverPtr(NULL),
+                            cachedAddressNb(0)
+{
+    memset(classCredits, 0, sizeof(classCredits));
+    memset(classStats, 0, sizeof(classStats));
+}
+
+/*!
+ * @brief Destructor for HttpUploader. The requests not completed are
+ * dropped without calling their handler.
+ * */
+HttpUploader::~HttpUploader(void)
+{
+    for (uint8_t i = 0; i < TRAFFIC_CLASS_NB; i++)
+    {
+        for (std::list<Request*>::iterator it = waitingRequests[i].begin();
+             it != waitingRequests[i].end(); it++)
+        {
+            if ((*it)->easyHandle != NULL)
+            {
+                curl_multi_remove_handle(multiHandle, (*it)->easyHandle);
+                curl_easy_cleanup((*it)->easyHandle);
+                curl_slist_free_all((*it)->resolveList);
+            }
+
+            delete *it;
+        }
+    }
+
+    if (multiHandle != NULL)
+    {
+        curl_multi_cleanup(multiHandle);
+    }
+
+    if (shareHandle != NULL)
+    {
+        curl_share_cleanup(shareHandle);
+    }
+
+    curl_slist_free_all(headerList);
+}
+
+/*!
+ * @brief Create the curl handles
+ *
+ * @return Status of the operation
+ * */
+bool HttpUploader::init(void)
+{
+    bool status = true;
+    std::string contentType = "Content-Type: " + UPLOADER_CONTENT_TYPE;
+
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+    {
+        LE_ERROR("Failed to initialize curl");
+        return false;
+    }
+
+    multiHandle = curl_multi_init();
+    shareHandle = curl_share_init();
+
+    if ((multiHandle == NULL) || (shareHandle == NULL))
+    {
+        LE_ERROR("Failed to create the curl handles");
+        return false;
+    }
+
+    /* Requests to the same server share one connection when the server
+     * speaks HTTP/2, and are limited to a few connections otherwise */
+    curl_multi_setopt(multiHandle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multiHandle, CURLMOPT_MAX_HOST_CONNECTIONS,
+                                        (long) UPLOADER_MAX_HOST_CONNECTIONS);
+
+    /* Everything runs from the thread calling process(), no locking needed */
+    curl_share_setopt(shareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(shareHandle, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+
+    headerList = curl_slist_append(NULL, contentType.c_str());
+    /* The server answers at once, the data is not held back waiting for
+     * a 100 Continue */
+    headerList = curl_slist_append(headerList, "Expect:");
+
+    if (headerList == NULL)
+    {
+        LE_ERROR("Failed to create the request headers");
+        status = false;
+    }
+
+    LE_INFO("Uploader to %s, %s", url.c_str(), curl_version());
+
+    return status;
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t HttpUploader::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Body of the server responses, not used
+ *
+ * @param[in] ptr       Data received
+ * @param[in] size      Size of an item
+ * @param[in] nmemb     Number of items
+ * @param[in] userdata  Not used
+ *
+ * @return Number of bytes consumed
+ * */
+size_t HttpUploader::discardResponse(char* ptr, size_t size, size_t nmemb,
+                                        void* userdata)
+{
+    return size * nmemb;
+}
+
+/*!
+ * @brief Give the next chunk of a request body to curl. A bulk request asked
+ * to give way is paused here, at a chunk boundary.
+ *
+ * @param[out] buffer   Buffer to fill
+ * @param[in] size      Size of an item
+ * @param[in] nitems    Number of items
+ * @param[in] userdata  Request
+ *
+ * @return Number of bytes given, CURL_READFUNC_PAUSE to pause the upload
+ * */
+size_t HttpUploader::readBody(char* buffer, size_t size, size_t nitems,
+                                void* userdata)
+{
+    Request* requestPtr = (Request*) userdata;
+    size_t len = size * nitems;
+
+    if (requestPtr->isPauseRequested)
+    {
+        requestPtr->isPaused = true;
+        requestPtr->pauseNb++;
+        return CURL_READFUNC_PAUSE;
+    }
+
+    if (len > UPLOADER_CHUNK_SIZE)
+    {
+        len = UPLOADER_CHUNK_SIZE;
+    }
+
+    if (len > (requestPtr->body.size() - requestPtr->sentOffset))
+    {
+        len = requestPtr->body.size() - requestPtr->sentOffset;
+    }
+
+    memcpy(buffer, requestPtr->body.data() + requestPtr->sentOffset, len);
+    requestPtr->sentOffset += len;
+
+    return len;
+}
+
+/*!
+ * @brief Move in a request body, when curl has to send it again (e.g. on a
+ * redirect or a connection reset before the response)
+ *
+ * @param[in] userdata  Request
+ * @param[in] offset    New position
+ * @param[in] origin    Reference of the position, only SEEK_SET is used
+ *
+ * @return CURL_SEEKFUNC_OK on success
+ * */
+int HttpUploader::seekBody(void* userdata, curl_off_t offset, int origin)
+{
+    Request* requestPtr = (Request*) userdata;
+
+    if ((origin != SEEK_SET) || (offset < 0) ||
+        ((uint64_t) offset > requestPtr->body.size()))
+    {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    requestPtr->sentOffset = offset;
+
+    return CURL_SEEKFUNC_OK;
+}
+
+/*!
+ * @brief Find out if an attempt has to be retried from its outcome
+ *
+ * @param[in] code          Result of the transfer
+ * @param[in] httpCode      HTTP status of the response, 0 if none
+ * @param[out] resultPtr    Result of the upload if it is not retried
+ *
+ * @return True if the upload has to be attempted again
+ * */
+bool HttpUploader::isRetryable(CURLcode code, long httpCode,
+                                UploadResult* resultPtr)
+{
+    bool retry = false;
+
+    if (code != CURLE_OK)
+    {
+        switch (code)
+        {
+            /* A wrong URL or a missing protocol does not go away by itself,
+             * the data is kept and the problem reported */
+            case CURLE_UNSUPPORTED_PROTOCOL:
+            case CURLE_URL_MALFORMAT:
+            case CURLE_NOT_BUILT_IN:
+                *resultPtr = UPLOAD_RESULT_FLAGGED;
+                break;
+
+            /* Network and server side failures are transient */
+            default:
+                retry = true;
+                break;
+        }
+    }
+    else if (HttpStatus::isSuccessful(httpCode))
+    {
+        *resultPtr = UPLOAD_RESULT_SUCCESS;
+    }
+    else if (HttpStatus::isServerError(httpCode) ||
+             (httpCode == HttpStatus::TooManyRequests) ||
+             (httpCode == HttpStatus::RequestTimeout))
+    {
+        retry = true;
+    }
+    else if ((httpCode == HttpStatus::Unauthorized) ||
+             (httpCode == HttpStatus::Forbidden))
+    {
+        *resultPtr = UPLOAD_RESULT_FLAGGED;
+    }
+    else
+    {
+        /* Other 4xx and unexpected codes: the request itself is wrong */
+        *resultPtr = UPLOAD_RESULT_REJECTED;
+    }
+
+    return retry;
+}
+
+/*!
+ * @brief Get the delay before the next attempt, exponential with full
+ * jitter so that hubs failing together do not retry together
+ *
+ * @param[in] attempt   Number of attempts done
+ *
+ * @return Delay in milliseconds
+ * */
+uint32_t HttpUploader::getBackoffMs(uint8_t attempt)
+{
+    uint32_t maxMs = UPLOADER_BACKOFF_MAX_MS;
+
+    if (attempt < 32)
+    {
+        uint64_t expMs = (uint64_t) UPLOADER_BACKOFF_BASE_MS << attempt;
+
+        if (expMs < maxMs)
+        {
+            maxMs = expMs;
+        }
+    }
+
+    return jitterGenerator() % (maxMs + 1);
+}
+
+/*!
+ * @brief Queue data to be posted to the server
+ *
+ * @param[in] data          Data to post, copied
+ * @param[in] len           Number of bytes
+ * @param[in] handler       Function called once the upload is complete
+ * @param[in] contextPtr    Context given to the handler
+ * @param[out] requestIdPtr Identifier of the request, given to the handler
+ * @param[in] trafficClass  Priority class of the data
+ *
+ * @return LE_OK on success, LE_BUSY if too many requests of the class are
+ * queued, LE_FAULT if the uploader is not initialized
+ * */
+le_result_t HttpUploader::submit(const uint8_t* data, uint32_t len,
+                                    CompletionHandler handler,
+                                    void* contextPtr, uint32_t* requestIdPtr,
+                                    TrafficClass trafficClass)
+{
+    if ((multiHandle == NULL) || (trafficClass >= TRAFFIC_CLASS_NB))
+    {
+        return LE_FAULT;
+    }
+
+    if (waitingRequests[trafficClass].size() >=
+                                    UPLOADER_CLASS_MAX_QUEUED[trafficClass])
+    {
+        return LE_BUSY;
+    }
+
+    Request* requestPtr = new Request;
+
+    requestPtr->id = nextRequestId++;
+    requestPtr->trafficClass = trafficClass;
+    requestPtr->body.assign(data, data + len);
+    requestPtr->sentOffset = 0;
+    requestPtr->attemptNb = 0;
+    requestPtr->submitMs = getNowMs();
+    requestPtr->dueMs = requestPtr->submitMs;
+    requestPtr->easyHandle = NULL;
+    requestPtr->resolveList = NULL;
+    requestPtr->isPauseRequested = false;
+    requestPtr->isPaused = false;
+    requestPtr->pauseNb = 0;
+    requestPtr->handler = handler;
+    requestPtr->contextPtr = contextPtr;
+
+    waitingRequests[trafficClass].push_back(requestPtr);
+    classStats[trafficClass].requestNb++;
+    requestNb++;
+
+    if (requestIdPtr != NULL)
+    {
+        *requestIdPtr = requestPtr->id;
+    }
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Choose how the next request to start is picked between the classes
+ *
+ * @param[in] mode  Scheduling mode
+ *
+ * @return None
+ * */
+void HttpUploader::setScheduling(SchedulingMode mode)
+{
+    schedulingMode = mode;
+    memset(classCredits, 0, sizeof(classCredits));
+}
+
+/*!
+ * @brief Set the function told about the link after each attempt, to track
+ * its liveness from the uploads
+ *
+ * @param[in] handler       Function called, NULL to remove it
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return None
+ * */
+void HttpUploader::setActivityHandler(ActivityHandler handler,
+                                        void* contextPtr)
+{
+    activityHandler = handler;
+    activityContextPtr = contextPtr;
+}
+
+/*!
+ * @brief Get the host name and the port of the server from its URL
+ *
+ * @return False if the URL has no host name, or an IP address
+ * */
+bool HttpUploader::parseHost(void)
+{
+    size_t start = url.find("://");
+    size_t end;
+    size_t portStart;
+    struct in6_addr addr;
+    std::string port;
+
+    if (start == std::string::npos)
+    {
+        return false;
+    }
+
+    start += 3;
+    end = url.find_first_of("/?#", start);
+    host = url.substr(start, (end == std::string::npos) ? std::string::npos :
+                                                            (end - start));
+
+    /* No user name in the URLs of the uploader, but skip it anyway */
+    if (host.find('@') != std::string::npos)
+    {
+        host.erase(0, host.find('@') + 1);
+    }
+
+    portStart = host.find(':');
+
+    if (portStart != std::string::npos)
+    {
+        port = host.substr(portStart + 1);
+        host.erase(portStart);
+    }
+    else
+    {
+        port = (url.compare(0, 6, "https:") == 0) ? "443" : "80";
+    }
+
+    hostPort = host + ":" + port + ":";
+
+    return !host.empty() && (host[0] != '[') &&
+            (inet_pton(AF_INET, host.c_str(), &addr) != 1);
+}
+
+/*!
+ * @brief Take the address of the server from a DNS cache. Its name is
+ * prefetched, so that the cache keeps it resolved.
+ *
+ * @param[in] cachePtr  DNS cache, NULL to let curl resolve the name
+ *
+ * @return None
+ * */
+void HttpUploader::setResolver(DnsCache* cachePtr)
+{
+    resolverPtr = NULL;
+
+    if ((cachePtr != NULL) && parseHost())
+    {
+        resolverPtr = cachePtr;
+        resolverPtr->prefetch(host);
+    }
+}
+
+/*!
+ * @brief Add an attempt of a request to the multi handle
+ *
+ * @param[in] requestPtr    Request to send
+ *
+ * @return Status of the operation
+ * */
+bool HttpUploader::startRequest(Request* requestPtr)
+{
+    CURL* easyHandle = curl_easy_init();
+
+    if (easyHandle == NULL)
+    {
+        LE_ERROR("Failed to create a curl handle");
+        return false;
+    }
+
+    curl_easy_setopt(easyHandle, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(easyHandle, CURLOPT_PRIVATE, requestPtr);
+    curl_easy_setopt(easyHandle, CURLOPT_SHARE, shareHandle);
+    curl_easy_setopt(easyHandle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(easyHandle, CURLOPT_HTTPHEADER, headerList);
+    curl_easy_setopt(easyHandle, CURLOPT_POST, 1L);
+    curl_easy_setopt(easyHandle, CURLOPT_READFUNCTION, readBody);
+    curl_easy_setopt(easyHandle, CURLOPT_READDATA, requestPtr);
+    curl_easy_setopt(easyHandle, CURLOPT_SEEKFUNCTION, seekBody);
+    curl_easy_setopt(easyHandle, CURLOPT_SEEKDATA, requestPtr);
+    curl_easy_setopt(easyHandle, CURLOPT_POSTFIELDSIZE_LARGE,
+                                        (curl_off_t) requestPtr->body.size());
+    curl_easy_setopt(easyHandle, CURLOPT_WRITEFUNCTION, discardResponse);
+
+    /* HTTP/2 over TLS when the server agrees to it, and wait for the
+     * connection in progress rather than opening a new one so that the
+     * requests can be multiplexed. An urgent request does not wait: without
+     * HTTP/2 it would only go once the bulk upload in progress is done. */
+    curl_easy_setopt(easyHandle, CURLOPT_HTTP_VERSION,
+                                                (long) CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easyHandle, CURLOPT_PIPEWAIT,
+                    (requestPtr->trafficClass == TRAFFIC_CLASS_BULK) ? 1L : 0L);
+
+    curl_easy_setopt(easyHandle, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(easyHandle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easyHandle, CURLOPT_TCP_KEEPIDLE,
+                                        (long) UPLOADER_KEEPALIVE_IDLE_SEC);
+    curl_easy_setopt(easyHandle, CURLOPT_TCP_KEEPINTVL,
+                                        (long) UPLOADER_KEEPALIVE_INTVL_SEC);
+    curl_easy_setopt(easyHandle, CURLOPT_CONNECTTIMEOUT_MS,
+                                        (long) UPLOADER_CONNECT_TIMEOUT_MS);
+    curl_easy_setopt(easyHandle, CURLOPT_TIMEOUT_MS,
+                                        (long) UPLOADER_REQUEST_TIMEOUT_MS);
+
+    if (resolverPtr != NULL)
+    {
+        std::vector<std::string> addresses;
+
+        /* Replaces the address curl cached for the name, if any */
+        if (resolverPtr->lookup(host, &addresses))
+        {
+            requestPtr->resolveList = curl_slist_append(NULL,
+                                        (hostPort + addresses[0]).c_str());
+            curl_easy_setopt(easyHandle, CURLOPT_RESOLVE,
+                                requestPtr->resolveList);
+            cachedAddressNb++;
+        }
+    }
+
+    if (curl_multi_add_handle(multiHandle, easyHandle) != CURLM_OK)
+    {
+        LE_ERROR("Failed to start request %u", requestPtr->id);
+        curl_easy_cleanup(easyHandle);
+        curl_slist_free_all(requestPtr->resolveList);
+        requestPtr->resolveList = NULL;
+        return false;
+    }
+
+    if (requestPtr->attemptNb == 0)
+    {
+        ClassStats& stats = classStats[requestPtr->trafficClass];
+        uint32_t queueMs = getNowMs() - requestPtr->submitMs;
+
+        stats.startedNb++;
+        stats.totalQueueMs += queueMs;
+        stats.maxQueueMs = (queueMs > stats.maxQueueMs) ? queueMs :
+                                                            stats.maxQueueMs;
+    }
+
+    requestPtr->easyHandle = easyHandle;
+    requestPtr->sentOffset = 0;
+    requestPtr->isPauseRequested = false;
+    requestPtr->isPaused = false;
+    requestPtr->attemptNb++;
+    activeNb++;
+    attemptNb++;
+
+    return true;
+}
+
+/*!
+ * @brief Find the first request of a class ready to start
+ *
+ * @param[in] trafficClass  Class of the request
+ * @param[in] nowMs         Current time
+ *
+ * @return The request, NULL if none is ready
+ * */
+HttpUploader::Request* HttpUploader::findDueRequest(TrafficClass trafficClass,
+                                                    uint64_t nowMs)
+{
+    std::list<Request*>& requests = waitingRequests[trafficClass];
+
+    for (std::list<Request*>::iterator it = requests.begin();
+         it != requests.end(); it++)
+    {
+        if (((*it)->easyHandle == NULL) && ((*it)->dueMs <= nowMs))
+        {
+            return *it;
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Choose the next request to start according to the scheduling mode
+ *
+ * @param[in] nowMs     Current time
+ *
+ * @return The request, NULL if none can start
+ * */
+HttpUploader::Request* HttpUploader::pickRequest(uint64_t nowMs)
+{
+    Request* candidates[TRAFFIC_CLASS_NB];
+    uint16_t bulkActiveNb = 0;
+    int32_t totalWeight = 0;
+    int8_t picked = -1;
+
+    for (uint8_t i = 0; i < TRAFFIC_CLASS_NB; i++)
+    {
+        candidates[i] = findDueRequest((TrafficClass) i, nowMs);
+    }
+
+    for (std::list<Request*>::iterator it =
+                                waitingRequests[TRAFFIC_CLASS_BULK].begin();
+         it != waitingRequests[TRAFFIC_CLASS_BULK].end(); it++)
+    {
+        bulkActiveNb += ((*it)->easyHandle != NULL) ? 1 : 0;
+    }
+
+    /* Keep connections for the urgent classes */
+    if (bulkActiveNb >= (UPLOADER_MAX_HOST_CONNECTIONS -
+                                                    UPLOADER_PRIORITY_SLOTS))
+    {
+        candidates[TRAFFIC_CLASS_BULK] = NULL;
+    }
+
+    for (uint8_t i = 0; i < TRAFFIC_CLASS_NB; i++)
+    {
+        if (candidates[i] == NULL)
+        {
+            continue;
+        }
+
+        if (schedulingMode == SCHEDULING_STRICT)
+        {
+            return candidates[i];
+        }
+
+        /* Smooth weighted round robin between the classes ready */
+        classCredits[i] += UPLOADER_CLASS_WEIGHTS[i];
+        totalWeight += UPLOADER_CLASS_WEIGHTS[i];
+
+        if ((picked < 0) || (classCredits[i] > classCredits[picked]))
+        {
+            picked = i;
+        }
+    }
+
+    if (picked < 0)
+    {
+        return NULL;
+    }
+
+    classCredits[picked] -= totalWeight;
+
+    return candidates[picked];
+}
+
+/*!
+ * @brief Start the queued requests whose time has come, within the limit of
+ * requests in flight
+ *
+ * @return None
+ * */
+void HttpUploader::startDueRequests(void)
+{
+    uint64_t nowMs = getNowMs();
+
+    while (activeNb < UPLOADER_MAX_CONCURRENT)
+    {
+        Request* requestPtr = pickRequest(nowMs);
+
+        if ((requestPtr == NULL) || !startRequest(requestPtr))
+        {
+            break;
+        }
+    }
+}
+
+/*!
+ * @brief Pause the bulk uploads while an alert or control request is in
+ * flight or ready to start, and resume them once there is none. The bulk
+ * uploads stop at their next chunk boundary, see readBody().
+ *
+ * @return None
+ * */
+void HttpUploader::updatePreemption(void)
+{
+    uint64_t nowMs = getNowMs();
+    bool isUrgent = false;
+
+    for (uint8_t i = 0; (i < TRAFFIC_CLASS_BULK) && !isUrgent; i++)
+    {
+        for (std::list<Request*>::iterator it = waitingRequests[i].begin();
+             it != waitingRequests[i].end(); it++)
+        {
+            if (((*it)->easyHandle != NULL) || ((*it)->dueMs <= nowMs))
+            {
+                isUrgent = true;
+                break;
+            }
+        }
+    }
+
+    std::list<Request*>& bulkRequests = waitingRequests[TRAFFIC_CLASS_BULK];
+
+    for (std::list<Request*>::iterator it = bulkRequests.begin();
+         it != bulkRequests.end(); it++)
+    {
+        Request* requestPtr = *it;
+
+        if (requestPtr->easyHandle == NULL)
+        {
+            continue;
+        }
+
+        requestPtr->isPauseRequested = isUrgent;
+
+        if (!isUrgent && requestPtr->isPaused)
+        {
+            requestPtr->isPaused = false;
+            curl_easy_pause(requestPtr->easyHandle, CURLPAUSE_CONT);
+        }
+    }
+}
+
+/*!
+ * @brief Account the bytes of an attempt and update the bearer throughput
+ * estimate with it
+ *
+ * @param[in] easyHandle    Handle of the attempt
+ * @param[in] bodySize      Size of the data posted
+ *
+ * @return None
+ * */
+void HttpUploader::updateThroughput(CURL* easyHandle, uint32_t bodySize)
+{
+    long requestSize = 0;
+    long responseHeaderSize = 0;
+    double totalTimeSec = 0;
+
+    curl_easy_getinfo(easyHandle, CURLINFO_REQUEST_SIZE, &requestSize);
+    curl_easy_getinfo(easyHandle, CURLINFO_HEADER_SIZE, &responseHeaderSize);
+    curl_easy_getinfo(easyHandle, CURLINFO_TOTAL_TIME, &totalTimeSec);
+
+    /* The request size covers the headers and the data posted */
+    uint32_t bytesNb = ((requestSize > (long) bodySize) ?
+                            requestSize : bodySize) + responseHeaderSize;
+
+    onAirBytesNb += bytesNb;
+
+    if (totalTimeSec > 0)
+    {
+        /* Includes the round trip and the server time: this is the
+         * throughput actually seen by the uploads, not the raw bearer rate */
+        double kbps = (bytesNb * 8) / (totalTimeSec * 1000);
+
+        throughputKbps = (throughputKbps == 0) ? kbps :
+                        (UPLOADER_THROUGHPUT_EWMA_WEIGHT * kbps +
+                        (1 - UPLOADER_THROUGHPUT_EWMA_WEIGHT) * throughputKbps);
+    }
+}
+
+/*!
+ * @brief Report the result of a request and forget it
+ *
+ * @param[in] requestPtr    Request completed
+ * @param[in] result        Result of the upload
+ * @param[in] httpCode      HTTP status of the last response
+ *
+ * @return None
+ * */
+void HttpUploader::finishRequest(Request* requestPtr, UploadResult result,
+                                    long httpCode)
+{
+    ClassStats& stats = classStats[requestPtr->trafficClass];
+    uint32_t latencyMs = getNowMs() - requestPtr->submitMs;
+
+    switch (result)
+    {
+        case UPLOAD_RESULT_SUCCESS:
+            successNb++;
+            sentBytesNb += requestPtr->body.size();
+            totalLatencyMs += latencyMs;
+            stats.deliveredNb++;
+            stats.totalLatencyMs += latencyMs;
+            stats.maxLatencyMs = (latencyMs > stats.maxLatencyMs) ?
+                                                latencyMs : stats.maxLatencyMs;
+            break;
+
+        case UPLOAD_RESULT_REJECTED:
+            LE_WARN("Request %u rejected by the server (%ld %s), dropped",
+                    requestPtr->id, httpCode,
+                    HttpStatus::reasonPhrase(httpCode).c_str());
+            rejectedNb++;
+            break;
+
+        case UPLOAD_RESULT_FLAGGED:
+            LE_ERROR("Request %u refused (%ld), check the hub configuration",
+                                                    requestPtr->id, httpCode);
+            flaggedNb++;
+            break;
+
+        case UPLOAD_RESULT_EXHAUSTED:
+            LE_ERROR("Request %u failed after %u attempts", requestPtr->id,
+                                                    requestPtr->attemptNb);
+            exhaustedNb++;
+            break;
+    }
+
+    waitingRequests[requestPtr->trafficClass].remove(requestPtr);
+
+    if (requestPtr->handler != NULL)
+    {
+        requestPtr->handler(requestPtr->id, result, httpCode,
+                                                    requestPtr->contextPtr);
+    }
+
+    delete requestPtr;
+}
+
+/*!
+ * @brief Handle the end of an attempt: complete the request or schedule a
+ * retry
+ *
+ * @param[in] msgPtr    Message of the multi handle for the attempt
+ *
+ * @return None
+ * */
+void HttpUploader::completeRequest(CURLMsg* msgPtr)
+{
+    CURL* easyHandle = msgPtr->easy_handle;
+    CURLcode code = msgPtr->data.result;
+    Request* requestPtr = NULL;
+    long httpCode = 0;
+    long connectNb = 0;
+    long httpVersion = 0;
+    UploadResult result = UPLOAD_RESULT_EXHAUSTED;
+
+    curl_easy_getinfo(easyHandle, CURLINFO_PRIVATE, (char**) &requestPtr);
+    curl_easy_getinfo(easyHandle, CURLINFO_RESPONSE_CODE, &httpCode);
+    curl_easy_getinfo(easyHandle, CURLINFO_NUM_CONNECTS, &connectNb);
+    curl_easy_getinfo(easyHandle, CURLINFO_HTTP_VERSION, &httpVersion);
+
+    uint32_t retryAfterMs = 0;
+#if LIBCURL_VERSION_NUM >= 0x074200
+    curl_off_t retryAfterSec = 0;
+
+    if ((curl_easy_getinfo(easyHandle, CURLINFO_RETRY_AFTER,
+                                            &retryAfterSec) == CURLE_OK) &&
+        (retryAfterSec > 0))
+    {
+        retryAfterMs = (retryAfterSec * 1000 < UPLOADER_BACKOFF_MAX_MS) ?
+                            (retryAfterSec * 1000) : UPLOADER_BACKOFF_MAX_MS;
+    }
+#endif
+
+    if (code == CURLE_OK)
+    {
+        updateThroughput(easyHandle, requestPtr->body.size());
+        (connectNb == 0) ? reusedConnectionNb++ : newConnectionNb++;
+
+        if (httpVersion == CURL_HTTP_VERSION_2_0)
+        {
+            http2Nb++;
+        }
+    }
+
+    if (activityHandler != NULL)
+    {
+        curl_socket_t socketFd = CURL_SOCKET_BAD;
+
+        /* Read while the connection is still attached to the transfer */
+        if (curl_easy_getinfo(easyHandle, CURLINFO_ACTIVESOCKET,
+                                &socketFd) != CURLE_OK)
+        {
+            socketFd = CURL_SOCKET_BAD;
+        }
+
+        activityHandler(httpCode > 0,
+                        (socketFd == CURL_SOCKET_BAD) ? -1 : socketFd,
+                        activityContextPtr);
+    }
+
+    curl_multi_remove_handle(multiHandle, easyHandle);
+    curl_easy_cleanup(easyHandle);
+    curl_slist_free_all(requestPtr->resolveList);
+    requestPtr->easyHandle = NULL;
+    requestPtr->resolveList = NULL;
+    preemptionNb += requestPtr->pauseNb;
+    requestPtr->pauseNb = 0;
+    activeNb--;
+
+    if (!isRetryable(code, httpCode, &result))
+    {
+        finishRequest(requestPtr, result, httpCode);
+    }
+    else if (requestPtr->attemptNb >= UPLOADER_MAX_ATTEMPTS)
+    {
+        finishRequest(requestPtr, UPLOAD_RESULT_EXHAUSTED, httpCode);
+    }
+    else
+    {
+        /* A delay asked by the server is honoured, the jitter is added on
+         * top so that the hubs do not all come back at the same time */
+        uint32_t delayMs = retryAfterMs + getBackoffMs(requestPtr->attemptNb);
+
+        LE_WARN("Request %u attempt %u failed (%s, HTTP %ld), retry in %u ms",
+                requestPtr->id, requestPtr->attemptNb, curl_easy_strerror(code),
+                httpCode, delayMs);
+
+        requestPtr->dueMs = getNowMs() + delayMs;
+        retryNb++;
+    }
+}
+
+/*!
+ * @brief Handle the attempts completed since the last call
+ *
+ * @return None
+ * */
+void HttpUploader::readCompletions(void)
+{
+    CURLMsg* msgPtr;
+    int32_t msgNb;
+
+    while ((msgPtr = curl_multi_info_read(multiHandle, &msgNb)) != NULL)
+    {
+        if (msgPtr->msg == CURLMSG_DONE)
+        {
+            completeRequest(msgPtr);
+        }
+    }
+}
+
+/*!
+ * @brief Move the transfers forward. To be called regularly, ideally after
+ * getNextTimeoutMs() elapsed.
+ *
+ * @param[in] waitMs    Maximum time to wait for network activity, 0 to only
+ *                      process what is ready
+ *
+ * @return None
+ * */
+void HttpUploader::process(uint32_t waitMs)
+{
+    int32_t runningNb = 0;
+
+    if (multiHandle == NULL)
+    {
+        return;
+    }
+
+    startDueRequests();
+    updatePreemption();
+    curl_multi_perform(multiHandle, &runningNb);
+    readCompletions();
+
+    if ((waitMs > 0) && (activeNb > 0))
+    {
+        int32_t nextTimeoutMs = getNextTimeoutMs();
+        int32_t fdNb;
+
+        if ((nextTimeoutMs >= 0) && ((uint32_t) nextTimeoutMs < waitMs))
+        {
+            waitMs = nextTimeoutMs;
+        }
+
+        curl_multi_wait(multiHandle, NULL, 0, waitMs, &fdNb);
+        curl_multi_perform(multiHandle, &runningNb);
+        readCompletions();
+    }
+
+    /* Retries completed above can free slots for the next requests */
+    startDueRequests();
+    updatePreemption();
+    curl_multi_perform(multiHandle, &runningNb);
+}
+
+/*!
+ * @brief Get the time until process() has work to do without network
+ * activity: a curl timeout or a retry becoming due
+ *
+ * @return Delay in milliseconds, -1 if there is nothing to wait for
+ * */
+int32_t HttpUploader::getNextTimeoutMs(void)
+{
+    long curlTimeoutMs = -1;
+    int64_t timeoutMs = -1;
+    uint64_t nowMs = getNowMs();
+
+    if (multiHandle == NULL)
+    {
+        return -1;
+    }
+
+    if (activeNb > 0)
+    {
+        curl_multi_timeout(multiHandle, &curlTimeoutMs);
+        timeoutMs = curlTimeoutMs;
+    }
+
+    for (uint8_t i = 0; (i < TRAFFIC_CLASS_NB) &&
+                        (activeNb < UPLOADER_MAX_CONCURRENT); i++)
+    {
+        for (std::list<Request*>::iterator it = waitingRequests[i].begin();
+             it != waitingRequests[i].end(); it++)
+        {
+            if ((*it)->easyHandle == NULL)
+            {
+                int64_t dueInMs = ((*it)->dueMs > nowMs) ?
+                                                ((*it)->dueMs - nowMs) : 0;
+
+                if ((timeoutMs < 0) || (dueInMs < timeoutMs))
+                {
+                    timeoutMs = dueInMs;
+                }
+            }
+        }
+    }
+
+    return timeoutMs;
+}
+
+/*!
+ * @brief Get the number of requests not completed yet
+ *
+ * @return Number of requests in flight or waiting
+ * */
+uint16_t HttpUploader::getPendingNb(void) const
+{
+    uint16_t pendingNb = 0;
+
+    for (uint8_t i = 0; i < TRAFFIC_CLASS_NB; i++)
+    {
+        pendingNb += waitingRequests[i].size();
+    }
+
+    return pendingNb;
+}
+
+/*!
+ * @brief Get the throughput measured on the last uploads
+ *
+ * @return Throughput in kbit/s, 0 if nothing was uploaded yet
+ * */
+uint32_t HttpUploader::getThroughputKbps(void) const
+{
+    return throughputKbps;
+}
+
+/*!
+ * @brief Log the statistics of the uploader
+ *
+ * @return None
+ * */
+void HttpUploader::logStats(void) const
+{
+    LE_INFO("Uploader: requests %u, attempts %u, success %u, retries %u, "
+            "rejected %u, flagged %u, exhausted %u", requestNb, attemptNb,
+            successNb, retryNb, rejectedNb, flaggedNb, exhaustedNb);
+    LE_INFO("Uploader: connections new %u reused %u, HTTP/2 %u, sent %llu "
+            "bytes (%llu on air), throughput %u kbps, average latency %llu ms",
+            newConnectionNb, reusedConnectionNb, http2Nb,
+            (unsigned long long) sentBytesNb,
+            (unsigned long long) onAirBytesNb, (uint32_t) throughputKbps,
+            (unsigned long long) ((successNb > 0) ?
+                                            (totalLatencyMs / successNb) : 0));
+    LE_INFO("Uploader: %s scheduling, %u bulk preemptions, %u attempts to "
+            "an address from the DNS cache",
+            (schedulingMode == SCHEDULING_STRICT) ? "strict" : "weighted",
+            preemptionNb, cachedAddressNb);
+
+    for (uint8_t i = 0; i < TRAFFIC_CLASS_NB; i++)
+    {
+        const ClassStats& stats = classStats[i];
+
+        LE_INFO("Uploader %s: requests %u, queued %u, queueing average %llu "
+                "ms max %u ms, delivered %u, latency average %llu ms max %u "
+                "ms", TRAFFIC_CLASS_NAMES[i], stats.requestNb,
+                (uint32_t) waitingRequests[i].size(),
+                (unsigned long long) ((stats.startedNb > 0) ?
+                                (stats.totalQueueMs / stats.startedNb) : 0),
+                stats.maxQueueMs, stats.deliveredNb,
+                (unsigned long long) ((stats.deliveredNb > 0) ?
+                                (stats.totalLatencyMs / stats.deliveredNb) : 0),
+                stats.maxLatencyMs);
+    }
+}
+
+/*** end of file ***/
@@ -0,0 +1,136 @@
+/** @file HttpUploader.h
+ *
+ * @brief This class uploads data to the Current Health server over HTTP,
+ * running several requests at the same time from a single thread
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef HTTP_UPLOADER_H
+#define HTTP_UPLOADER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/DnsCache.h"
+#include "Uplink/HttpUploaderUtils.h"
+#include <curl/curl.h>
+#include <list>
+#include <random>
+#include <vector>
+
+class HttpUploader
+{
+    private:
+        struct Request
+        {
+            uint32_t id;
+            HttpUploaderTypes::TrafficClass trafficClass;
+            std::vector<uint8_t> body;
+            uint32_t sentOffset;
+            uint8_t attemptNb;
+            uint64_t dueMs;
+            uint64_t submitMs;
+            CURL* easyHandle;
+            /* Address of the server given to curl, from the DNS cache */
+            struct curl_slist* resolveList;
+            bool isPauseRequested;
+            bool isPaused;
+            uint16_t pauseNb;
+            HttpUploaderTypes::CompletionHandler handler;
+            void* contextPtr;
+        };
+
+        /* Queueing statistics of a traffic class */
+        struct ClassStats
+        {
+            uint32_t requestNb;
+            uint32_t startedNb;
+            uint64_t totalQueueMs;
+            uint32_t maxQueueMs;
+            uint32_t deliveredNb;
+            uint64_t totalLatencyMs;
+            uint32_t maxLatencyMs;
+        };
+
+        std::string url;
+        CURLM* multiHandle;
+        CURLSH* shareHandle;
+        struct curl_slist* headerList;
+        std::list<Request*>
+            waitingRequests[HttpUploaderTypes::TRAFFIC_CLASS_NB];
+        HttpUploaderTypes::SchedulingMode schedulingMode;
+        int32_t classCredits[HttpUploaderTypes::TRAFFIC_CLASS_NB];
+        ClassStats classStats[HttpUploaderTypes::TRAFFIC_CLASS_NB];
+        uint16_t activeNb;
+        uint32_t nextRequestId;
+        std::minstd_rand jitterGenerator;
+        uint32_t requestNb;
+        uint32_t attemptNb;
+        uint32_t successNb;
+        uint32_t retryNb;
+        uint32_t rejectedNb;
+        uint32_t flaggedNb;
+        uint32_t exhaustedNb;
+        uint32_t newConnectionNb;
+        uint32_t reusedConnectionNb;
+        uint32_t http2Nb;
+        uint64_t sentBytesNb;
+        uint64_t onAirBytesNb;
+        uint64_t totalLatencyMs;
+        uint32_t preemptionNb;
+        double throughputKbps;
+        HttpUploaderTypes::ActivityHandler activityHandler;
+        void* activityContextPtr;
+        DnsCache* resolverPtr;
+        std::string host;
+        std::string hostPort;
+        uint32_t cachedAddressNb;
+
+        static uint64_t getNowMs(void);
+        static size_t discardResponse(char* ptr, size_t size, size_t nmemb,
+                                        void* userdata);
+        static size_t readBody(char* buffer, size_t size, size_t nitems,
+                                void* userdata);
+        static int seekBody(void* userdata, curl_off_t offset, int origin);
+        static bool isRetryable(CURLcode code, long httpCode,
+                                HttpUploaderTypes::UploadResult* resultPtr);
+        uint32_t getBackoffMs(uint8_t attempt);
+        bool parseHost(void);
+        bool startRequest(Request* requestPtr);
+        Request* findDueRequest(HttpUploaderTypes::TrafficClass trafficClass,
+                                uint64_t nowMs);
+        Request* pickRequest(uint64_t nowMs);
+        void updatePreemption(void);
+        void completeRequest(CURLMsg* msgPtr);
+        void updateThroughput(CURL* easyHandle, uint32_t bodySize);
+        void finishRequest(Request* requestPtr,
+                            HttpUploaderTypes::UploadResult result,
+                            long httpCode);
+        void startDueRequests(void);
+        void readCompletions(void);
+
+    public:
+        HttpUploader(const std::string& serverUrl =
+                                HttpUploaderConstants::UPLOADER_DEFAULT_URL);
+        ~HttpUploader(void);
+        bool init(void);
+        le_result_t submit(const uint8_t* data, uint32_t len,
+                            HttpUploaderTypes::CompletionHandler handler,
+                            void* contextPtr, uint32_t* requestIdPtr = NULL,
+                            HttpUploaderTypes::TrafficClass trafficClass =
+                                        HttpUploaderTypes::TRAFFIC_CLASS_BULK);
+        void setScheduling(HttpUploaderTypes::SchedulingMode mode);
+        void setActivityHandler(HttpUploaderTypes::ActivityHandler handler,
+                                void* contextPtr);
+        void setResolver(DnsCache* cachePtr);
+        void process(uint32_t waitMs);
+        int32_t getNextTimeoutMs(void);
+        uint16_t getPendingNb(void) const;
+        uint32_t getThroughputKbps(void) const;
+        void logStats(void) const;
+};
+
+#endif /* HTTP_UPLOADER_H */
+
+/*** end of file ***/
@@ -0,0 +1,126 @@
+/** @file HttpUploaderUtils.h
+ *
+ * @brief This file provides the types and constants of the HTTP uploader
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef HTTP_UPLOADER_UTILS_H
+#define HTTP_UPLOADER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <iostream>
+
+namespace HttpUploaderTypes
+{
+    /* Final result of an upload */
+    enum UploadResult
+    {
+        /* The server accepted the data (2xx) */
+        UPLOAD_RESULT_SUCCESS,
+        /* The server refused the data for good (4xx), retrying would fail
+         * the same way so the data can be dropped */
+        UPLOAD_RESULT_REJECTED,
+        /* The server refused the hub itself (401, 403). The data is fine and
+         * must be kept until the problem is fixed. */
+        UPLOAD_RESULT_FLAGGED,
+        /* All the attempts failed on transport errors, 5xx or 429 */
+        UPLOAD_RESULT_EXHAUSTED
+    };
+
+    /* Priority class of an upload, the most urgent first */
+    enum TrafficClass
+    {
+        /* Alerts raised by the wearables or the hub */
+        TRAFFIC_CLASS_ALERT,
+        /* Small messages driving the devices: acks, status, configuration */
+        TRAFFIC_CLASS_CONTROL,
+        /* Batches of sensor history */
+        TRAFFIC_CLASS_BULK,
+        TRAFFIC_CLASS_NB
+    };
+
+    /* How the next request to start is chosen between the classes */
+    enum SchedulingMode
+    {
+        /* Always the most urgent class with a request ready */
+        SCHEDULING_STRICT,
+        /* Smooth weighted round robin on UPLOADER_CLASS_WEIGHTS, so that the
+         * bulk data still moves under a steady flow of urgent requests */
+        SCHEDULING_WEIGHTED
+    };
+
+    /* Function called when an upload is complete, after its retries */
+    typedef void (*CompletionHandler)(uint32_t requestId, UploadResult result,
+                                        int32_t httpCode, void* contextPtr);
+
+    /* Function called after each attempt, with what it tells about the link:
+     * isDelivered is true if the server answered, whatever the answer. The
+     * socket is the connection used, -1 if it is already closed. */
+    typedef void (*ActivityHandler)(bool isDelivered, int32_t socketFd,
+                                    void* contextPtr);
+}
+
+namespace HttpUploaderConstants
+{
+    /* Server receiving the data. A loopback URL can be given to the
+     * uploader to test against a local server. */
+    const std::string UPLOADER_DEFAULT_URL =
+                                    "https://ingest.currenthealth.com/v1/pdu";
+    const std::string UPLOADER_CONTENT_TYPE = "application/octet-stream";
+
+    /* Requests in flight at the same time. They share a single connection
+     * when the server speaks HTTP/2. */
+    const uint16_t UPLOADER_MAX_CONCURRENT = 4;
+    const uint16_t UPLOADER_MAX_HOST_CONNECTIONS = 2;
+
+    /* Requests waiting to be sent per class, including the ones waiting for
+     * a retry. An alert is never refused because of the bulk backlog. */
+    const uint16_t
+        UPLOADER_CLASS_MAX_QUEUED[HttpUploaderTypes::TRAFFIC_CLASS_NB] =
+    {
+        16, 16, 64
+    };
+
+    /* Connections kept for the alert and control classes: the bulk requests
+     * in flight never use all of them, so that an urgent request does not
+     * wait for a connection without HTTP/2 */
+    const uint16_t UPLOADER_PRIORITY_SLOTS = 1;
+
+    /* Scheduling of the classes, and their weights in weighted mode */
+    const HttpUploaderTypes::SchedulingMode UPLOADER_DEFAULT_SCHEDULING =
+                                        HttpUploaderTypes::SCHEDULING_STRICT;
+    const uint8_t UPLOADER_CLASS_WEIGHTS[HttpUploaderTypes::TRAFFIC_CLASS_NB] =
+    {
+        8, 4, 1
+    };
+
+    /* The bulk bodies are given to curl by chunks of this size. While an
+     * alert or control request is in flight, the bulk uploads are paused at
+     * the next chunk boundary and resumed once it is done. */
+    const uint32_t UPLOADER_CHUNK_SIZE = 16 * 1024;
+
+    /* Timeouts of a single attempt */
+    const uint32_t UPLOADER_CONNECT_TIMEOUT_MS = 15000;
+    const uint32_t UPLOADER_REQUEST_TIMEOUT_MS = 60000;
+
+    /* Retries use an exponential back-off with full jitter: the delay is
+     * drawn between 0 and min(MAX, BASE * 2^attempt) */
+    const uint8_t UPLOADER_MAX_ATTEMPTS = 8;
+    const uint32_t UPLOADER_BACKOFF_BASE_MS = 1000;
+    const uint32_t UPLOADER_BACKOFF_MAX_MS = 120000;
+
+    /* Idle connections are kept open with TCP keep-alive probes so that the
+     * next upload does not pay for a new TCP and TLS handshake */
+    const uint32_t UPLOADER_KEEPALIVE_IDLE_SEC = 60;
+    const uint32_t UPLOADER_KEEPALIVE_INTVL_SEC = 30;
+
+    /* Weight of the last upload in the bearer throughput estimate */
+    const double UPLOADER_THROUGHPUT_EWMA_WEIGHT = 0.25;
+}
+
+#endif /* HTTP_UPLOADER_UTILS_H */
+
+/*** end of file ***/
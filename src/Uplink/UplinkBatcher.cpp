@@ -0,0 +1,526 @@
+/** @file UplinkBatcher.cpp
+ *
+ * @brief This class groups the PDUs to upload into compressed batches, sized
+ * from the measured throughput of the bearer
+ *
+ * Each upload costs HTTP headers and, on cellular, a radio wake-up. The PDUs
+ * are therefore deflated one after the other into the current batch, which
+ * is sent once it is big enough for the bearer or once its oldest PDU waited
+ * long enough.
+ *
+ * Alert and control PDUs are not held: they are sent at once, alone, in
+ * their own traffic class.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/UplinkBatcher.h"
+#include "Uplink/UplinkBatcherUtils.h"
+#include "Com/WearableDeviceALPUtils.h"
+#include <time.h>
+
+using namespace UplinkBatcherConstants;
+using namespace HttpUploaderTypes;
+
+/*!
+ * @brief Constructor for UplinkBatcher. init() must be called before use.
+ *
+ * @param[in] batchUploader     Uploader the batches are given to
+ * */
+UplinkBatcher::UplinkBatcher(HttpUploader& batchUploader) :
+                                uploader(batchUploader), isStreamReady(false),
+                                compressionRatio(1), pduNb(0), batchNb(0),
+                                sizeTriggerNb(0), ageTriggerNb(0),
+                                deliveredNb(0), lostNb(0), rawBytesNb(0),
+                                compressedBytesNb(0), urgentNb(0),
+                                totalLatencyMs(0), maxLatencyMs(0)
+{
+    memset(&stream, 0, sizeof(stream));
+}
+
+/*!
+ * @brief Destructor for UplinkBatcher. The PDUs not sent are dropped.
+ * */
+UplinkBatcher::~UplinkBatcher(void)
+{
+    if (isStreamReady)
+    {
+        deflateEnd(&stream);
+    }
+}
+
+/*!
+ * @brief Create the compressor and start the first batch
+ *
+ * @return Status of the operation
+ * */
+bool UplinkBatcher::init(void)
+{
+    if (deflateInit(&stream, BATCH_COMPRESSION_LEVEL) != Z_OK)
+    {
+        LE_ERROR("Failed to create the compressor: %s",
+                            (stream.msg != NULL) ? stream.msg : "no memory");
+        return false;
+    }
+
+    isStreamReady = true;
+    startBatch();
+
+    return true;
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t UplinkBatcher::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Write the header of a PDU in a batch
+ *
+ * @param[out] pduHeader    Header, BATCH_PDU_HEADER_SIZE bytes
+ * @param[in] type          Type of the PDU
+ * @param[in] mac           MAC address of the device which sent the PDU
+ * @param[in] len           Size of the payload
+ *
+ * @return None
+ * */
+void UplinkBatcher::setPduHeader(uint8_t* pduHeader, uint8_t type,
+                                    const uint8_t* mac, uint32_t len)
+{
+    pduHeader[0] = type;
+    memcpy(&pduHeader[1], mac, WearableDeviceALPConstants::MAC_ADDRESS_SIZE);
+    pduHeader[7] = len & 0xFF;
+    pduHeader[8] = (len >> 8) & 0xFF;
+    pduHeader[9] = (len >> 16) & 0xFF;
+    pduHeader[10] = (len >> 24) & 0xFF;
+}
+
+/*!
+ * @brief Write the header of a batch
+ *
+ * @param[in,out] batch     Batch, its data starts with room for the header
+ * @param[in] flags         Flags of the batch
+ *
+ * @return None
+ * */
+void UplinkBatcher::setBatchHeader(Batch& batch, uint8_t flags)
+{
+    batch.data[0] = BATCH_FORMAT_VERSION;
+    batch.data[1] = flags;
+    batch.data[2] = batch.pduNb & 0xFF;
+    batch.data[3] = (batch.pduNb >> 8) & 0xFF;
+    batch.data[4] = batch.rawBytesNb & 0xFF;
+    batch.data[5] = (batch.rawBytesNb >> 8) & 0xFF;
+    batch.data[6] = (batch.rawBytesNb >> 16) & 0xFF;
+    batch.data[7] = (batch.rawBytesNb >> 24) & 0xFF;
+}
+
+/*!
+ * @brief Start a new batch, reusing the compressor
+ *
+ * @return None
+ * */
+void UplinkBatcher::startBatch(void)
+{
+    current.data.assign(BATCH_HEADER_SIZE, 0);
+    current.pduNb = 0;
+    current.rawBytesNb = 0;
+    current.firstPduMs = 0;
+
+    deflateReset(&stream);
+}
+
+/*!
+ * @brief Feed data to the compressor, appending its output to the current
+ * batch
+ *
+ * @param[in] data  Data to compress
+ * @param[in] len   Number of bytes
+ * @param[in] mode  Z_NO_FLUSH while the batch is filled, Z_FINISH to end it
+ *
+ * @return Status of the operation
+ * */
+bool UplinkBatcher::compress(const uint8_t* data, uint32_t len, int32_t mode)
+{
+    int32_t result;
+
+    stream.next_in = (Bytef*) data;
+    stream.avail_in = len;
+
+    do
+    {
+        size_t usedNb = current.data.size();
+
+        current.data.resize(usedNb + BATCH_DEFLATE_CHUNK_SIZE);
+        stream.next_out = &current.data[usedNb];
+        stream.avail_out = BATCH_DEFLATE_CHUNK_SIZE;
+
+        result = deflate(&stream, mode);
+
+        current.data.resize(current.data.size() - stream.avail_out);
+
+        if ((result != Z_OK) && (result != Z_STREAM_END) &&
+            (result != Z_BUF_ERROR))
+        {
+            LE_ERROR("Compression failed (%d)", result);
+            return false;
+        }
+    }
+    while ((stream.avail_out == 0) ||
+           ((mode == Z_FINISH) && (result != Z_STREAM_END)));
+
+    return true;
+}
+
+/*!
+ * @brief Add a PDU to the current batch. The batch is sent if it reached the
+ * size threshold.
+ *
+ * @param[in] type  Type of the PDU
+ * @param[in] mac   MAC address of the device which sent the PDU
+ * @param[in] data  Payload of the PDU
+ * @param[in] len   Size of the payload
+ *
+ * @return LE_OK on success, LE_BUSY if the uploader does not keep up and the
+ * PDU has to be offered again later, LE_FAULT on error
+ * */
+le_result_t UplinkBatcher::add(uint8_t type, const uint8_t* mac,
+                                const uint8_t* data, uint32_t len)
+{
+    uint8_t pduHeader[BATCH_PDU_HEADER_SIZE];
+
+    if (!isStreamReady)
+    {
+        return LE_FAULT;
+    }
+
+    if (sealedBatches.size() >= BATCH_MAX_SEALED)
+    {
+        submitSealed();
+
+        if (sealedBatches.size() >= BATCH_MAX_SEALED)
+        {
+            return LE_BUSY;
+        }
+    }
+
+    setPduHeader(pduHeader, type, mac, len);
+
+    if (!compress(pduHeader, sizeof(pduHeader), Z_NO_FLUSH) ||
+        !compress(data, len, Z_NO_FLUSH))
+    {
+        startBatch();
+        return LE_FAULT;
+    }
+
+    if (current.pduNb == 0)
+    {
+        current.firstPduMs = getNowMs();
+    }
+
+    current.pduNb++;
+    current.rawBytesNb += sizeof(pduHeader) + len;
+    pduNb++;
+
+    if (current.rawBytesNb >= getSizeThreshold())
+    {
+        sizeTriggerNb++;
+        seal();
+        submitSealed();
+    }
+
+    return LE_OK;
+}
+
+/*!
+ * @brief Send a PDU at once in a batch of its own, ahead of the bulk data.
+ * It is not compressed, a single small PDU would not gain from it.
+ *
+ * @param[in] trafficClass  Class of the PDU, alert or control
+ * @param[in] type          Type of the PDU
+ * @param[in] mac           MAC address of the device which sent the PDU
+ * @param[in] data          Payload of the PDU
+ * @param[in] len           Size of the payload
+ *
+ * @return LE_OK on success, LE_BUSY if the uploader queue of the class is
+ * full, LE_FAULT on error
+ * */
+le_result_t UplinkBatcher::sendNow(TrafficClass trafficClass, uint8_t type,
+                                    const uint8_t* mac, const uint8_t* data,
+                                    uint32_t len)
+{
+    Batch batch;
+    uint32_t requestId;
+
+    batch.data.assign(BATCH_HEADER_SIZE + BATCH_PDU_HEADER_SIZE, 0);
+    batch.data.insert(batch.data.end(), data, data + len);
+    batch.pduNb = 1;
+    batch.rawBytesNb = BATCH_PDU_HEADER_SIZE + len;
+    batch.firstPduMs = getNowMs();
+
+    setBatchHeader(batch, 0);
+    setPduHeader(&batch.data[BATCH_HEADER_SIZE], type, mac, len);
+
+    le_result_t result = uploader.submit(batch.data.data(), batch.data.size(),
+                                            onUploadComplete, this,
+                                            &requestId, trafficClass);
+
+    if (result != LE_OK)
+    {
+        return result;
+    }
+
+    batch.data.clear();
+    batch.data.shrink_to_fit();
+    sentBatches[requestId] = batch;
+    pduNb++;
+    urgentNb++;
+
+    return LE_OK;
+}
+
+/*!
+ * @brief End the current batch and queue it for upload
+ *
+ * @return Status of the operation
+ * */
+bool UplinkBatcher::seal(void)
+{
+    if (current.pduNb == 0)
+    {
+        return true;
+    }
+
+    if (!compress(NULL, 0, Z_FINISH))
+    {
+        startBatch();
+        return false;
+    }
+
+    setBatchHeader(current, BATCH_FLAG_DEFLATE);
+
+    double ratio = (double) current.data.size() / current.rawBytesNb;
+
+    compressionRatio = BATCH_RATIO_EWMA_WEIGHT * ratio +
+                        (1 - BATCH_RATIO_EWMA_WEIGHT) * compressionRatio;
+
+    rawBytesNb += current.rawBytesNb;
+    compressedBytesNb += current.data.size();
+    batchNb++;
+
+    sealedBatches.push_back(current);
+    startBatch();
+
+    return true;
+}
+
+/*!
+ * @brief Give the sealed batches to the uploader, as long as it takes them
+ *
+ * @return None
+ * */
+void UplinkBatcher::submitSealed(void)
+{
+    while (!sealedBatches.empty())
+    {
+        Batch& batch = sealedBatches.front();
+        uint32_t requestId;
+
+        if (uploader.submit(batch.data.data(), batch.data.size(),
+                            onUploadComplete, this, &requestId) != LE_OK)
+        {
+            break;
+        }
+
+        /* The uploader has its own copy of the data */
+        batch.data.clear();
+        batch.data.shrink_to_fit();
+        sentBatches[requestId] = batch;
+        sealedBatches.pop_front();
+    }
+}
+
+/*!
+ * @brief Account the end of the upload of a batch
+ *
+ * @param[in] requestId     Identifier of the upload request
+ * @param[in] result        Result of the upload
+ * @param[in] httpCode      HTTP status of the last response
+ * @param[in] contextPtr    Batcher which sent the batch
+ *
+ * @return None
+ * */
+void UplinkBatcher::onUploadComplete(uint32_t requestId, UploadResult result,
+                                        int32_t httpCode, void* contextPtr)
+{
+    UplinkBatcher* batcherPtr = (UplinkBatcher*) contextPtr;
+    std::map<uint32_t, Batch>::iterator it =
+                                    batcherPtr->sentBatches.find(requestId);
+
+    if (it == batcherPtr->sentBatches.end())
+    {
+        return;
+    }
+
+    if (result == UPLOAD_RESULT_SUCCESS)
+    {
+        uint32_t latencyMs = getNowMs() - it->second.firstPduMs;
+
+        batcherPtr->deliveredNb++;
+        batcherPtr->totalLatencyMs += latencyMs;
+
+        if (latencyMs > batcherPtr->maxLatencyMs)
+        {
+            batcherPtr->maxLatencyMs = latencyMs;
+        }
+    }
+    else
+    {
+        LE_WARN("Batch of %u PDUs not delivered (result %d, HTTP %d)",
+                                    it->second.pduNb, result, httpCode);
+        batcherPtr->lostNb++;
+    }
+
+    batcherPtr->sentBatches.erase(it);
+}
+
+/*!
+ * @brief Send the current batch if its oldest PDU waited long enough, and
+ * the batches the uploader could not take before. To be called regularly,
+ * ideally after getNextTimeoutMs() elapsed.
+ *
+ * @return None
+ * */
+void UplinkBatcher::process(void)
+{
+    if ((current.pduNb > 0) &&
+        ((getNowMs() - current.firstPduMs) >= getAgeThresholdMs()))
+    {
+        ageTriggerNb++;
+        seal();
+    }
+
+    submitSealed();
+}
+
+/*!
+ * @brief Send the current batch right away, e.g. before stopping
+ *
+ * @return None
+ * */
+void UplinkBatcher::flush(void)
+{
+    seal();
+    submitSealed();
+}
+
+/*!
+ * @brief Get the uncompressed size from which a batch is sent: the amount
+ * uploaded in BATCH_TARGET_UPLOAD_MS at the measured throughput and
+ * compression ratio
+ *
+ * @return Size in bytes
+ * */
+uint32_t UplinkBatcher::getSizeThreshold(void) const
+{
+    uint32_t kbps = uploader.getThroughputKbps();
+
+    if (kbps == 0)
+    {
+        kbps = BATCH_DEFAULT_THROUGHPUT_KBPS;
+    }
+
+    double bytesNb = (double) kbps * BATCH_TARGET_UPLOAD_MS / 8;
+
+    if (compressionRatio > 0)
+    {
+        bytesNb /= compressionRatio;
+    }
+
+    if (bytesNb < BATCH_MIN_BYTES)
+    {
+        return BATCH_MIN_BYTES;
+    }
+
+    return (bytesNb > BATCH_MAX_BYTES) ? BATCH_MAX_BYTES : bytesNb;
+}
+
+/*!
+ * @brief Get the time from which a batch is sent even if it is not full.
+ * The slower the bearer, the longer the PDUs are held.
+ *
+ * @return Time in milliseconds
+ * */
+uint32_t UplinkBatcher::getAgeThresholdMs(void) const
+{
+    uint32_t kbps = uploader.getThroughputKbps();
+
+    if (kbps == 0)
+    {
+        kbps = BATCH_DEFAULT_THROUGHPUT_KBPS;
+    }
+
+    uint64_t ageMs = (uint64_t) BATCH_MIN_AGE_MS * BATCH_REFERENCE_KBPS / kbps;
+
+    if (ageMs < BATCH_MIN_AGE_MS)
+    {
+        return BATCH_MIN_AGE_MS;
+    }
+
+    return (ageMs > BATCH_MAX_AGE_MS) ? BATCH_MAX_AGE_MS : ageMs;
+}
+
+/*!
+ * @brief Get the time until the current batch reaches its age threshold
+ *
+ * @return Delay in milliseconds, -1 if the current batch is empty
+ * */
+int32_t UplinkBatcher::getNextTimeoutMs(void) const
+{
+    if (current.pduNb == 0)
+    {
+        return -1;
+    }
+
+    uint64_t ageMs = getNowMs() - current.firstPduMs;
+    uint32_t thresholdMs = getAgeThresholdMs();
+
+    return (ageMs >= thresholdMs) ? 0 : (thresholdMs - ageMs);
+}
+
+/*!
+ * @brief Log the statistics of the batcher
+ *
+ * @return None
+ * */
+void UplinkBatcher::logStats(void) const
+{
+    LE_INFO("Batcher: %u PDUs in %u batches (size %u, age %u), raw %llu "
+            "bytes, compressed %llu bytes, ratio %u%%", pduNb, batchNb,
+            sizeTriggerNb, ageTriggerNb, (unsigned long long) rawBytesNb,
+            (unsigned long long) compressedBytesNb,
+            (uint32_t) ((rawBytesNb > 0) ?
+                                (100 * compressedBytesNb / rawBytesNb) : 0));
+    LE_INFO("Batcher: %u PDUs sent at once", urgentNb);
+    LE_INFO("Batcher: delivered %u, lost %u, latency average %llu ms max %u "
+            "ms, thresholds %u bytes %u ms", deliveredNb, lostNb,
+            (unsigned long long) ((deliveredNb > 0) ?
+                                            (totalLatencyMs / deliveredNb) : 0),
+            maxLatencyMs, getSizeThreshold(), getAgeThresholdMs());
+
+    uploader.logStats();
+}
+
+/*** end of file ***/
@@ -0,0 +1,82 @@
+/** @file UplinkBatcher.h
+ *
+ * @brief This class groups the PDUs to upload into compressed batches, sized
+ * from the measured throughput of the bearer
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef UPLINK_BATCHER_H
+#define UPLINK_BATCHER_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/HttpUploader.h"
+#include <zlib.h>
+#include <deque>
+#include <map>
+#include <vector>
+
+class UplinkBatcher
+{
+    private:
+        struct Batch
+        {
+            std::vector<uint8_t> data;
+            uint16_t pduNb;
+            uint32_t rawBytesNb;
+            uint64_t firstPduMs;
+        };
+
+        HttpUploader& uploader;
+        z_stream stream;
+        bool isStreamReady;
+        Batch current;
+        std::deque<Batch> sealedBatches;
+        std::map<uint32_t, Batch> sentBatches;
+        double compressionRatio;
+        uint32_t pduNb;
+        uint32_t batchNb;
+        uint32_t sizeTriggerNb;
+        uint32_t ageTriggerNb;
+        uint32_t deliveredNb;
+        uint32_t lostNb;
+        uint64_t rawBytesNb;
+        uint64_t compressedBytesNb;
+        uint32_t urgentNb;
+        uint64_t totalLatencyMs;
+        uint32_t maxLatencyMs;
+
+        static uint64_t getNowMs(void);
+        static void onUploadComplete(uint32_t requestId,
+                                        HttpUploaderTypes::UploadResult result,
+                                        int32_t httpCode, void* contextPtr);
+        static void setPduHeader(uint8_t* pduHeader, uint8_t type,
+                                    const uint8_t* mac, uint32_t len);
+        static void setBatchHeader(Batch& batch, uint8_t flags);
+        bool compress(const uint8_t* data, uint32_t len, int32_t mode);
+        void startBatch(void);
+        bool seal(void);
+        void submitSealed(void);
+
+    public:
+        UplinkBatcher(HttpUploader& batchUploader);
+        ~UplinkBatcher(void);
+        bool init(void);
+        le_result_t add(uint8_t type, const uint8_t* mac, const uint8_t* data,
+                        uint32_t len);
+        le_result_t sendNow(HttpUploaderTypes::TrafficClass trafficClass,
+                            uint8_t type, const uint8_t* mac,
+                            const uint8_t* data, uint32_t len);
+        void process(void);
+        void flush(void);
+        uint32_t getSizeThreshold(void) const;
+        uint32_t getAgeThresholdMs(void) const;
+        int32_t getNextTimeoutMs(void) const;
+        void logStats(void) const;
+};
+
+#endif /* UPLINK_BATCHER_H */
+
+/*** end of file ***/
@@ -0,0 +1,59 @@
+/** @file UplinkBatcherUtils.h
+ *
+ * @brief This file provides the constants of the uplink batcher
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef UPLINK_BATCHER_UTILS_H
+#define UPLINK_BATCHER_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace UplinkBatcherConstants
+{
+    /* Batch layout, little endian:
+     *   version (1) | flags (1) | PDU number (2) | raw size (4) | body
+     * The body is the list of PDUs, deflated when BATCH_FLAG_DEFLATE is set:
+     *   type (1) | MAC address (6) | length (4) | data (length)
+     */
+    const uint8_t BATCH_FORMAT_VERSION = 1;
+    const uint8_t BATCH_FLAG_DEFLATE = 0x01;
+    const uint8_t BATCH_HEADER_SIZE = 8;
+    const uint8_t BATCH_PDU_HEADER_SIZE = 11;
+
+    /* Compression level: 1 is the fastest, 9 the smallest */
+    const int8_t BATCH_COMPRESSION_LEVEL = 6;
+
+    /* A batch is sent once it holds enough data to be uploaded in about
+     * BATCH_TARGET_UPLOAD_MS at the measured throughput, within these
+     * bounds (uncompressed bytes) */
+    const uint32_t BATCH_TARGET_UPLOAD_MS = 2000;
+    const uint32_t BATCH_MIN_BYTES = 4 * 1024;
+    const uint32_t BATCH_MAX_BYTES = 256 * 1024;
+
+    /* A batch is also sent once its oldest PDU waited long enough. The wait
+     * is longer on a slow bearer to save radio wake-ups, and goes down to
+     * BATCH_MIN_AGE_MS at BATCH_REFERENCE_KBPS and above. */
+    const uint32_t BATCH_MIN_AGE_MS = 5000;
+    const uint32_t BATCH_MAX_AGE_MS = 60000;
+    const uint32_t BATCH_REFERENCE_KBPS = 1000;
+
+    /* Throughput assumed until the first upload is measured */
+    const uint32_t BATCH_DEFAULT_THROUGHPUT_KBPS = 64;
+
+    /* Weight of the last batch in the compression ratio estimate */
+    const double BATCH_RATIO_EWMA_WEIGHT = 0.25;
+
+    /* Batches sealed but not accepted by the uploader yet */
+    const uint8_t BATCH_MAX_SEALED = 4;
+
+    /* Size of the chunks the compressor writes to */
+    const uint32_t BATCH_DEFLATE_CHUNK_SIZE = 4096;
+}
+
+#endif /* UPLINK_BATCHER_UTILS_H */
+
+/*** end of file ***/
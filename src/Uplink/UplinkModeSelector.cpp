@@ -0,0 +1,143 @@
+/** @file UplinkModeSelector.cpp
+ *
+ * @brief This class chooses between sending raw data and summaries, from the
+ * throughput of the bearer and the backlog waiting to be uploaded
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/UplinkModeSelector.h"
+#include <time.h>
+
+using namespace UplinkModeSelectorConstants;
+using namespace UplinkModeSelectorTypes;
+
+/*!
+ * @brief Constructor for UplinkModeSelector. Starts in raw mode.
+ * */
+UplinkModeSelector::UplinkModeSelector(void) : mode(UPLINK_MODE_RAW),
+                                                modeStartMs(getNowMs()),
+                                                summaryTotalMs(0), switchNb(0)
+{
+
+}
+
+/*!
+ * @brief Destructor for UplinkModeSelector
+ * */
+UplinkModeSelector::~UplinkModeSelector(void)
+{
+
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t UplinkModeSelector::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Switch to another mode
+ *
+ * @param[in] newMode   Mode to use
+ * @param[in] nowMs     Current time
+ *
+ * @return None
+ * */
+void UplinkModeSelector::setMode(UplinkMode newMode, uint64_t nowMs)
+{
+    if (mode == UPLINK_MODE_SUMMARY)
+    {
+        summaryTotalMs += nowMs - modeStartMs;
+    }
+
+    mode = newMode;
+    modeStartMs = nowMs;
+    switchNb++;
+}
+
+/*!
+ * @brief Update the mode from the last measures
+ *
+ * @param[in] throughputKbps    Throughput of the last uploads, 0 if unknown
+ * @param[in] backlogBytesNb    Bytes waiting to be uploaded
+ *
+ * @return Mode to use
+ * */
+UplinkMode UplinkModeSelector::update(uint32_t throughputKbps,
+                                        uint64_t backlogBytesNb)
+{
+    uint64_t nowMs = getNowMs();
+
+    /* The dwell starts at the first switch: a degraded uplink at startup is
+     * acted on at once */
+    if ((switchNb > 0) && ((nowMs - modeStartMs) < MODE_MIN_DWELL_MS))
+    {
+        return mode;
+    }
+
+    /* No measure yet means nothing was uploaded: the backlog decides */
+    bool isThroughputKnown = (throughputKbps > 0);
+
+    if ((mode == UPLINK_MODE_RAW) &&
+        ((isThroughputKnown && (throughputKbps < MODE_SUMMARY_KBPS)) ||
+         (backlogBytesNb > MODE_SUMMARY_BACKLOG)))
+    {
+        LE_WARN("Uplink degraded (%u kbps, backlog %llu bytes), send "
+                "summaries", throughputKbps,
+                (unsigned long long) backlogBytesNb);
+        setMode(UPLINK_MODE_SUMMARY, nowMs);
+    }
+    else if ((mode == UPLINK_MODE_SUMMARY) &&
+             (!isThroughputKnown || (throughputKbps > MODE_RAW_KBPS)) &&
+             (backlogBytesNb < MODE_RAW_BACKLOG))
+    {
+        LE_INFO("Uplink recovered (%u kbps, backlog %llu bytes), send raw "
+                "data", throughputKbps, (unsigned long long) backlogBytesNb);
+        setMode(UPLINK_MODE_RAW, nowMs);
+    }
+
+    return mode;
+}
+
+/*!
+ * @brief Get the mode in use
+ *
+ * @return Mode in use
+ * */
+UplinkMode UplinkModeSelector::getMode(void) const
+{
+    return mode;
+}
+
+/*!
+ * @brief Log the statistics of the mode selection
+ *
+ * @return None
+ * */
+void UplinkModeSelector::logStats(void) const
+{
+    uint64_t summaryMs = summaryTotalMs;
+
+    if (mode == UPLINK_MODE_SUMMARY)
+    {
+        summaryMs += getNowMs() - modeStartMs;
+    }
+
+    LE_INFO("Uplink mode %s, %u switches, %llu s in summary mode",
+            (mode == UPLINK_MODE_RAW) ? "raw" : "summary", switchNb,
+            (unsigned long long) (summaryMs / 1000));
+}
+
+/*** end of file ***/
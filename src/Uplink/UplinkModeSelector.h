@@ -0,0 +1,40 @@
+/** @file UplinkModeSelector.h
+ *
+ * @brief This class chooses between sending raw data and summaries, from the
+ * throughput of the bearer and the backlog waiting to be uploaded
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef UPLINK_MODE_SELECTOR_H
+#define UPLINK_MODE_SELECTOR_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/UplinkModeSelectorUtils.h"
+
+class UplinkModeSelector
+{
+    private:
+        UplinkModeSelectorTypes::UplinkMode mode;
+        uint64_t modeStartMs;
+        uint64_t summaryTotalMs;
+        uint32_t switchNb;
+
+        static uint64_t getNowMs(void);
+        void setMode(UplinkModeSelectorTypes::UplinkMode newMode,
+                        uint64_t nowMs);
+
+    public:
+        UplinkModeSelector(void);
+        ~UplinkModeSelector(void);
+        UplinkModeSelectorTypes::UplinkMode update(uint32_t throughputKbps,
+                                                    uint64_t backlogBytesNb);
+        UplinkModeSelectorTypes::UplinkMode getMode(void) const;
+        void logStats(void) const;
+};
+
+#endif /* UPLINK_MODE_SELECTOR_H */
+
+/*** end of file ***/
@@ -0,0 +1,48 @@
+/** @file UplinkModeSelectorUtils.h
+ *
+ * @brief This file provides the types and constants of the uplink mode
+ * selection
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef UPLINK_MODE_SELECTOR_UTILS_H
+#define UPLINK_MODE_SELECTOR_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace UplinkModeSelectorTypes
+{
+    /* What the uplink sends */
+    enum UplinkMode
+    {
+        /* All the PDUs as received */
+        UPLINK_MODE_RAW,
+        /* Per window summaries of the samples, the raw PDUs stay in the
+         * backlog until the bearer recovers */
+        UPLINK_MODE_SUMMARY
+    };
+}
+
+namespace UplinkModeSelectorConstants
+{
+    /* The uplink falls back to summaries when the throughput drops under
+     * MODE_SUMMARY_KBPS or the backlog grows over MODE_SUMMARY_BACKLOG */
+    const uint32_t MODE_SUMMARY_KBPS = 32;
+    const uint64_t MODE_SUMMARY_BACKLOG = 4 * 1024 * 1024;
+
+    /* It goes back to raw data once the throughput is over MODE_RAW_KBPS and
+     * the backlog under MODE_RAW_BACKLOG. The gap between the two sets of
+     * thresholds avoids flapping around a single value. */
+    const uint32_t MODE_RAW_KBPS = 128;
+    const uint64_t MODE_RAW_BACKLOG = 1024 * 1024;
+
+    /* Minimum time spent in a mode after a switch before switching again */
+    const uint32_t MODE_MIN_DWELL_MS = 60000;
+}
+
+#endif /* UPLINK_MODE_SELECTOR_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,814 @@
+/** @file CommandExecutor.cpp
+ *
+ * @brief This class runs system commands with posix_spawn, without a shell,
+ * either blocking or completing on the event loop
+ *
+ * The commands are given as a vector of arguments and spawned directly, so
+ * neither the process image is copied nor a shell started. Their standard
+ * output and error are captured through pipes. A command still running at
+ * its timeout gets SIGTERM, then SIGKILL if it doesn't exit, along with the
+ * processes it started. The latency of each command is kept in a histogram.
+ *
+ * run() blocks until the command is over. start() returns at once and calls
+ * a handler from the Legato event loop when the command is over.
+ *
+ * A command is over once it exited, even if the processes it left in the
+ * background still hold its outputs open: what it wrote before exiting is
+ * kept, the rest is not waited for.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/CommandExecutor.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <time.h>
+
+using namespace CommandExecutorConstants;
+using namespace CommandExecutorTypes;
+
+extern char** environ;
+
+/*!
+ * @brief Constructor for CommandExecutor
+ * */
+CommandExecutor::CommandExecutor(void) : statsNb(0), nextId(0),
+                                            spawnFailureNb(0)
+{
+    for (uint8_t i = 0; i < COMMAND_MAX_RUNNING; i++)
+    {
+        commands[i].isUsed = false;
+        commands[i].pid = -1;
+        commands[i].outFd = -1;
+        commands[i].errFd = -1;
+        commands[i].outMonitorRef = NULL;
+        commands[i].errMonitorRef = NULL;
+        commands[i].timer = NULL;
+    }
+
+    memset(stats, 0, sizeof(stats));
+}
+
+/*!
+ * @brief Destructor for CommandExecutor. The commands running are killed.
+ * */
+CommandExecutor::~CommandExecutor(void)
+{
+    for (uint8_t i = 0; i < COMMAND_MAX_RUNNING; i++)
+    {
+        Command& command = commands[i];
+
+        if (command.isUsed)
+        {
+            kill(-command.pid, SIGKILL);
+            waitpid(command.pid, NULL, 0);
+            closeOutput(command.outFd, command.outMonitorRef);
+            closeOutput(command.errFd, command.errMonitorRef);
+        }
+
+        if (command.timer != NULL)
+        {
+            le_timer_Delete(command.timer);
+        }
+    }
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+uint64_t CommandExecutor::getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Get the statistics entry of a command, named after its program
+ *
+ * @param[in] args  Arguments of the command
+ *
+ * @return Index of the entry
+ * */
+uint8_t CommandExecutor::getStatsIndex(const std::vector<std::string>& args)
+{
+    std::string name = args[0];
+
+    /* A shell command is named after the program it runs */
+    if ((args.size() > 2) && (args[1] == "-c") && (name.size() >= 2) &&
+        (name.compare(name.size() - 2, 2, "sh") == 0))
+    {
+        name = args[2].substr(0, args[2].find(' '));
+    }
+
+    name = name.substr(name.rfind('/') + 1);
+
+    for (uint8_t i = 0; i < statsNb; i++)
+    {
+        if (name.compare(0, COMMAND_NAME_SIZE - 1, stats[i].name) == 0)
+        {
+            return i;
+        }
+    }
+
+    /* The last entry holds all the commands without an entry */
+    if (statsNb == COMMAND_MAX_STATS)
+    {
+        return COMMAND_MAX_STATS - 1;
+    }
+
+    snprintf(stats[statsNb].name, sizeof(stats[statsNb].name), "%s",
+                (statsNb == COMMAND_MAX_STATS - 1) ? "other" : name.c_str());
+
+    return statsNb++;
+}
+
+/*!
+ * @brief Spawn a command with its output captured
+ *
+ * @param[in] args          Program and its arguments, the program is looked
+ *                          up in the PATH if it has no '/'
+ * @param[in] timeoutMs     Time before the command is killed, 0 for no limit
+ * @param[out] command      Command spawned
+ *
+ * @return Status of the operation
+ * */
+bool CommandExecutor::spawn(const std::vector<std::string>& args,
+                            uint32_t timeoutMs, Command& command)
+{
+    int outPipe[2] = {-1, -1};
+    int errPipe[2] = {-1, -1};
+    std::vector<char*> argv;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+    int error;
+
+    command.pid = -1;
+    command.outFd = -1;
+    command.errFd = -1;
+    command.startMs = getNowMs();
+    command.deadlineMs = (timeoutMs > 0) ? (command.startMs + timeoutMs) : 0;
+    command.isTerminating = false;
+    command.reapDelayMs = COMMAND_REAP_MIN_MS;
+    command.result = CommandResult();
+
+    if (args.empty())
+    {
+        LE_ERROR("Empty command");
+        return false;
+    }
+
+    command.statsIndex = getStatsIndex(args);
+
+    for (uint32_t i = 0; i < args.size(); i++)
+    {
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    }
+
+    argv.push_back(NULL);
+
+    if ((pipe2(outPipe, O_CLOEXEC | O_NONBLOCK) < 0) ||
+        (pipe2(errPipe, O_CLOEXEC | O_NONBLOCK) < 0))
+    {
+        LE_ERROR("Couldn't create the pipes: %m");
+        ::close(outPipe[0]);
+        ::close(outPipe[1]);
+        spawnFailureNb++;
+        stats[command.statsIndex].runNb++;
+        stats[command.statsIndex].failureNb++;
+        return false;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                        O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    /* The command starts with the default signal handling and its own
+     * process group, so that its children are killed with it */
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+                                    POSIX_SPAWN_SETSIGDEF |
+                                    POSIX_SPAWN_SETPGROUP);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigfillset(&signals);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setpgroup(&attr, 0);
+
+    error = posix_spawnp(&command.pid, argv[0], &actions, &attr, &argv[0],
+                            environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    ::close(outPipe[1]);
+    ::close(errPipe[1]);
+
+    if (error != 0)
+    {
+        LE_ERROR("Couldn't run %s: %s", argv[0], strerror(error));
+        ::close(outPipe[0]);
+        ::close(errPipe[0]);
+        command.pid = -1;
+        spawnFailureNb++;
+        stats[command.statsIndex].runNb++;
+        stats[command.statsIndex].failureNb++;
+        return false;
+    }
+
+    command.outFd = outPipe[0];
+    command.errFd = errPipe[0];
+
+    return true;
+}
+
+/*!
+ * @brief Read what a command wrote on one of its outputs
+ *
+ * @param[in] fd        Pipe of the output
+ * @param[in,out] output Output kept, up to COMMAND_MAX_OUTPUT_SIZE bytes
+ *
+ * @return False once the command closed the output
+ * */
+bool CommandExecutor::readOutput(int fd, std::string& output)
+{
+    char buffer[512];
+
+    while (1)
+    {
+        ssize_t len = read(fd, buffer, sizeof(buffer));
+
+        if (len > 0)
+        {
+            if (output.size() < COMMAND_MAX_OUTPUT_SIZE)
+            {
+                output.append(buffer, std::min((size_t) len,
+                                    COMMAND_MAX_OUTPUT_SIZE - output.size()));
+            }
+        }
+        else if (len == 0)
+        {
+            return false;
+        }
+        else if (errno == EAGAIN)
+        {
+            return true;
+        }
+        else if (errno != EINTR)
+        {
+            return false;
+        }
+    }
+}
+
+/*!
+ * @brief Close one of the outputs of a command
+ *
+ * @param[in,out] fd            Pipe of the output, set to -1
+ * @param[in,out] fdMonitorRef  Monitor of the pipe, set to NULL
+ *
+ * @return None
+ * */
+void CommandExecutor::closeOutput(int& fd, le_fdMonitor_Ref_t& fdMonitorRef)
+{
+    if (fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(fdMonitorRef);
+        fdMonitorRef = NULL;
+    }
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+/*!
+ * @brief Signal a command which reached its deadline: SIGTERM first, then
+ * SIGKILL if it is still running after COMMAND_KILL_GRACE_MS
+ *
+ * @param[in,out] command   Command
+ * @param[in] nowMs         Current time
+ *
+ * @return None
+ * */
+void CommandExecutor::checkDeadline(Command& command, uint64_t nowMs)
+{
+    if ((command.deadlineMs == 0) || (nowMs < command.deadlineMs))
+    {
+        return;
+    }
+
+    if (!command.isTerminating)
+    {
+        LE_WARN("%s timed out", stats[command.statsIndex].name);
+
+        command.isTerminating = true;
+        command.result.isTimedOut = true;
+        command.deadlineMs = nowMs + COMMAND_KILL_GRACE_MS;
+        kill(-command.pid, SIGTERM);
+    }
+    else
+    {
+        command.deadlineMs = 0;
+        kill(-command.pid, SIGKILL);
+    }
+}
+
+/*!
+ * @brief Collect the exit status of a command, if it exited
+ *
+ * @param[in,out] command   Command, its result is completed
+ *
+ * @return True if the command exited
+ * */
+bool CommandExecutor::reap(Command& command)
+{
+    int status = 0;
+    pid_t pid = waitpid(command.pid, &status, WNOHANG);
+
+    if (pid == 0)
+    {
+        return false;
+    }
+
+    if (pid < 0)
+    {
+        /* Reaped by someone else, the status is lost */
+        LE_WARN("Couldn't get the status of %d: %m", command.pid);
+        command.result.exitCode = -1;
+    }
+    else if (WIFEXITED(status))
+    {
+        command.result.exitCode = WEXITSTATUS(status);
+    }
+    else
+    {
+        command.result.exitCode = -1;
+        command.result.signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+    }
+
+    command.result.isSuccess = (command.result.exitCode == 0) &&
+                                !command.result.isTimedOut;
+    command.pid = -1;
+
+    return true;
+}
+
+/*!
+ * @brief Arm the timer of a command for its next deadline, or for the next
+ * check of its exit if it comes first
+ *
+ * @param[in,out] command   Command
+ * @param[in] nowMs         Current time
+ *
+ * @return None
+ * */
+void CommandExecutor::armTimer(Command& command, uint64_t nowMs)
+{
+    uint64_t nextMs = nowMs + command.reapDelayMs;
+
+    le_timer_Stop(command.timer);
+
+    if ((command.deadlineMs != 0) && (command.deadlineMs < nextMs))
+    {
+        nextMs = command.deadlineMs;
+    }
+
+    le_timer_SetMsInterval(command.timer,
+                            (nextMs > nowMs) ? (nextMs - nowMs) : 1);
+    le_timer_Start(command.timer);
+}
+
+/*!
+ * @brief Account for a command over, and call its handler if it was started
+ * on the event loop
+ *
+ * @param[in,out] command   Command
+ *
+ * @return None
+ * */
+void CommandExecutor::complete(Command& command)
+{
+    CommandStats& commandStats = stats[command.statsIndex];
+    uint8_t bucket = 0;
+
+    command.result.durationMs = getNowMs() - command.startMs;
+
+    /* Keep what the command wrote before exiting */
+    if (command.outFd >= 0)
+    {
+        readOutput(command.outFd, command.result.output);
+    }
+
+    if (command.errFd >= 0)
+    {
+        readOutput(command.errFd, command.result.errors);
+    }
+
+    closeOutput(command.outFd, command.outMonitorRef);
+    closeOutput(command.errFd, command.errMonitorRef);
+
+    if (command.timer != NULL)
+    {
+        le_timer_Stop(command.timer);
+    }
+
+    while ((bucket < COMMAND_LATENCY_BUCKET_NB - 1) &&
+            (command.result.durationMs >= COMMAND_LATENCY_BOUNDS_MS[bucket]))
+    {
+        bucket++;
+    }
+
+    commandStats.runNb++;
+    commandStats.latencyNb[bucket]++;
+    commandStats.failureNb += command.result.isSuccess ? 0 : 1;
+    commandStats.timeoutNb += command.result.isTimedOut ? 1 : 0;
+
+    if (command.result.durationMs > commandStats.maxMs)
+    {
+        commandStats.maxMs = command.result.durationMs;
+    }
+
+    if (command.result.isSuccess)
+    {
+        LE_DEBUG("%s done in %u ms", commandStats.name,
+                    command.result.durationMs);
+    }
+    else
+    {
+        LE_ERROR("%s failed in %u ms: (%d, signal %d) %s", commandStats.name,
+                    command.result.durationMs, command.result.exitCode,
+                    command.result.signal, command.result.errors.c_str());
+    }
+
+    if (command.isUsed)
+    {
+        /* The handler may start another command in the same slot */
+        CommandResult result = command.result;
+        CommandHandler handler = command.handler;
+
+        command.isUsed = false;
+
+        if (handler != NULL)
+        {
+            handler(&result, command.contextPtr);
+        }
+    }
+}
+
+/*!
+ * @brief Find the command started on the event loop using a pipe or a timer
+ *
+ * @param[in] fd        Pipe, -1 to look for the timer
+ * @param[in] timerRef  Timer
+ *
+ * @return The command, NULL if not found
+ * */
+CommandExecutor::Command* CommandExecutor::findCommand(int fd,
+                                                    le_timer_Ref_t timerRef)
+{
+    for (uint8_t i = 0; i < COMMAND_MAX_RUNNING; i++)
+    {
+        Command& command = commands[i];
+
+        if (command.isUsed &&
+            (((fd >= 0) && ((command.outFd == fd) || (command.errFd == fd))) ||
+                ((fd < 0) && (command.timer == timerRef))))
+        {
+            return &command;
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Handler of the output pipes of the commands started on the event
+ * loop
+ *
+ * @param[in] fd        Pipe
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void CommandExecutor::fdHandler(int fd, short events)
+{
+    CommandExecutor* executorPtr =
+                            (CommandExecutor*) le_fdMonitor_GetContextPtr();
+    Command* commandPtr = executorPtr->findCommand(fd, NULL);
+
+    if (commandPtr == NULL)
+    {
+        return;
+    }
+
+    if ((fd == commandPtr->outFd) &&
+        !readOutput(fd, commandPtr->result.output))
+    {
+        closeOutput(commandPtr->outFd, commandPtr->outMonitorRef);
+    }
+    else if ((fd == commandPtr->errFd) &&
+                !readOutput(fd, commandPtr->result.errors))
+    {
+        closeOutput(commandPtr->errFd, commandPtr->errMonitorRef);
+    }
+
+    if ((commandPtr->outFd >= 0) || (commandPtr->errFd >= 0))
+    {
+        return;
+    }
+
+    if (reap(*commandPtr))
+    {
+        executorPtr->complete(*commandPtr);
+    }
+    else
+    {
+        /* Most commands exit right after closing their outputs */
+        commandPtr->reapDelayMs = COMMAND_REAP_MIN_MS;
+        executorPtr->armTimer(*commandPtr, getNowMs());
+    }
+}
+
+/*!
+ * @brief Handler of the timers of the commands started on the event loop
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+void CommandExecutor::timerHandler(le_timer_Ref_t timerRef)
+{
+    CommandExecutor* executorPtr =
+                        (CommandExecutor*) le_timer_GetContextPtr(timerRef);
+    Command* commandPtr = executorPtr->findCommand(-1, timerRef);
+    uint64_t nowMs = getNowMs();
+
+    if (commandPtr == NULL)
+    {
+        return;
+    }
+
+    executorPtr->checkDeadline(*commandPtr, nowMs);
+
+    /* The outputs may be held open by the processes the command left in
+     * the background, its exit is what ends it */
+    if (reap(*commandPtr))
+    {
+        executorPtr->complete(*commandPtr);
+        return;
+    }
+
+    commandPtr->reapDelayMs = std::min(commandPtr->reapDelayMs * 2,
+                                        COMMAND_REAP_MAX_MS);
+
+    executorPtr->armTimer(*commandPtr, nowMs);
+}
+
+/*!
+ * @brief Run a command and wait for its end
+ *
+ * @param[in] args          Program and its arguments, the program is looked
+ *                          up in the PATH if it has no '/'
+ * @param[in] timeoutMs     Time before the command is killed, 0 for no limit
+ * @param[out] resultPtr    Outcome of the command, may be NULL
+ *
+ * @return True if the command succeeded
+ * */
+bool CommandExecutor::run(const std::vector<std::string>& args,
+                            uint32_t timeoutMs, CommandResult* resultPtr)
+{
+    Command command;
+
+    command.isUsed = false;
+    command.handler = NULL;
+    command.outMonitorRef = NULL;
+    command.errMonitorRef = NULL;
+    command.timer = NULL;
+
+    if (!spawn(args, timeoutMs, command))
+    {
+        return false;
+    }
+
+    uint32_t delayUs = COMMAND_REAP_MIN_US;
+
+    /* The outputs may be held open by the processes the command left in
+     * the background, its exit is what ends it */
+    while (!reap(command))
+    {
+        uint64_t nowMs = getNowMs();
+
+        checkDeadline(command, nowMs);
+
+        if ((command.outFd < 0) && (command.errFd < 0))
+        {
+            usleep(delayUs);
+            delayUs = std::min(delayUs * 2, COMMAND_REAP_MAX_MS * 1000);
+            continue;
+        }
+
+        struct pollfd pfds[2] = {{command.outFd, POLLIN, 0},
+                                    {command.errFd, POLLIN, 0}};
+        uint64_t waitMs = command.reapDelayMs;
+
+        if ((command.deadlineMs != 0) &&
+            ((command.deadlineMs - nowMs) < waitMs))
+        {
+            waitMs = command.deadlineMs - nowMs;
+        }
+
+        /* A negative fd is ignored by poll */
+        if ((poll(pfds, 2, (int) waitMs) < 0) && (errno != EINTR))
+        {
+            LE_ERROR("Couldn't wait for the command: %m");
+            command.deadlineMs = nowMs;
+            continue;
+        }
+
+        command.reapDelayMs = std::min(command.reapDelayMs * 2,
+                                        COMMAND_REAP_MAX_MS);
+
+        if ((pfds[0].revents != 0) &&
+            !readOutput(command.outFd, command.result.output))
+        {
+            closeOutput(command.outFd, command.outMonitorRef);
+        }
+
+        if ((pfds[1].revents != 0) &&
+            !readOutput(command.errFd, command.result.errors))
+        {
+            closeOutput(command.errFd, command.errMonitorRef);
+        }
+    }
+
+    complete(command);
+
+    if (resultPtr != NULL)
+    {
+        *resultPtr = command.result;
+    }
+
+    return command.result.isSuccess;
+}
+
+/*!
+ * @brief Start a command, its handler is called from the event loop when it
+ * is over
+ *
+ * @param[in] args          Program and its arguments, the program is looked
+ *                          up in the PATH if it has no '/'
+ * @param[in] timeoutMs     Time before the command is killed, 0 for no limit
+ * @param[in] handler       Function called when the command is over, may be
+ *                          NULL
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return Identifier of the command, -1 if it couldn't be started
+ * */
+int32_t CommandExecutor::start(const std::vector<std::string>& args,
+                                uint32_t timeoutMs, CommandHandler handler,
+                                void* contextPtr)
+{
+    Command* commandPtr = NULL;
+
+    for (uint8_t i = 0; (i < COMMAND_MAX_RUNNING) && (commandPtr == NULL); i++)
+    {
+        if (!commands[i].isUsed)
+        {
+            commandPtr = &commands[i];
+        }
+    }
+
+    if (commandPtr == NULL)
+    {
+        LE_ERROR("Too many commands running");
+        return -1;
+    }
+
+    if (!spawn(args, timeoutMs, *commandPtr))
+    {
+        return -1;
+    }
+
+    if (commandPtr->timer == NULL)
+    {
+        commandPtr->timer = le_timer_Create("CommandTimer");
+        le_timer_SetRepeat(commandPtr->timer, 1);
+        le_timer_SetHandler(commandPtr->timer, timerHandler);
+        le_timer_SetContextPtr(commandPtr->timer, this);
+    }
+
+    commandPtr->isUsed = true;
+    commandPtr->id = nextId;
+    commandPtr->handler = handler;
+    commandPtr->contextPtr = contextPtr;
+    nextId = (nextId == INT32_MAX) ? 0 : (nextId + 1);
+
+    commandPtr->outMonitorRef = le_fdMonitor_Create("CommandOutput",
+                                                    commandPtr->outFd,
+                                                    fdHandler, POLLIN);
+    le_fdMonitor_SetContextPtr(commandPtr->outMonitorRef, this);
+    commandPtr->errMonitorRef = le_fdMonitor_Create("CommandErrors",
+                                                    commandPtr->errFd,
+                                                    fdHandler, POLLIN);
+    le_fdMonitor_SetContextPtr(commandPtr->errMonitorRef, this);
+
+    armTimer(*commandPtr, commandPtr->startMs);
+
+    return commandPtr->id;
+}
+
+/*!
+ * @brief Stop a command started on the event loop. Its handler is called
+ * once it exited.
+ *
+ * @param[in] commandId     Identifier returned by start()
+ *
+ * @return None
+ * */
+void CommandExecutor::cancel(int32_t commandId)
+{
+    for (uint8_t i = 0; i < COMMAND_MAX_RUNNING; i++)
+    {
+        Command& command = commands[i];
+
+        if (command.isUsed && (command.id == commandId) &&
+            !command.isTerminating)
+        {
+            uint64_t nowMs = getNowMs();
+
+            command.isTerminating = true;
+            command.deadlineMs = nowMs + COMMAND_KILL_GRACE_MS;
+            kill(-command.pid, SIGTERM);
+            armTimer(command, nowMs);
+        }
+    }
+}
+
+/*!
+ * @brief Check if a command started on the event loop is still running
+ *
+ * @param[in] commandId     Identifier returned by start()
+ *
+ * @return True if running
+ * */
+bool CommandExecutor::isRunning(int32_t commandId) const
+{
+    for (uint8_t i = 0; i < COMMAND_MAX_RUNNING; i++)
+    {
+        if (commands[i].isUsed && (commands[i].id == commandId))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Log the latency histogram of each command
+ *
+ * @return None
+ * */
+void CommandExecutor::logStats(void) const
+{
+    LE_INFO("Commands: %u spawn failures", spawnFailureNb);
+
+    for (uint8_t i = 0; i < statsNb; i++)
+    {
+        const CommandStats& commandStats = stats[i];
+        char histogram[128] = {0};
+        uint32_t len = 0;
+
+        for (uint8_t j = 0; (j < COMMAND_LATENCY_BUCKET_NB) &&
+                                (len < sizeof(histogram)); j++)
+        {
+            len += snprintf(histogram + len, sizeof(histogram) - len,
+                            (j < COMMAND_LATENCY_BUCKET_NB - 1) ?
+                                                " <%u:%u" : " >=%u:%u",
+                            COMMAND_LATENCY_BOUNDS_MS[std::min(j,
+                                (uint8_t) (COMMAND_LATENCY_BUCKET_NB - 2))],
+                            commandStats.latencyNb[j]);
+        }
+
+        LE_INFO("%s: %u runs, %u failed, %u timed out, max %u ms, ms%s",
+                commandStats.name, commandStats.runNb, commandStats.failureNb,
+                commandStats.timeoutNb, commandStats.maxMs, histogram);
+    }
+}
+
+/*** end of file ***/
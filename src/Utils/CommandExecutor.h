@@ -0,0 +1,92 @@
+/** @file CommandExecutor.h
+ *
+ * @brief This class runs system commands with posix_spawn, without a shell,
+ * either blocking or completing on the event loop
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef COMMAND_EXECUTOR_H
+#define COMMAND_EXECUTOR_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/CommandExecutorUtils.h"
+#include <sys/types.h>
+#include <vector>
+
+class CommandExecutor
+{
+    private:
+        /* Command running */
+        struct Command
+        {
+            bool isUsed;
+            int32_t id;
+            pid_t pid;
+            int outFd;
+            int errFd;
+            le_fdMonitor_Ref_t outMonitorRef;
+            le_fdMonitor_Ref_t errMonitorRef;
+            le_timer_Ref_t timer;
+            uint64_t startMs;
+            /* Time of the next signal, 0 if none */
+            uint64_t deadlineMs;
+            bool isTerminating;
+            uint32_t reapDelayMs;
+            uint8_t statsIndex;
+            CommandExecutorTypes::CommandHandler handler;
+            void* contextPtr;
+            CommandExecutorTypes::CommandResult result;
+        };
+
+        /* Statistics of a command */
+        struct CommandStats
+        {
+            char name[CommandExecutorConstants::COMMAND_NAME_SIZE];
+            uint32_t runNb;
+            uint32_t failureNb;
+            uint32_t timeoutNb;
+            uint32_t maxMs;
+            uint32_t latencyNb
+                [CommandExecutorConstants::COMMAND_LATENCY_BUCKET_NB];
+        };
+
+        Command commands[CommandExecutorConstants::COMMAND_MAX_RUNNING];
+        CommandStats stats[CommandExecutorConstants::COMMAND_MAX_STATS];
+        uint8_t statsNb;
+        int32_t nextId;
+        uint32_t spawnFailureNb;
+
+        static uint64_t getNowMs(void);
+        static void fdHandler(int fd, short events);
+        static void timerHandler(le_timer_Ref_t timerRef);
+        uint8_t getStatsIndex(const std::vector<std::string>& args);
+        bool spawn(const std::vector<std::string>& args, uint32_t timeoutMs,
+                    Command& command);
+        static bool readOutput(int fd, std::string& output);
+        void checkDeadline(Command& command, uint64_t nowMs);
+        static void closeOutput(int& fd, le_fdMonitor_Ref_t& fdMonitorRef);
+        static bool reap(Command& command);
+        void armTimer(Command& command, uint64_t nowMs);
+        void complete(Command& command);
+        Command* findCommand(int fd, le_timer_Ref_t timerRef);
+
+    public:
+        CommandExecutor(void);
+        ~CommandExecutor(void);
+        bool run(const std::vector<std::string>& args, uint32_t timeoutMs,
+                    CommandExecutorTypes::CommandResult* resultPtr);
+        int32_t start(const std::vector<std::string>& args,
+                        uint32_t timeoutMs,
+                        CommandExecutorTypes::CommandHandler handler,
+                        void* contextPtr);
+        void cancel(int32_t commandId);
+        bool isRunning(int32_t commandId) const;
+        void logStats(void) const;
+};
+
+#endif /* COMMAND_EXECUTOR_H */
+
+/*** end of file ***/
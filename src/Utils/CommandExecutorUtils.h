@@ -0,0 +1,78 @@
+/** @file CommandExecutorUtils.h
+ *
+ * @brief This file provides the types and constants of the execution of the
+ * system commands
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef COMMAND_EXECUTOR_UTILS_H
+#define COMMAND_EXECUTOR_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <iostream>
+
+namespace CommandExecutorTypes
+{
+    /* Outcome of a command */
+    struct CommandResult
+    {
+        /* Exited with status 0 */
+        bool isSuccess;
+        /* Exit status, -1 if killed by a signal */
+        int32_t exitCode;
+        /* Signal that killed the command, 0 if none */
+        int32_t signal;
+        bool isTimedOut;
+        uint32_t durationMs;
+        /* Beginning of the standard output and error */
+        std::string output;
+        std::string errors;
+    };
+
+    /* Function called on the event loop when a command is over */
+    typedef void (*CommandHandler)(const CommandResult* resultPtr,
+                                    void* contextPtr);
+}
+
+namespace CommandExecutorConstants
+{
+    /* Time given to a command before it is killed, 0 for no limit */
+    const uint32_t COMMAND_DEFAULT_TIMEOUT_MS = 30000;
+
+    /* Timeout of the commands which must never be killed midway */
+    const uint32_t COMMAND_NO_TIMEOUT = 0;
+
+    /* Time given to a command to exit on SIGTERM before SIGKILL */
+    const uint32_t COMMAND_KILL_GRACE_MS = 1000;
+
+    /* Wait between two checks of the exit of a command, doubled up to the
+     * maximum, and started again once it closed its outputs: most commands
+     * exit right after. The blocking runs then start with a shorter wait. */
+    const uint32_t COMMAND_REAP_MIN_MS = 1;
+    const uint32_t COMMAND_REAP_MIN_US = 50;
+    const uint32_t COMMAND_REAP_MAX_MS = 1000;
+
+    /* Commands running at once on the event loop */
+    const uint8_t COMMAND_MAX_RUNNING = 8;
+
+    /* Part of the standard output and error kept, the rest is dropped */
+    const uint32_t COMMAND_MAX_OUTPUT_SIZE = 4096;
+
+    /* Commands with their own statistics, the others share the last ones */
+    const uint8_t COMMAND_MAX_STATS = 16;
+    const uint8_t COMMAND_NAME_SIZE = 24;
+
+    /* Upper bounds of the latency histogram buckets, the last bucket holds
+     * the longer ones */
+    const uint32_t COMMAND_LATENCY_BOUNDS_MS[] =
+                                    {10, 30, 100, 300, 1000, 3000, 10000};
+    const uint8_t COMMAND_LATENCY_BUCKET_NB =
+            sizeof(COMMAND_LATENCY_BOUNDS_MS) / sizeof(uint32_t) + 1;
+}
+
+#endif /* COMMAND_EXECUTOR_UTILS_H */
+
+/*** end of file ***/
@@ -0,0 +1,67 @@
+/** @file Crc32.cpp
+ *
+ * @brief This class computes CRC-32 checksums (IEEE 802.3 polynomial)
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "Utils/Crc32.h"
+
+/* Reflected polynomial of the IEEE 802.3 CRC-32 */
+static const uint32_t CRC32_POLYNOMIAL = 0xEDB88320;
+
+/* Initialize the static members of Crc32. The table is built on first use. */
+uint32_t Crc32::table[256];
+bool Crc32::isTableReady = false;
+
+/*!
+ * @brief Build the table giving the CRC of each byte value
+ *
+ * @return None
+ */
+void Crc32::buildTable(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC32_POLYNOMIAL) : (crc >> 1);
+        }
+
+        table[i] = crc;
+    }
+
+    isTableReady = true;
+}
+
+/*!
+ * @brief Compute the CRC-32 of a buffer
+ *
+ * @param[in] buf   Data
+ * @param[in] len   Number of bytes
+ * @param[in] crc   CRC of the previous data, to compute the CRC of data
+ *                  split into several buffers. 0 for the first buffer.
+ *
+ * @return The CRC-32 of the data
+ */
+uint32_t Crc32::compute(const uint8_t* buf, size_t len, uint32_t crc)
+{
+    if (!isTableReady)
+    {
+        buildTable();
+    }
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+/*** end of file ***/
@@ -0,0 +1,29 @@
+/** @file Crc32.h
+ *
+ * @brief This class computes CRC-32 checksums (IEEE 802.3 polynomial)
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+class Crc32
+{
+    private:
+        static uint32_t table[256];
+        static bool isTableReady;
+        static void buildTable(void);
+
+    public:
+        static uint32_t compute(const uint8_t* buf, size_t len,
+                                uint32_t crc = 0);
+};
+
+#endif /* CRC32_H */
+
+/*** end of file ***/
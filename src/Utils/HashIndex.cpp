@@ -0,0 +1,294 @@
+/** @file HashIndex.cpp
+ *
+ * @brief This class finds the entry of a fixed size key (e.g. a MAC address)
+ * among a fixed number of entries, with an open addressing hash table
+ *
+ * The table uses linear probing on a FNV-1a hash of the key, and has at
+ * least twice as many slots as entries so that the probe sequences stay
+ * short. The slots only hold the number of the entry: the owner keeps the
+ * data of entry N at index N of its own array, which does not move when the
+ * table is rebuilt.
+ *
+ * Removing an entry leaves a tombstone in its slot so that the probe
+ * sequences going through it are not broken. Inserting reuses the
+ * tombstones, and the table is rebuilt without them once they fill a
+ * quarter of the slots: the lookups of unknown keys, which probe until a
+ * free slot, stay short however many keys came and went.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/HashIndex.h"
+
+/*!
+ * @brief Constructor for HashIndex. All the memory is allocated here.
+ *
+ * @param[in] maxEntryNb    Number of entries
+ * @param[in] keyLen        Size of a key in bytes
+ * */
+HashIndex::HashIndex(uint16_t maxEntryNb, uint8_t keyLen) :
+                                                    entryNb(maxEntryNb),
+                                                    keySize(keyLen),
+                                                    usedNb(0), deletedNb(0),
+                                                    rebuildNb(0)
+{
+    LE_ASSERT((entryNb > 0) && (entryNb <= INT16_MAX) && (keySize > 0));
+
+    uint32_t slotNb = 1;
+
+    while (slotNb < (2 * (uint32_t) entryNb))
+    {
+        slotNb *= 2;
+    }
+
+    slotIndexMask = slotNb - 1;
+    slots.assign(slotNb, SLOT_FREE);
+    keys.assign((size_t) entryNb * keySize, 0);
+    entrySlots.assign(entryNb, 0);
+    isEntryUsed.assign(entryNb, false);
+    freeEntries.reserve(entryNb);
+
+    /* Entry 0 is given first */
+    for (uint16_t i = entryNb; i > 0; i--)
+    {
+        freeEntries.push_back(i - 1);
+    }
+}
+
+/*!
+ * @brief Destructor for HashIndex
+ * */
+HashIndex::~HashIndex(void)
+{
+
+}
+
+/*!
+ * @brief Hash a key (FNV-1a)
+ *
+ * @param[in] key   Key (keySize bytes)
+ *
+ * @return Hash of the key
+ * */
+uint32_t HashIndex::hash(const uint8_t* key) const
+{
+    uint32_t value = 2166136261u;
+
+    for (uint8_t i = 0; i < keySize; i++)
+    {
+        value ^= key[i];
+        value *= 16777619u;
+    }
+
+    return value;
+}
+
+/*!
+ * @brief Put an entry in the first slot of its probe sequence that holds no
+ * entry. The key must not be in the table.
+ *
+ * @param[in] entry     Entry
+ *
+ * @return None
+ * */
+void HashIndex::placeEntry(uint16_t entry)
+{
+    uint32_t index = hash(&keys[(size_t) entry * keySize]) & slotIndexMask;
+
+    while (slots[index] >= 0)
+    {
+        index = (index + 1) & slotIndexMask;
+    }
+
+    if (slots[index] == SLOT_DELETED)
+    {
+        deletedNb--;
+    }
+
+    slots[index] = entry;
+    entrySlots[entry] = index;
+}
+
+/*!
+ * @brief Rebuild the table without its tombstones. The entries keep their
+ * number.
+ *
+ * @return None
+ * */
+void HashIndex::rebuild(void)
+{
+    slots.assign(slots.size(), SLOT_FREE);
+    deletedNb = 0;
+
+    for (uint16_t i = 0; i < entryNb; i++)
+    {
+        if (isEntryUsed[i])
+        {
+            placeEntry(i);
+        }
+    }
+
+    rebuildNb++;
+}
+
+/*!
+ * @brief Find the entry of a key
+ *
+ * @param[in] key   Key (keySize bytes)
+ *
+ * @return Entry, -1 if the key is not in the table
+ * */
+int32_t HashIndex::find(const uint8_t* key) const
+{
+    uint32_t index = hash(key) & slotIndexMask;
+
+    for (uint32_t probeNb = 0; probeNb < slots.size(); probeNb++)
+    {
+        int16_t entry = slots[index];
+
+        if (entry == SLOT_FREE)
+        {
+            break;
+        }
+
+        if ((entry >= 0) &&
+            (memcmp(&keys[(size_t) entry * keySize], key, keySize) == 0))
+        {
+            return entry;
+        }
+
+        index = (index + 1) & slotIndexMask;
+    }
+
+    return -1;
+}
+
+/*!
+ * @brief Add a key to the table
+ *
+ * @param[in] key   Key (keySize bytes)
+ *
+ * @return Entry of the key, -1 if all the entries are used. If the key was
+ * already in the table its entry is returned.
+ * */
+int32_t HashIndex::insert(const uint8_t* key)
+{
+    int32_t existing = find(key);
+
+    if (existing >= 0)
+    {
+        return existing;
+    }
+
+    if (freeEntries.empty())
+    {
+        return -1;
+    }
+
+    uint16_t entry = freeEntries.back();
+
+    freeEntries.pop_back();
+    memcpy(&keys[(size_t) entry * keySize], key, keySize);
+    isEntryUsed[entry] = true;
+    usedNb++;
+    placeEntry(entry);
+
+    return entry;
+}
+
+/*!
+ * @brief Remove an entry from the table. Its number may be given to the next
+ * key inserted.
+ *
+ * @param[in] entry     Entry
+ *
+ * @return None
+ * */
+void HashIndex::remove(int32_t entry)
+{
+    if (!isUsed(entry))
+    {
+        return;
+    }
+
+    slots[entrySlots[entry]] = SLOT_DELETED;
+    isEntryUsed[entry] = false;
+    freeEntries.push_back(entry);
+    usedNb--;
+    deletedNb++;
+
+    if (deletedNb > (slots.size() / 4))
+    {
+        rebuild();
+    }
+}
+
+/*!
+ * @brief Tell whether an entry holds a key
+ *
+ * @param[in] entry     Entry
+ *
+ * @return True if the entry is used
+ * */
+bool HashIndex::isUsed(int32_t entry) const
+{
+    return ((entry >= 0) && (entry < entryNb) && isEntryUsed[entry]);
+}
+
+/*!
+ * @brief Get the key of an entry
+ *
+ * @param[in] entry     Entry, it must be used
+ *
+ * @return Key (keySize bytes)
+ * */
+const uint8_t* HashIndex::getKey(int32_t entry) const
+{
+    return &keys[(size_t) entry * keySize];
+}
+
+/*!
+ * @brief Get the number of entries, used or not
+ *
+ * @return Number of entries
+ * */
+uint16_t HashIndex::getEntryNb(void) const
+{
+    return entryNb;
+}
+
+/*!
+ * @brief Get the number of entries used
+ *
+ * @return Number of entries used
+ * */
+uint16_t HashIndex::getUsedNb(void) const
+{
+    return usedNb;
+}
+
+/*!
+ * @brief Tell whether all the entries are used
+ *
+ * @return True if no key can be inserted
+ * */
+bool HashIndex::isFull(void) const
+{
+    return freeEntries.empty();
+}
+
+/*!
+ * @brief Get the number of times the table was rebuilt to drop its
+ * tombstones
+ *
+ * @return Number of rebuilds
+ * */
+uint32_t HashIndex::getRebuildNb(void) const
+{
+    return rebuildNb;
+}
+
+/*** end of file ***/
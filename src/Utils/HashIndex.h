@@ -0,0 +1,60 @@
+/** @file HashIndex.h
+ *
+ * @brief This class finds the entry of a fixed size key (e.g. a MAC address)
+ * among a fixed number of entries, with an open addressing hash table
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include <vector>
+
+class HashIndex
+{
+    private:
+        /* Content of a slot of the table: an entry, or one of these */
+        enum SlotState
+        {
+            SLOT_FREE = -1,
+            SLOT_DELETED = -2
+        };
+
+        uint16_t entryNb;
+        uint8_t keySize;
+        uint32_t slotIndexMask;
+        std::vector<int16_t> slots;
+        /* Key and slot of each entry, and the entries not used */
+        std::vector<uint8_t> keys;
+        std::vector<uint16_t> entrySlots;
+        std::vector<bool> isEntryUsed;
+        std::vector<uint16_t> freeEntries;
+        uint16_t usedNb;
+        uint16_t deletedNb;
+        uint32_t rebuildNb;
+
+        uint32_t hash(const uint8_t* key) const;
+        void placeEntry(uint16_t entry);
+        void rebuild(void);
+
+    public:
+        HashIndex(uint16_t maxEntryNb, uint8_t keyLen);
+        ~HashIndex(void);
+        int32_t find(const uint8_t* key) const;
+        int32_t insert(const uint8_t* key);
+        void remove(int32_t entry);
+        bool isUsed(int32_t entry) const;
+        const uint8_t* getKey(int32_t entry) const;
+        uint16_t getEntryNb(void) const;
+        uint16_t getUsedNb(void) const;
+        bool isFull(void) const;
+        uint32_t getRebuildNb(void) const;
+};
+
+#endif /* HASH_INDEX_H */
+
+/*** end of file ***/
@@ -11,7 +11,20 @@
 using namespace std;
 
 /*!
- * @brief Runs a system command on linux host.
+ * @brief Get the executor shared by the commands of the process
+ *
+ * @return Command executor
+ */
+CommandExecutor& SystemUtils::GetCommandExecutor(void)
+{
+    static CommandExecutor executor;
+
+    return executor;
+}
+
+/*!
+ * @brief Runs a system command on linux host, through the shell. Prefer
+ * RunCommand() when the command needs no shell.
  *
  * @param[in] commandStringPtr   String command to execute
  *
@@ -19,29 +32,56 @@ using namespace std;
  */
 bool SystemUtils::RunSystemCommand(string commandStringPtr)
 {
-    int systemResult;
-    bool status = true;
+    vector<string> args;
+
+    args.push_back("/bin/sh");
+    args.push_back("-c");
+    args.push_back(commandStringPtr);
 
-    if (status)
+    /* No time limit, as with system() */
+    if (!GetCommandExecutor().run(args, 0, NULL))
     {
-        systemResult = system(commandStringPtr.c_str());
-
-        /* Return value of -1 means that the fork()
-         * has failed (see man system). */
-        if (0 == WEXITSTATUS(systemResult))
-        {
-            LE_INFO("Success: %s", commandStringPtr.c_str());
-        }
-        else
-        {
-            LE_ERROR("Error %s Failed: (%d)",
-                                commandStringPtr.c_str(),
-                                systemResult);
-            status = false;
-        }
+        LE_ERROR("Error %s Failed", commandStringPtr.c_str());
+        return false;
     }
 
-    return status;
+    LE_INFO("Success: %s", commandStringPtr.c_str());
+
+    return true;
+}
+
+/*!
+ * @brief Runs a program on linux host without a shell, and waits for its end
+ *
+ * @param[in] args          Program and its arguments
+ * @param[in] timeoutMs     Time before the program is killed, 0 for no limit
+ *
+ * @return Status of the operation.
+ */
+bool SystemUtils::RunCommand(const vector<string>& args, uint32_t timeoutMs)
+{
+    return GetCommandExecutor().run(args, timeoutMs, NULL);
+}
+
+/*!
+ * @brief Starts a program on linux host without a shell. The handler is
+ * called from the event loop when the program is over.
+ *
+ * @param[in] args          Program and its arguments
+ * @param[in] timeoutMs     Time before the program is killed, 0 for no limit
+ * @param[in] handler       Function called when the program is over, may be
+ *                          NULL
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return Identifier of the command, -1 if it couldn't be started
+ */
+int32_t SystemUtils::StartCommand(const vector<string>& args,
+                                    uint32_t timeoutMs,
+                                    CommandExecutorTypes::CommandHandler
+                                                                    handler,
+                                    void* contextPtr)
+{
+    return GetCommandExecutor().start(args, timeoutMs, handler, contextPtr);
 }
 
 /*** end of file ***/
@@ -7,7 +7,9 @@
  */
 #include "legato.h"
 #include "interfaces.h"
+#include "Utils/CommandExecutor.h"
 #include <iostream>
+#include <vector>
 
 #ifndef SYSTEM_UTILS_H
 #define SYSTEM_UTILS_H
@@ -16,6 +18,14 @@ class SystemUtils
 {
     public:
         static bool RunSystemCommand(std::string commandStringPtr);
+        static bool RunCommand(const std::vector<std::string>& args,
+                                uint32_t timeoutMs =
+                    CommandExecutorConstants::COMMAND_DEFAULT_TIMEOUT_MS);
+        static int32_t StartCommand(const std::vector<std::string>& args,
+                                uint32_t timeoutMs,
+                                CommandExecutorTypes::CommandHandler handler,
+                                void* contextPtr);
+        static CommandExecutor& GetCommandExecutor(void);
 };
 
 #endif /* SYSTEM_UTILS_H */
@@ -13,25 +13,50 @@
 #include "Utils/SystemUtils.h"
 
 using namespace TimeUpdaterConstants;
+using namespace CommandExecutorTypes;
 
 /* Initialize the static member of TimeUpdater that allows to tell if the
  * current system time is accurate */
 bool TimeUpdater::isTimeUpdated = false;
 
+/* Update running, -1 if none */
+int32_t TimeUpdater::updateCommandId = -1;
+
+/*!
+ * @brief Handler of the end of the time update
+ *
+ * @param[in] resultPtr     Outcome of ntpd
+ * @param[in] contextPtr    Unused
+ *
+ * @return None
+ */
+void TimeUpdater::onTimeUpdate(const CommandResult* resultPtr,
+                                void* contextPtr)
+{
+    TimeUpdater::updateCommandId = -1;
+
+    if (resultPtr->isSuccess)
+    {
+        LE_INFO("Time updated successfully in %u ms!", resultPtr->durationMs);
+        TimeUpdater::isTimeUpdated = true;
+    }
+}
+
 /*!
  * @brief Update the time. Return true if the time was updated at least once.
+ * The update runs in the background and completes on the event loop, the
+ * status is polled until it succeeds.
  *
  * @return True if the system time is updated since app start, false otherwise.
  */
 bool TimeUpdater::getTimeUpdateStatus()
 {
-    if (!TimeUpdater::isTimeUpdated)
+    if (!TimeUpdater::isTimeUpdated && (TimeUpdater::updateCommandId < 0))
     {
-        if (SystemUtils::RunSystemCommand(TIME_UPDATE_CMD.c_str()))
-        {
-            LE_INFO("Time updated successfully!");
-            TimeUpdater::isTimeUpdated = true;
-        }
+        TimeUpdater::updateCommandId =
+                    SystemUtils::StartCommand(TIME_UPDATE_ARGS,
+                                                TIME_UPDATE_TIMEOUT_MS,
+                                                onTimeUpdate, NULL);
     }
 
     return TimeUpdater::isTimeUpdated;
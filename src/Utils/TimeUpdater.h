@@ -9,12 +9,18 @@
 #ifndef TIME_UPDATER_H
 #define TIME_UPDATER_H
 
+#include "Utils/CommandExecutorUtils.h"
+
 class TimeUpdater
 {
     public:
         virtual bool getTimeUpdateStatus();
     private:
         static bool isTimeUpdated;
+        static int32_t updateCommandId;
+        static void onTimeUpdate(
+                        const CommandExecutorTypes::CommandResult* resultPtr,
+                        void* contextPtr);
 };
 
 #endif /* TIME_UPDATER_H */
@@ -10,12 +10,16 @@
 #define TIME_UPDATER_UTILS_H
 
 #include <iostream>
+#include <vector>
 
 namespace TimeUpdaterConstants
 {
     const std::string NTP_SERVER_HOSTNAME = "pool.ntp.org";
-    const std::string NTPD_CMD = "/usr/sbin/ntpd -d -q -n -p ";
-    const std::string TIME_UPDATE_CMD = NTPD_CMD + " " + NTP_SERVER_HOSTNAME;
+    const std::vector<std::string> TIME_UPDATE_ARGS =
+                {"/usr/sbin/ntpd", "-d", "-q", "-n", "-p", NTP_SERVER_HOSTNAME};
+
+    /* Time given to ntpd to set the time before it is killed */
+    const uint32_t TIME_UPDATE_TIMEOUT_MS = 60000;
 }
 
 #endif /* TIME_UPDATER_UTILS_H */
@@ -0,0 +1,417 @@
+/** @file TimerWheel.cpp
+ *
+ * @brief This class manages a large number of timers (hierarchical timing
+ * wheel) using a single timerfd
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/TimerWheel.h"
+#include <sys/timerfd.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace TimerWheelConstants;
+using namespace TimerWheelTypes;
+
+static const uint32_t SLOT_INDEX_MASK = TIMER_WHEEL_LEVEL_SIZE - 1;
+
+/*!
+ * @brief Constructor for TimerWheel. init() must be called before use.
+ * */
+TimerWheel::TimerWheel(void) : currentTick(getNowTick()), timerNb(0),
+                                timer_fd(-1), isArmed(false),
+                                fdMonitorRef(NULL)
+{
+    for (uint8_t level = 0; level < TIMER_WHEEL_LEVEL_NB; level++)
+    {
+        for (uint32_t index = 0; index < TIMER_WHEEL_LEVEL_SIZE; index++)
+        {
+            /* Each slot is a circular list whose head is the slot itself */
+            slots[level][index].prevPtr = &slots[level][index];
+            slots[level][index].nextPtr = &slots[level][index];
+        }
+    }
+}
+
+/*!
+ * @brief Destructor for TimerWheel. The timers still running are dropped.
+ * */
+TimerWheel::~TimerWheel(void)
+{
+    if (fdMonitorRef != NULL)
+    {
+        le_fdMonitor_Delete(fdMonitorRef);
+    }
+
+    if (timer_fd >= 0)
+    {
+        ::close(timer_fd);
+    }
+}
+
+/*!
+ * @brief Create the timerfd driving the wheel
+ *
+ * @return Status of the operation
+ * */
+bool TimerWheel::init(void)
+{
+    bool status = true;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (timer_fd < 0)
+    {
+        LE_ERROR("Failed to create the timerfd: %s", strerror(errno));
+        status = false;
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Get the file descriptor to poll (POLLIN) to know when process()
+ * has to be called
+ *
+ * @return File descriptor of the timerfd
+ * */
+int32_t TimerWheel::getFd(void) const
+{
+    return timer_fd;
+}
+
+/*!
+ * @brief Let the Legato event loop call process() when needed
+ *
+ * @return None
+ * */
+void TimerWheel::monitor(void)
+{
+    if ((fdMonitorRef == NULL) && (timer_fd >= 0))
+    {
+        fdMonitorRef = le_fdMonitor_Create("TimerWheel", timer_fd, fdHandler,
+                                                                    POLLIN);
+        le_fdMonitor_SetContextPtr(fdMonitorRef, this);
+    }
+}
+
+/*!
+ * @brief Handler of the timerfd when monitored by the Legato event loop
+ *
+ * @param[in] fd        File descriptor of the timerfd
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+void TimerWheel::fdHandler(int fd, short events)
+{
+    TimerWheel* wheelPtr = (TimerWheel*) le_fdMonitor_GetContextPtr();
+
+    wheelPtr->process();
+}
+
+/*!
+ * @brief Get the current time in ticks
+ *
+ * @return Number of ticks since an arbitrary point in the past
+ * */
+uint64_t TimerWheel::getNowTick(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000) /
+                                                        TIMER_WHEEL_TICK_MS;
+}
+
+/*!
+ * @brief Initialize a timer before its first use
+ *
+ * @param[out] timerPtr     Timer to initialize
+ * @param[in] handler       Function called when the timer expires
+ * @param[in] contextPtr    Context given to the handler
+ *
+ * @return None
+ * */
+void TimerWheel::initTimer(Timer* timerPtr, ExpiryHandler handler,
+                            void* contextPtr)
+{
+    timerPtr->prevPtr = NULL;
+    timerPtr->nextPtr = NULL;
+    timerPtr->expiryTick = 0;
+    timerPtr->handler = handler;
+    timerPtr->contextPtr = contextPtr;
+}
+
+/*!
+ * @brief Remove a timer from the slot it is linked into
+ *
+ * @param[in] timerPtr  Timer to remove
+ *
+ * @return None
+ * */
+void TimerWheel::unlink(Timer* timerPtr)
+{
+    timerPtr->prevPtr->nextPtr = timerPtr->nextPtr;
+    timerPtr->nextPtr->prevPtr = timerPtr->prevPtr;
+    timerPtr->prevPtr = NULL;
+    timerPtr->nextPtr = NULL;
+}
+
+/*!
+ * @brief Add a timer at the end of a list
+ *
+ * @param[in] headPtr   Head of the list
+ * @param[in] timerPtr  Timer to add
+ *
+ * @return None
+ * */
+void TimerWheel::append(Timer* headPtr, Timer* timerPtr)
+{
+    timerPtr->nextPtr = headPtr;
+    timerPtr->prevPtr = headPtr->prevPtr;
+    headPtr->prevPtr->nextPtr = timerPtr;
+    headPtr->prevPtr = timerPtr;
+}
+
+/*!
+ * @brief Link a timer into the slot matching its expiry. The lowest level
+ * holds the timers expiring in the next TIMER_WHEEL_LEVEL_SIZE ticks, each
+ * upper level covers TIMER_WHEEL_LEVEL_SIZE times more.
+ *
+ * @param[in] timerPtr  Timer to insert
+ *
+ * @return None
+ * */
+void TimerWheel::insert(Timer* timerPtr)
+{
+    uint64_t expiryTick = timerPtr->expiryTick;
+    uint8_t level = 0;
+
+    /* Timers already late expire on the next tick processed */
+    if (expiryTick < currentTick)
+    {
+        expiryTick = currentTick;
+    }
+
+    while ((level < (TIMER_WHEEL_LEVEL_NB - 1)) &&
+           ((expiryTick - currentTick) >=
+                    ((uint64_t) 1 << (TIMER_WHEEL_LEVEL_BITS * (level + 1)))))
+    {
+        level++;
+    }
+
+    /* Timers beyond the range of the wheel are parked in the farthest slot
+     * and inserted again when it is cascaded */
+    uint64_t maxDelta =
+                ((uint64_t) 1 << (TIMER_WHEEL_LEVEL_BITS * TIMER_WHEEL_LEVEL_NB)) - 1;
+
+    if ((expiryTick - currentTick) > maxDelta)
+    {
+        expiryTick = currentTick + maxDelta;
+    }
+
+    uint32_t index = (expiryTick >> (TIMER_WHEEL_LEVEL_BITS * level)) &
+                                                            SLOT_INDEX_MASK;
+
+    append(&slots[level][index], timerPtr);
+}
+
+/*!
+ * @brief Move the timers of the current slot of a level to the lower levels
+ *
+ * @param[in] level     Level to cascade
+ *
+ * @return None
+ * */
+void TimerWheel::cascade(uint8_t level)
+{
+    uint32_t index = (currentTick >> (TIMER_WHEEL_LEVEL_BITS * level)) &
+                                                            SLOT_INDEX_MASK;
+    Timer* headPtr = &slots[level][index];
+
+    while (headPtr->nextPtr != headPtr)
+    {
+        Timer* timerPtr = headPtr->nextPtr;
+
+        unlink(timerPtr);
+        insert(timerPtr);
+    }
+}
+
+/*!
+ * @brief Start or stop the periodic tick of the timerfd. The tick only runs
+ * while timers are pending so that an idle wheel does not wake the process.
+ *
+ * @param[in] isEnabled     True to start the tick, false to stop it
+ *
+ * @return None
+ * */
+void TimerWheel::arm(bool isEnabled)
+{
+    struct itimerspec spec;
+
+    if ((timer_fd < 0) || (isEnabled == isArmed))
+    {
+        return;
+    }
+
+    memset(&spec, 0, sizeof(spec));
+
+    if (isEnabled)
+    {
+        spec.it_value.tv_sec = TIMER_WHEEL_TICK_MS / 1000;
+        spec.it_value.tv_nsec = (TIMER_WHEEL_TICK_MS % 1000) * 1000000;
+        spec.it_interval = spec.it_value;
+    }
+
+    if (timerfd_settime(timer_fd, 0, &spec, NULL) < 0)
+    {
+        LE_ERROR("Failed to arm the timerfd: %s", strerror(errno));
+    }
+    else
+    {
+        isArmed = isEnabled;
+    }
+}
+
+/*!
+ * @brief Start a timer, restarting it if it is already running
+ *
+ * @param[in] timerPtr  Timer initialized with initTimer()
+ * @param[in] delayMs   Delay before expiry, rounded up to the tick
+ *
+ * @return None
+ * */
+void TimerWheel::start(Timer* timerPtr, uint32_t delayMs)
+{
+    uint64_t nowTick = getNowTick();
+
+    cancel(timerPtr);
+
+    /* Nothing moved the wheel forward while it was empty */
+    if (timerNb == 0)
+    {
+        currentTick = nowTick;
+    }
+
+    timerPtr->expiryTick = nowTick +
+                    (delayMs + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+
+    insert(timerPtr);
+    timerNb++;
+    arm(true);
+}
+
+/*!
+ * @brief Stop a timer. Does nothing if the timer is not running.
+ *
+ * @param[in] timerPtr  Timer to stop
+ *
+ * @return None
+ * */
+void TimerWheel::cancel(Timer* timerPtr)
+{
+    if (isRunning(timerPtr))
+    {
+        unlink(timerPtr);
+        timerNb--;
+    }
+}
+
+/*!
+ * @brief Check if a timer is running
+ *
+ * @param[in] timerPtr  Timer to check
+ *
+ * @return True if the timer is running, false otherwise
+ * */
+bool TimerWheel::isRunning(const Timer* timerPtr)
+{
+    return (timerPtr->nextPtr != NULL);
+}
+
+/*!
+ * @brief Call the handlers of the expired timers. To be called when the
+ * timerfd is readable.
+ *
+ * @return None
+ * */
+void TimerWheel::process(void)
+{
+    uint64_t expirationNb;
+    uint64_t nowTick = getNowTick();
+
+    /* Acknowledge the timerfd, the time elapsed is read from the clock */
+    if (timer_fd >= 0)
+    {
+        if (::read(timer_fd, &expirationNb, sizeof(expirationNb)) < 0)
+        {
+            expirationNb = 0;
+        }
+    }
+
+    while ((timerNb > 0) && (currentTick <= nowTick))
+    {
+        uint32_t index = currentTick & SLOT_INDEX_MASK;
+        Timer expired;
+
+        /* Entering a new turn of a level brings down the timers of the next
+         * slot of the level above */
+        for (uint8_t level = 1; (level < TIMER_WHEEL_LEVEL_NB) &&
+                ((currentTick & (((uint64_t) 1 <<
+                        (TIMER_WHEEL_LEVEL_BITS * level)) - 1)) == 0); level++)
+        {
+            cascade(level);
+        }
+
+        /* Detach the slot so that the handlers can start timers again */
+        expired.prevPtr = &expired;
+        expired.nextPtr = &expired;
+
+        while (slots[0][index].nextPtr != &slots[0][index])
+        {
+            Timer* timerPtr = slots[0][index].nextPtr;
+
+            unlink(timerPtr);
+            append(&expired, timerPtr);
+        }
+
+        currentTick++;
+
+        while (expired.nextPtr != &expired)
+        {
+            Timer* timerPtr = expired.nextPtr;
+
+            unlink(timerPtr);
+            timerNb--;
+
+            if (timerPtr->handler != NULL)
+            {
+                timerPtr->handler(timerPtr->contextPtr);
+            }
+        }
+    }
+
+    if (timerNb == 0)
+    {
+        arm(false);
+    }
+}
+
+/*!
+ * @brief Get the number of timers running
+ *
+ * @return Number of timers
+ * */
+uint32_t TimerWheel::getTimerNb(void) const
+{
+    return timerNb;
+}
+
+/*** end of file ***/
@@ -0,0 +1,55 @@
+/** @file TimerWheel.h
+ *
+ * @brief This class manages a large number of timers (hierarchical timing
+ * wheel) using a single timerfd
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/TimerWheelUtils.h"
+
+class TimerWheel
+{
+    private:
+        TimerWheelTypes::Timer slots[TimerWheelConstants::TIMER_WHEEL_LEVEL_NB]
+                                    [TimerWheelConstants::TIMER_WHEEL_LEVEL_SIZE];
+        uint64_t currentTick;
+        uint32_t timerNb;
+        int32_t timer_fd;
+        bool isArmed;
+        le_fdMonitor_Ref_t fdMonitorRef;
+
+        static uint64_t getNowTick(void);
+        static void fdHandler(int fd, short events);
+        static void unlink(TimerWheelTypes::Timer* timerPtr);
+        static void append(TimerWheelTypes::Timer* headPtr,
+                            TimerWheelTypes::Timer* timerPtr);
+        void insert(TimerWheelTypes::Timer* timerPtr);
+        void cascade(uint8_t level);
+        void arm(bool isEnabled);
+
+    public:
+        TimerWheel(void);
+        ~TimerWheel(void);
+        bool init(void);
+        int32_t getFd(void) const;
+        void monitor(void);
+        static void initTimer(TimerWheelTypes::Timer* timerPtr,
+                                TimerWheelTypes::ExpiryHandler handler,
+                                void* contextPtr);
+        void start(TimerWheelTypes::Timer* timerPtr, uint32_t delayMs);
+        void cancel(TimerWheelTypes::Timer* timerPtr);
+        static bool isRunning(const TimerWheelTypes::Timer* timerPtr);
+        void process(void);
+        uint32_t getTimerNb(void) const;
+};
+
+#endif /* TIMER_WHEEL_H */
+
+/*** end of file ***/
@@ -0,0 +1,48 @@
+/** @file TimerWheelUtils.h
+ *
+ * @brief This file provides the types and constants of the timer wheel
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef TIMER_WHEEL_UTILS_H
+#define TIMER_WHEEL_UTILS_H
+
+#include "legato.h"
+#include "interfaces.h"
+
+namespace TimerWheelTypes
+{
+    /* Function called when a timer expires */
+    typedef void (*ExpiryHandler)(void* contextPtr);
+
+    /* Timer managed by the wheel. The memory is owned by the user of the
+     * timer, the wheel only links it into its slots. */
+    struct Timer
+    {
+        Timer* prevPtr;
+        Timer* nextPtr;
+        uint64_t expiryTick;
+        ExpiryHandler handler;
+        void* contextPtr;
+    };
+}
+
+namespace TimerWheelConstants
+{
+    /* Resolution of the wheel */
+    const uint32_t TIMER_WHEEL_TICK_MS = 100;
+
+    /* Each level has 2^TIMER_WHEEL_LEVEL_BITS slots */
+    const uint8_t TIMER_WHEEL_LEVEL_BITS = 6;
+    const uint32_t TIMER_WHEEL_LEVEL_SIZE = 1 << TIMER_WHEEL_LEVEL_BITS;
+
+    /* Number of levels. With 4 levels of 64 slots of 100 ms, timers can be
+     * set up to 19 days ahead. */
+    const uint8_t TIMER_WHEEL_LEVEL_NB = 4;
+}
+
+#endif /* TIMER_WHEEL_UTILS_H */
+
+/*** end of file ***/
@@ -12,6 +12,7 @@
 #include "Wifi/WiFiAccessPoint.h"
 #include "WiFi/WiFiAccessPointUtils.h"
 #include "Utils/SystemUtils.h"
+#include "Network/NetlinkConfigurator.h"
 #include <signal.h>
 
 using namespace WiFiAccessPointConstants;
@@ -20,7 +21,7 @@ using namespace WiFiAccessPointConstants;
  * @brief Constructor for WiFiAccessPoint
  *
  * */
-WiFiAccessPoint::WiFiAccessPoint()
+WiFiAccessPoint::WiFiAccessPoint() : firewall("AP")
 {
     char env[] = "PATH=/legato/systems/current/bin:/usr/local/bin:"
             "/usr/bin:/bin:/usr/local/sbin:/usr/sbin:/sbin";
@@ -45,16 +46,33 @@ WiFiAccessPoint::~WiFiAccessPoint()
  */
 void WiFiAccessPoint::configureDHCPAndIpTables(void)
 {
-    /* Flush the IP address of the wlan0 interface */
-    SystemUtils::RunSystemCommand("ip addr flush dev " + ITF_LAN);
-
-    SystemUtils::RunSystemCommand("ifconfig " + ITF_LAN +
-                                " " + HOST_IP + " up");
+    NetlinkConfigurator netConfig;
+
+    /* Replace the IP addresses of the wlan0 interface and bring it up, at
+     * once: the interface is left untouched if any of it fails */
+    if (!netConfig.open() ||
+        !netConfig.flushAddresses(ITF_LAN.c_str()) ||
+        !netConfig.addAddress(ITF_LAN.c_str(), HOST_IP.c_str(),
+                                HOST_PREFIX_LEN) ||
+        !netConfig.setLinkUp(ITF_LAN.c_str(), true) ||
+        !netConfig.apply())
+    {
+        LE_ERROR("Couldn't configure %s", ITF_LAN.c_str());
+    }
+    else
+    {
+        LE_INFO("%s configured in %u us", ITF_LAN.c_str(),
+                netConfig.getLastApplyUs());
+    }
 
-    SystemUtils::RunSystemCommand("iptables -I INPUT -s " + SUBNET +
-                                " --jump ACCEPT");
+    /* Applied only if it changed since the last start */
+    firewall.addRule("INPUT", "-s " + SUBNET + " -j ACCEPT");
+    firewall.setPolicy("INPUT", "ACCEPT");
 
-    SystemUtils::RunSystemCommand("iptables --policy INPUT ACCEPT");
+    if (!firewall.apply())
+    {
+        LE_ERROR("Couldn't configure the firewall of %s", ITF_LAN.c_str());
+    }
 
     LE_ASSERT(LE_OK == le_wifiAp_SetIpRange(HOST_IP.c_str(),
                                                 IP_RANGE_START.c_str(),
@@ -120,8 +138,11 @@ void WiFiAccessPoint::stop(void)
     /* Problem in start is that if at least one wifi module were already
      * started, the script will consider everything is configured.
      * The problem will lead to having not all the modules started + the GPIO
-     * not configured. */
-    SystemUtils::RunSystemCommand("/etc/init.d/tiwifi stop");
+     * not configured.
+     * The script unloads the WiFi modules, it is not killed midway as it
+     * would leave them half unloaded. */
+    SystemUtils::RunCommand({"/etc/init.d/tiwifi", "stop"},
+                            CommandExecutorConstants::COMMAND_NO_TIMEOUT);
 }
 
 /*** end of file ***/
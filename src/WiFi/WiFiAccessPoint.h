@@ -12,10 +12,13 @@
 
 #include "legato.h"
 #include "interfaces.h"
+#include "Network/FirewallManager.h"
 
 class WiFiAccessPoint
 {
     private:
+        FirewallManager firewall;
+
         void configureDHCPAndIpTables(void);
         void setApParameters(void);
     public:
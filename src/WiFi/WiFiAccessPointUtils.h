@@ -24,6 +24,7 @@ namespace WiFiAccessPointConstants
     /* IP & mask of subnet created on the wlan */
     const std::string SUBNET  = "192.168.10.0/24";
     const std::string HOST_IP = "192.168.10.1";
+    const uint8_t HOST_PREFIX_LEN = 24;
 
     /* IP range allotted to clients */
     const std::string IP_RANGE_START = "192.168.10.10";
@@ -0,0 +1,474 @@
+/** @file AtChannelTest.cpp
+ *
+ * @brief Unit test of AtChannel against a fake modem on a pseudo terminal,
+ * which echoes the commands and answers them after a set delay: the echo
+ * left out of the responses, the cached identity, +CME ERROR, a command
+ * timing out, the AVMS configuration batch, and the loss of the port and its
+ * reopening. The port is opened through a link, pointed at a new pseudo
+ * terminal once the first one is lost. The steps run from the event loop,
+ * each one started by the handler of the previous one.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "CellularNetwork/AtChannel.h"
+#include "CellularNetwork/CellularNetworkUtils.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <time.h>
+#include <deque>
+
+using namespace AtChannelConstants;
+using namespace AtChannelTypes;
+
+/* Time the fake modem takes to answer a command */
+static const uint32_t TEST_MODEM_DELAY_MS = 20;
+
+/* Margin allowed on the times measured */
+static const uint32_t TEST_MARGIN_MS = 250;
+
+/* Timeout of the command the modem never answers */
+static const uint32_t TEST_TIMEOUT_MS = 300;
+
+static const char* TEST_IMEI = "351234567890123";
+
+/* Command answered by +CME ERROR, and command never answered */
+static const char* TEST_CMD_FAIL = "AT+FAIL";
+static const char* TEST_CMD_DROP = "AT+DROP";
+
+/* Directory of the link to the port */
+static std::string LinkDir;
+
+static AtChannel* ChannelPtr;
+
+/* Fake modem: master side of the pseudo terminal, commands received and
+ * not answered yet */
+static int ModemFd = -1;
+static le_fdMonitor_Ref_t ModemMonitorRef;
+static le_timer_Ref_t ModemTimer;
+static std::string ModemInput;
+static std::deque<std::string> PendingCommands;
+static bool IsAnswering;
+static uint32_t ModemCommandNb;
+static size_t MaxPendingNb;
+
+static le_timer_Ref_t StepTimer;
+static uint64_t BatchStartMs;
+static uint64_t LossMs;
+static uint32_t OpenNb;
+
+static void onReopened(le_timer_Ref_t timerRef);
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Write to the port, as the modem
+ *
+ * @param[in] text  Bytes written
+ *
+ * @return None
+ * */
+static void writeModem(const std::string& text)
+{
+    LE_TEST(write(ModemFd, text.data(), text.size()) == (ssize_t) text.size());
+}
+
+/*!
+ * @brief Answer the first command received, and arm the answer of the next
+ * one
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void modemTimerHandler(le_timer_Ref_t timerRef)
+{
+    std::string command = PendingCommands.front();
+
+    PendingCommands.pop_front();
+    IsAnswering = false;
+
+    if (command == AT_CMD_IMEI)
+    {
+        writeModem(std::string("\r\n") + TEST_IMEI + "\r\n\r\nOK\r\n");
+    }
+    else if (command == AT_CMD_ICCID)
+    {
+        writeModem("\r\n+CCID: 89441000301234567890\r\n\r\nOK\r\n");
+    }
+    else if (command == AT_CMD_FIRMWARE_VERSION)
+    {
+        writeModem("\r\nSWI9X07Y_02.28.03.05\r\n\r\nOK\r\n");
+
+        /* Last command queued when the port is opened */
+        if (OpenNb == 2)
+        {
+            le_timer_SetHandler(StepTimer, onReopened);
+            le_timer_SetMsInterval(StepTimer, TEST_MODEM_DELAY_MS);
+            le_timer_Start(StepTimer);
+        }
+    }
+    else if (command == "AT+CSQ")
+    {
+        writeModem("\r\n+CSQ: 20,99\r\n\r\nOK\r\n");
+    }
+    else if (command == TEST_CMD_FAIL)
+    {
+        writeModem("\r\n+CME ERROR: 3\r\n");
+    }
+    else if (command != TEST_CMD_DROP)
+    {
+        writeModem("\r\nOK\r\n");
+    }
+
+    if (!PendingCommands.empty())
+    {
+        IsAnswering = true;
+        le_timer_Start(ModemTimer);
+    }
+}
+
+/*!
+ * @brief Receive the commands, as the modem: each one is echoed at once
+ * and answered after TEST_MODEM_DELAY_MS
+ *
+ * @param[in] fd        Master side of the pseudo terminal
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+static void modemHandler(int fd, short events)
+{
+    char buffer[256];
+    ssize_t readNb = read(fd, buffer, sizeof(buffer));
+
+    for (ssize_t i = 0; i < readNb; i++)
+    {
+        if (buffer[i] != '\r')
+        {
+            ModemInput += buffer[i];
+            continue;
+        }
+
+        if (ModemInput == AT_CMD_IMEI)
+        {
+            OpenNb++;
+        }
+
+        writeModem(ModemInput + "\r");
+        PendingCommands.push_back(ModemInput);
+        ModemInput.clear();
+        ModemCommandNb++;
+        MaxPendingNb = std::max(MaxPendingNb, PendingCommands.size());
+
+        if (!IsAnswering)
+        {
+            IsAnswering = true;
+            le_timer_Start(ModemTimer);
+        }
+    }
+}
+
+/*!
+ * @brief Start the fake modem on a new pseudo terminal, and point the link
+ * at it
+ *
+ * @return Status of the operation
+ * */
+static bool startModem(void)
+{
+    std::string linkPath = LinkDir + "/ttyAT";
+
+    ModemFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+
+    if ((ModemFd < 0) || (grantpt(ModemFd) != 0) ||
+        (unlockpt(ModemFd) != 0) || (ptsname(ModemFd) == NULL))
+    {
+        return false;
+    }
+
+    unlink(linkPath.c_str());
+
+    if (symlink(ptsname(ModemFd), linkPath.c_str()) != 0)
+    {
+        return false;
+    }
+
+    ModemInput.clear();
+    PendingCommands.clear();
+    IsAnswering = false;
+    ModemMonitorRef = le_fdMonitor_Create("TestModem", ModemFd, modemHandler,
+                                            POLLIN);
+
+    return true;
+}
+
+/*!
+ * @brief Stop the fake modem: its pseudo terminal is gone
+ *
+ * @return None
+ * */
+static void stopModem(void)
+{
+    le_timer_Stop(ModemTimer);
+    le_fdMonitor_Delete(ModemMonitorRef);
+    ::close(ModemFd);
+    ModemFd = -1;
+}
+
+/*!
+ * @brief Response of the last command, on the port reopened. End of the
+ * test.
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onFinalCommand(const AtResponse* responsePtr, void* contextPtr)
+{
+    std::string value;
+
+    LE_TEST(responsePtr->result == AT_RESULT_OK);
+    LE_TEST(AtChannel::getValue(responsePtr, &value) && (value == "20,99"));
+
+    ChannelPtr->logStats();
+    ChannelPtr->close();
+    stopModem();
+    unlink((LinkDir + "/ttyAT").c_str());
+    rmdir(LinkDir.c_str());
+
+    LE_TEST_EXIT;
+}
+
+/*!
+ * @brief The port was reopened after AT_REOPEN_MS, and its identity read
+ * again: the channel is usable again
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void onReopened(le_timer_Ref_t timerRef)
+{
+    std::string response;
+    uint32_t elapsedMs = getNowMs() - LossMs;
+
+    LE_TEST(elapsedMs >= AT_REOPEN_MS);
+    LE_TEST(elapsedMs < (AT_REOPEN_MS + TEST_MARGIN_MS));
+    LE_TEST(ChannelPtr->getCached(AT_CMD_IMEI, &response) &&
+            (response == TEST_IMEI));
+
+    LE_TEST(ChannelPtr->send("AT+CSQ", AT_COMMAND_TIMEOUT_MS, onFinalCommand,
+                                NULL));
+}
+
+/*!
+ * @brief Response of a command queued when the port is lost: it fails, and
+ * nothing can be sent until the port is reopened
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onLostCommand(const AtResponse* responsePtr, void* contextPtr)
+{
+    LE_TEST(responsePtr->result == AT_RESULT_CLOSED);
+    LE_TEST(!ChannelPtr->send("AT+CSQ", AT_COMMAND_TIMEOUT_MS, NULL, NULL));
+    LE_TEST(ChannelPtr->getQueuedNb() == 0);
+
+    LossMs = getNowMs();
+
+    LE_TEST(startModem());
+}
+
+/*!
+ * @brief End of the AVMS configuration: its commands were written one after
+ * the other, each one as soon as the previous one was answered. Then the
+ * port is lost with a command in progress.
+ *
+ * @param[in] commandNb     Number of commands of the batch
+ * @param[in] failedNb      Number of commands which failed
+ * @param[in] durationMs    Time from the queueing of the batch to the last
+ *                          final response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onBatch(uint8_t commandNb, uint8_t failedNb, uint32_t durationMs,
+                    void* contextPtr)
+{
+    uint32_t minMs = CellularNetworkConstants::AT_STARTUP_CMDS.size() *
+                        TEST_MODEM_DELAY_MS;
+
+    LE_TEST(commandNb == CellularNetworkConstants::AT_STARTUP_CMDS.size());
+    LE_TEST(failedNb == 0);
+    LE_TEST(durationMs >= minMs);
+    LE_TEST(durationMs < (minMs + TEST_MARGIN_MS));
+    LE_TEST(durationMs <= (getNowMs() - BatchStartMs));
+    LE_TEST(MaxPendingNb == 1);
+
+    LE_INFO("AVMS batch of %u commands in %u ms, modem delay %u ms",
+            commandNb, durationMs, TEST_MODEM_DELAY_MS);
+
+    LE_TEST(ChannelPtr->send("AT+CSQ", AT_COMMAND_TIMEOUT_MS, onLostCommand,
+                                NULL));
+    stopModem();
+}
+
+/*!
+ * @brief Response of the command sent after the one never answered: the
+ * channel goes on. Then the AVMS configuration is sent as a batch.
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onAfterTimeout(const AtResponse* responsePtr, void* contextPtr)
+{
+    std::string value;
+
+    LE_TEST(responsePtr->result == AT_RESULT_OK);
+    LE_TEST(AtChannel::getValue(responsePtr, &value) && (value == "20,99"));
+
+    BatchStartMs = getNowMs();
+
+    LE_TEST(ChannelPtr->sendBatch(CellularNetworkConstants::AT_STARTUP_CMDS,
+                                    onBatch, NULL));
+}
+
+/*!
+ * @brief Response of the command never answered: it times out
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Time it was sent
+ *
+ * @return None
+ * */
+static void onTimeout(const AtResponse* responsePtr, void* contextPtr)
+{
+    LE_TEST(responsePtr->result == AT_RESULT_TIMEOUT);
+    LE_TEST(responsePtr->durationMs >= TEST_TIMEOUT_MS);
+    LE_TEST(responsePtr->durationMs < (TEST_TIMEOUT_MS + TEST_MARGIN_MS));
+    LE_TEST(responsePtr->finalLine[0] == '\0');
+}
+
+/*!
+ * @brief Response of the command answered by +CME ERROR
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onError(const AtResponse* responsePtr, void* contextPtr)
+{
+    std::string value;
+
+    LE_TEST(responsePtr->result == AT_RESULT_ERROR);
+    LE_TEST(strcmp(responsePtr->finalLine, "+CME ERROR: 3") == 0);
+    LE_TEST(responsePtr->lines[0] == '\0');
+    LE_TEST(!AtChannel::getValue(responsePtr, &value));
+}
+
+/*!
+ * @brief Response of a cached command, given before send() returns
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Set once the response is given
+ *
+ * @return None
+ * */
+static void onCached(const AtResponse* responsePtr, void* contextPtr)
+{
+    LE_TEST(responsePtr->result == AT_RESULT_OK);
+    LE_TEST(responsePtr->isCached);
+    LE_TEST(strcmp(responsePtr->lines, TEST_IMEI) == 0);
+
+    *((bool*) contextPtr) = true;
+}
+
+/*!
+ * @brief Response of the first command, queued after the identity read when
+ * the port was opened: the identity is cached without the echo, and served
+ * without writing to the port. Then an error, a timeout and a command
+ * answered are queued together.
+ *
+ * @param[in] responsePtr   Response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onFirstCommand(const AtResponse* responsePtr, void* contextPtr)
+{
+    std::string response;
+    uint32_t commandNb = ModemCommandNb;
+    bool isCached = false;
+
+    LE_TEST(responsePtr->result == AT_RESULT_OK);
+    LE_TEST(!responsePtr->isCached);
+    LE_TEST(commandNb == (AT_STATIC_CMDS.size() + 1));
+
+    LE_TEST(ChannelPtr->getCached(AT_CMD_IMEI, &response) &&
+            (response == TEST_IMEI));
+    LE_TEST(ChannelPtr->getCached(AT_CMD_ICCID, &response) &&
+            (response == "+CCID: 89441000301234567890"));
+    LE_TEST(!ChannelPtr->getCached("AT+CSQ", &response));
+
+    LE_TEST(ChannelPtr->send(" at+cgsn ", AT_COMMAND_TIMEOUT_MS, onCached,
+                                &isCached));
+    LE_TEST(isCached);
+    LE_TEST(ModemCommandNb == commandNb);
+
+    LE_TEST(ChannelPtr->send(TEST_CMD_FAIL, AT_COMMAND_TIMEOUT_MS, onError,
+                                NULL));
+    LE_TEST(ChannelPtr->send(TEST_CMD_DROP, TEST_TIMEOUT_MS, onTimeout,
+                                NULL));
+    LE_TEST(ChannelPtr->send("AT+CSQ", AT_COMMAND_TIMEOUT_MS, onAfterTimeout,
+                                NULL));
+    LE_TEST(ChannelPtr->getQueuedNb() == 3);
+}
+
+COMPONENT_INIT
+{
+    char dir[] = "/tmp/atChannelTestXXXXXX";
+
+    LE_TEST_INIT;
+
+    LE_TEST(mkdtemp(dir) != NULL);
+    LinkDir = dir;
+
+    ModemTimer = le_timer_Create("TestModemTimer");
+    le_timer_SetMsInterval(ModemTimer, TEST_MODEM_DELAY_MS);
+    le_timer_SetHandler(ModemTimer, modemTimerHandler);
+
+    StepTimer = le_timer_Create("TestStepTimer");
+
+    LE_TEST(startModem());
+
+    ChannelPtr = new AtChannel();
+
+    LE_TEST(ChannelPtr->open((LinkDir + "/ttyAT").c_str()));
+    LE_TEST(ChannelPtr->send("AT", AT_COMMAND_TIMEOUT_MS, onFirstCommand,
+                                NULL));
+}
+
+/*** end of file ***/
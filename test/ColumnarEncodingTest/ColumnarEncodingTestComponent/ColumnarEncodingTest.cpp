@@ -0,0 +1,287 @@
+/** @file ColumnarEncodingTest.cpp
+ *
+ * @brief Unit test of ColumnarEncoder and ColumnarDecoder: round trip of
+ * ordinary and extreme samples, limits of a block, and malformed blocks
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Encoding/ColumnarEncoder.h"
+#include "Encoding/ColumnarDecoder.h"
+
+using namespace ColumnarEncodingConstants;
+using namespace ColumnarEncodingTypes;
+
+static const uint32_t TEST_STREAM_SAMPLES = 1000;
+static const uint32_t TEST_SAMPLE_PERIOD_MS = 40;
+
+/*!
+ * @brief Append a varint, as the encoder writes it
+ *
+ * @param[out] block    Buffer to append to
+ * @param[in] value     Number to write
+ *
+ * @return None
+ * */
+static void writeVarint(std::vector<uint8_t>& block, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        block.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+
+    block.push_back(value);
+}
+
+/*!
+ * @brief Check that a block decodes, on both paths, to the samples given
+ *
+ * @param[in] block     Encoded block
+ * @param[in] expected  Samples added to the encoder, per channel
+ *
+ * @return True if both decoders return the samples
+ * */
+static bool checkBlock(const std::vector<uint8_t>& block,
+                        const std::vector<ChannelSamples>& expected)
+{
+    std::vector<ChannelSamples> channels;
+
+    if (!ColumnarDecoder::verify(block.data(), block.size()) ||
+        !ColumnarDecoder::decode(block.data(), block.size(), channels) ||
+        (channels.size() != expected.size()))
+    {
+        return false;
+    }
+
+    for (size_t c = 0; c < channels.size(); c++)
+    {
+        if ((channels[c].channelId != expected[c].channelId) ||
+            (channels[c].timestamps != expected[c].timestamps) ||
+            (channels[c].values != expected[c].values))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*!
+ * @brief Encode a regular stream and samples at the limits of their types,
+ * and decode them back
+ *
+ * @return None
+ * */
+static void testRoundTrip(void)
+{
+    ColumnarEncoder encoder;
+    std::vector<ChannelSamples> expected(3);
+    std::vector<uint8_t> block;
+
+    srand(1);
+
+    /* Regular stream: fixed period with some jitter, slow values */
+    expected[0].channelId = 1;
+
+    for (uint32_t i = 0; i < TEST_STREAM_SAMPLES; i++)
+    {
+        expected[0].timestamps.push_back(1500000000000ULL +
+                        i * TEST_SAMPLE_PERIOD_MS + (((i % 50) == 0) ? 1 : 0));
+        expected[0].values.push_back(1000 + (rand() % 7));
+    }
+
+    /* Timestamps going back and forth over the whole range, values jumping
+     * between the extremes */
+    uint64_t timestamps[] = {0, UINT64_MAX, 1, UINT64_MAX / 2, UINT64_MAX,
+                                UINT64_MAX, 0};
+    int32_t values[] = {INT32_MIN, INT32_MAX, INT32_MIN, 0, INT32_MAX, -1,
+                        INT32_MIN};
+
+    expected[1].channelId = 2;
+    expected[1].timestamps.assign(timestamps, timestamps + 7);
+    expected[1].values.assign(values, values + 7);
+
+    /* A single sample */
+    expected[2].channelId = 255;
+    expected[2].timestamps.push_back(UINT64_MAX);
+    expected[2].values.push_back(INT32_MAX);
+
+    bool isAdded = true;
+
+    for (size_t c = 0; c < expected.size(); c++)
+    {
+        for (size_t i = 0; i < expected[c].timestamps.size(); i++)
+        {
+            isAdded = isAdded &&
+                        (encoder.addSample(expected[c].channelId,
+                                            expected[c].timestamps[i],
+                                            expected[c].values[i]) == LE_OK);
+        }
+    }
+
+    LE_TEST(isAdded);
+    LE_TEST(encoder.encode(block));
+    LE_TEST(encoder.getSampleNb() == 0);
+    LE_TEST(checkBlock(block, expected));
+
+    /* The regular stream is mostly runs */
+    LE_TEST(block.size() <
+                        (TEST_STREAM_SAMPLES * COLUMNAR_RAW_SAMPLE_SIZE / 4));
+    LE_TEST(!encoder.encode(block));
+}
+
+/*!
+ * @brief Check the limits of a block on the encoder side
+ *
+ * @return None
+ * */
+static void testLimits(void)
+{
+    ColumnarEncoder encoder;
+    bool isAdded = true;
+
+    for (uint32_t i = 0; i < COLUMNAR_MAX_CHANNELS; i++)
+    {
+        isAdded = isAdded && (encoder.addSample(i, 0, 0) == LE_OK);
+    }
+
+    LE_TEST(isAdded);
+    LE_TEST(encoder.addSample(COLUMNAR_MAX_CHANNELS, 0, 0) == LE_OVERFLOW);
+
+    /* The samples are counted over all the channels */
+    for (uint32_t i = COLUMNAR_MAX_CHANNELS; i < COLUMNAR_MAX_SAMPLES; i++)
+    {
+        isAdded = isAdded && (encoder.addSample(i % 2, i, 0) == LE_OK);
+    }
+
+    LE_TEST(isAdded);
+    LE_TEST(encoder.addSample(0, 0, 0) == LE_OVERFLOW);
+
+    std::vector<uint8_t> block;
+    std::vector<ChannelSamples> channels;
+
+    LE_TEST(encoder.encode(block));
+    LE_TEST(ColumnarDecoder::decodeFast(block.data(), block.size(), channels));
+}
+
+/*!
+ * @brief Build the start of a block with one channel
+ *
+ * @param[out] block        Buffer to fill
+ * @param[in] count         Number of samples of the channel
+ * @param[in] firstValue    Zigzag encoded first value
+ *
+ * @return None
+ * */
+static void startBlock(std::vector<uint8_t>& block, uint64_t count,
+                        uint64_t firstValue)
+{
+    block.clear();
+    block.push_back(COLUMNAR_FORMAT_VERSION);
+    writeVarint(block, 1);
+    block.push_back(0);
+    writeVarint(block, count);
+    writeVarint(block, 0);
+    writeVarint(block, firstValue);
+}
+
+/*!
+ * @brief Check that malformed blocks are rejected by both decoders, without
+ * allocating more than the limits allow
+ *
+ * @return None
+ * */
+static void testMalformed(void)
+{
+    std::vector<uint8_t> block;
+    std::vector<ChannelSamples> channels;
+
+    /* More samples than a block can hold, in a few bytes */
+    startBlock(block, COLUMNAR_MAX_SAMPLES + 1, 0);
+    writeVarint(block, ((uint64_t) COLUMNAR_MAX_SAMPLES << 1) | 1);
+    writeVarint(block, 0);
+    writeVarint(block, ((uint64_t) COLUMNAR_MAX_SAMPLES << 1) | 1);
+    writeVarint(block, 0);
+    LE_TEST(!ColumnarDecoder::decode(block.data(), block.size(), channels));
+    LE_TEST(!ColumnarDecoder::decodeFast(block.data(), block.size(),
+                                                                    channels));
+
+    /* Two channels within the limit each, not together */
+    block.clear();
+    block.push_back(COLUMNAR_FORMAT_VERSION);
+    writeVarint(block, 2);
+
+    for (uint8_t c = 0; c < 2; c++)
+    {
+        block.push_back(c);
+        writeVarint(block, COLUMNAR_MAX_SAMPLES);
+        writeVarint(block, 0);
+        writeVarint(block, 0);
+        writeVarint(block, ((uint64_t) (COLUMNAR_MAX_SAMPLES - 1) << 1) | 1);
+        writeVarint(block, 0);
+        writeVarint(block, ((uint64_t) (COLUMNAR_MAX_SAMPLES - 1) << 1) | 1);
+        writeVarint(block, 0);
+    }
+
+    LE_TEST(!ColumnarDecoder::decode(block.data(), block.size(), channels));
+
+    /* A run longer than the column */
+    startBlock(block, 3, 0);
+    writeVarint(block, (5 << 1) | 1);
+    writeVarint(block, 0);
+    LE_TEST(!ColumnarDecoder::decode(block.data(), block.size(), channels));
+
+    /* A value delta that would overflow the sum */
+    startBlock(block, 2, (uint64_t) INT32_MAX << 1);
+    writeVarint(block, (1 << 1) | 1);
+    writeVarint(block, 0);
+    writeVarint(block, 1 << 1);
+    writeVarint(block, UINT64_MAX - 1);
+    LE_TEST(!ColumnarDecoder::decode(block.data(), block.size(), channels));
+    LE_TEST(!ColumnarDecoder::decodeFast(block.data(), block.size(),
+                                                                    channels));
+
+    /* A first value out of range */
+    startBlock(block, 1, (uint64_t) INT32_MAX << 2);
+    LE_TEST(!ColumnarDecoder::decode(block.data(), block.size(), channels));
+
+    /* Every truncation of a valid block */
+    ColumnarEncoder encoder;
+
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        encoder.addSample(i % 3, i * i, (int32_t) (i * 1000003));
+    }
+
+    encoder.encode(block);
+
+    bool isRejected = true;
+
+    for (size_t len = 0; len < block.size(); len++)
+    {
+        isRejected = isRejected &&
+                        !ColumnarDecoder::decode(block.data(), len, channels) &&
+                        !ColumnarDecoder::decodeFast(block.data(), len,
+                                                                    channels);
+    }
+
+    LE_TEST(isRejected);
+    LE_TEST(ColumnarDecoder::verify(block.data(), block.size()));
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testRoundTrip();
+    testLimits();
+    testMalformed();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,325 @@
+/** @file ConnectivityProberTest.cpp
+ *
+ * @brief Unit test of ConnectivityProber against loopback targets: a DNS
+ * server answering after a set delay, a TCP listener and silent UDP ports.
+ * It checks that a round ends at the first answer, that a round without
+ * answer ends at the timeout after resending its probes, and the round trip
+ * time statistics. The rounds run from the event loop, each one started by
+ * the handler of the previous one.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/ConnectivityProber.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <time.h>
+
+using namespace ConnectivityProberConstants;
+using namespace ConnectivityProberTypes;
+
+static const char* TEST_ADDRESS = "127.0.0.1";
+
+/* Answer delays of the DNS server for the two rounds of the RTT test */
+static const uint32_t TEST_FIRST_DELAY_MS = 100;
+static const uint32_t TEST_SECOND_DELAY_MS = 300;
+
+/* Margin allowed on the times measured */
+static const uint32_t TEST_MARGIN_MS = 250;
+
+static ConnectivityProber* ProberPtr;
+
+/* Sockets of the targets */
+static int SilentFd = -1;
+static int SilentFd2 = -1;
+static int ListenFd = -1;
+static int DnsFd = -1;
+
+/* Query waiting for its answer, sent by DnsTimer */
+static uint8_t Query[512];
+static ssize_t QueryLen;
+static struct sockaddr_in QueryAddr;
+static uint32_t DnsDelayMs;
+static le_timer_Ref_t DnsTimer;
+
+static uint64_t RoundStartMs;
+static uint32_t FirstRttMs;
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Open a loopback socket on a port chosen by the kernel
+ *
+ * @param[in] type      SOCK_DGRAM or SOCK_STREAM
+ *
+ * @return Socket, -1 on failure
+ * */
+static int openSocket(int type)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((fd >= 0) &&
+        ((bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) ||
+         ((type == SOCK_STREAM) && (listen(fd, 4) < 0))))
+    {
+        ::close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+/*!
+ * @brief Get the target probing a socket of the test
+ *
+ * @param[in] type      How the socket is probed
+ * @param[in] fd        Socket
+ *
+ * @return Target
+ * */
+static ProbeTarget getTarget(ProbeType type, int fd)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    ProbeTarget target = {type, TEST_ADDRESS, 0};
+
+    if (getsockname(fd, (struct sockaddr*) &addr, &addrLen) == 0)
+    {
+        target.port = ntohs(addr.sin_port);
+    }
+
+    return target;
+}
+
+/*!
+ * @brief Send the answer of the query received by the DNS server
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void dnsTimerHandler(le_timer_Ref_t timerRef)
+{
+    /* Any answer will do, the prober only checks its identifier */
+    Query[2] |= 0x80;
+
+    sendto(DnsFd, Query, QueryLen, 0, (struct sockaddr*) &QueryAddr,
+            sizeof(QueryAddr));
+}
+
+/*!
+ * @brief Receive a query on the DNS server, answered after DnsDelayMs
+ *
+ * @param[in] fd        Socket of the server
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+static void dnsHandler(int fd, short events)
+{
+    socklen_t addrLen = sizeof(QueryAddr);
+
+    QueryLen = recvfrom(fd, Query, sizeof(Query), 0,
+                        (struct sockaddr*) &QueryAddr, &addrLen);
+
+    if (QueryLen > 2)
+    {
+        le_timer_SetMsInterval(DnsTimer, (DnsDelayMs > 0) ? DnsDelayMs : 1);
+        le_timer_Start(DnsTimer);
+    }
+}
+
+/*!
+ * @brief Start a round on new targets
+ *
+ * @param[in] targets   Targets of the round
+ * @param[in] handler   Called once the round is over
+ *
+ * @return None
+ * */
+static void startRound(const std::vector<ProbeTarget>& targets,
+                        ProbeHandler handler)
+{
+    LE_TEST(ProberPtr->setTargets(targets));
+
+    RoundStartMs = getNowMs();
+
+    LE_TEST(ProberPtr->start(handler, NULL));
+    LE_TEST(ProberPtr->isProbing());
+}
+
+/*!
+ * @brief End of the round without answer: it ends at the timeout, after
+ * sending the datagram probes again every PROBE_RESEND_MS. End of the test.
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onTimeoutRound(bool isReachable, uint32_t rttMs, void* contextPtr)
+{
+    uint32_t elapsedMs = getNowMs() - RoundStartMs;
+    ProbeStats stats;
+
+    LE_TEST(!isReachable);
+    LE_TEST(rttMs == 0);
+    LE_TEST(elapsedMs >= PROBE_TIMEOUT_MS);
+    LE_TEST(elapsedMs < (PROBE_TIMEOUT_MS + TEST_MARGIN_MS));
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        LE_TEST(ProberPtr->getTargetStats(i, &stats));
+        LE_TEST(stats.sentNb == (PROBE_TIMEOUT_MS / PROBE_RESEND_MS));
+        LE_TEST(stats.successNb == 0);
+    }
+
+    ProberPtr->logStats();
+
+    ::close(SilentFd);
+    ::close(SilentFd2);
+    ::close(ListenFd);
+    ::close(DnsFd);
+    delete ProberPtr;
+
+    LE_TEST_EXIT;
+}
+
+/*!
+ * @brief End of the second round of the RTT test: check the statistics of
+ * both rounds, then start a round on silent targets only
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onSecondRttRound(bool isReachable, uint32_t rttMs,
+                                void* contextPtr)
+{
+    ProbeStats stats;
+
+    LE_TEST(isReachable);
+    LE_TEST(rttMs >= TEST_SECOND_DELAY_MS);
+    LE_TEST(rttMs < (TEST_SECOND_DELAY_MS + TEST_MARGIN_MS));
+
+    LE_TEST(ProberPtr->getTargetStats(0, &stats));
+    LE_TEST(stats.sentNb == 2);
+    LE_TEST(stats.successNb == 2);
+    LE_TEST(stats.lastRttMs == rttMs);
+    LE_TEST(stats.minRttMs == FirstRttMs);
+    LE_TEST(stats.maxRttMs == rttMs);
+    LE_TEST(stats.smoothedRttMs == ((7 * FirstRttMs + rttMs) / 8));
+    LE_TEST(!ProberPtr->getTargetStats(1, &stats));
+
+    startRound({getTarget(PROBE_DNS, SilentFd),
+                getTarget(PROBE_DNS, SilentFd2)}, onTimeoutRound);
+}
+
+/*!
+ * @brief End of the first round of the RTT test: the answer is timed from
+ * the query, then a second round is run on the same target with a longer
+ * delay
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onFirstRttRound(bool isReachable, uint32_t rttMs,
+                            void* contextPtr)
+{
+    LE_TEST(isReachable);
+    LE_TEST(rttMs >= TEST_FIRST_DELAY_MS);
+    LE_TEST(rttMs < (TEST_FIRST_DELAY_MS + TEST_MARGIN_MS));
+
+    FirstRttMs = rttMs;
+    DnsDelayMs = TEST_SECOND_DELAY_MS;
+
+    /* Same targets, the statistics are kept */
+    RoundStartMs = getNowMs();
+    LE_TEST(ProberPtr->start(onSecondRttRound, NULL));
+}
+
+/*!
+ * @brief End of the round on a silent and a listening target: it ends at
+ * the TCP connection, without waiting for the silent target
+ *
+ * @param[in] isReachable   True if a target answered
+ * @param[in] rttMs         Round trip time of the answer
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void onFirstAnswerRound(bool isReachable, uint32_t rttMs,
+                                void* contextPtr)
+{
+    uint32_t elapsedMs = getNowMs() - RoundStartMs;
+    ProbeStats stats;
+
+    LE_TEST(isReachable);
+    LE_TEST(elapsedMs < PROBE_RESEND_MS);
+    LE_TEST(rttMs <= elapsedMs);
+    LE_TEST(!ProberPtr->isProbing());
+
+    /* The silent target was not sent its probe again */
+    LE_TEST(ProberPtr->getTargetStats(0, &stats));
+    LE_TEST(stats.sentNb == 1);
+    LE_TEST(stats.successNb == 0);
+
+    LE_TEST(ProberPtr->getTargetStats(1, &stats));
+    LE_TEST(stats.sentNb == 1);
+    LE_TEST(stats.successNb == 1);
+
+    DnsDelayMs = TEST_FIRST_DELAY_MS;
+    startRound({getTarget(PROBE_DNS, DnsFd)}, onFirstRttRound);
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    SilentFd = openSocket(SOCK_DGRAM);
+    SilentFd2 = openSocket(SOCK_DGRAM);
+    ListenFd = openSocket(SOCK_STREAM);
+    DnsFd = openSocket(SOCK_DGRAM);
+
+    LE_TEST((SilentFd >= 0) && (SilentFd2 >= 0) && (ListenFd >= 0) &&
+            (DnsFd >= 0));
+
+    le_fdMonitor_Create("TestDnsServer", DnsFd, dnsHandler, POLLIN);
+
+    DnsTimer = le_timer_Create("TestDnsTimer");
+    le_timer_SetHandler(DnsTimer, dnsTimerHandler);
+
+    ProberPtr = new ConnectivityProber();
+
+    startRound({getTarget(PROBE_DNS, SilentFd),
+                getTarget(PROBE_TCP, ListenFd)}, onFirstAnswerRound);
+}
+
+/*** end of file ***/
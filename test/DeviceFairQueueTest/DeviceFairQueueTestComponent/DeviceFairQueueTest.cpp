@@ -0,0 +1,180 @@
+/** @file DeviceFairQueueTest.cpp
+ *
+ * @brief Unit test of DeviceFairQueue: weighted shares, limits, and devices
+ * coming and going with the device table full
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/DeviceFairQueue.h"
+
+using namespace WearableDeviceALPConstants;
+using namespace DeviceFairQueueConstants;
+using namespace DeviceFairQueueTypes;
+
+static const uint32_t TEST_PDU_SIZE = 10000;
+static const uint32_t TEST_CHURN_NB = 10000;
+
+/*!
+ * @brief Build the MAC address of a device number
+ *
+ * @param[in] deviceId  Device number
+ * @param[out] mac      MAC address
+ *
+ * @return None
+ * */
+static void makeMac(uint32_t deviceId, uint8_t* mac)
+{
+    memset(mac, 0, MAC_ADDRESS_SIZE);
+    mac[0] = 0x02;
+    memcpy(&mac[2], &deviceId, sizeof(deviceId));
+}
+
+/*!
+ * @brief Check that two backlogged devices share the uplink by weight
+ *
+ * @return None
+ * */
+static void testShares(void)
+{
+    DeviceFairQueue queue;
+    std::vector<uint8_t> data(TEST_PDU_SIZE);
+    uint8_t macs[2][MAC_ADDRESS_SIZE];
+    uint32_t pduNb = FAIR_QUEUE_DEVICE_MAX_BYTES / TEST_PDU_SIZE;
+    DeviceStats stats[2];
+
+    makeMac(1, macs[0]);
+    makeMac(2, macs[1]);
+    LE_TEST(queue.setWeight(macs[1], 2));
+
+    for (uint32_t i = 0; i < pduNb; i++)
+    {
+        LE_TEST(queue.enqueue(macs[0], 1, data.data(), data.size()) == LE_OK);
+        LE_TEST(queue.enqueue(macs[1], 1, data.data(), data.size()) == LE_OK);
+    }
+
+    /* One round: a quantum for the first device, two for the second */
+    uint32_t roundPduNb = 3 * FAIR_QUEUE_QUANTUM / TEST_PDU_SIZE;
+
+    for (uint32_t i = 0; i < roundPduNb; i++)
+    {
+        LE_TEST(queue.peek() != NULL);
+        queue.pop();
+    }
+
+    LE_TEST(queue.getDeviceStats(macs[0], &stats[0]));
+    LE_TEST(queue.getDeviceStats(macs[1], &stats[1]));
+    LE_TEST(stats[0].servedBytesNb == FAIR_QUEUE_QUANTUM);
+    LE_TEST(stats[1].servedBytesNb == 2 * FAIR_QUEUE_QUANTUM);
+    LE_TEST(stats[1].weight == 2);
+
+    while (!queue.isEmpty())
+    {
+        queue.pop();
+    }
+
+    LE_TEST(queue.getQueuedBytesNb() == 0);
+}
+
+/*!
+ * @brief Check the errors of enqueue()
+ *
+ * @return None
+ * */
+static void testLimits(void)
+{
+    DeviceFairQueue queue;
+    std::vector<uint8_t> data(FAIR_QUEUE_QUANTUM + 1);
+    uint8_t mac[MAC_ADDRESS_SIZE];
+    DeviceStats stats;
+
+    makeMac(1, mac);
+    LE_TEST(queue.enqueue(NULL, 1, data.data(), 1) == LE_FAULT);
+    LE_TEST(queue.enqueue(mac, 1, data.data(), data.size()) == LE_OVERFLOW);
+
+    uint32_t pduNb = FAIR_QUEUE_DEVICE_MAX_BYTES / TEST_PDU_SIZE;
+
+    for (uint32_t i = 0; i < pduNb; i++)
+    {
+        queue.enqueue(mac, 1, data.data(), TEST_PDU_SIZE);
+    }
+
+    LE_TEST(queue.enqueue(mac, 1, data.data(), TEST_PDU_SIZE) ==
+                                                                LE_NO_MEMORY);
+    LE_TEST(queue.getDeviceStats(mac, &stats));
+    LE_TEST(stats.refusedNb == 1);
+}
+
+/*!
+ * @brief Fill the device table, then replace idle devices by new ones many
+ * times, checking that each PDU comes out with its own device
+ *
+ * @return None
+ * */
+static void testChurn(void)
+{
+    DeviceFairQueue queue;
+    uint8_t mac[MAC_ADDRESS_SIZE];
+    uint8_t data[sizeof(uint32_t)];
+
+    for (uint32_t i = 0; i < FAIR_QUEUE_MAX_DEVICES; i++)
+    {
+        makeMac(i, mac);
+        LE_TEST(queue.enqueue(mac, 1, data, sizeof(data)) == LE_OK);
+    }
+
+    /* No idle device to drop */
+    makeMac(FAIR_QUEUE_MAX_DEVICES, mac);
+    LE_TEST(queue.enqueue(mac, 1, data, sizeof(data)) == LE_NO_MEMORY);
+
+    while (!queue.isEmpty())
+    {
+        queue.pop();
+    }
+
+    bool isConsistent = true;
+
+    for (uint32_t i = 0; i < TEST_CHURN_NB; i++)
+    {
+        uint32_t deviceId = FAIR_QUEUE_MAX_DEVICES + i;
+
+        makeMac(deviceId, mac);
+        memcpy(data, &deviceId, sizeof(deviceId));
+        isConsistent = isConsistent &&
+                        (queue.enqueue(mac, 1, data, sizeof(data)) == LE_OK);
+
+        const QueuedPdu* pduPtr = queue.peek();
+
+        isConsistent = isConsistent && (pduPtr != NULL) &&
+                        (memcmp(pduPtr->mac, mac, MAC_ADDRESS_SIZE) == 0) &&
+                        (memcmp(pduPtr->data.data(), data, sizeof(data)) == 0);
+        queue.pop();
+    }
+
+    LE_TEST(isConsistent);
+    LE_TEST(queue.isEmpty());
+
+    /* The oldest devices were dropped, the last ones are still known */
+    DeviceStats stats;
+
+    makeMac(0, mac);
+    LE_TEST(!queue.getDeviceStats(mac, &stats));
+    makeMac(FAIR_QUEUE_MAX_DEVICES + TEST_CHURN_NB - 1, mac);
+    LE_TEST(queue.getDeviceStats(mac, &stats) && (stats.servedPduNb == 1));
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testShares();
+    testLimits();
+    testChurn();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
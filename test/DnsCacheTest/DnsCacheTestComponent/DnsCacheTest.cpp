@@ -0,0 +1,234 @@
+/** @file DnsCacheTest.cpp
+ *
+ * @brief Unit test of DnsCache against a DNS server on the loopback
+ * interface, queried along with a port where nothing listens: a name missing
+ * from the cache, then found in it, a name which doesn't exist, the
+ * unreachable server alone, and an expired answer used while it is
+ * refreshed. The test waits for the shortest TTL kept by the cache, about
+ * half a minute.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/DnsCache.h"
+#include "../../TestUtils/LoopbackDnsServer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <time.h>
+
+using namespace DnsCacheConstants;
+
+static const char* TEST_NAME = "ingest.example.com";
+static const char* TEST_ADDRESS = "10.0.0.1";
+static const char* TEST_NEW_ADDRESS = "10.0.0.2";
+static const char* TEST_UNKNOWN_NAME = "nx.example.com";
+
+/* Answer delay of the server, and margin allowed on the times measured */
+static const uint32_t TEST_DELAY_MS = 50;
+static const uint32_t TEST_MARGIN_MS = 250;
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Get a loopback port where nothing listens, so that the queries
+ * sent to it are refused
+ *
+ * @return Address and port, empty on failure
+ * */
+static std::string getClosedAddress(void)
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    std::string address;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((fd >= 0) &&
+        (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0) &&
+        (getsockname(fd, (struct sockaddr*) &addr, &addrLen) == 0))
+    {
+        address = "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    }
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+
+    return address;
+}
+
+/*!
+ * @brief Check a name missing from the cache, then found in it, whatever
+ * its case and final dot, while the other server is unreachable
+ *
+ * @param[in,out] cache     Cache
+ * @param[in,out] server    DNS server
+ *
+ * @return None
+ * */
+static void testMissAndHit(DnsCache& cache, LoopbackDnsServer& server)
+{
+    std::vector<std::string> addresses;
+    uint64_t startMs = getNowMs();
+
+    LE_TEST(!cache.lookup(TEST_NAME, &addresses));
+    LE_TEST(cache.resolve(TEST_NAME, DNS_TIMEOUT_MS, &addresses));
+
+    uint32_t elapsedMs = getNowMs() - startMs;
+
+    /* Answered by the server, before any query is sent again */
+    LE_TEST(elapsedMs >= TEST_DELAY_MS);
+    LE_TEST(elapsedMs < (TEST_DELAY_MS + TEST_MARGIN_MS));
+    LE_TEST((addresses.size() == 1) && (addresses[0] == TEST_ADDRESS));
+    LE_TEST(server.getQueryNb() == 1);
+
+    addresses.clear();
+    startMs = getNowMs();
+
+    LE_TEST(cache.resolve("INGEST.Example.com.", DNS_TIMEOUT_MS,
+                            &addresses));
+    LE_TEST((getNowMs() - startMs) < TEST_DELAY_MS);
+    LE_TEST((addresses.size() == 1) && (addresses[0] == TEST_ADDRESS));
+    LE_TEST(cache.lookup(TEST_NAME, NULL));
+    LE_TEST(server.getQueryNb() == 1);
+}
+
+/*!
+ * @brief Check that a name which doesn't exist fails at the answer, and
+ * that the answer is cached too
+ *
+ * @param[in,out] cache     Cache
+ * @param[in,out] server    DNS server
+ *
+ * @return None
+ * */
+static void testUnknownName(DnsCache& cache, LoopbackDnsServer& server)
+{
+    std::vector<std::string> addresses;
+    uint64_t startMs = getNowMs();
+
+    LE_TEST(!cache.resolve(TEST_UNKNOWN_NAME, DNS_TIMEOUT_MS, &addresses));
+    LE_TEST((getNowMs() - startMs) < (TEST_DELAY_MS + TEST_MARGIN_MS));
+    LE_TEST(addresses.empty());
+    LE_TEST(server.getQueryNb() == 2);
+
+    startMs = getNowMs();
+
+    LE_TEST(!cache.resolve(TEST_UNKNOWN_NAME, DNS_TIMEOUT_MS, &addresses));
+    LE_TEST((getNowMs() - startMs) < TEST_DELAY_MS);
+    LE_TEST(server.getQueryNb() == 2);
+}
+
+/*!
+ * @brief Check that a query to an unreachable server alone fails when it
+ * is refused, without waiting for the timeout, and that the cached answers
+ * are still used
+ *
+ * @param[in,out] cache         Cache
+ * @param[in] closedAddress     Address where nothing listens
+ *
+ * @return None
+ * */
+static void testUnreachableServer(DnsCache& cache,
+                                    const std::string& closedAddress)
+{
+    std::vector<std::string> addresses;
+    uint64_t startMs = getNowMs();
+
+    LE_TEST(cache.setServers({closedAddress}));
+    LE_TEST(!cache.resolve("other.example.com", DNS_TIMEOUT_MS, &addresses));
+    LE_TEST((getNowMs() - startMs) < DNS_RESEND_MS);
+
+    LE_TEST(cache.lookup(TEST_NAME, &addresses));
+    LE_TEST((addresses.size() == 1) && (addresses[0] == TEST_ADDRESS));
+}
+
+/*!
+ * @brief Check that an expired answer is still used at once, while it is
+ * refreshed from the server
+ *
+ * @param[in,out] cache     Cache
+ * @param[in,out] server    DNS server
+ *
+ * @return None
+ * */
+static void testStaleAnswer(DnsCache& cache, LoopbackDnsServer& server)
+{
+    std::vector<std::string> addresses;
+    uint32_t queryNb = server.getQueryNb();
+
+    server.setRecord(TEST_NAME, TEST_NEW_ADDRESS, 1);
+
+    /* The answer expires at the shortest TTL kept */
+    sleep(DNS_MIN_TTL_S);
+    usleep(TEST_MARGIN_MS * 1000);
+
+    uint64_t startMs = getNowMs();
+
+    LE_TEST(cache.lookup(TEST_NAME, &addresses));
+    LE_TEST((getNowMs() - startMs) < TEST_DELAY_MS);
+    LE_TEST((addresses.size() == 1) && (addresses[0] == TEST_ADDRESS));
+
+    /* The refusal of the unreachable server comes first */
+    uint64_t endMs = getNowMs() + TEST_DELAY_MS + TEST_MARGIN_MS;
+
+    while (getNowMs() < endMs)
+    {
+        cache.process(endMs - getNowMs());
+    }
+
+    LE_TEST(server.getQueryNb() == (queryNb + 1));
+    LE_TEST(cache.lookup(TEST_NAME, &addresses));
+    LE_TEST((addresses.size() == 1) && (addresses[0] == TEST_NEW_ADDRESS));
+}
+
+COMPONENT_INIT
+{
+    LoopbackDnsServer server;
+    DnsCache cache;
+    std::string closedAddress = getClosedAddress();
+
+    LE_TEST_INIT;
+
+    LE_TEST(server.start());
+    LE_TEST(!closedAddress.empty());
+
+    server.setDelayMs(TEST_DELAY_MS);
+    server.setRecord(TEST_NAME, TEST_ADDRESS, 1);
+
+    LE_TEST(cache.setServers({closedAddress, server.getAddress()}));
+
+    testMissAndHit(cache, server);
+    testUnknownName(cache, server);
+    testUnreachableServer(cache, closedAddress);
+
+    LE_TEST(cache.setServers({closedAddress, server.getAddress()}));
+
+    testStaleAnswer(cache, server);
+
+    cache.logStats();
+    server.stop();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,202 @@
+/** @file DspKernelsTest.cpp
+ *
+ * @brief Unit test of DspKernels: known results of each kernel on every
+ * variant the CPU supports, including the sizes that end in the scalar
+ * tails of the SIMD loops
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Dsp/DspKernels.h"
+#include <math.h>
+#include <vector>
+
+using namespace DspKernelsConstants;
+using namespace DspKernelsTypes;
+
+/* Sizes around the SIMD widths */
+static const uint32_t TEST_SIZES[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33};
+static const uint32_t TEST_SIZE_NB = sizeof(TEST_SIZES) / sizeof(TEST_SIZES[0]);
+
+/*!
+ * @brief Check the conversions on the extremes of the sample types
+ *
+ * @return True if all the samples are converted exactly
+ * */
+static bool checkConversions(void)
+{
+    bool status = true;
+
+    for (uint32_t s = 0; s < TEST_SIZE_NB; s++)
+    {
+        uint32_t n = TEST_SIZES[s];
+        std::vector<int16_t> samples16(n);
+        std::vector<uint8_t> samples24(n * DSP_INT24_SIZE);
+        std::vector<float> out16(n + 1, -1);
+        std::vector<float> out24(n + 1, -1);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            static const int32_t VALUES[] = {-32768, -1, 0, 1, 32767};
+            int32_t value24 = VALUES[i % 5] * 256 + ((i % 2) ? 255 : 0);
+
+            samples16[i] = VALUES[i % 5];
+            samples24[i * DSP_INT24_SIZE] = value24 & 0xFF;
+            samples24[i * DSP_INT24_SIZE + 1] = (value24 >> 8) & 0xFF;
+            samples24[i * DSP_INT24_SIZE + 2] = (value24 >> 16) & 0xFF;
+        }
+
+        DspKernels::convertInt16(samples16.data(), out16.data(), n, 0.5f);
+        DspKernels::convertInt24(samples24.data(), out24.data(), n, 0.25f);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            int32_t value24 = samples16[i] * 256 + ((i % 2) ? 255 : 0);
+
+            status = status && (out16[i] == samples16[i] * 0.5f) &&
+                        (out24[i] == value24 * 0.25f);
+        }
+
+        /* Nothing written past the end */
+        status = status && (out16[n] == -1) && (out24[n] == -1);
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Check the filter on a ramp, with coefficients and samples whose
+ * sums are exact whatever their order
+ *
+ * @return True if all the filtered samples are right
+ * */
+static bool checkFilter(void)
+{
+    static const uint32_t TAP_NBS[] = {1, 3, 4, 8, 9, 17};
+    static const uint32_t FACTORS[] = {1, 2, 4, 5};
+    std::vector<float> ramp(100);
+    std::vector<float> out(ramp.size() + 1);
+    bool status = true;
+
+    for (uint32_t i = 0; i < ramp.size(); i++)
+    {
+        ramp[i] = i;
+    }
+
+    for (uint32_t t = 0; t < (sizeof(TAP_NBS) / sizeof(TAP_NBS[0])); t++)
+    {
+        uint32_t tapNb = TAP_NBS[t];
+        std::vector<float> taps(tapNb, 0.5f);
+
+        for (uint32_t f = 0; f < (sizeof(FACTORS) / sizeof(FACTORS[0])); f++)
+        {
+            uint32_t factor = FACTORS[f];
+            uint32_t outNb = DspKernels::firDecimate(ramp.data(), ramp.size(),
+                                                        taps.data(), tapNb,
+                                                        factor, out.data());
+
+            status = status &&
+                        (outNb == ((ramp.size() - tapNb) / factor + 1));
+
+            for (uint32_t k = 0; k < outNb; k++)
+            {
+                /* Half the sum of tapNb consecutive integers */
+                float first = k * factor;
+                float expected = 0.5f * (first * tapNb +
+                                            tapNb * (tapNb - 1) / 2.0f);
+
+                status = status && (out[k] == expected);
+            }
+        }
+
+        /* Fewer samples than coefficients */
+        status = status && (DspKernels::firDecimate(ramp.data(), tapNb - 1,
+                                                    taps.data(), tapNb, 1,
+                                                    out.data()) == 0);
+    }
+
+    status = status && (DspKernels::firDecimate(ramp.data(), ramp.size(),
+                                                ramp.data(), 4, 0,
+                                                out.data()) == 0);
+
+    return status;
+}
+
+/*!
+ * @brief Check the reduction, with the minimum and maximum at both ends and
+ * in the middle of the samples
+ *
+ * @return True if all the reductions are right
+ * */
+static bool checkReduction(void)
+{
+    bool status = true;
+    Reduction result = DspKernels::reduce(NULL, 0);
+
+    status = (result.min == 0) && (result.max == 0) && (result.mean == 0);
+
+    for (uint32_t s = 1; s < TEST_SIZE_NB; s++)
+    {
+        uint32_t n = TEST_SIZES[s];
+
+        for (uint32_t position = 0; position < n; position++)
+        {
+            std::vector<float> samples(n, 1.0f);
+
+            samples[position] = -8.0f;
+            samples[(position + 1) % n] = 8.0f;
+
+            result = DspKernels::reduce(samples.data(), n);
+
+            /* The sums are exact, only the division rounds */
+            double sum = 0;
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                sum += samples[i];
+            }
+
+            status = status && (result.max == 8.0f) &&
+                        (result.min == ((n > 1) ? -8.0f : 8.0f)) &&
+                        (fabsf(result.mean - (float) (sum / n)) < 1e-6f);
+        }
+    }
+
+    return status;
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    for (uint8_t v = 0; v < KERNEL_VARIANT_NB; v++)
+    {
+        KernelVariant kernelVariant = (KernelVariant) v;
+
+        if (!DspKernels::setVariant(kernelVariant))
+        {
+            LE_INFO("DSP variant %s not supported",
+                    DspKernels::getVariantName(kernelVariant));
+            continue;
+        }
+
+        LE_INFO("DSP variant %s", DspKernels::getVariantName(kernelVariant));
+        LE_TEST(DspKernels::getVariant() == kernelVariant);
+        LE_TEST(checkConversions());
+        LE_TEST(checkFilter());
+        LE_TEST(checkReduction());
+    }
+
+    LE_TEST(DspKernels::setVariant(KERNEL_VARIANT_SCALAR));
+    LE_TEST(!DspKernels::setVariant(KERNEL_VARIANT_NB));
+
+    DspKernels::init();
+    LE_TEST(DspKernels::benchmark());
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
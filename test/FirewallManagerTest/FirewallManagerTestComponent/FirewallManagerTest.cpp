@@ -0,0 +1,249 @@
+/** @file FirewallManagerTest.cpp
+ *
+ * @brief Unit test of FirewallManager against stand-in iptables tools which
+ * keep the batches: the first batch setting everything, the calls without
+ * change, the batches holding only the changes, and the resync after a
+ * refused batch
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/FirewallManager.h"
+#include <fstream>
+#include <sstream>
+
+using namespace FirewallManagerConstants;
+
+static const std::string TEST_OWNER = "TEST";
+static const std::string TEST_LOOPBACK_RULE = "-i lo -j ACCEPT";
+static const std::string TEST_SSH_RULE = "-p tcp --dport 22 -j ACCEPT";
+static const std::string TEST_HTTP_RULE = "-p tcp --dport 80 -j ACCEPT";
+static const std::string TEST_DROP_RULE = "-j DROP";
+
+/* Directory of the stand-in tools, put first in the PATH */
+static std::string ToolDir;
+
+/*!
+ * @brief Write a stand-in tool
+ *
+ * @param[in] name      Name of the tool
+ * @param[in] script    Shell script run by the tool
+ *
+ * @return Status of the operation
+ * */
+static bool writeTool(const std::string& name, const std::string& script)
+{
+    std::string path = ToolDir + "/" + name;
+    std::ofstream file(path.c_str());
+
+    file << "#!/bin/sh\n" << script;
+    file.close();
+
+    return !file.fail() && (chmod(path.c_str(), 0700) == 0);
+}
+
+/*!
+ * @brief Install the stand-in tools. iptables-restore keeps its batch in
+ * "last" and counts the batches in "count", or refuses them while "refuse"
+ * exists. iptables reports that no jump is present.
+ *
+ * @return Status of the operation
+ * */
+static bool installTools(void)
+{
+    char dir[] = "/tmp/firewallTestXXXXXX";
+
+    if (mkdtemp(dir) == NULL)
+    {
+        return false;
+    }
+
+    ToolDir = dir;
+
+    std::string path = ToolDir + ":" + getenv("PATH");
+
+    return writeTool(FIREWALL_RESTORE_CMD,
+                        "[ -e " + ToolDir + "/refuse ] && exit 1\n"
+                        "cp \"$2\" " + ToolDir + "/last\n"
+                        "echo >> " + ToolDir + "/count\n") &&
+            writeTool(FIREWALL_CHECK_CMD, "exit 1\n") &&
+            (setenv("PATH", path.c_str(), 1) == 0);
+}
+
+/*!
+ * @brief Remove the stand-in tools and what they kept
+ *
+ * @return None
+ * */
+static void removeTools(void)
+{
+    static const char* FILES[] = {"last", "count", "refuse", "iptables",
+                                    "iptables-restore"};
+
+    for (uint8_t i = 0; i < (sizeof(FILES) / sizeof(FILES[0])); i++)
+    {
+        unlink((ToolDir + "/" + FILES[i]).c_str());
+    }
+
+    rmdir(ToolDir.c_str());
+}
+
+/*!
+ * @brief Read a file kept by the stand-in tools
+ *
+ * @param[in] name  Name of the file
+ *
+ * @return Content of the file, empty if there is none
+ * */
+static std::string readToolFile(const std::string& name)
+{
+    std::ifstream file((ToolDir + "/" + name).c_str());
+    std::stringstream content;
+
+    content << file.rdbuf();
+
+    return content.str();
+}
+
+/*!
+ * @brief Get the number of batches applied
+ *
+ * @return Number of batches
+ * */
+static size_t getBatchNb(void)
+{
+    return readToolFile("count").size();
+}
+
+/*!
+ * @brief Check the first batch, which declares the chain of the owner and
+ * sets all the rules, and that nothing is run when nothing changed
+ *
+ * @param[in,out] firewall  Firewall
+ *
+ * @return None
+ * */
+static void testFullBatch(FirewallManager& firewall)
+{
+    firewall.setPolicy("INPUT", "DROP");
+    firewall.addRule("INPUT", TEST_LOOPBACK_RULE);
+    firewall.addRule("INPUT", TEST_SSH_RULE);
+    firewall.addRule("INPUT", TEST_LOOPBACK_RULE);
+
+    LE_TEST(firewall.apply());
+    LE_TEST(getBatchNb() == 1);
+    LE_TEST(readToolFile("last") ==
+            "*filter\n"
+            ":INPUT DROP [0:0]\n"
+            ":TEST_INPUT - [0:0]\n"
+            "-I INPUT 1 -j TEST_INPUT\n"
+            "-A TEST_INPUT " + TEST_LOOPBACK_RULE + "\n"
+            "-A TEST_INPUT " + TEST_SSH_RULE + "\n"
+            "COMMIT\n");
+
+    /* Nothing changed, or changed back */
+    firewall.setPolicy("INPUT", "DROP");
+    firewall.addRule("INPUT", TEST_SSH_RULE);
+    LE_TEST(firewall.apply());
+    LE_TEST(getBatchNb() == 1);
+}
+
+/*!
+ * @brief Check that the next batches only hold the rules deleted and added,
+ * and the chains used for the first time
+ *
+ * @param[in,out] firewall  Firewall
+ *
+ * @return None
+ * */
+static void testChanges(FirewallManager& firewall)
+{
+    firewall.removeRule("INPUT", TEST_SSH_RULE);
+    firewall.addRule("INPUT", TEST_HTTP_RULE);
+
+    LE_TEST(!firewall.hasRule("INPUT", TEST_SSH_RULE));
+    LE_TEST(firewall.hasRule("INPUT", TEST_HTTP_RULE));
+    LE_TEST(firewall.apply());
+    LE_TEST(getBatchNb() == 2);
+    LE_TEST(readToolFile("last") ==
+            "*filter\n"
+            "-D TEST_INPUT " + TEST_SSH_RULE + "\n"
+            "-A TEST_INPUT " + TEST_HTTP_RULE + "\n"
+            "COMMIT\n");
+
+    /* A chain used for the first time is declared and jumped to */
+    firewall.addRule("FORWARD", TEST_DROP_RULE);
+    LE_TEST(firewall.apply());
+    LE_TEST(readToolFile("last") ==
+            "*filter\n"
+            ":TEST_FORWARD - [0:0]\n"
+            "-I FORWARD 1 -j TEST_FORWARD\n"
+            "-A TEST_FORWARD " + TEST_DROP_RULE + "\n"
+            "COMMIT\n");
+
+    firewall.setPolicy("INPUT", "ACCEPT");
+    LE_TEST(firewall.apply());
+    LE_TEST(readToolFile("last") == "*filter\n:INPUT ACCEPT [0:0]\nCOMMIT\n");
+}
+
+/*!
+ * @brief Check that a refused batch, or rules changed by someone else, make
+ * the next batch set all the rules again
+ *
+ * @param[in,out] firewall  Firewall
+ *
+ * @return None
+ * */
+static void testResync(FirewallManager& firewall)
+{
+    static const std::string FULL_BATCH =
+            "*filter\n"
+            ":TEST_FORWARD - [0:0]\n"
+            ":INPUT ACCEPT [0:0]\n"
+            ":TEST_INPUT - [0:0]\n"
+            "-I FORWARD 1 -j TEST_FORWARD\n"
+            "-A TEST_FORWARD " + TEST_DROP_RULE + "\n"
+            "-I INPUT 1 -j TEST_INPUT\n"
+            "-A TEST_INPUT " + TEST_LOOPBACK_RULE + "\n"
+            "-A TEST_INPUT " + TEST_HTTP_RULE + "\n"
+            "COMMIT\n";
+    size_t batchNb = getBatchNb();
+
+    writeTool("refuse", "");
+    firewall.removeRule("INPUT", TEST_HTTP_RULE);
+    LE_TEST(!firewall.apply());
+    LE_TEST(getBatchNb() == batchNb);
+
+    unlink((ToolDir + "/refuse").c_str());
+    firewall.addRule("INPUT", TEST_HTTP_RULE);
+    LE_TEST(firewall.apply());
+    LE_TEST(readToolFile("last") == FULL_BATCH);
+
+    firewall.invalidate();
+    LE_TEST(firewall.apply());
+    LE_TEST(getBatchNb() == (batchNb + 2));
+    LE_TEST(readToolFile("last") == FULL_BATCH);
+    firewall.logStats();
+}
+
+COMPONENT_INIT
+{
+    FirewallManager firewall(TEST_OWNER);
+
+    LE_TEST_INIT;
+
+    LE_TEST(installTools());
+
+    testFullBatch(firewall);
+    testChanges(firewall);
+    testResync(firewall);
+
+    removeTools();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,176 @@
+/** @file HashIndexTest.cpp
+ *
+ * @brief Unit test of HashIndex: lookups, stable entries across the
+ * rebuilds, and a long churn of devices coming and going
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Utils/HashIndex.h"
+
+static const uint16_t TEST_ENTRY_NB = 32;
+static const uint8_t TEST_KEY_SIZE = 6;
+static const uint32_t TEST_CHURN_NB = 100000;
+
+/*!
+ * @brief Build the key of a device number
+ *
+ * @param[in] deviceId  Device number
+ * @param[out] key      Key (TEST_KEY_SIZE bytes)
+ *
+ * @return None
+ * */
+static void makeKey(uint32_t deviceId, uint8_t* key)
+{
+    memset(key, 0, TEST_KEY_SIZE);
+    key[0] = 0x02;
+    memcpy(&key[2], &deviceId, sizeof(deviceId));
+}
+
+/*!
+ * @brief Insert, find and remove keys, and fill the index
+ *
+ * @return None
+ * */
+static void testBasic(void)
+{
+    HashIndex index(TEST_ENTRY_NB, TEST_KEY_SIZE);
+    uint8_t key[TEST_KEY_SIZE];
+
+    LE_TEST(index.getEntryNb() == TEST_ENTRY_NB);
+    makeKey(1, key);
+    LE_TEST(index.find(key) == -1);
+
+    int32_t entry = index.insert(key);
+
+    LE_TEST(entry >= 0);
+    LE_TEST(index.find(key) == entry);
+    LE_TEST(index.insert(key) == entry);
+    LE_TEST(memcmp(index.getKey(entry), key, TEST_KEY_SIZE) == 0);
+    LE_TEST(index.getUsedNb() == 1);
+
+    index.remove(entry);
+    LE_TEST(index.find(key) == -1);
+    LE_TEST(!index.isUsed(entry));
+    LE_TEST(index.getUsedNb() == 0);
+
+    for (uint32_t i = 0; i < TEST_ENTRY_NB; i++)
+    {
+        makeKey(100 + i, key);
+        LE_TEST(index.insert(key) >= 0);
+    }
+
+    LE_TEST(index.isFull());
+    makeKey(1000, key);
+    LE_TEST(index.insert(key) == -1);
+    LE_TEST(!index.isUsed(-1) && !index.isUsed(TEST_ENTRY_NB));
+}
+
+/*!
+ * @brief Check that the entries keep their number when the index is rebuilt
+ *
+ * @return None
+ * */
+static void testStableEntries(void)
+{
+    HashIndex index(TEST_ENTRY_NB, TEST_KEY_SIZE);
+    uint8_t key[TEST_KEY_SIZE];
+    int32_t entries[TEST_ENTRY_NB];
+
+    for (uint32_t i = 0; i < TEST_ENTRY_NB; i++)
+    {
+        makeKey(i, key);
+        entries[i] = index.insert(key);
+    }
+
+    /* Keep one key out of 4, enough removals to go over the tombstone
+     * threshold */
+    for (uint32_t i = 0; i < TEST_ENTRY_NB; i++)
+    {
+        if ((i % 4) != 3)
+        {
+            index.remove(entries[i]);
+        }
+    }
+
+    LE_TEST(index.getRebuildNb() > 0);
+
+    bool isStable = true;
+
+    for (uint32_t i = 3; i < TEST_ENTRY_NB; i += 4)
+    {
+        makeKey(i, key);
+        isStable = isStable && (index.find(key) == entries[i]);
+    }
+
+    LE_TEST(isStable);
+}
+
+/*!
+ * @brief Replace a random device by a new one many times with the index
+ * full, checking the index against a plain array
+ *
+ * @return None
+ * */
+static void testChurn(void)
+{
+    HashIndex index(TEST_ENTRY_NB, TEST_KEY_SIZE);
+    uint8_t key[TEST_KEY_SIZE];
+    uint32_t devices[TEST_ENTRY_NB];
+    uint32_t nextDeviceId = 0;
+    bool isConsistent = true;
+
+    for (uint32_t i = 0; i < TEST_ENTRY_NB; i++)
+    {
+        devices[i] = nextDeviceId++;
+        makeKey(devices[i], key);
+        index.insert(key);
+    }
+
+    srand(1);
+
+    for (uint32_t n = 0; n < TEST_CHURN_NB; n++)
+    {
+        uint32_t i = rand() % TEST_ENTRY_NB;
+        uint32_t goneId = devices[i];
+
+        makeKey(goneId, key);
+        index.remove(index.find(key));
+
+        devices[i] = nextDeviceId++;
+        makeKey(devices[i], key);
+        isConsistent = isConsistent && (index.insert(key) >= 0);
+
+        /* The device gone must not be found anymore */
+        makeKey(goneId, key);
+        isConsistent = isConsistent && (index.find(key) == -1);
+    }
+
+    for (uint32_t i = 0; i < TEST_ENTRY_NB; i++)
+    {
+        makeKey(devices[i], key);
+        isConsistent = isConsistent && (index.find(key) >= 0);
+    }
+
+    LE_TEST(isConsistent);
+    LE_TEST(index.getUsedNb() == TEST_ENTRY_NB);
+
+    /* The tombstones left by the removals were reclaimed */
+    LE_TEST(index.getRebuildNb() > 0);
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testBasic();
+    testStableEntries();
+    testChurn();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,316 @@
+/** @file HttpUploaderTest.cpp
+ *
+ * @brief Unit test of HttpUploader against a server on the loopback: the
+ * connection kept for the urgent classes, the queue limits per class, and
+ * the results given to the completion handlers
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/HttpUploader.h"
+#include "../../TestUtils/LoopbackHttpServer.h"
+#include <map>
+
+using namespace HttpUploaderConstants;
+using namespace HttpUploaderTypes;
+
+static const uint32_t TEST_DRAIN_MS = 20000;
+static const uint32_t TEST_START_MS = 1000;
+
+/* Result of a request, as given to its completion handler */
+struct TestCompletion
+{
+    UploadResult result;
+    int32_t httpCode;
+};
+
+/* Completions of all the requests, by request identifier */
+static std::map<uint32_t, TestCompletion> Completions;
+
+/* Attempts the server answered */
+static uint32_t DeliveredAttemptNb = 0;
+
+/*!
+ * @brief Keep the result of a request
+ *
+ * @param[in] requestId     Identifier of the request
+ * @param[in] result        Result of the upload
+ * @param[in] httpCode      HTTP status of the last response
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void completionHandler(uint32_t requestId, UploadResult result,
+                                int32_t httpCode, void* contextPtr)
+{
+    TestCompletion completion = {result, httpCode};
+
+    Completions[requestId] = completion;
+}
+
+/*!
+ * @brief Count the attempts the server answered
+ *
+ * @param[in] isDelivered   True if the server answered
+ * @param[in] socketFd      Socket of the connection, not used
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void activityHandler(bool isDelivered, int32_t socketFd,
+                            void* contextPtr)
+{
+    DeliveredAttemptNb += isDelivered ? 1 : 0;
+}
+
+/*!
+ * @brief Submit a request whose body is a single byte
+ *
+ * @param[in] uploader      Uploader
+ * @param[in] tag           Byte of the body, to find the request on the server
+ * @param[in] trafficClass  Class of the request
+ *
+ * @return Identifier of the request, 0 if it was refused
+ * */
+static uint32_t submitTagged(HttpUploader& uploader, uint8_t tag,
+                                TrafficClass trafficClass)
+{
+    uint32_t requestId = 0;
+
+    if (uploader.submit(&tag, 1, completionHandler, NULL, &requestId,
+                        trafficClass) != LE_OK)
+    {
+        return 0;
+    }
+
+    return requestId;
+}
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    le_clk_Time_t now = le_clk_GetRelativeTime();
+
+    return (uint64_t) now.sec * 1000 + now.usec / 1000;
+}
+
+/*!
+ * @brief Run the uploads until none is pending
+ *
+ * @param[in] uploader  Uploader
+ *
+ * @return True if all the uploads completed in time
+ * */
+static bool drain(HttpUploader& uploader)
+{
+    uint64_t endMs = getNowMs() + TEST_DRAIN_MS;
+
+    while (getNowMs() < endMs)
+    {
+        uploader.process(100);
+
+        if (uploader.getPendingNb() == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Run the uploads until the server received a number of requests,
+ * for TEST_START_MS at most. process() may return at once, the time is what
+ * gives the server the chance to receive the requests.
+ *
+ * @param[in] uploader  Uploader
+ * @param[in] server    Loopback server
+ * @param[in] requestNb Number of requests to wait for
+ *
+ * @return Number of requests received
+ * */
+static size_t runUntil(HttpUploader& uploader, LoopbackHttpServer& server,
+                        size_t requestNb)
+{
+    uint64_t endMs = getNowMs() + TEST_START_MS;
+
+    while ((getNowMs() < endMs) && (server.getRequestNb() < requestNb))
+    {
+        uploader.process(10);
+        usleep(1000);
+    }
+
+    return server.getRequestNb();
+}
+
+/*!
+ * @brief Check that the bulk requests use a single connection, leaving the
+ * other one to an alert which is served while the first bulk response is
+ * still awaited
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testPrioritySlot(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    size_t firstRequest = server.getRequestNb();
+    uint32_t bulkIds[3];
+    bool isSubmitted = true;
+
+    LE_TEST(uploader.init());
+    server.hold(true);
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        bulkIds[i] = submitTagged(uploader, 'b' + i, TRAFFIC_CLASS_BULK);
+        isSubmitted = isSubmitted && (bulkIds[i] != 0);
+    }
+
+    LE_TEST(isSubmitted);
+
+    /* The first bulk request waits for its response, the others for it */
+    LE_TEST(runUntil(uploader, server, firstRequest + 2) ==
+                                                        (firstRequest + 1));
+
+    uint32_t alertId = submitTagged(uploader, 'a', TRAFFIC_CLASS_ALERT);
+
+    LE_TEST(alertId != 0);
+    LE_TEST(runUntil(uploader, server, firstRequest + 2) ==
+                                                        (firstRequest + 2));
+    LE_TEST(server.getBody(firstRequest + 1) == std::vector<uint8_t>(1, 'a'));
+
+    server.hold(false);
+    LE_TEST(drain(uploader));
+
+    /* The other bulk requests follow, in the order they were submitted */
+    static const char ORDER[] = "bacd";
+    bool isOrdered = (server.getRequestNb() == (firstRequest + 4));
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        isOrdered = isOrdered && (server.getBody(firstRequest + i) ==
+                                            std::vector<uint8_t>(1, ORDER[i]));
+    }
+
+    LE_TEST(isOrdered);
+    LE_TEST(Completions[alertId].result == UPLOAD_RESULT_SUCCESS);
+    LE_TEST(Completions[bulkIds[2]].result == UPLOAD_RESULT_SUCCESS);
+    uploader.logStats();
+}
+
+/*!
+ * @brief Check the limit of queued requests of each class, and the requests
+ * refused outright
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testQueueLimits(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    uint8_t data = 0;
+
+    /* Not initialized */
+    LE_TEST(uploader.submit(&data, 1, completionHandler, NULL) == LE_FAULT);
+    LE_TEST(uploader.init());
+    LE_TEST(uploader.submit(&data, 1, completionHandler, NULL, NULL,
+                            TRAFFIC_CLASS_NB) == LE_FAULT);
+
+    for (uint8_t c = 0; c < TRAFFIC_CLASS_NB; c++)
+    {
+        bool isSubmitted = true;
+
+        for (uint16_t i = 0; i < UPLOADER_CLASS_MAX_QUEUED[c]; i++)
+        {
+            isSubmitted = isSubmitted &&
+                            (submitTagged(uploader, c, (TrafficClass) c) != 0);
+        }
+
+        LE_TEST(isSubmitted);
+        LE_TEST(submitTagged(uploader, c, (TrafficClass) c) == 0);
+    }
+
+    /* A full bulk queue does not stop the alerts, once their own queue
+     * has room again */
+    LE_TEST(drain(uploader));
+    LE_TEST(submitTagged(uploader, 0, TRAFFIC_CLASS_ALERT) != 0);
+    LE_TEST(drain(uploader));
+}
+
+/*!
+ * @brief Check the result given for the status codes of the server
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testResults(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    size_t firstRequest = server.getRequestNb();
+    uint32_t firstDeliveredNb;
+
+    LE_TEST(uploader.init());
+    uploader.setActivityHandler(activityHandler, NULL);
+    firstDeliveredNb = DeliveredAttemptNb;
+
+    /* A server error is retried */
+    server.queueStatus(500);
+
+    uint32_t retriedId = submitTagged(uploader, 'r', TRAFFIC_CLASS_BULK);
+
+    LE_TEST(drain(uploader));
+    LE_TEST(server.getRequestNb() == (firstRequest + 2));
+    LE_TEST((Completions[retriedId].result == UPLOAD_RESULT_SUCCESS) &&
+            (Completions[retriedId].httpCode == 200));
+
+    /* A bad request is dropped, a refused hub is flagged, without retry */
+    server.queueStatus(400);
+
+    uint32_t rejectedId = submitTagged(uploader, 'x', TRAFFIC_CLASS_BULK);
+
+    LE_TEST(drain(uploader));
+    server.queueStatus(403);
+
+    uint32_t flaggedId = submitTagged(uploader, 'f', TRAFFIC_CLASS_CONTROL);
+
+    LE_TEST(drain(uploader));
+    LE_TEST(server.getRequestNb() == (firstRequest + 4));
+    LE_TEST((Completions[rejectedId].result == UPLOAD_RESULT_REJECTED) &&
+            (Completions[rejectedId].httpCode == 400));
+    LE_TEST((Completions[flaggedId].result == UPLOAD_RESULT_FLAGGED) &&
+            (Completions[flaggedId].httpCode == 403));
+
+    /* Every attempt was answered */
+    LE_TEST((DeliveredAttemptNb - firstDeliveredNb) == 4);
+    uploader.logStats();
+}
+
+COMPONENT_INIT
+{
+    LoopbackHttpServer server;
+
+    LE_TEST_INIT;
+
+    LE_TEST(server.start());
+
+    testPrioritySlot(server);
+    testQueueLimits(server);
+    testResults(server);
+
+    server.stop();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
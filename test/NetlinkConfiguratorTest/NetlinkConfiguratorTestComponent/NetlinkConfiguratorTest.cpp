@@ -0,0 +1,236 @@
+/** @file NetlinkConfiguratorTest.cpp
+ *
+ * @brief Unit test of NetlinkConfigurator on the loopback interface of a
+ * private network namespace: the flush of the addresses, the changes made
+ * again without error, and the rollback of a failed batch, which must leave
+ * what already existed. It is skipped when the namespace can't be created
+ * or configured, which needs CAP_SYS_ADMIN and CAP_NET_ADMIN.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkConfigurator.h"
+#include <sched.h>
+#include <string>
+
+static const char* TEST_IF_NAME = "lo";
+static const char* TEST_ADDRESS = "192.168.10.1";
+static const uint8_t TEST_PREFIX_LEN = 24;
+static const char* TEST_GATEWAY = "192.168.10.254";
+
+/* Gateway on no subnet of the interface, the route to it is refused */
+static const char* TEST_UNREACHABLE_GATEWAY = "172.16.0.1";
+
+/*!
+ * @brief Run an ip command
+ *
+ * @param[in] arguments     Arguments of the command
+ *
+ * @return Status of the operation
+ * */
+static bool runIp(const std::string& arguments)
+{
+    std::string command = "ip " + arguments + " > /dev/null 2>&1";
+
+    return (system(command.c_str()) == 0);
+}
+
+/*!
+ * @brief Get the output of an ip command
+ *
+ * @param[in] arguments     Arguments of the command
+ *
+ * @return Output of the command
+ * */
+static std::string readIp(const std::string& arguments)
+{
+    std::string command = "ip " + arguments + " 2>/dev/null";
+    std::string output;
+    char buffer[256];
+    FILE* pipePtr = popen(command.c_str(), "r");
+
+    if (pipePtr == NULL)
+    {
+        return output;
+    }
+
+    while (fgets(buffer, sizeof(buffer), pipePtr) != NULL)
+    {
+        output += buffer;
+    }
+
+    pclose(pipePtr);
+
+    return output;
+}
+
+/*!
+ * @brief Check if the test interface has an address
+ *
+ * @param[in] address   Address with its prefix length
+ *
+ * @return True if the address is set
+ * */
+static bool hasAddress(const std::string& address)
+{
+    return (readIp("-o address show dev lo").find(" " + address + " ") !=
+            std::string::npos);
+}
+
+/*!
+ * @brief Count the default routes
+ *
+ * @param[in] gateway   Gateway of the routes
+ *
+ * @return Number of default routes through the gateway
+ * */
+static uint32_t countDefaultRoutes(const std::string& gateway)
+{
+    std::string routes = readIp("route show default");
+    std::string wanted = "via " + gateway + " ";
+    uint32_t count = 0;
+
+    for (size_t pos = routes.find(wanted); pos != std::string::npos;
+         pos = routes.find(wanted, pos + 1))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+/*!
+ * @brief Check if the test interface is up
+ *
+ * @return True if the interface is up
+ * */
+static bool isLinkUp(void)
+{
+    return (readIp("-o link show dev lo").find("<LOOPBACK,UP") !=
+            std::string::npos);
+}
+
+/*!
+ * @brief Check that a flush removes all the addresses, of both families,
+ * and that the batch sets the link and the default route after it
+ *
+ * @param[in,out] config    Configurator
+ *
+ * @return None
+ * */
+static void testFlush(NetlinkConfigurator& config)
+{
+    LE_TEST(runIp("address add 10.1.0.5/16 dev lo"));
+    LE_TEST(runIp("address add 10.1.0.6/16 dev lo"));
+    LE_TEST(runIp("-6 address add fd00::5/64 dev lo"));
+
+    LE_TEST(config.flushAddresses(TEST_IF_NAME));
+    LE_TEST(config.addAddress(TEST_IF_NAME, TEST_ADDRESS, TEST_PREFIX_LEN));
+    LE_TEST(config.setLinkUp(TEST_IF_NAME, true));
+    LE_TEST(config.addDefaultRoute(TEST_GATEWAY, TEST_IF_NAME));
+    LE_TEST(config.apply());
+
+    LE_TEST(!hasAddress("10.1.0.5/16"));
+    LE_TEST(!hasAddress("10.1.0.6/16"));
+    LE_TEST(!hasAddress("fd00::5/64"));
+    LE_TEST(hasAddress(std::string(TEST_ADDRESS) + "/" +
+                        std::to_string(TEST_PREFIX_LEN)));
+    LE_TEST(isLinkUp());
+    LE_TEST(countDefaultRoutes(TEST_GATEWAY) == 1);
+}
+
+/*!
+ * @brief Check that adding what already exists succeeds and changes
+ * nothing, and that such an addition is not undone by a rollback
+ *
+ * @param[in,out] config    Configurator
+ *
+ * @return None
+ * */
+static void testExisting(NetlinkConfigurator& config)
+{
+    std::string address = std::string(TEST_ADDRESS) + "/" +
+                            std::to_string(TEST_PREFIX_LEN);
+
+    LE_TEST(config.addAddress(TEST_IF_NAME, TEST_ADDRESS, TEST_PREFIX_LEN));
+    LE_TEST(config.addDefaultRoute(TEST_GATEWAY, TEST_IF_NAME));
+    LE_TEST(config.setLinkUp(TEST_IF_NAME, true));
+    LE_TEST(config.apply());
+    LE_TEST(hasAddress(address));
+    LE_TEST(countDefaultRoutes(TEST_GATEWAY) == 1);
+
+    /* Only the new address is removed when the batch fails */
+    LE_TEST(config.addAddress(TEST_IF_NAME, TEST_ADDRESS, TEST_PREFIX_LEN));
+    LE_TEST(config.addAddress(TEST_IF_NAME, "10.3.0.1", 24));
+    LE_TEST(runIp("route del default"));
+    LE_TEST(config.addDefaultRoute(TEST_UNREACHABLE_GATEWAY, TEST_IF_NAME));
+    LE_TEST(!config.apply());
+    LE_TEST(hasAddress(address));
+    LE_TEST(!hasAddress("10.3.0.1/24"));
+    LE_TEST(countDefaultRoutes(TEST_UNREACHABLE_GATEWAY) == 0);
+}
+
+/*!
+ * @brief Check that a failed batch restores the flushed addresses and the
+ * link state, and that a batch with an invalid parameter changes nothing
+ *
+ * @param[in,out] config    Configurator
+ *
+ * @return None
+ * */
+static void testRollback(NetlinkConfigurator& config)
+{
+    std::string address = std::string(TEST_ADDRESS) + "/" +
+                            std::to_string(TEST_PREFIX_LEN);
+
+    LE_TEST(config.flushAddresses(TEST_IF_NAME));
+    LE_TEST(config.addAddress(TEST_IF_NAME, "10.2.0.1", 24));
+    LE_TEST(config.setLinkUp(TEST_IF_NAME, false));
+    LE_TEST(config.addDefaultRoute(TEST_UNREACHABLE_GATEWAY, TEST_IF_NAME));
+    LE_TEST(!config.apply());
+
+    LE_TEST(hasAddress(address));
+    LE_TEST(hasAddress("127.0.0.1/8"));
+    LE_TEST(!hasAddress("10.2.0.1/24"));
+    LE_TEST(isLinkUp());
+
+    /* Nothing is sent once a change of the batch is invalid */
+    LE_TEST(config.flushAddresses(TEST_IF_NAME));
+    LE_TEST(!config.setLinkUp("nosuchif0", false));
+    LE_TEST(!config.apply());
+    LE_TEST(hasAddress(address));
+
+    /* The queue is empty after a failure */
+    LE_TEST(config.apply());
+    LE_TEST(hasAddress(address));
+}
+
+COMPONENT_INIT
+{
+    NetlinkConfigurator config;
+
+    LE_TEST_INIT;
+
+    /* The interfaces of the hub are left alone */
+    if ((unshare(CLONE_NEWNET) != 0) || !runIp("link set lo down"))
+    {
+        LE_INFO("Test skipped: no network namespace, or no CAP_NET_ADMIN");
+        LE_TEST_EXIT;
+    }
+
+    LE_TEST(config.open());
+
+    testFlush(config);
+    testExisting(config);
+    testRollback(config);
+
+    config.logStats();
+    config.close();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,309 @@
+/** @file NetlinkMonitorTest.cpp
+ *
+ * @brief Unit test of NetlinkMonitor on the loopback interface of a private
+ * network namespace: the link up and down events, the address and default
+ * route events, and the link states read again after the receive buffer
+ * overran. It is skipped when the namespace can't be created or configured,
+ * which needs CAP_SYS_ADMIN and CAP_NET_ADMIN.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/NetlinkMonitor.h"
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+using namespace NetlinkMonitorTypes;
+
+static const char* TEST_IF_NAME = "lo";
+static const char* TEST_ADDRESS = "10.9.0.1";
+static const uint8_t TEST_PREFIX_LEN = 24;
+static const char* TEST_GATEWAY = "10.9.0.2";
+
+/* Addresses added at once to overrun the receive buffer of the monitor */
+static const uint16_t TEST_FLOOD_ADDRESS_NB = 4000;
+
+/* Longest wait for an event */
+static const uint32_t TEST_EVENT_TIMEOUT_MS = 1000;
+
+/* Events received by the subscriber of the test interface */
+static std::vector<NetlinkEvent> Events;
+
+/* Events received by the subscriber of another interface */
+static uint32_t OtherEventNb;
+
+/*!
+ * @brief Run an ip command
+ *
+ * @param[in] arguments     Arguments of the command
+ *
+ * @return Status of the operation
+ * */
+static bool runIp(const std::string& arguments)
+{
+    std::string command = "ip " + arguments + " > /dev/null 2>&1";
+
+    return (system(command.c_str()) == 0);
+}
+
+/*!
+ * @brief Keep the events of the test interface
+ *
+ * @param[in] eventPtr      Event
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void recordEvent(const NetlinkEvent* eventPtr, void* contextPtr)
+{
+    Events.push_back(*eventPtr);
+}
+
+/*!
+ * @brief Count the events of another interface
+ *
+ * @param[in] eventPtr      Event
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void countOtherEvent(const NetlinkEvent* eventPtr, void* contextPtr)
+{
+    OtherEventNb++;
+}
+
+/*!
+ * @brief Count the events received of a type, for an address if given
+ *
+ * @param[in] type      Type of the events
+ * @param[in] address   Address of the events, NULL for any
+ *
+ * @return Number of events
+ * */
+static uint32_t countEvents(NetlinkEventType type, const char* address)
+{
+    uint32_t count = 0;
+
+    for (size_t i = 0; i < Events.size(); i++)
+    {
+        if ((Events[i].type == type) &&
+            ((address == NULL) || (strcmp(Events[i].address, address) == 0)))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*!
+ * @brief Handle the messages until an event is received
+ *
+ * @param[in,out] monitor   Monitor
+ * @param[in] type          Type of the event
+ * @param[in] address       Address of the event, NULL for any
+ *
+ * @return The event, NULL if it was not received in time
+ * */
+static const NetlinkEvent* waitRecorded(NetlinkMonitor& monitor,
+                                        NetlinkEventType type,
+                                        const char* address)
+{
+    for (uint32_t waitedMs = 0; waitedMs < TEST_EVENT_TIMEOUT_MS;
+         waitedMs += 100)
+    {
+        for (size_t i = 0; i < Events.size(); i++)
+        {
+            if ((Events[i].type == type) &&
+                ((address == NULL) ||
+                    (strcmp(Events[i].address, address) == 0)))
+            {
+                return &Events[i];
+            }
+        }
+
+        monitor.process(100);
+    }
+
+    return NULL;
+}
+
+/*!
+ * @brief Add host addresses to the test interface through a netlink socket
+ * of its own, without waiting for the kernel to acknowledge them
+ *
+ * @param[in] addressNb     Number of addresses
+ *
+ * @return Status of the operation
+ * */
+static bool floodAddresses(uint16_t addressNb)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct ifaddrmsg message;
+        struct rtattr localAttr;
+        struct in_addr local;
+    } request;
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    bool status = (fd >= 0);
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = RTM_NEWADDR;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL;
+    request.message.ifa_family = AF_INET;
+    request.message.ifa_prefixlen = 32;
+    request.message.ifa_index = if_nametoindex(TEST_IF_NAME);
+    request.localAttr.rta_len = RTA_LENGTH(sizeof(struct in_addr));
+    request.localAttr.rta_type = IFA_LOCAL;
+
+    for (uint16_t i = 0; status && (i < addressNb); i++)
+    {
+        request.header.nlmsg_seq = i + 1;
+        request.local.s_addr = htonl(0x0A0A0000 + i + 1);
+        status = (send(fd, &request, sizeof(request), 0) ==
+                    (ssize_t) sizeof(request));
+    }
+
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+
+    return status;
+}
+
+/*!
+ * @brief Check the link up and down events, and that the states read when
+ * the monitor is opened are not delivered
+ *
+ * @param[in,out] monitor   Monitor
+ *
+ * @return None
+ * */
+static void testLinkEvents(NetlinkMonitor& monitor)
+{
+    LE_TEST(!monitor.isLinkUp(TEST_IF_NAME));
+    LE_TEST(Events.empty());
+
+    LE_TEST(runIp("link set lo up"));
+    LE_TEST(waitRecorded(monitor, NETLINK_LINK_UP, NULL) != NULL);
+    LE_TEST(monitor.isLinkUp(TEST_IF_NAME));
+
+    LE_TEST(runIp("link set lo down"));
+    LE_TEST(waitRecorded(monitor, NETLINK_LINK_DOWN, NULL) != NULL);
+    LE_TEST(!monitor.isLinkUp(TEST_IF_NAME));
+
+    /* Only the transitions are delivered */
+    LE_TEST(runIp("link set lo up"));
+    monitor.process(TEST_EVENT_TIMEOUT_MS);
+    monitor.process(0);
+    LE_TEST(countEvents(NETLINK_LINK_UP, NULL) == 2);
+    LE_TEST(countEvents(NETLINK_LINK_DOWN, NULL) == 1);
+    LE_TEST(monitor.isLinkUp(TEST_IF_NAME));
+}
+
+/*!
+ * @brief Check the address and default route events
+ *
+ * @param[in,out] monitor   Monitor
+ *
+ * @return None
+ * */
+static void testAddressAndRouteEvents(NetlinkMonitor& monitor)
+{
+    const NetlinkEvent* eventPtr;
+
+    LE_TEST(runIp(std::string("address add ") + TEST_ADDRESS + "/" +
+                    std::to_string(TEST_PREFIX_LEN) + " dev lo"));
+    eventPtr = waitRecorded(monitor, NETLINK_ADDRESS_ADDED, TEST_ADDRESS);
+    LE_TEST((eventPtr != NULL) && (eventPtr->family == AF_INET) &&
+            (eventPtr->prefixLen == TEST_PREFIX_LEN) &&
+            (strcmp(eventPtr->ifName, TEST_IF_NAME) == 0));
+
+    LE_TEST(runIp(std::string("route add default via ") + TEST_GATEWAY +
+                    " dev lo"));
+    eventPtr = waitRecorded(monitor, NETLINK_DEFAULT_ROUTE_ADDED,
+                            TEST_GATEWAY);
+    LE_TEST((eventPtr != NULL) && (eventPtr->family == AF_INET) &&
+            (strcmp(eventPtr->ifName, TEST_IF_NAME) == 0));
+
+    /* A route which is not a default one is not delivered */
+    LE_TEST(runIp("route add 10.8.0.0/16 via 10.9.0.2 dev lo"));
+
+    LE_TEST(runIp("route del default"));
+    eventPtr = waitRecorded(monitor, NETLINK_DEFAULT_ROUTE_REMOVED,
+                            TEST_GATEWAY);
+    LE_TEST((eventPtr != NULL) &&
+            (strcmp(eventPtr->ifName, TEST_IF_NAME) == 0));
+    LE_TEST(countEvents(NETLINK_DEFAULT_ROUTE_ADDED, NULL) == 1);
+
+    LE_TEST(runIp(std::string("address del ") + TEST_ADDRESS + "/" +
+                    std::to_string(TEST_PREFIX_LEN) + " dev lo"));
+    eventPtr = waitRecorded(monitor, NETLINK_ADDRESS_REMOVED, TEST_ADDRESS);
+    LE_TEST((eventPtr != NULL) && (eventPtr->prefixLen == TEST_PREFIX_LEN));
+}
+
+/*!
+ * @brief Check that a link change lost in an overrun of the receive buffer
+ * is still delivered, from the link states read again
+ *
+ * @param[in,out] monitor   Monitor
+ *
+ * @return None
+ * */
+static void testOverrun(NetlinkMonitor& monitor)
+{
+    Events.clear();
+
+    /* The buffer is full when the link goes down, its event is dropped */
+    LE_TEST(floodAddresses(TEST_FLOOD_ADDRESS_NB));
+    LE_TEST(runIp("link set lo down"));
+
+    LE_TEST(waitRecorded(monitor, NETLINK_LINK_DOWN, NULL) != NULL);
+    LE_TEST(countEvents(NETLINK_LINK_DOWN, NULL) == 1);
+    LE_TEST(countEvents(NETLINK_ADDRESS_ADDED, NULL) <
+            TEST_FLOOD_ADDRESS_NB);
+    LE_TEST(!monitor.isLinkUp(TEST_IF_NAME));
+}
+
+COMPONENT_INIT
+{
+    NetlinkMonitor monitor;
+
+    LE_TEST_INIT;
+
+    /* The interfaces of the hub are left alone */
+    if ((unshare(CLONE_NEWNET) != 0) || !runIp("link set lo down"))
+    {
+        LE_INFO("Test skipped: no network namespace, or no CAP_NET_ADMIN");
+        LE_TEST_EXIT;
+    }
+
+    LE_TEST(monitor.open());
+    LE_TEST(monitor.subscribe(TEST_IF_NAME, NETLINK_ALL_EVENTS, recordEvent,
+                                NULL) >= 0);
+    LE_TEST(monitor.subscribe("eth9", NETLINK_ALL_EVENTS, countOtherEvent,
+                                NULL) >= 0);
+
+    testLinkEvents(monitor);
+    testAddressAndRouteEvents(monitor);
+    testOverrun(monitor);
+
+    LE_TEST(OtherEventNb == 0);
+
+    monitor.logStats();
+    monitor.close();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,228 @@
+/** @file PduJournalTest.cpp
+ *
+ * @brief Unit test of PduJournal: records read back, a torn record dropped
+ * when opening, and the group commit of a record that no other one follows
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/PduJournal.h"
+#include <dirent.h>
+
+using namespace PduJournalConstants;
+using namespace PduJournalTypes;
+
+static const std::string TEST_JOURNAL_NAME = "PduJournalTest";
+static const uint8_t TEST_MAC[WearableDeviceALPConstants::MAC_ADDRESS_SIZE] =
+{
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+
+/* Journal of the commit test, still used once COMPONENT_INIT returned */
+static PduJournal* CommitJournalPtr = NULL;
+
+/*!
+ * @brief Delete the files left by a previous run of the test
+ *
+ * @return None
+ * */
+static void clearJournal(void)
+{
+    std::string dir = JOURNAL_ROOT_DIR + "/" + TEST_JOURNAL_NAME;
+    DIR* dirPtr = opendir(dir.c_str());
+
+    if (dirPtr == NULL)
+    {
+        return;
+    }
+
+    struct dirent* entryPtr;
+
+    while ((entryPtr = readdir(dirPtr)) != NULL)
+    {
+        if (entryPtr->d_name[0] != '.')
+        {
+            unlink((dir + "/" + entryPtr->d_name).c_str());
+        }
+    }
+
+    closedir(dirPtr);
+}
+
+/*!
+ * @brief Append records, read them back, and check that the confirmed ones
+ * are not read again once the journal is opened again
+ *
+ * @return None
+ * */
+static void testAppendRead(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    RecordHeader header;
+    std::vector<uint8_t> payload;
+    uint8_t data[3] = {1, 2, 3};
+
+    clearJournal();
+    LE_TEST(journal.open());
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        LE_TEST(journal.append(i, TEST_MAC, data, i + 1) == LE_OK);
+    }
+
+    Position position = journal.getCursor();
+
+    for (uint32_t i = 0; i < sizeof(data); i++)
+    {
+        LE_TEST(journal.read(position, &header, payload) == LE_OK);
+        LE_TEST((header.type == i) && (payload.size() == (i + 1)));
+        LE_TEST(memcmp(header.mac, TEST_MAC, sizeof(TEST_MAC)) == 0);
+    }
+
+    LE_TEST(journal.read(position, &header, payload) == LE_NOT_FOUND);
+
+    /* Only the first two records are uploaded */
+    position = journal.getCursor();
+    journal.read(position, &header, payload);
+    journal.read(position, &header, payload);
+    LE_TEST(journal.confirm(position, header.sequence));
+    journal.close();
+
+    LE_TEST(journal.open());
+    position = journal.getCursor();
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST((header.type == 2) && (header.sequence == 3));
+    LE_TEST(journal.append(3, TEST_MAC, data, 1) == LE_OK);
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST(header.sequence == 4);
+    journal.close();
+}
+
+/*!
+ * @brief Damage the last record on flash, as a crash while writing it would,
+ * and check that it is dropped and overwritten when opening the journal
+ *
+ * @return None
+ * */
+static void testTornRecord(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    RecordHeader header;
+    std::vector<uint8_t> payload;
+    uint8_t data[16] = {0};
+
+    clearJournal();
+    LE_TEST(journal.open());
+    journal.append(0, TEST_MAC, data, sizeof(data));
+    journal.append(1, TEST_MAC, data, sizeof(data));
+    journal.close();
+
+    /* Flip a payload byte of the second record */
+    uint32_t recordSize = sizeof(RecordHeader) + sizeof(data);
+    std::string path = JOURNAL_ROOT_DIR + "/" + TEST_JOURNAL_NAME +
+                                                            "/00000000.seg";
+    int32_t fd = ::open(path.c_str(), O_WRONLY);
+    uint8_t damaged = 0xFF;
+
+    LE_TEST(fd >= 0);
+    LE_TEST(pwrite(fd, &damaged, 1, recordSize + sizeof(RecordHeader)) == 1);
+    ::close(fd);
+
+    LE_TEST(journal.open());
+
+    Position position = journal.getCursor();
+
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST(header.type == 0);
+    LE_TEST(journal.read(position, &header, payload) == LE_NOT_FOUND);
+
+    /* The next record takes the place of the torn one */
+    LE_TEST(journal.append(2, TEST_MAC, data, sizeof(data)) == LE_OK);
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST((header.type == 2) && (header.sequence == 2));
+    journal.close();
+}
+
+/*!
+ * @brief Check that the records are committed once JOURNAL_COMMIT_RECORDS
+ * of them were appended
+ *
+ * @return None
+ * */
+static void testGroupCommit(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    uint8_t data[4] = {0};
+
+    clearJournal();
+    LE_TEST(journal.open());
+
+    for (uint32_t i = 0; i < (JOURNAL_COMMIT_RECORDS - 1U); i++)
+    {
+        journal.append(0, TEST_MAC, data, sizeof(data));
+    }
+
+    LE_TEST(journal.getUncommittedNb() == (JOURNAL_COMMIT_RECORDS - 1U));
+    journal.append(0, TEST_MAC, data, sizeof(data));
+    LE_TEST(journal.getUncommittedNb() == 0);
+    journal.close();
+}
+
+/*!
+ * @brief Check that the last record appended was committed by the journal
+ * timer, then end the test
+ *
+ * @param[in] timerRef  Reference to the check timer
+ *
+ * @return None
+ * */
+static void commitCheckHandler(le_timer_Ref_t timerRef)
+{
+    LE_TEST(CommitJournalPtr->getUncommittedNb() == 0);
+
+    delete CommitJournalPtr;
+    le_timer_Delete(timerRef);
+
+    LE_TEST_EXIT;
+}
+
+/*!
+ * @brief Append a single record and check, from the event loop, that it is
+ * committed within JOURNAL_COMMIT_DELAY_MS although nothing follows it
+ *
+ * @return None
+ * */
+static void startCommitTimerTest(void)
+{
+    uint8_t data[4] = {0};
+
+    clearJournal();
+    CommitJournalPtr = new PduJournal(TEST_JOURNAL_NAME);
+    LE_TEST(CommitJournalPtr->open());
+    LE_TEST(CommitJournalPtr->append(0, TEST_MAC, data, sizeof(data)) ==
+                                                                        LE_OK);
+    LE_TEST(CommitJournalPtr->getUncommittedNb() == 1);
+
+    le_timer_Ref_t checkTimer = le_timer_Create("CommitCheckTimer");
+
+    le_timer_SetMsInterval(checkTimer, JOURNAL_COMMIT_DELAY_MS + 100);
+    le_timer_SetHandler(checkTimer, commitCheckHandler);
+    le_timer_Start(checkTimer);
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testAppendRead();
+    testTornRecord();
+    testGroupCommit();
+
+    /* Ends the test from the event loop */
+    startCommitTimerTest();
+}
+
+/*** end of file ***/
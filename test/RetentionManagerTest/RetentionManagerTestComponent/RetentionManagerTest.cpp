@@ -0,0 +1,283 @@
+/** @file RetentionManagerTest.cpp
+ *
+ * @brief Unit test of RetentionManager: compaction without loss, eviction
+ * keeping the alerts, and a reader whose next segment was evicted
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Storage/RetentionManager.h"
+#include <dirent.h>
+
+using namespace PduJournalConstants;
+using namespace PduJournalTypes;
+using namespace RetentionManagerConstants;
+using namespace RetentionManagerTypes;
+
+static const std::string TEST_JOURNAL_NAME = "RetentionManagerTest";
+static const uint8_t TEST_MAC[WearableDeviceALPConstants::MAC_ADDRESS_SIZE] =
+{
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+static const uint32_t TEST_SMALL_PDU_SIZE = 1024;
+static const uint32_t TEST_BIG_PDU_SIZE = 32 * 1024;
+static const uint32_t TEST_ALERT_PERIOD = 10;
+static const uint32_t TEST_MAX_STEPS = 100000;
+
+/*!
+ * @brief Delete the files left by a previous test
+ *
+ * @return None
+ * */
+static void clearJournal(void)
+{
+    std::string dir = JOURNAL_ROOT_DIR + "/" + TEST_JOURNAL_NAME;
+    DIR* dirPtr = opendir(dir.c_str());
+
+    if (dirPtr == NULL)
+    {
+        return;
+    }
+
+    struct dirent* entryPtr;
+
+    while ((entryPtr = readdir(dirPtr)) != NULL)
+    {
+        if (entryPtr->d_name[0] != '.')
+        {
+            unlink((dir + "/" + entryPtr->d_name).c_str());
+        }
+    }
+
+    closedir(dirPtr);
+}
+
+/*!
+ * @brief Append PDUs until the journal reaches a storage pressure
+ *
+ * @param[in] journal       Journal to fill
+ * @param[in] manager       Retention manager of the journal
+ * @param[in] pressure      Pressure to reach
+ * @param[in] isRandom      True for PDUs which cannot be compacted
+ * @param[in] alertPeriod   One PDU out of alertPeriod is an alert, none if 0
+ * @param[in,out] pduNb     Number of PDUs appended
+ * @param[in,out] alertNb   Number of alert PDUs appended
+ *
+ * @return None
+ * */
+static void fillJournal(PduJournal& journal, RetentionManager& manager,
+                        RetentionPressure pressure, bool isRandom,
+                        uint32_t alertPeriod, uint32_t* pduNb,
+                        uint32_t* alertNb)
+{
+    std::vector<uint8_t> data(isRandom ? TEST_BIG_PDU_SIZE :
+                                                        TEST_SMALL_PDU_SIZE);
+
+    while (manager.getPressure() < pressure)
+    {
+        bool isAlert = (alertPeriod > 0) && ((*pduNb % alertPeriod) == 0);
+
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            data[i] = isRandom ? rand() : (i % 16);
+        }
+
+        if (journal.append(1, TEST_MAC, data.data(), data.size(),
+                            isAlert ? JOURNAL_FLAG_ALERT : 0) != LE_OK)
+        {
+            return;
+        }
+
+        (*pduNb)++;
+        *alertNb += isAlert ? 1 : 0;
+    }
+}
+
+/*!
+ * @brief Run the retention until it has nothing more to do
+ *
+ * @param[in] manager   Retention manager
+ *
+ * @return True if it stopped by itself
+ * */
+static bool runRetention(RetentionManager& manager)
+{
+    for (uint32_t i = 0; i < TEST_MAX_STEPS; i++)
+    {
+        if (!manager.step())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Count the PDUs of the journal not consumed yet, a compacted record
+ * counting for the PDUs it holds
+ *
+ * @param[in] journal       Journal
+ * @param[out] pduNb        Number of PDUs
+ * @param[out] alertNb      Number of alert PDUs
+ *
+ * @return True if the sequences of the records only increase
+ * */
+static bool countPdus(PduJournal& journal, uint32_t* pduNb, uint32_t* alertNb)
+{
+    Position position = journal.getCursor();
+    RecordHeader header;
+    std::vector<uint8_t> payload;
+    uint64_t lastSequence = 0;
+    bool isOrdered = true;
+
+    *pduNb = 0;
+    *alertNb = 0;
+
+    while (journal.read(position, &header, payload) == LE_OK)
+    {
+        if ((header.flags & JOURNAL_FLAG_COMPACTED) != 0)
+        {
+            *pduNb += payload[2] | (payload[3] << 8);
+        }
+        else
+        {
+            (*pduNb)++;
+        }
+
+        *alertNb += ((header.flags & JOURNAL_FLAG_ALERT) != 0) ? 1 : 0;
+        isOrdered = isOrdered && (header.sequence > lastSequence);
+        lastSequence = header.sequence;
+    }
+
+    return isOrdered;
+}
+
+/*!
+ * @brief Fill the journal with PDUs which can be compacted, and check that
+ * the compaction brings it back under the threshold without losing any
+ *
+ * @return None
+ * */
+static void testCompaction(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    RetentionManager manager(journal);
+    uint32_t pduNb = 0;
+    uint32_t alertNb = 0;
+    uint32_t readPduNb;
+    uint32_t readAlertNb;
+
+    clearJournal();
+    LE_TEST(journal.open());
+    fillJournal(journal, manager, RETENTION_PRESSURE_COMPACT, false,
+                TEST_ALERT_PERIOD, &pduNb, &alertNb);
+    LE_TEST(manager.getPressure() == RETENTION_PRESSURE_COMPACT);
+
+    LE_TEST(runRetention(manager));
+    LE_TEST(manager.getPressure() == RETENTION_PRESSURE_NONE);
+    LE_TEST(countPdus(journal, &readPduNb, &readAlertNb));
+    LE_TEST((readPduNb == pduNb) && (readAlertNb == alertNb));
+    manager.logStats();
+    journal.close();
+}
+
+/*!
+ * @brief Fill the journal with PDUs which cannot be compacted, and check
+ * that the eviction brings it under the threshold and keeps the alerts
+ *
+ * @return None
+ * */
+static void testEviction(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    RetentionManager manager(journal);
+    uint32_t pduNb = 0;
+    uint32_t alertNb = 0;
+    uint32_t readPduNb;
+    uint32_t readAlertNb;
+
+    clearJournal();
+    LE_TEST(journal.open());
+    fillJournal(journal, manager, RETENTION_PRESSURE_EVICT, true,
+                TEST_ALERT_PERIOD, &pduNb, &alertNb);
+    LE_TEST(manager.getPressure() == RETENTION_PRESSURE_EVICT);
+
+    LE_TEST(runRetention(manager));
+    LE_TEST(manager.getPressure() < RETENTION_PRESSURE_EVICT);
+    LE_TEST(countPdus(journal, &readPduNb, &readAlertNb));
+    LE_TEST((readPduNb < pduNb) && (readAlertNb == alertNb));
+    manager.logStats();
+    journal.close();
+}
+
+/*!
+ * @brief Leave a reader at the start of a segment it did not read yet, as
+ * after a crash right after the segment was created, let that segment be
+ * evicted, and check that the reader goes on with the next one
+ *
+ * @return None
+ * */
+static void testReaderAfterEviction(void)
+{
+    PduJournal journal(TEST_JOURNAL_NAME);
+    RetentionManager manager(journal);
+    RecordHeader header;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> data(TEST_BIG_PDU_SIZE);
+    uint32_t pduNb = 0;
+    uint32_t alertNb = 0;
+
+    clearJournal();
+    LE_TEST(journal.open());
+    journal.append(1, TEST_MAC, data.data(), data.size());
+    journal.close();
+
+    /* Empty segment, as left by a crash before its first record */
+    std::string path = JOURNAL_ROOT_DIR + "/" + TEST_JOURNAL_NAME +
+                                                            "/00000001.seg";
+    int32_t fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+
+    LE_TEST((fd >= 0) && (ftruncate(fd, JOURNAL_SEGMENT_SIZE) == 0));
+    ::close(fd);
+
+    LE_TEST(journal.open());
+    LE_TEST(journal.getSegmentNb() == 2);
+
+    Position position = journal.getCursor();
+
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST(journal.read(position, &header, payload) == LE_NOT_FOUND);
+    LE_TEST(position.segmentId == 1);
+
+    /* The reader did not read anything from segment 1, which is evicted as
+     * a whole: it has no alert */
+    fillJournal(journal, manager, RETENTION_PRESSURE_EVICT, true, 0, &pduNb,
+                &alertNb);
+    LE_TEST(runRetention(manager));
+    LE_TEST(manager.getPressure() < RETENTION_PRESSURE_EVICT);
+
+    LE_TEST(journal.read(position, &header, payload) == LE_OK);
+    LE_TEST(position.segmentId > 1);
+    journal.close();
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    srand(1);
+
+    testCompaction();
+    testEviction();
+    testReaderAfterEviction();
+
+    clearJournal();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,152 @@
+/** @file RollingAggregatorTest.cpp
+ *
+ * @brief Unit test of RollingAggregator: statistics of a window, closing of
+ * the windows, and eviction when more channels than windows send samples
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Aggregation/RollingAggregator.h"
+#include <math.h>
+
+using namespace RollingAggregatorConstants;
+using namespace RollingAggregatorTypes;
+
+static const uint8_t TEST_MAC[WearableDeviceALPConstants::MAC_ADDRESS_SIZE] =
+{
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+
+/*!
+ * @brief Tell whether two values are close enough
+ *
+ * @param[in] value     Value computed
+ * @param[in] expected  Value expected
+ *
+ * @return True if they differ by less than 1e-3
+ * */
+static bool isNear(double value, double expected)
+{
+    return (fabs(value - expected) < 1e-3);
+}
+
+/*!
+ * @brief Check the statistics of a window and its closing by a sample of the
+ * next window
+ *
+ * @return None
+ * */
+static void testWindow(void)
+{
+    RollingAggregator aggregator;
+    Summary summary;
+
+    /* 1, 2, 3, 4: mean 2.5, population variance 1.25 */
+    for (uint32_t i = 1; i <= 4; i++)
+    {
+        aggregator.addSample(TEST_MAC, 3, i * 1000, (float) i);
+    }
+
+    LE_TEST(aggregator.getSummaryNb() == 0);
+
+    aggregator.addSample(TEST_MAC, 3, AGGREGATE_WINDOW_MS + 1000, 10.0f);
+    LE_TEST(aggregator.popSummary(&summary));
+    LE_TEST(memcmp(summary.mac, TEST_MAC, sizeof(TEST_MAC)) == 0);
+    LE_TEST(summary.channelId == 3);
+    LE_TEST(summary.windowStart == 0);
+    LE_TEST(summary.count == 4);
+    LE_TEST(isNear(summary.min, 1.0) && isNear(summary.max, 4.0));
+    LE_TEST(isNear(summary.mean, 2.5));
+    LE_TEST(isNear(summary.variance, 1.25));
+    LE_TEST(isNear(summary.last, 4.0));
+    LE_TEST(!aggregator.popSummary(&summary));
+
+    /* A late sample is counted in the current window */
+    aggregator.addSample(TEST_MAC, 3, 5000, 20.0f);
+    aggregator.closeAll();
+    LE_TEST(aggregator.popSummary(&summary));
+    LE_TEST(summary.windowStart == AGGREGATE_WINDOW_MS);
+    LE_TEST(summary.count == 2);
+    LE_TEST(isNear(summary.max, 20.0));
+}
+
+/*!
+ * @brief Check that a window is closed once its lateness is over
+ *
+ * @return None
+ * */
+static void testExpiry(void)
+{
+    RollingAggregator aggregator;
+    Summary summary;
+
+    aggregator.addSample(TEST_MAC, 0, 1000, 1.0f);
+
+    aggregator.closeExpired(AGGREGATE_WINDOW_MS + AGGREGATE_LATENESS_MS - 1);
+    LE_TEST(aggregator.getSummaryNb() == 0);
+
+    aggregator.closeExpired(AGGREGATE_WINDOW_MS + AGGREGATE_LATENESS_MS);
+    LE_TEST(aggregator.popSummary(&summary));
+    LE_TEST(summary.count == 1);
+
+    aggregator.closeAll();
+    LE_TEST(aggregator.getSummaryNb() == 0);
+}
+
+/*!
+ * @brief Send samples on twice as many channels as windows, many times, and
+ * check that no sample is lost: an evicted window is summarized first
+ *
+ * @return None
+ * */
+static void testEviction(void)
+{
+    RollingAggregator aggregator;
+    Summary summary;
+    uint8_t mac[WearableDeviceALPConstants::MAC_ADDRESS_SIZE];
+    uint32_t channelNb = 2 * AGGREGATE_MAX_WINDOWS;
+    uint32_t roundNb = 10;
+    uint64_t countedNb = 0;
+
+    memcpy(mac, TEST_MAC, sizeof(mac));
+
+    for (uint32_t round = 0; round < roundNb; round++)
+    {
+        for (uint32_t i = 0; i < channelNb; i++)
+        {
+            mac[4] = i / AGGREGATE_MAX_CHANNELS;
+            aggregator.addSample(mac, i % AGGREGATE_MAX_CHANNELS,
+                                    round * 1000, 1.0f);
+
+            while (aggregator.popSummary(&summary))
+            {
+                countedNb += summary.count;
+            }
+        }
+    }
+
+    aggregator.closeAll();
+
+    while (aggregator.popSummary(&summary))
+    {
+        countedNb += summary.count;
+    }
+
+    LE_TEST(countedNb == (uint64_t) channelNb * roundNb);
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testWindow();
+    testExpiry();
+    testEviction();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,301 @@
+/** @file LoopbackDnsServer.cpp
+ *
+ * @brief Minimal DNS server over UDP on the loopback interface, for the unit
+ * tests of the name resolution. It answers the A queries of the names set
+ * by the test, after a set delay, and NXDOMAIN for the other names.
+ *
+ * The queries are served in order by a thread, so that a test waiting for
+ * an answer in its own thread gets it.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "LoopbackDnsServer.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+/* Period at which the thread checks that the server is stopping */
+static const int32_t SERVER_POLL_MS = 100;
+
+/* Size of a DNS message over UDP, and of its header */
+static const size_t SERVER_MESSAGE_SIZE = 512;
+static const size_t SERVER_HEADER_SIZE = 12;
+
+/* Size of an address record, its name being a pointer to the question */
+static const size_t SERVER_RECORD_SIZE = 16;
+
+/*!
+ * @brief Constructor for LoopbackDnsServer. start() must be called before
+ * use.
+ * */
+LoopbackDnsServer::LoopbackDnsServer(void) : fd(-1), port(0),
+                                                isStopping(false), delayMs(0),
+                                                queryNb(0)
+{
+}
+
+/*!
+ * @brief Destructor for LoopbackDnsServer
+ * */
+LoopbackDnsServer::~LoopbackDnsServer(void)
+{
+    stop();
+}
+
+/*!
+ * @brief Serve on an ephemeral port of the loopback interface
+ *
+ * @return Status of the operation
+ * */
+bool LoopbackDnsServer::start(void)
+{
+    struct sockaddr_in address;
+    socklen_t addressLen = sizeof(address);
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if ((fd < 0) ||
+        (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0) ||
+        (getsockname(fd, (struct sockaddr*) &address, &addressLen) != 0))
+    {
+        LE_ERROR("Failed to serve on the loopback: %m");
+        return false;
+    }
+
+    port = ntohs(address.sin_port);
+    serverThread = std::thread(&LoopbackDnsServer::serveQueries, this);
+
+    return true;
+}
+
+/*!
+ * @brief Stop serving and wait for the thread
+ *
+ * @return None
+ * */
+void LoopbackDnsServer::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        isStopping = true;
+    }
+
+    if (serverThread.joinable())
+    {
+        serverThread.join();
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+/*!
+ * @brief Get the address to query
+ *
+ * @return Address and port of the server
+ * */
+std::string LoopbackDnsServer::getAddress(void) const
+{
+    return "127.0.0.1:" + std::to_string(port);
+}
+
+/*!
+ * @brief Set the answer of a name, replacing the previous one
+ *
+ * @param[in] name      Host name, lower case and without the final dot
+ * @param[in] address   IPv4 address of the name
+ * @param[in] ttlS      TTL of the answer
+ *
+ * @return None
+ * */
+void LoopbackDnsServer::setRecord(const std::string& name,
+                                    const std::string& address, uint32_t ttlS)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    records[name] = {address, ttlS};
+}
+
+/*!
+ * @brief Set the time waited before answering each query
+ *
+ * @param[in] delay     Delay in milliseconds
+ *
+ * @return None
+ * */
+void LoopbackDnsServer::setDelayMs(uint32_t delay)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    delayMs = delay;
+}
+
+/*!
+ * @brief Get the number of queries received
+ *
+ * @return Number of queries
+ * */
+uint32_t LoopbackDnsServer::getQueryNb(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return queryNb;
+}
+
+/*!
+ * @brief Build the answer of a query: the question, followed by the address
+ * of the name if it is known
+ *
+ * @param[in] query     Query received
+ * @param[in] len       Size of the query
+ * @param[out] answer   Answer, of SERVER_MESSAGE_SIZE bytes
+ *
+ * @return Size of the answer, 0 if the query is invalid
+ * */
+size_t LoopbackDnsServer::buildAnswer(const uint8_t* query, size_t len,
+                                        uint8_t* answer)
+{
+    std::string name;
+    size_t offset = SERVER_HEADER_SIZE;
+    struct in_addr address;
+
+    while ((offset < len) && (query[offset] != 0))
+    {
+        uint8_t labelLen = query[offset];
+
+        if ((labelLen > 63) || ((offset + 1 + labelLen) >= len))
+        {
+            return 0;
+        }
+
+        for (uint8_t i = 0; i < labelLen; i++)
+        {
+            name += (char) tolower(query[offset + 1 + i]);
+        }
+
+        offset += 1 + labelLen;
+
+        if (query[offset] != 0)
+        {
+            name += '.';
+        }
+    }
+
+    /* End of the name, type and class */
+    offset += 5;
+
+    if ((offset > len) ||
+        ((offset + SERVER_RECORD_SIZE) > SERVER_MESSAGE_SIZE))
+    {
+        return 0;
+    }
+
+    memcpy(answer, query, offset);
+
+    /* Response, recursion desired and available, a single question */
+    answer[2] = 0x81;
+    answer[3] = 0x80;
+    answer[4] = 0;
+    answer[5] = 1;
+    memset(&answer[6], 0, 6);
+
+    std::map<std::string, Record>::const_iterator it = records.find(name);
+
+    if ((it == records.end()) ||
+        (inet_pton(AF_INET, it->second.address.c_str(), &address) != 1))
+    {
+        answer[3] |= 3;
+        return offset;
+    }
+
+    uint32_t ttlS = it->second.ttlS;
+    const uint8_t record[] =
+    {
+        0xC0, SERVER_HEADER_SIZE, 0, 1, 0, 1,
+        (uint8_t) (ttlS >> 24), (uint8_t) (ttlS >> 16),
+        (uint8_t) (ttlS >> 8), (uint8_t) ttlS, 0, 4
+    };
+
+    answer[7] = 1;
+    memcpy(&answer[offset], record, sizeof(record));
+    memcpy(&answer[offset + sizeof(record)], &address, 4);
+
+    return offset + SERVER_RECORD_SIZE;
+}
+
+/*!
+ * @brief Answer the queries until the server is stopping
+ *
+ * @return None
+ * */
+void LoopbackDnsServer::serveQueries(void)
+{
+    struct pollfd pollFd = {fd, POLLIN, 0};
+    uint8_t query[SERVER_MESSAGE_SIZE];
+    uint8_t answer[SERVER_MESSAGE_SIZE];
+
+    while (true)
+    {
+        struct sockaddr_in client;
+        socklen_t clientLen = sizeof(client);
+        size_t answerLen;
+        uint32_t delay;
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (isStopping)
+            {
+                return;
+            }
+        }
+
+        if (poll(&pollFd, 1, SERVER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t len = recvfrom(fd, query, sizeof(query), 0,
+                                (struct sockaddr*) &client, &clientLen);
+
+        if (len < (ssize_t) SERVER_HEADER_SIZE)
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            queryNb++;
+            delay = delayMs;
+            answerLen = buildAnswer(query, len, answer);
+        }
+
+        if (answerLen == 0)
+        {
+            continue;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        sendto(fd, answer, answerLen, 0, (struct sockaddr*) &client,
+                clientLen);
+    }
+}
+
+/*** end of file ***/
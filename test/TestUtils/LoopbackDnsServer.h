@@ -0,0 +1,57 @@
+/** @file LoopbackDnsServer.h
+ *
+ * @brief Minimal DNS server over UDP on the loopback interface, for the unit
+ * tests of the name resolution. It answers the A queries of the names set
+ * by the test, after a set delay, and NXDOMAIN for the other names.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef LOOPBACK_DNS_SERVER_H
+#define LOOPBACK_DNS_SERVER_H
+
+#include "legato.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class LoopbackDnsServer
+{
+    private:
+        /* Answer of a name */
+        struct Record
+        {
+            std::string address;
+            uint32_t ttlS;
+        };
+
+        int32_t fd;
+        uint16_t port;
+        bool isStopping;
+        uint32_t delayMs;
+        uint32_t queryNb;
+        std::mutex lock;
+        std::thread serverThread;
+        std::map<std::string, Record> records;
+
+        void serveQueries(void);
+        size_t buildAnswer(const uint8_t* query, size_t len,
+                            uint8_t* answer);
+
+    public:
+        LoopbackDnsServer(void);
+        ~LoopbackDnsServer(void);
+        bool start(void);
+        void stop(void);
+        std::string getAddress(void) const;
+        void setRecord(const std::string& name, const std::string& address,
+                        uint32_t ttlS);
+        void setDelayMs(uint32_t delay);
+        uint32_t getQueryNb(void);
+};
+
+#endif /* LOOPBACK_DNS_SERVER_H */
+
+/*** end of file ***/
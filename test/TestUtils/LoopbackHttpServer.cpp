@@ -0,0 +1,333 @@
+/** @file LoopbackHttpServer.cpp
+ *
+ * @brief Minimal HTTP/1.1 server on the loopback interface, for the unit
+ * tests of the uploads. It keeps the body of each request and answers with
+ * the status codes queued by the test.
+ *
+ * Each connection is served by its own thread, so that a held response on
+ * one connection does not stop the requests arriving on the others.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "LoopbackHttpServer.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+/* Period at which the threads check that the server is stopping */
+static const int32_t SERVER_POLL_MS = 100;
+
+/*!
+ * @brief Constructor for LoopbackHttpServer. start() must be called before
+ * use.
+ * */
+LoopbackHttpServer::LoopbackHttpServer(void) : listenFd(-1), port(0),
+                                                isStopping(false),
+                                                isHeld(false)
+{
+}
+
+/*!
+ * @brief Destructor for LoopbackHttpServer
+ * */
+LoopbackHttpServer::~LoopbackHttpServer(void)
+{
+    stop();
+}
+
+/*!
+ * @brief Listen on an ephemeral port of the loopback interface
+ *
+ * @return Status of the operation
+ * */
+bool LoopbackHttpServer::start(void)
+{
+    struct sockaddr_in address;
+    socklen_t addressLen = sizeof(address);
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if ((listenFd < 0) ||
+        (bind(listenFd, (struct sockaddr*) &address, sizeof(address)) != 0) ||
+        (listen(listenFd, 8) != 0) ||
+        (getsockname(listenFd, (struct sockaddr*) &address,
+                                                        &addressLen) != 0))
+    {
+        LE_ERROR("Failed to listen on the loopback: %m");
+        return false;
+    }
+
+    port = ntohs(address.sin_port);
+    acceptThread = std::thread(&LoopbackHttpServer::acceptConnections, this);
+
+    return true;
+}
+
+/*!
+ * @brief Close the connections and wait for their threads
+ *
+ * @return None
+ * */
+void LoopbackHttpServer::stop(void)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        isStopping = true;
+    }
+
+    heldCondition.notify_all();
+
+    if (acceptThread.joinable())
+    {
+        acceptThread.join();
+    }
+
+    for (size_t i = 0; i < connectionThreads.size(); i++)
+    {
+        connectionThreads[i].join();
+    }
+
+    connectionThreads.clear();
+
+    if (listenFd >= 0)
+    {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+/*!
+ * @brief Get the URL to post to
+ *
+ * @return URL of the server
+ * */
+std::string LoopbackHttpServer::getUrl(void) const
+{
+    return "http://127.0.0.1:" + std::to_string(port) + "/v1/pdu";
+}
+
+/*!
+ * @brief Queue the status of a coming response. The responses are 200 once
+ * the queue is empty.
+ *
+ * @param[in] status    HTTP status code
+ *
+ * @return None
+ * */
+void LoopbackHttpServer::queueStatus(int32_t status)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    statuses.push_back(status);
+}
+
+/*!
+ * @brief Hold the responses: the requests are received and kept, but not
+ * answered until the responses are released
+ *
+ * @param[in] isHeldNow     True to hold, false to release
+ *
+ * @return None
+ * */
+void LoopbackHttpServer::hold(bool isHeldNow)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        isHeld = isHeldNow;
+    }
+
+    heldCondition.notify_all();
+}
+
+/*!
+ * @brief Get the number of requests received
+ *
+ * @return Number of requests whose body was received
+ * */
+size_t LoopbackHttpServer::getRequestNb(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return bodies.size();
+}
+
+/*!
+ * @brief Get the body of a request
+ *
+ * @param[in] index     Rank of the request, in the order of arrival
+ *
+ * @return Body of the request, empty if there is no such request
+ * */
+std::vector<uint8_t> LoopbackHttpServer::getBody(size_t index)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    return (index < bodies.size()) ? bodies[index] : std::vector<uint8_t>();
+}
+
+/*!
+ * @brief Accept the connections, each one served by a thread of its own
+ *
+ * @return None
+ * */
+void LoopbackHttpServer::acceptConnections(void)
+{
+    struct pollfd pollFd = {listenFd, POLLIN, 0};
+
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (isStopping)
+            {
+                return;
+            }
+        }
+
+        if (poll(&pollFd, 1, SERVER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        int32_t fd = accept(listenFd, NULL, NULL);
+
+        if (fd >= 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            connectionThreads.push_back(
+                std::thread(&LoopbackHttpServer::serveConnection, this, fd));
+        }
+    }
+}
+
+/*!
+ * @brief Read a request, until its whole body is received
+ *
+ * @param[in] fd            Socket of the connection
+ * @param[in,out] buffer    Bytes received and not used yet
+ * @param[out] body         Body of the request
+ *
+ * @return False if the connection is closed or the server stopping
+ * */
+bool LoopbackHttpServer::readRequest(int32_t fd, std::string& buffer,
+                                        std::vector<uint8_t>& body)
+{
+    struct pollfd pollFd = {fd, POLLIN, 0};
+    size_t headerEnd = std::string::npos;
+    size_t contentLength = 0;
+    char data[4096];
+
+    while ((headerEnd == std::string::npos) ||
+           (buffer.size() < (headerEnd + contentLength)))
+    {
+        if (headerEnd == std::string::npos)
+        {
+            size_t end = buffer.find("\r\n\r\n");
+
+            if (end != std::string::npos)
+            {
+                size_t field = buffer.find("Content-Length:");
+
+                headerEnd = end + 4;
+
+                if ((field != std::string::npos) && (field < end))
+                {
+                    contentLength = strtoul(buffer.c_str() + field + 15,
+                                            NULL, 10);
+                }
+
+                continue;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (isStopping)
+            {
+                return false;
+            }
+        }
+
+        if (poll(&pollFd, 1, SERVER_POLL_MS) <= 0)
+        {
+            continue;
+        }
+
+        ssize_t len = recv(fd, data, sizeof(data), 0);
+
+        if (len <= 0)
+        {
+            return false;
+        }
+
+        buffer.append(data, len);
+    }
+
+    body.assign(buffer.begin() + headerEnd,
+                buffer.begin() + headerEnd + contentLength);
+    buffer.erase(0, headerEnd + contentLength);
+
+    return true;
+}
+
+/*!
+ * @brief Serve the requests of a connection until it is closed
+ *
+ * @param[in] fd    Socket of the connection
+ *
+ * @return None
+ * */
+void LoopbackHttpServer::serveConnection(int32_t fd)
+{
+    std::string buffer;
+    std::vector<uint8_t> body;
+
+    while (readRequest(fd, buffer, body))
+    {
+        int32_t status = 200;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+
+            bodies.push_back(body);
+
+            if (!statuses.empty())
+            {
+                status = statuses.front();
+                statuses.pop_front();
+            }
+
+            while (isHeld && !isStopping)
+            {
+                heldCondition.wait(guard);
+            }
+        }
+
+        std::string response = "HTTP/1.1 " + std::to_string(status) +
+                                " Test\r\nContent-Length: 0\r\n\r\n";
+
+        if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) !=
+                                                    (ssize_t) response.size())
+        {
+            break;
+        }
+    }
+
+    close(fd);
+}
+
+/*** end of file ***/
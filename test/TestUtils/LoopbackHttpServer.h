@@ -0,0 +1,55 @@
+/** @file LoopbackHttpServer.h
+ *
+ * @brief Minimal HTTP/1.1 server on the loopback interface, for the unit
+ * tests of the uploads. It keeps the body of each request and answers with
+ * the status codes queued by the test.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#ifndef LOOPBACK_HTTP_SERVER_H
+#define LOOPBACK_HTTP_SERVER_H
+
+#include "legato.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LoopbackHttpServer
+{
+    private:
+        int32_t listenFd;
+        uint16_t port;
+        bool isStopping;
+        bool isHeld;
+        std::mutex lock;
+        std::condition_variable heldCondition;
+        std::thread acceptThread;
+        std::vector<std::thread> connectionThreads;
+        std::deque<int32_t> statuses;
+        std::vector<std::vector<uint8_t> > bodies;
+
+        void acceptConnections(void);
+        void serveConnection(int32_t fd);
+        bool readRequest(int32_t fd, std::string& buffer,
+                            std::vector<uint8_t>& body);
+
+    public:
+        LoopbackHttpServer(void);
+        ~LoopbackHttpServer(void);
+        bool start(void);
+        void stop(void);
+        std::string getUrl(void) const;
+        void queueStatus(int32_t status);
+        void hold(bool isHeldNow);
+        size_t getRequestNb(void);
+        std::vector<uint8_t> getBody(size_t index);
+};
+
+#endif /* LOOPBACK_HTTP_SERVER_H */
+
+/*** end of file ***/
@@ -0,0 +1,360 @@
+/** @file UplinkBatcherTest.cpp
+ *
+ * @brief Unit test of UplinkBatcher, uploading through HttpUploader to a
+ * server on the loopback: batches sealed on size and on flush, alerts sent
+ * alone and uncompressed, and the back-pressure of a full uploader
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/UplinkBatcher.h"
+#include "Uplink/UplinkBatcherUtils.h"
+#include "Com/WearableDeviceALPUtils.h"
+#include "../../TestUtils/LoopbackHttpServer.h"
+
+using namespace HttpUploaderConstants;
+using namespace HttpUploaderTypes;
+using namespace UplinkBatcherConstants;
+
+static const uint8_t TEST_MAC[WearableDeviceALPConstants::MAC_ADDRESS_SIZE] =
+{
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+static const uint8_t TEST_PDU_TYPE = 7;
+static const uint32_t TEST_PDU_SIZE = 1000;
+static const uint32_t TEST_DRAIN_SEC = 20;
+
+/* PDU read back from a batch */
+struct TestPdu
+{
+    uint8_t type;
+    uint32_t index;
+    uint32_t len;
+};
+
+/*!
+ * @brief Build the payload of a PDU, starting with its index
+ *
+ * @param[in] index     Index of the PDU
+ *
+ * @return Payload
+ * */
+static std::vector<uint8_t> makePdu(uint32_t index)
+{
+    std::vector<uint8_t> data(TEST_PDU_SIZE);
+
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = i % 32;
+    }
+
+    memcpy(data.data(), &index, sizeof(index));
+
+    return data;
+}
+
+/*!
+ * @brief Decode a batch as the server would and check its PDUs
+ *
+ * @param[in] batch     Body of the request
+ * @param[out] flags    Flags of the batch
+ * @param[out] pdus     PDUs of the batch
+ *
+ * @return True if the batch is well formed and the payloads are intact
+ * */
+static bool decodeBatch(const std::vector<uint8_t>& batch, uint8_t* flags,
+                        std::vector<TestPdu>& pdus)
+{
+    pdus.clear();
+
+    if ((batch.size() < BATCH_HEADER_SIZE) ||
+        (batch[0] != BATCH_FORMAT_VERSION))
+    {
+        return false;
+    }
+
+    uint16_t pduNb = batch[2] | (batch[3] << 8);
+    uLongf rawSize = batch[4] | (batch[5] << 8) | (batch[6] << 16) |
+                        ((uint32_t) batch[7] << 24);
+    std::vector<uint8_t> body(rawSize);
+
+    *flags = batch[1];
+
+    if ((*flags & BATCH_FLAG_DEFLATE) != 0)
+    {
+        if ((uncompress(body.data(), &rawSize, &batch[BATCH_HEADER_SIZE],
+                        batch.size() - BATCH_HEADER_SIZE) != Z_OK) ||
+            (rawSize != body.size()))
+        {
+            return false;
+        }
+    }
+    else if (batch.size() != (BATCH_HEADER_SIZE + rawSize))
+    {
+        return false;
+    }
+    else
+    {
+        body.assign(batch.begin() + BATCH_HEADER_SIZE, batch.end());
+    }
+
+    size_t offset = 0;
+
+    while ((offset + BATCH_PDU_HEADER_SIZE) <= body.size())
+    {
+        TestPdu pdu;
+        const uint8_t* pduPtr = &body[offset];
+
+        pdu.type = pduPtr[0];
+        pdu.len = pduPtr[7] | (pduPtr[8] << 8) | (pduPtr[9] << 16) |
+                    ((uint32_t) pduPtr[10] << 24);
+        offset += BATCH_PDU_HEADER_SIZE;
+
+        if ((memcmp(&pduPtr[1], TEST_MAC, sizeof(TEST_MAC)) != 0) ||
+            (pdu.len != TEST_PDU_SIZE) || ((offset + pdu.len) > body.size()))
+        {
+            return false;
+        }
+
+        memcpy(&pdu.index, &body[offset], sizeof(pdu.index));
+
+        if (makePdu(pdu.index) != std::vector<uint8_t>(&body[offset],
+                                                    &body[offset] + pdu.len))
+        {
+            return false;
+        }
+
+        offset += pdu.len;
+        pdus.push_back(pdu);
+    }
+
+    return (offset == body.size()) && (pdus.size() == pduNb);
+}
+
+/*!
+ * @brief Run the uploads until none is pending
+ *
+ * @param[in] uploader  Uploader
+ * @param[in] batcher   Batcher, given the batches it could not submit yet
+ *
+ * @return True if all the uploads completed in time
+ * */
+static bool drain(HttpUploader& uploader, UplinkBatcher& batcher)
+{
+    time_t endSec = le_clk_GetRelativeTime().sec + TEST_DRAIN_SEC;
+
+    while (le_clk_GetRelativeTime().sec < endSec)
+    {
+        batcher.process();
+        uploader.process(100);
+
+        if (uploader.getPendingNb() == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Check that the PDUs reach the server in order, in a batch sealed
+ * once it reaches the size threshold, then in a batch sealed by a flush
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testBatches(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    UplinkBatcher batcher(uploader);
+    uint32_t pduSize = BATCH_PDU_HEADER_SIZE + TEST_PDU_SIZE;
+    size_t firstRequest = server.getRequestNb();
+    std::vector<TestPdu> pdus;
+    std::vector<uint8_t> data;
+    uint8_t flags = 0;
+    bool isAdded = true;
+
+    LE_TEST(uploader.init() && batcher.init());
+
+    uint32_t thresholdNb = (batcher.getSizeThreshold() + pduSize - 1) /
+                                                                    pduSize;
+
+    for (uint32_t i = 0; i < (thresholdNb - 1); i++)
+    {
+        data = makePdu(i);
+        isAdded = isAdded && (batcher.add(TEST_PDU_TYPE, TEST_MAC,
+                                            data.data(), data.size()) == LE_OK);
+    }
+
+    LE_TEST(isAdded && (uploader.getPendingNb() == 0));
+
+    /* The PDU reaching the threshold seals the batch */
+    data = makePdu(thresholdNb - 1);
+    LE_TEST(batcher.add(TEST_PDU_TYPE, TEST_MAC, data.data(), data.size()) ==
+                                                                        LE_OK);
+    LE_TEST(uploader.getPendingNb() == 1);
+    LE_TEST(drain(uploader, batcher));
+    LE_TEST(server.getRequestNb() == (firstRequest + 1));
+
+    std::vector<uint8_t> batch = server.getBody(firstRequest);
+    bool isOrdered = true;
+
+    LE_TEST(decodeBatch(batch, &flags, pdus));
+    LE_TEST((flags == BATCH_FLAG_DEFLATE) && (pdus.size() == thresholdNb));
+    LE_TEST(batch.size() < (thresholdNb * pduSize / 2));
+
+    for (size_t i = 0; i < pdus.size(); i++)
+    {
+        isOrdered = isOrdered && (pdus[i].type == TEST_PDU_TYPE) &&
+                    (pdus[i].index == i);
+    }
+
+    LE_TEST(isOrdered);
+
+    /* A few PDUs, sent by a flush */
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        data = makePdu(thresholdNb + i);
+        batcher.add(TEST_PDU_TYPE, TEST_MAC, data.data(), data.size());
+    }
+
+    LE_TEST(uploader.getPendingNb() == 0);
+    batcher.flush();
+    LE_TEST(drain(uploader, batcher));
+    LE_TEST(server.getRequestNb() == (firstRequest + 2));
+    LE_TEST(decodeBatch(server.getBody(firstRequest + 1), &flags, pdus));
+    LE_TEST((pdus.size() == 3) && (pdus[0].index == thresholdNb) &&
+            (pdus[2].index == (thresholdNb + 2)));
+
+    /* Nothing to send */
+    batcher.flush();
+    LE_TEST(uploader.getPendingNb() == 0);
+    batcher.logStats();
+}
+
+/*!
+ * @brief Check that an alert is sent at once, alone and uncompressed, while
+ * bulk PDUs are held in the current batch
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testUrgent(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    UplinkBatcher batcher(uploader);
+    size_t firstRequest = server.getRequestNb();
+    std::vector<TestPdu> pdus;
+    std::vector<uint8_t> data = makePdu(1);
+    uint8_t flags = BATCH_FLAG_DEFLATE;
+
+    LE_TEST(uploader.init() && batcher.init());
+    batcher.add(TEST_PDU_TYPE, TEST_MAC, data.data(), data.size());
+
+    data = makePdu(2);
+    LE_TEST(batcher.sendNow(TRAFFIC_CLASS_ALERT, TEST_PDU_TYPE + 1, TEST_MAC,
+                            data.data(), data.size()) == LE_OK);
+    LE_TEST(uploader.getPendingNb() == 1);
+    LE_TEST(drain(uploader, batcher));
+    LE_TEST(server.getRequestNb() == (firstRequest + 1));
+    LE_TEST(decodeBatch(server.getBody(firstRequest), &flags, pdus));
+    LE_TEST((flags == 0) && (pdus.size() == 1) && (pdus[0].index == 2) &&
+            (pdus[0].type == (TEST_PDU_TYPE + 1)));
+}
+
+/*!
+ * @brief Fill the uploader queue and the sealed batches, check that the
+ * next PDU is refused with LE_BUSY, and that everything is delivered in
+ * order once the uploads move again and the refused PDU is offered again
+ *
+ * @param[in] server    Loopback server
+ *
+ * @return None
+ * */
+static void testBackPressure(LoopbackHttpServer& server)
+{
+    HttpUploader uploader(server.getUrl());
+    UplinkBatcher batcher(uploader);
+    size_t firstRequest = server.getRequestNb();
+    uint32_t acceptedNb = 0;
+    std::vector<uint8_t> data;
+    le_result_t result = LE_OK;
+
+    LE_TEST(uploader.init() && batcher.init());
+
+    /* One batch per PDU, nothing uploaded while the queues fill */
+    while ((acceptedNb <= (uint32_t) (UPLOADER_CLASS_MAX_QUEUED[
+                            TRAFFIC_CLASS_BULK] + BATCH_MAX_SEALED)) &&
+           (result == LE_OK))
+    {
+        data = makePdu(acceptedNb);
+        result = batcher.add(TEST_PDU_TYPE, TEST_MAC, data.data(),
+                                data.size());
+
+        if (result == LE_OK)
+        {
+            batcher.flush();
+            acceptedNb++;
+        }
+    }
+
+    LE_TEST(result == LE_BUSY);
+    LE_TEST(acceptedNb == (uint32_t) (UPLOADER_CLASS_MAX_QUEUED[
+                                    TRAFFIC_CLASS_BULK] + BATCH_MAX_SEALED));
+    LE_TEST(uploader.getPendingNb() ==
+                                UPLOADER_CLASS_MAX_QUEUED[TRAFFIC_CLASS_BULK]);
+
+    /* The refused PDU is offered again until it is taken */
+    for (uint32_t i = 0; (i < 100) && (result == LE_BUSY); i++)
+    {
+        uploader.process(100);
+        batcher.process();
+        result = batcher.add(TEST_PDU_TYPE, TEST_MAC, data.data(),
+                                data.size());
+    }
+
+    LE_TEST(result == LE_OK);
+    batcher.flush();
+    LE_TEST(drain(uploader, batcher));
+    LE_TEST(server.getRequestNb() == (firstRequest + acceptedNb + 1));
+
+    std::vector<TestPdu> pdus;
+    uint8_t flags;
+    bool isOrdered = true;
+
+    for (uint32_t i = 0; i <= acceptedNb; i++)
+    {
+        isOrdered = isOrdered &&
+                    decodeBatch(server.getBody(firstRequest + i), &flags,
+                                pdus) &&
+                    (pdus.size() == 1) && (pdus[0].index == i);
+    }
+
+    LE_TEST(isOrdered);
+    batcher.logStats();
+}
+
+COMPONENT_INIT
+{
+    LoopbackHttpServer server;
+
+    LE_TEST_INIT;
+
+    LE_TEST(server.start());
+
+    testBatches(server);
+    testUrgent(server);
+    testBackPressure(server);
+
+    server.stop();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
@@ -0,0 +1,68 @@
+/** @file UplinkModeSelectorTest.cpp
+ *
+ * @brief Unit test of UplinkModeSelector: switching on the thresholds, and
+ * the dwell that only starts at the first switch
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Uplink/UplinkModeSelector.h"
+
+using namespace UplinkModeSelectorConstants;
+using namespace UplinkModeSelectorTypes;
+
+/*!
+ * @brief Check the thresholds of the summary mode
+ *
+ * @return None
+ * */
+static void testThresholds(void)
+{
+    UplinkModeSelector selector;
+
+    LE_TEST(selector.getMode() == UPLINK_MODE_RAW);
+
+    /* Between the two sets of thresholds nothing changes */
+    LE_TEST(selector.update(MODE_SUMMARY_KBPS, MODE_SUMMARY_BACKLOG) ==
+                                                            UPLINK_MODE_RAW);
+
+    /* Nothing uploaded yet: only the backlog counts */
+    LE_TEST(selector.update(0, MODE_RAW_BACKLOG) == UPLINK_MODE_RAW);
+
+    UplinkModeSelector backlogSelector;
+
+    LE_TEST(backlogSelector.update(0, MODE_SUMMARY_BACKLOG + 1) ==
+                                                        UPLINK_MODE_SUMMARY);
+}
+
+/*!
+ * @brief Check that a degraded uplink right after startup is acted on at
+ * once, and that the next switch waits for the dwell
+ *
+ * @return None
+ * */
+static void testDwell(void)
+{
+    UplinkModeSelector selector;
+
+    LE_TEST(selector.update(MODE_SUMMARY_KBPS - 1, 0) == UPLINK_MODE_SUMMARY);
+
+    /* Recovered, but the dwell of the switch is not over */
+    LE_TEST(selector.update(MODE_RAW_KBPS + 1, 0) == UPLINK_MODE_SUMMARY);
+    LE_TEST(selector.getMode() == UPLINK_MODE_SUMMARY);
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    testThresholds();
+    testDwell();
+
+    LE_TEST_EXIT;
+}
+
+/*** end of file ***/
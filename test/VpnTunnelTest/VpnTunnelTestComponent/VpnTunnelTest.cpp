@@ -0,0 +1,509 @@
+/** @file VpnTunnelTest.cpp
+ *
+ * @brief Unit test of VpnTunnel with a stand-in OpenVPN. The stand-in is a
+ * script which tells the test it started, through a FIFO, then waits to be
+ * killed; the test serves its management interface. It checks the release
+ * of the hold, the tunnel going up and down on the states reported, the
+ * back-off between the restarts, and the kill of an OpenVPN whose management
+ * interface can't be reached.
+ * It uses the management socket of the hub tunnel, so it must not run with
+ * the VPN of the hub.
+ *
+ * @par
+ * COPYRIGHT NOTICE: (c) 2019 Current Health ltd. All rights reserved.
+ */
+
+#include "legato.h"
+#include "interfaces.h"
+#include "Network/VpnTunnel.h"
+#include <fstream>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <vector>
+
+using namespace VpnTunnelConstants;
+using namespace VpnTunnelTypes;
+
+/* Margin allowed on the times measured */
+static const uint32_t TEST_MARGIN_MS = 500;
+
+/* The test fails if it is not over within this delay */
+static const uint32_t TEST_TIMEOUT_MS = 30000;
+
+static const char* TEST_LOCAL_ADDRESS = "10.8.0.6";
+static const char* TEST_NEW_LOCAL_ADDRESS = "10.8.0.7";
+static const char* TEST_REMOTE_ADDRESS = "127.0.0.1";
+
+/* Directory of the stand-in and of its FIFO */
+static std::string ToolDir;
+
+static VpnTunnel* TunnelPtr;
+
+/* FIFO receiving the process identifiers of the stand-ins started */
+static int FifoFd = -1;
+static int FifoWriteFd = -1;
+
+/* Management interface served to the tunnel */
+static int ListenFd = -1;
+static le_fdMonitor_Ref_t ListenMonitorRef;
+static int ClientFd = -1;
+static le_fdMonitor_Ref_t ClientMonitorRef;
+static std::string ClientInput;
+
+/* Commands received on the management interface */
+static std::vector<std::string> Commands;
+
+static le_timer_Ref_t CheckTimer;
+static le_timer_Ref_t TestTimer;
+
+/* Starts of the stand-in, and when the last one was killed by the test */
+static pid_t StandInPid;
+static std::vector<uint64_t> StartTimesMs;
+static uint64_t KillMs;
+
+static uint32_t UpNb;
+static uint32_t DownNb;
+
+/*!
+ * @brief Get the monotonic time in milliseconds
+ *
+ * @return Number of milliseconds since an arbitrary point in the past
+ * */
+static uint64_t getNowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*!
+ * @brief Install the stand-in OpenVPN: it writes its process identifier to
+ * the FIFO, then sleeps until it is killed
+ *
+ * @return Status of the operation
+ * */
+static bool installStandIn(void)
+{
+    char dir[] = "/tmp/vpnTunnelTestXXXXXX";
+
+    if (mkdtemp(dir) == NULL)
+    {
+        return false;
+    }
+
+    ToolDir = dir;
+
+    std::string path = ToolDir + "/openvpn";
+    std::ofstream file(path.c_str());
+
+    file << "#!/bin/sh\n"
+            "echo $$ > " << ToolDir << "/started\n"
+            "exec sleep 600\n";
+    file.close();
+
+    if (file.fail() || (chmod(path.c_str(), 0700) != 0) ||
+        (mkfifo((ToolDir + "/started").c_str(), 0600) != 0))
+    {
+        return false;
+    }
+
+    /* Kept open for writing too, so that the FIFO never reads an end */
+    FifoFd = open((ToolDir + "/started").c_str(),
+                    O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    FifoWriteFd = open((ToolDir + "/started").c_str(),
+                        O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+    return (FifoFd >= 0) && (FifoWriteFd >= 0);
+}
+
+/*!
+ * @brief Remove the stand-in and its FIFO
+ *
+ * @return None
+ * */
+static void removeStandIn(void)
+{
+    ::close(FifoFd);
+    ::close(FifoWriteFd);
+    unlink((ToolDir + "/openvpn").c_str());
+    unlink((ToolDir + "/started").c_str());
+    rmdir(ToolDir.c_str());
+}
+
+/*!
+ * @brief Send a line on the management interface
+ *
+ * @param[in] text  Line, without the end of line
+ *
+ * @return None
+ * */
+static void sendLine(const std::string& text)
+{
+    std::string line = text + "\r\n";
+
+    LE_TEST(write(ClientFd, line.c_str(), line.size()) ==
+            (ssize_t) line.size());
+}
+
+/*!
+ * @brief Report the tunnel connected
+ *
+ * @param[in] localAddress  Address of the hub in the tunnel
+ *
+ * @return None
+ * */
+static void sendConnected(const char* localAddress)
+{
+    sendLine(std::string(">STATE:1,CONNECTED,SUCCESS,") + localAddress + "," +
+                TEST_REMOTE_ADDRESS + ",1194,,");
+}
+
+/*!
+ * @brief Close the connection to the tunnel
+ *
+ * @return None
+ * */
+static void closeClient(void)
+{
+    if (ClientFd >= 0)
+    {
+        le_fdMonitor_Delete(ClientMonitorRef);
+        ::close(ClientFd);
+        ClientFd = -1;
+    }
+}
+
+/*!
+ * @brief Stop serving the management interface
+ *
+ * @return None
+ * */
+static void closeServer(void)
+{
+    closeClient();
+
+    if (ListenFd >= 0)
+    {
+        le_fdMonitor_Delete(ListenMonitorRef);
+        ::close(ListenFd);
+        ListenFd = -1;
+        unlink(VPN_MANAGEMENT_PATH.c_str());
+    }
+}
+
+/*!
+ * @brief Handler of the connection to the tunnel: the commands are kept, the
+ * hold release is answered by the tunnel connected
+ *
+ * @param[in] fd        Socket of the connection
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+static void clientHandler(int fd, short events)
+{
+    char buffer[256];
+    ssize_t readNb = read(fd, buffer, sizeof(buffer));
+    size_t endPos;
+
+    if (readNb <= 0)
+    {
+        closeClient();
+        return;
+    }
+
+    ClientInput.append(buffer, readNb);
+
+    while ((endPos = ClientInput.find('\n')) != std::string::npos)
+    {
+        std::string command = ClientInput.substr(0, endPos);
+
+        ClientInput.erase(0, endPos + 1);
+        Commands.push_back(command);
+
+        if (command == "hold release")
+        {
+            sendLine("SUCCESS: hold release succeeded");
+            sendConnected((UpNb == 0) ? TEST_LOCAL_ADDRESS :
+                                        TEST_NEW_LOCAL_ADDRESS);
+        }
+        else
+        {
+            sendLine("SUCCESS: done");
+        }
+    }
+}
+
+/*!
+ * @brief Accept the connection of the tunnel, and hold OpenVPN
+ *
+ * @param[in] fd        Listening socket
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+static void listenHandler(int fd, short events)
+{
+    int clientFd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (clientFd < 0)
+    {
+        return;
+    }
+
+    closeClient();
+    ClientFd = clientFd;
+    ClientInput.clear();
+    ClientMonitorRef = le_fdMonitor_Create("TestVpnClient", ClientFd,
+                                            clientHandler, POLLIN);
+
+    sendLine(">INFO:OpenVPN Management Interface Version 1");
+    sendLine(">HOLD:Waiting for hold release:0");
+}
+
+/*!
+ * @brief Serve the management interface of the stand-in started
+ *
+ * @return None
+ * */
+static void serveManagement(void)
+{
+    struct sockaddr_un addr;
+
+    closeServer();
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+                VPN_MANAGEMENT_PATH.c_str());
+
+    ListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    LE_TEST((ListenFd >= 0) &&
+            (bind(ListenFd, (struct sockaddr*) &addr, sizeof(addr)) == 0) &&
+            (listen(ListenFd, 1) == 0));
+
+    ListenMonitorRef = le_fdMonitor_Create("TestVpnListen", ListenFd,
+                                            listenHandler, POLLIN);
+}
+
+/*!
+ * @brief Check, once the management timeout is over, that the stand-in
+ * without management interface was killed and waits for its restart
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void checkTimerHandler(le_timer_Ref_t timerRef)
+{
+    LE_TEST(TunnelPtr->getState() == TUNNEL_WAITING);
+    LE_TEST(kill(StandInPid, 0) != 0);
+    LE_TEST(StartTimesMs.size() == 2);
+}
+
+/*!
+ * @brief Handler of the test timer: the tunnel is stuck. End of the test.
+ *
+ * @param[in] timerRef  Reference to the timer
+ *
+ * @return None
+ * */
+static void testTimerHandler(le_timer_Ref_t timerRef)
+{
+    LE_TEST(false);
+
+    TunnelPtr->logStats();
+    TunnelPtr->stop();
+    closeServer();
+    removeStandIn();
+
+    LE_TEST_EXIT;
+}
+
+/*!
+ * @brief Handler of the FIFO, written by each stand-in started. The first
+ * and third ones are served, the second one is left without management
+ * interface.
+ *
+ * @param[in] fd        FIFO
+ * @param[in] events    Events received
+ *
+ * @return None
+ * */
+static void fifoHandler(int fd, short events)
+{
+    char buffer[32];
+    ssize_t readNb = read(fd, buffer, sizeof(buffer) - 1);
+    uint64_t nowMs = getNowMs();
+
+    if (readNb <= 0)
+    {
+        return;
+    }
+
+    buffer[readNb] = '\0';
+    StandInPid = atoi(buffer);
+    StartTimesMs.push_back(nowMs);
+
+    switch (StartTimesMs.size())
+    {
+        case 1:
+            serveManagement();
+            break;
+
+        case 2:
+            /* First restart, after the minimum delay */
+            LE_TEST((nowMs - KillMs) >= VPN_RESTART_MIN_MS);
+            LE_TEST((nowMs - KillMs) < (VPN_RESTART_MIN_MS + TEST_MARGIN_MS));
+
+            le_timer_SetMsInterval(CheckTimer, VPN_MANAGEMENT_TIMEOUT_MS +
+                                                TEST_MARGIN_MS);
+            le_timer_Start(CheckTimer);
+            break;
+
+        case 3:
+            /* Killed at the management timeout, restarted after twice the
+             * delay */
+            LE_TEST((nowMs - StartTimesMs[1]) >=
+                    (VPN_MANAGEMENT_TIMEOUT_MS + 2 * VPN_RESTART_MIN_MS));
+            LE_TEST((nowMs - StartTimesMs[1]) <
+                    (VPN_MANAGEMENT_TIMEOUT_MS + 2 * VPN_RESTART_MIN_MS +
+                        TEST_MARGIN_MS));
+
+            serveManagement();
+            break;
+
+        default:
+            LE_TEST(false);
+            break;
+    }
+}
+
+/*!
+ * @brief Check if a command was received on the management interface
+ *
+ * @param[in] command   Command
+ *
+ * @return True if it was received
+ * */
+static bool isCommandReceived(const std::string& command)
+{
+    for (size_t i = 0; i < Commands.size(); i++)
+    {
+        if (Commands[i] == command)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*!
+ * @brief Handler of the tunnel events, which runs the test: up, down and up
+ * again on the states reported, down when the stand-in is killed, then up
+ * after its restarts, and stopped. End of the test.
+ *
+ * @param[in] eventPtr      Event
+ * @param[in] contextPtr    Not used
+ *
+ * @return None
+ * */
+static void tunnelHandler(const TunnelEvent* eventPtr, void* contextPtr)
+{
+    if (eventPtr->type == TUNNEL_EVENT_UP)
+    {
+        UpNb++;
+
+        LE_TEST(TunnelPtr->getState() == TUNNEL_UP);
+        LE_TEST(strcmp(eventPtr->remoteAddress, TEST_REMOTE_ADDRESS) == 0);
+
+        switch (UpNb)
+        {
+            case 1:
+                /* The state changes were asked for before the release */
+                LE_TEST(isCommandReceived("state on"));
+                LE_TEST(isCommandReceived("hold release"));
+                LE_TEST(strcmp(eventPtr->localAddress,
+                                TEST_LOCAL_ADDRESS) == 0);
+
+                sendLine(">STATE:2,RECONNECTING,ping-restart,,,,,");
+                break;
+
+            case 2:
+                LE_TEST(strcmp(eventPtr->localAddress,
+                                TEST_NEW_LOCAL_ADDRESS) == 0);
+
+                /* OpenVPN exits */
+                KillMs = getNowMs();
+                LE_TEST(kill(StandInPid, SIGTERM) == 0);
+                break;
+
+            case 3:
+                LE_TEST(DownNb == 2);
+
+                TunnelPtr->stop();
+
+                LE_TEST(DownNb == 3);
+                LE_TEST(TunnelPtr->getState() == TUNNEL_STOPPED);
+
+                TunnelPtr->logStats();
+                closeServer();
+                removeStandIn();
+
+                LE_TEST_EXIT;
+                break;
+
+            default:
+                LE_TEST(false);
+                break;
+        }
+    }
+    else if (eventPtr->type == TUNNEL_EVENT_DOWN)
+    {
+        DownNb++;
+
+        if (DownNb == 1)
+        {
+            /* OpenVPN reconnects by itself, it is not restarted */
+            LE_TEST(TunnelPtr->getState() == TUNNEL_CONNECTING);
+            LE_TEST(StartTimesMs.size() == 1);
+
+            sendConnected(TEST_NEW_LOCAL_ADDRESS);
+        }
+    }
+}
+
+COMPONENT_INIT
+{
+    LE_TEST_INIT;
+
+    LE_TEST(installStandIn());
+
+    le_fdMonitor_Create("TestVpnFifo", FifoFd, fifoHandler, POLLIN);
+
+    CheckTimer = le_timer_Create("TestVpnCheckTimer");
+    le_timer_SetHandler(CheckTimer, checkTimerHandler);
+
+    TestTimer = le_timer_Create("TestVpnTimer");
+    le_timer_SetMsInterval(TestTimer, TEST_TIMEOUT_MS);
+    le_timer_SetHandler(TestTimer, testTimerHandler);
+    le_timer_Start(TestTimer);
+
+    TunnelPtr = new VpnTunnel();
+    TunnelPtr->setCommand({ToolDir + "/openvpn"});
+
+    LE_TEST(TunnelPtr->subscribe(TUNNEL_EVENT_UP | TUNNEL_EVENT_DOWN,
+                                    tunnelHandler, NULL) >= 0);
+    LE_TEST(TunnelPtr->start());
+    LE_TEST(TunnelPtr->getState() == TUNNEL_CONNECTING);
+}
+
+/*** end of file ***/